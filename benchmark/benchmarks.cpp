@@ -0,0 +1,397 @@
+#include <benchmark/benchmark.h>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <streambuf>
+
+#include "report_builder/report_builder.h"
+
+namespace fs = std::filesystem;
+using namespace report_builder;
+
+namespace {
+    // Параметры синтетических таблиц задаются переменными окружения:
+    //   REPORT_BUILDER_BENCH_MIN_ROWS / MAX_ROWS - диапазон размеров (по умолчанию 10K..10M)
+    //   REPORT_BUILDER_BENCH_WIDTH - число колонок (не меньше 4, по умолчанию 8)
+    //   REPORT_BUILDER_BENCH_TYPES - типы дополнительных колонок по кругу:
+    //     i - int, d - double, s - string, b - bool (по умолчанию "idsb")
+    struct TBenchConfig {
+        int64_t MinRows = 10'000;
+        int64_t MaxRows = 10'000'000;
+        size_t Width = 8;
+        std::string TypeMix = "idsb";
+    };
+
+    const TBenchConfig& GetConfig() {
+        static const TBenchConfig config = [] {
+            TBenchConfig result;
+            if (const char* value = std::getenv("REPORT_BUILDER_BENCH_MIN_ROWS")) {
+                result.MinRows = std::max<int64_t>(std::atoll(value), 1);
+            }
+            if (const char* value = std::getenv("REPORT_BUILDER_BENCH_MAX_ROWS")) {
+                result.MaxRows = std::max<int64_t>(std::atoll(value), result.MinRows);
+            }
+            if (const char* value = std::getenv("REPORT_BUILDER_BENCH_WIDTH")) {
+                result.Width = std::max<size_t>(std::atoll(value), 4);
+            }
+            if (const char* value = std::getenv("REPORT_BUILDER_BENCH_TYPES"); value && *value) {
+                result.TypeMix = value;
+            }
+            return result;
+        }();
+        return config;
+    }
+
+    // Таблица в формате продаж: product, region, units, price и дополнительные колонки
+    DataTable GenerateTable(int64_t rows) {
+        const auto& config = GetConfig();
+        static const std::vector<std::string> regions = {"North", "South", "East", "West", "Center"};
+
+        std::mt19937_64 rng(42);
+        std::uniform_int_distribution<int> units(1, 100);
+        std::uniform_real_distribution<double> price(10.0, 2000.0);
+
+        DataTable table;
+        table.reserve(rows);
+        for (int64_t i = 0; i < rows; i++) {
+            DataRow row;
+            row["product"] = "Product" + std::to_string(rng() % 50);
+            row["region"] = regions[rng() % regions.size()];
+            row["units"] = units(rng);
+            row["price"] = price(rng);
+            for (size_t col = 4; col < config.Width; col++) {
+                std::string name = "col" + std::to_string(col);
+                switch (config.TypeMix[(col - 4) % config.TypeMix.size()]) {
+                    case 'i':
+                        row[name] = static_cast<int>(rng() % 1'000'000);
+                        break;
+                    case 'd':
+                        row[name] = price(rng);
+                        break;
+                    case 'b':
+                        row[name] = static_cast<bool>(rng() & 1);
+                        break;
+                    default:
+                        row[name] = "value" + std::to_string(rng() % 100'000);
+                        break;
+                }
+            }
+            table.push_back(std::move(row));
+        }
+        return table;
+    }
+
+    // Генерация не входит в измерения. Хранится только таблица последнего размера:
+    // повторные запуски одного бенчмарка ее переиспользуют, а при смене размера
+    // прежняя освобождается, так что в памяти не копятся таблицы всех размеров
+    const DataTable& GetTable(int64_t rows) {
+        static int64_t cachedRows = -1;
+        static DataTable cached;
+        if (cachedRows != rows) {
+            DataTable().swap(cached);
+            cached = GenerateTable(rows);
+            cachedRows = rows;
+        }
+        return cached;
+    }
+
+    // Поток, отбрасывающий все записанное
+    class TNullBuffer: public std::streambuf {
+    protected:
+        int overflow(int ch) override {
+            return traits_type::not_eof(ch);
+        }
+
+        std::streamsize xsputn(const char*, std::streamsize count) override {
+            return count;
+        }
+    };
+
+    // На время замера перенаправляет std::cout в пустой поток: экспорт в файл
+    // печатает путь на каждой итерации, и вывод в терминал искажал бы время
+    class TSilencedStdout {
+    private:
+        TNullBuffer Null;
+        std::streambuf* Original;
+
+    public:
+        TSilencedStdout()
+            : Original(std::cout.rdbuf(&Null)) {
+        }
+
+        ~TSilencedStdout() {
+            std::cout.rdbuf(Original);
+        }
+    };
+
+    const std::string& GetCsvFile(int64_t rows) {
+        static std::map<int64_t, std::string> files;
+        auto it = files.find(rows);
+        if (it != files.end()) {
+            return it->second;
+        }
+
+        std::string path = (fs::temp_directory_path() / ("report_builder_bench_" + std::to_string(rows) + ".csv")).string();
+        const auto& table = GetTable(rows);
+        std::ofstream file(path);
+        bool first = true;
+        for (const auto& [key, _] : table.front()) {
+            file << (first ? "" : ",") << key;
+            first = false;
+        }
+        file << "\n";
+        for (const auto& row : table) {
+            first = true;
+            for (const auto& [_, value] : row) {
+                file << (first ? "" : ",") << ValueToString(value);
+                first = false;
+            }
+            file << "\n";
+        }
+        return files.emplace(rows, path).first->second;
+    }
+
+    bool ExpensiveFilter(const DataRow& row) {
+        auto it = row.find("price");
+        return it != row.end() && std::holds_alternative<double>(it->second) && std::get<double>(it->second) > 500.0;
+    }
+
+    void SetRowCounters(benchmark::State& state, int64_t rows) {
+        state.SetItemsProcessed(state.iterations() * rows);
+        state.counters["rows"] = static_cast<double>(rows);
+    }
+
+    void BM_CsvDataProvider(benchmark::State& state) {
+        const auto& path = GetCsvFile(state.range(0));
+        for (auto _ : state) {
+            TCsvDataProvider provider(path);
+            auto result = provider.FetchData();
+            benchmark::DoNotOptimize(result.Data.data());
+        }
+        state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(fs::file_size(path)));
+        SetRowCounters(state, state.range(0));
+    }
+
+    // Обработчик получает таблицу по значению: копия делается вне замера
+    template <class TMakeProcessor>
+    void RunProcessor(benchmark::State& state, TMakeProcessor makeProcessor) {
+        const auto& table = GetTable(state.range(0));
+        auto processor = makeProcessor();
+        for (auto _ : state) {
+            state.PauseTiming();
+            DataTable input = table;
+            state.ResumeTiming();
+            auto result = processor->Process(std::move(input));
+            benchmark::DoNotOptimize(result.Data.data());
+            state.PauseTiming();
+            result = TOperationResult::Ok({});
+            state.ResumeTiming();
+        }
+        SetRowCounters(state, state.range(0));
+    }
+
+    void BM_FilterProcessor(benchmark::State& state) {
+        RunProcessor(state, [] { return std::make_unique<TFilterProcessor>(ExpensiveFilter, "price > 500"); });
+    }
+
+    void BM_SortProcessor(benchmark::State& state) {
+        RunProcessor(state, [] { return std::make_unique<TSortProcessor>("units", false); });
+    }
+
+    void BM_AggregationProcessor(benchmark::State& state) {
+        RunProcessor(state, [] { return std::make_unique<TAggregationProcessor>("price", "avg"); });
+    }
+
+    void BM_MultiAggregationProcessor(benchmark::State& state) {
+        RunProcessor(state, [] {
+            return std::make_unique<TMultiAggregationProcessor>(
+                std::vector<std::pair<std::string, std::string>>{{"units", "sum"}, {"price", "avg"}, {"price", "count"}});
+        });
+    }
+
+    // Тот же фильтр и агрегация через колоночные пачки, включая перевод таблицы в пачки
+    void BM_BatchPipeline(benchmark::State& state) {
+        RunProcessor(state, [] {
+            std::vector<std::unique_ptr<IBatchProcessor>> stages;
+            stages.push_back(std::make_unique<TBatchCompareFilter>("price", ECompareOp::Greater, 500.0));
+            stages.push_back(std::make_unique<TBatchAggregate>("price", "avg"));
+            return std::make_unique<TBatchPipelineProcessor>(std::move(stages));
+        });
+    }
+
+    void BM_RowFilterAggregation(benchmark::State& state) {
+        RunProcessor(state, [] {
+            auto aggregation = std::make_unique<TAggregationProcessor>("price", "avg");
+            aggregation->AddPreFilter(ExpensiveFilter, "price > 500");
+            return aggregation;
+        });
+    }
+
+    // Цепочка процессоров, вызываемых так же, как в TReport::Generate
+    class TDynamicChain: public IDataProcessor {
+    private:
+        std::vector<std::unique_ptr<IDataProcessor>> Stages;
+
+    public:
+        explicit TDynamicChain(std::vector<std::unique_ptr<IDataProcessor>> stages)
+            : Stages(std::move(stages)) {
+        }
+
+        TOperationResult Process(DataTable data) override {
+            for (auto& stage : Stages) {
+                auto result = stage->Process(std::move(data));
+                if (!result.Success) {
+                    return result;
+                }
+                data = std::move(result.Data);
+            }
+            return TOperationResult::Ok(std::move(data));
+        }
+
+        std::string GetDescription() const override {
+            return "Dynamic chain";
+        }
+    };
+
+    // Динамический путь: фильтр и агрегация отдельными процессорами,
+    // условие вызывается через std::function на каждую строку
+    void BM_DynamicFilterAggregate(benchmark::State& state) {
+        RunProcessor(state, [] {
+            std::vector<std::unique_ptr<IDataProcessor>> stages;
+            stages.push_back(std::make_unique<TFilterProcessor>(ExpensiveFilter, "price > 500"));
+            stages.push_back(std::make_unique<TAggregationProcessor>("units", "sum"));
+            return std::make_unique<TDynamicChain>(std::move(stages));
+        });
+    }
+
+    void BM_StaticFilterAggregate(benchmark::State& state) {
+        RunProcessor(state, [] {
+            return TStaticPipelineBuilder<>()
+                .Filter([](const DataRow& row) { return ExpensiveFilter(row); }, "price > 500")
+                .Aggregate<EStaticAggregation::Sum>("units");
+        });
+    }
+
+    void BM_ComputedColumns(benchmark::State& state) {
+        RunProcessor(state, [] {
+            return std::make_unique<TComputedColumnsProcessor>(std::vector<std::pair<std::string, std::string>>{
+                {"revenue", "units * price"},
+                {"tier", "if(revenue > 50000, 'high', 'low')"},
+            });
+        });
+    }
+
+    // Построение компактной таблицы; счетчики - байт на строку в обоих представлениях
+    void BM_CompactTable(benchmark::State& state) {
+        const auto& table = GetTable(state.range(0));
+        size_t compactBytes = 0;
+        for (auto _ : state) {
+            auto compact = TCompactTable::FromRows(table);
+            compactBytes = compact.GetMemoryBytes();
+            benchmark::DoNotOptimize(compactBytes);
+        }
+        const double rows = static_cast<double>(std::max<int64_t>(state.range(0), 1));
+        state.counters["row_bytes"] = static_cast<double>(EstimateTableBytes(table)) / rows;
+        state.counters["compact_bytes"] = static_cast<double>(compactBytes) / rows;
+        SetRowCounters(state, state.range(0));
+    }
+
+    template <class TFormatter>
+    void BM_Formatter(benchmark::State& state) {
+        const auto& table = GetTable(state.range(0));
+        TFormatter formatter;
+        size_t bytes = 0;
+        for (auto _ : state) {
+            auto output = formatter.Format(table);
+            bytes += output.size();
+            benchmark::DoNotOptimize(output.data());
+        }
+        state.SetBytesProcessed(static_cast<int64_t>(bytes));
+        SetRowCounters(state, state.range(0));
+    }
+
+    template <ECompression Codec>
+    void BM_FileExportStrategy(benchmark::State& state) {
+        const std::string formatted = TMarkdownFormatter().Format(GetTable(state.range(0)));
+        const auto dir = fs::temp_directory_path() / "report_builder_bench_export";
+        TCompressionOptions compression;
+        compression.Codec = Codec;
+        TFileExportStrategy exporter(dir.string(), compression);
+        {
+            TSilencedStdout silenced;
+            for (auto _ : state) {
+                benchmark::DoNotOptimize(exporter.ExportData(formatted));
+            }
+        }
+        state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(formatted.size()));
+        fs::remove_all(dir);
+    }
+
+    // Полный конвейер: CSV -> фильтр -> сортировка -> Markdown -> файл
+    void BM_EndToEnd(benchmark::State& state) {
+        const auto& path = GetCsvFile(state.range(0));
+        const auto dir = fs::temp_directory_path() / "report_builder_bench_e2e";
+        TSilencedStdout silenced;
+        for (auto _ : state) {
+            auto report = TReportBuilder()
+                              .SetDataSource(std::make_unique<TCsvDataProvider>(path))
+                              .AddProcessor(std::make_unique<TFilterProcessor>(ExpensiveFilter, "price > 500"))
+                              .AddProcessor(std::make_unique<TSortProcessor>("units", false))
+                              .SetFormatter(std::make_unique<TMarkdownFormatter>())
+                              .SetExportStrategy(std::make_unique<TFileExportStrategy>(dir.string()))
+                              .Build();
+            auto result = report->Generate();
+            benchmark::DoNotOptimize(result.Success);
+        }
+        SetRowCounters(state, state.range(0));
+        fs::remove_all(dir);
+    }
+
+    void RegisterAll() {
+        const auto& config = GetConfig();
+        auto withSizes = [&](benchmark::internal::Benchmark* bench) {
+            bench->RangeMultiplier(10)->Range(config.MinRows, config.MaxRows)->Unit(benchmark::kMillisecond);
+        };
+
+        withSizes(benchmark::RegisterBenchmark("CsvDataProvider", BM_CsvDataProvider));
+        withSizes(benchmark::RegisterBenchmark("FilterProcessor", BM_FilterProcessor));
+        withSizes(benchmark::RegisterBenchmark("SortProcessor", BM_SortProcessor));
+        withSizes(benchmark::RegisterBenchmark("AggregationProcessor", BM_AggregationProcessor));
+        withSizes(benchmark::RegisterBenchmark("MultiAggregationProcessor", BM_MultiAggregationProcessor));
+        withSizes(benchmark::RegisterBenchmark("RowFilterAggregation", BM_RowFilterAggregation));
+        withSizes(benchmark::RegisterBenchmark("BatchPipeline", BM_BatchPipeline));
+        withSizes(benchmark::RegisterBenchmark("DynamicFilterAggregate", BM_DynamicFilterAggregate));
+        withSizes(benchmark::RegisterBenchmark("StaticFilterAggregate", BM_StaticFilterAggregate));
+        withSizes(benchmark::RegisterBenchmark("ComputedColumns", BM_ComputedColumns));
+        withSizes(benchmark::RegisterBenchmark("CompactTable", BM_CompactTable));
+        withSizes(benchmark::RegisterBenchmark("HtmlFormatter", BM_Formatter<THtmlFormatter>));
+        withSizes(benchmark::RegisterBenchmark("PlainTextFormatter", BM_Formatter<TPlainTextFormatter>));
+        withSizes(benchmark::RegisterBenchmark("MarkdownFormatter", BM_Formatter<TMarkdownFormatter>));
+        withSizes(benchmark::RegisterBenchmark("FileExportStrategy", BM_FileExportStrategy<ECompression::None>));
+        if (IsCompressionAvailable(ECompression::Gzip)) {
+            withSizes(benchmark::RegisterBenchmark("GzipFileExportStrategy", BM_FileExportStrategy<ECompression::Gzip>));
+        }
+        withSizes(benchmark::RegisterBenchmark("EndToEnd", BM_EndToEnd));
+    }
+} // namespace
+
+int main(int argc, char** argv) {
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return 1;
+    }
+    RegisterAll();
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+
+    // Удаляем сгенерированные CSV файлы
+    for (const auto& entry : fs::directory_iterator(fs::temp_directory_path())) {
+        if (entry.path().filename().string().rfind("report_builder_bench_", 0) == 0) {
+            std::error_code ec;
+            fs::remove_all(entry.path(), ec);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,313 @@
+#ifndef REPORT_BUILDER_APPROXIMATE_AGGREGATES_H
+#define REPORT_BUILDER_APPROXIMATE_AGGREGATES_H
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include "report_builder/data_types.h"
+
+namespace report_builder {
+    // Параметры приближенных агрегатов
+    struct TApproxOptions {
+        // Относительная стандартная ошибка числа различных значений
+        double DistinctRelativeError = 0.01;
+        // Параметр сжатия t-digest: больше - точнее и больше памяти
+        double QuantileCompression = 100.0;
+    };
+
+    // 64-битный хеш значения ячейки. Обычные и словарные строки с одним текстом,
+    // а также равные int и double дают одинаковый хеш.
+    inline uint64_t HashValue64(const DataValue& value) {
+        uint64_t h = 0;
+        if (auto str = GetStringView(value)) {
+            h = std::hash<std::string_view>{}(*str);
+        } else if (auto number = GetNumber(value)) {
+            double d = *number == 0.0 ? 0.0 : *number; // -0.0 и 0.0 равны
+            std::memcpy(&h, &d, sizeof(h));
+        } else {
+            h = std::hash<DataValue>{}(value);
+        }
+        // Финализатор splitmix64: std::hash может быть тождественным
+        h += 0x9e3779b97f4a7c15ULL;
+        h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+        return h ^ (h >> 31);
+    }
+
+    // HyperLogLog: оценка числа различных значений в памяти 2^p байт.
+    // Стандартная ошибка примерно 1.04 / sqrt(2^p).
+    class THyperLogLog {
+    private:
+        uint8_t Precision;
+        std::vector<uint8_t> Registers;
+
+    public:
+        explicit THyperLogLog(uint8_t precision = 14)
+            : Precision(std::clamp<uint8_t>(precision, 4, 18))
+            , Registers(size_t{1} << Precision, 0) {
+        }
+
+        static THyperLogLog ForRelativeError(double error) {
+            double registers = std::pow(1.04 / std::max(error, 1e-4), 2.0);
+            return THyperLogLog(static_cast<uint8_t>(std::ceil(std::log2(registers))));
+        }
+
+        void AddHash(uint64_t hash) {
+            size_t index = hash >> (64 - Precision);
+            uint64_t rest = hash << Precision;
+            // Позиция первой единицы в оставшихся битах
+            uint8_t rank = 1;
+            while (rank <= 64 - Precision && !(rest & (uint64_t{1} << 63))) {
+                rest <<= 1;
+                rank++;
+            }
+            Registers[index] = std::max(Registers[index], rank);
+        }
+
+        void Add(const DataValue& value) {
+            AddHash(HashValue64(value));
+        }
+
+        // Объединение с другим состоянием той же точности
+        bool Merge(const THyperLogLog& other) {
+            if (other.Precision != Precision) {
+                return false;
+            }
+            for (size_t i = 0; i < Registers.size(); i++) {
+                Registers[i] = std::max(Registers[i], other.Registers[i]);
+            }
+            return true;
+        }
+
+        double Estimate() const {
+            const double m = static_cast<double>(Registers.size());
+            double sum = 0.0;
+            size_t zeros = 0;
+            for (uint8_t reg : Registers) {
+                sum += std::ldexp(1.0, -reg);
+                zeros += reg == 0;
+            }
+            const double alpha = 0.7213 / (1.0 + 1.079 / m);
+            double estimate = alpha * m * m / sum;
+            // На малых мощностях точнее линейный подсчет
+            if (estimate <= 2.5 * m && zeros > 0) {
+                estimate = m * std::log(m / static_cast<double>(zeros));
+            }
+            return estimate;
+        }
+
+        uint8_t GetPrecision() const {
+            return Precision;
+        }
+    };
+
+    // t-digest: оценка квантилей по центроидам, сжатым функцией масштаба k1.
+    // Точность выше на хвостах распределения, где нужны p95 и p99.
+    class TTDigest {
+    private:
+        struct TCentroid {
+            double Mean;
+            double Weight;
+        };
+
+        static constexpr double Pi = 3.14159265358979323846;
+
+        double Compression;
+        // Новые значения копятся в буфере и сливаются с центроидами при его
+        // заполнении или в Flush. Константные методы состояние не меняют.
+        std::vector<TCentroid> Centroids;
+        std::vector<TCentroid> Buffer;
+        double TotalWeight = 0.0;
+        double Min = std::numeric_limits<double>::infinity();
+        double Max = -std::numeric_limits<double>::infinity();
+
+        double ScaleK(double q) const {
+            return Compression / (2.0 * Pi) * std::asin(2.0 * q - 1.0);
+        }
+
+        double ScaleQ(double k) const {
+            return (std::sin(std::min(k * 2.0 * Pi / Compression, Pi / 2.0)) + 1.0) / 2.0;
+        }
+
+        void Compress() {
+            if (Buffer.empty()) {
+                return;
+            }
+            auto& all = Buffer;
+            all.insert(all.end(), Centroids.begin(), Centroids.end());
+            std::sort(all.begin(), all.end(), [](const TCentroid& a, const TCentroid& b) {
+                return a.Mean < b.Mean;
+            });
+
+            std::vector<TCentroid> merged;
+            merged.reserve(static_cast<size_t>(Compression) + 1);
+            double weightSoFar = 0.0;
+            double limit = TotalWeight * ScaleQ(ScaleK(0.0) + 1.0);
+            TCentroid current = all.front();
+            for (size_t i = 1; i < all.size(); i++) {
+                const auto& next = all[i];
+                if (weightSoFar + current.Weight + next.Weight <= limit) {
+                    current.Mean += (next.Mean - current.Mean) * next.Weight / (current.Weight + next.Weight);
+                    current.Weight += next.Weight;
+                } else {
+                    weightSoFar += current.Weight;
+                    merged.push_back(current);
+                    limit = TotalWeight * ScaleQ(ScaleK(weightSoFar / TotalWeight) + 1.0);
+                    current = next;
+                }
+            }
+            merged.push_back(current);
+
+            Centroids = std::move(merged);
+            Buffer.clear();
+        }
+
+    public:
+        explicit TTDigest(double compression = 100.0)
+            : Compression(std::max(compression, 10.0)) {
+        }
+
+        void Add(double value, double weight = 1.0) {
+            Buffer.push_back({value, weight});
+            TotalWeight += weight;
+            Min = std::min(Min, value);
+            Max = std::max(Max, value);
+            if (Buffer.size() >= static_cast<size_t>(Compression) * 8) {
+                Compress();
+            }
+        }
+
+        void Merge(const TTDigest& other) {
+            Buffer.insert(Buffer.end(), other.Centroids.begin(), other.Centroids.end());
+            Buffer.insert(Buffer.end(), other.Buffer.begin(), other.Buffer.end());
+            TotalWeight += other.TotalWeight;
+            Min = std::min(Min, other.Min);
+            Max = std::max(Max, other.Max);
+            Compress();
+        }
+
+        // Сливает буфер с центроидами. После Flush запросы не копируют дайджест,
+        // и его можно читать из нескольких потоков.
+        void Flush() {
+            Compress();
+        }
+
+        // С непустым буфером запрос считается по сжатой копии
+        double Quantile(double q) const {
+            if (!Buffer.empty()) {
+                TTDigest flushed(*this);
+                flushed.Flush();
+                return flushed.Quantile(q);
+            }
+            if (Centroids.empty()) {
+                return std::numeric_limits<double>::quiet_NaN();
+            }
+            if (Centroids.size() == 1) {
+                return Centroids.front().Mean;
+            }
+            q = std::clamp(q, 0.0, 1.0);
+            const double target = q * TotalWeight;
+
+            // Центр i-го центроида находится на отметке weightBefore + Weight/2;
+            // между центрами значение интерполируется линейно
+            double weightBefore = 0.0;
+            double prevCenter = 0.0;
+            double prevMean = Min;
+            for (const auto& centroid : Centroids) {
+                double center = weightBefore + centroid.Weight / 2.0;
+                if (target < center) {
+                    double span = center - prevCenter;
+                    double t = span > 0 ? (target - prevCenter) / span : 0.0;
+                    return prevMean + t * (centroid.Mean - prevMean);
+                }
+                prevCenter = center;
+                prevMean = centroid.Mean;
+                weightBefore += centroid.Weight;
+            }
+            double span = TotalWeight - prevCenter;
+            double t = span > 0 ? (target - prevCenter) / span : 1.0;
+            return prevMean + t * (Max - prevMean);
+        }
+
+        double GetTotalWeight() const {
+            return TotalWeight;
+        }
+
+        size_t GetCentroidCount() const {
+            if (!Buffer.empty()) {
+                TTDigest flushed(*this);
+                flushed.Flush();
+                return flushed.Centroids.size();
+            }
+            return Centroids.size();
+        }
+    };
+
+    // Разбирает имя квантильной операции вида "p95" или "p99.9"
+    inline std::optional<double> ParseQuantileOperation(const std::string& operation) {
+        if (operation.size() < 2 || operation[0] != 'p') {
+            return std::nullopt;
+        }
+        char* end = nullptr;
+        double percent = std::strtod(operation.c_str() + 1, &end);
+        if (*end != '\0' || percent < 0.0 || percent > 100.0) {
+            return std::nullopt;
+        }
+        return percent / 100.0;
+    }
+
+    inline bool IsApproximateOperation(const std::string& operation) {
+        return operation == "approx_distinct" || ParseQuantileOperation(operation).has_value();
+    }
+
+    // Вычисляет приближенный агрегат по полю. Возвращает nullopt, если
+    // подходящих значений в поле нет.
+    inline std::optional<DataRow> ApproximateAggregate(const DataTable& data, const std::string& field,
+                                                       const std::string& operation, const TApproxOptions& options) {
+        DataRow summaryRow;
+        summaryRow["field"] = field;
+        summaryRow["operation"] = operation;
+
+        if (operation == "approx_distinct") {
+            auto sketch = THyperLogLog::ForRelativeError(options.DistinctRelativeError);
+            int64_t count = 0;
+            for (const auto& row : data) {
+                auto it = row.find(field);
+                if (it != row.end()) {
+                    sketch.Add(it->second);
+                    count++;
+                }
+            }
+            if (count == 0) {
+                return std::nullopt;
+            }
+            summaryRow["value"] = std::round(sketch.Estimate());
+            summaryRow["count"] = MakeInteger(count);
+            return summaryRow;
+        }
+
+        auto quantile = ParseQuantileOperation(operation);
+        if (!quantile) {
+            return std::nullopt;
+        }
+        TTDigest digest(options.QuantileCompression);
+        for (const auto& row : data) {
+            auto it = row.find(field);
+            if (it != row.end()) {
+                if (auto number = GetNumber(it->second)) {
+                    digest.Add(*number);
+                }
+            }
+        }
+        if (digest.GetTotalWeight() == 0.0) {
+            return std::nullopt;
+        }
+        digest.Flush();
+        summaryRow["value"] = digest.Quantile(*quantile);
+        summaryRow["count"] = MakeInteger(static_cast<int64_t>(digest.GetTotalWeight()));
+        return summaryRow;
+    }
+} // namespace report_builder
+
+#endif
@@ -0,0 +1,734 @@
+#ifndef REPORT_BUILDER_BATCH_EXECUTION_H
+#define REPORT_BUILDER_BATCH_EXECUTION_H
+
+#include <numeric>
+#include <sstream>
+#include <unordered_map>
+
+#include "report_builder/interfaces.h"
+
+namespace report_builder {
+    enum class EColumnType {
+        Int,
+        Double,
+        Bool,
+        Value, // строки и колонки со смешанными типами
+    };
+
+    // Колонка пачки. Заполнен один вектор значений по типу колонки;
+    // Valid[i] == 0 означает, что в строке i поля нет.
+    struct TColumn {
+        EColumnType Type = EColumnType::Value;
+        std::vector<int> Ints;
+        std::vector<double> Doubles;
+        std::vector<uint8_t> Bools;
+        std::vector<DataValue> Values;
+        std::vector<uint8_t> Valid;
+
+        void Resize(size_t rows) {
+            switch (Type) {
+                case EColumnType::Int:
+                    Ints.resize(rows);
+                    break;
+                case EColumnType::Double:
+                    Doubles.resize(rows);
+                    break;
+                case EColumnType::Bool:
+                    Bools.resize(rows);
+                    break;
+                case EColumnType::Value:
+                    Values.resize(rows);
+                    break;
+            }
+            Valid.resize(rows, 0);
+        }
+
+        void Set(size_t row, DataValue value) {
+            switch (Type) {
+                case EColumnType::Int:
+                    Ints[row] = std::get<int>(value);
+                    break;
+                case EColumnType::Double:
+                    Doubles[row] = std::get<double>(value);
+                    break;
+                case EColumnType::Bool:
+                    Bools[row] = std::get<bool>(value);
+                    break;
+                case EColumnType::Value:
+                    Values[row] = std::move(value);
+                    break;
+            }
+            Valid[row] = 1;
+        }
+
+        DataValue Take(size_t row) {
+            switch (Type) {
+                case EColumnType::Int:
+                    return Ints[row];
+                case EColumnType::Double:
+                    return Doubles[row];
+                case EColumnType::Bool:
+                    return static_cast<bool>(Bools[row]);
+                case EColumnType::Value:
+                    break;
+            }
+            return std::move(Values[row]);
+        }
+
+        bool IsNumeric() const {
+            return Type == EColumnType::Int || Type == EColumnType::Double;
+        }
+
+        // Числовая колонка в виде double: Int преобразуется в buffer, Double отдается как есть
+        const double* AsDoubles(std::vector<double>& buffer) const {
+            if (Type == EColumnType::Double) {
+                return Doubles.data();
+            }
+            buffer.resize(Ints.size());
+            for (size_t i = 0; i < Ints.size(); i++) {
+                buffer[i] = Ints[i];
+            }
+            return buffer.data();
+        }
+    };
+
+    // Пачка строк фиксированного размера в колоночном виде.
+    // Выборка (Selection) - возрастающие индексы строк, оставшихся после фильтров;
+    // пока фильтров не было, AllSelected == true и Selection не используется.
+    class TColumnBatch {
+    public:
+        static constexpr size_t DefaultSize = 1024;
+
+        std::vector<std::string> Names;
+        std::vector<TColumn> Columns;
+        size_t RowCount = 0;
+        std::vector<uint32_t> Selection;
+        bool AllSelected = true;
+
+        size_t GetSelectedCount() const {
+            return AllSelected ? RowCount : Selection.size();
+        }
+
+        TColumn* FindColumn(const std::string& name) {
+            auto it = std::find(Names.begin(), Names.end(), name);
+            return it == Names.end() ? nullptr : &Columns[it - Names.begin()];
+        }
+
+        // Добавляет колонку или заменяет существующую с тем же именем
+        TColumn& SetColumn(const std::string& name, EColumnType type) {
+            TColumn* column = FindColumn(name);
+            if (!column) {
+                Names.push_back(name);
+                column = &Columns.emplace_back();
+            }
+            *column = TColumn();
+            column->Type = type;
+            column->Resize(RowCount);
+            return *column;
+        }
+
+        // Переводит выборку в явный вид, чтобы ее можно было сужать
+        std::vector<uint32_t>& MaterializeSelection() {
+            if (AllSelected) {
+                Selection.resize(RowCount);
+                std::iota(Selection.begin(), Selection.end(), 0u);
+                AllSelected = false;
+            }
+            return Selection;
+        }
+
+        // Строки [begin, end) переносятся из таблицы в пачку. Тип колонки
+        // определяется по значениям пачки; смешанные типы хранятся как DataValue.
+        static TColumnBatch FromRows(DataTable& rows, size_t begin, size_t end) {
+            TColumnBatch batch;
+            batch.RowCount = end - begin;
+
+            // Строки обычно имеют одинаковый набор полей, поэтому номер колонки
+            // сначала угадывается по позиции поля в предыдущей строке
+            std::unordered_map<std::string, size_t> index;
+            std::vector<std::optional<size_t>> kinds;
+            std::vector<size_t> slots;
+            std::vector<size_t> previous;
+            for (size_t r = begin; r < end; r++) {
+                size_t position = 0;
+                for (const auto& [name, value] : rows[r]) {
+                    size_t column = 0;
+                    if (position < previous.size() && batch.Names[previous[position]] == name) {
+                        column = previous[position];
+                    } else {
+                        auto [it, inserted] = index.emplace(name, batch.Names.size());
+                        if (inserted) {
+                            batch.Names.push_back(name);
+                            kinds.emplace_back();
+                        }
+                        column = it->second;
+                        if (position < previous.size()) {
+                            previous[position] = column;
+                        } else {
+                            previous.push_back(column);
+                        }
+                    }
+                    slots.push_back(column);
+                    position++;
+
+                    auto& kind = kinds[column];
+                    if (!kind) {
+                        kind = value.index();
+                    } else if (*kind != value.index()) {
+                        kind = std::variant_npos;
+                    }
+                }
+            }
+
+            batch.Columns.resize(batch.Names.size());
+            for (size_t c = 0; c < kinds.size(); c++) {
+                auto& column = batch.Columns[c];
+                if (*kinds[c] == DataValue(0).index()) {
+                    column.Type = EColumnType::Int;
+                } else if (*kinds[c] == DataValue(0.0).index()) {
+                    column.Type = EColumnType::Double;
+                } else if (*kinds[c] == DataValue(false).index()) {
+                    column.Type = EColumnType::Bool;
+                }
+                column.Resize(batch.RowCount);
+            }
+
+            size_t slot = 0;
+            for (size_t r = begin; r < end; r++) {
+                for (auto& [name, value] : rows[r]) {
+                    batch.Columns[slots[slot++]].Set(r - begin, std::move(value));
+                }
+                rows[r].clear();
+            }
+            return batch;
+        }
+
+        // Переносит выбранные строки пачки в таблицу
+        void MoveSelectedRows(DataTable& output) {
+            auto emit = [&](size_t row) {
+                DataRow result;
+                for (size_t c = 0; c < Columns.size(); c++) {
+                    if (Columns[c].Valid[row]) {
+                        result.emplace(Names[c], Columns[c].Take(row));
+                    }
+                }
+                output.push_back(std::move(result));
+            };
+            if (AllSelected) {
+                for (size_t row = 0; row < RowCount; row++) {
+                    emit(row);
+                }
+            } else {
+                for (uint32_t row : Selection) {
+                    emit(row);
+                }
+            }
+        }
+    };
+
+    using TBatchSink = std::vector<TColumnBatch>;
+
+    // Обработчик пачек. Потоковые обработчики выдают результат на каждую пачку,
+    // блокирующие (агрегации) копят состояние и выдают его в Finish.
+    class IBatchProcessor {
+    public:
+        virtual ~IBatchProcessor() = default;
+        // false - ошибка, текст в GetError
+        virtual bool Consume(TColumnBatch batch, TBatchSink& output) = 0;
+        virtual bool Finish(TBatchSink& output) {
+            (void)output;
+            return true;
+        }
+        // Сбрасывает накопленное состояние перед новым прогоном
+        virtual void Reset() {
+        }
+        virtual std::string GetDescription() const = 0;
+        virtual std::optional<std::string> GetError() const {
+            return std::nullopt;
+        }
+    };
+
+    enum class ECompareOp {
+        Less,
+        LessEqual,
+        Greater,
+        GreaterEqual,
+        Equal,
+        NotEqual,
+    };
+
+    // Ядро фильтра: сужает выборку до строк, где values[i] op constant.
+    // Запись индекса безусловная, сдвиг зависит от результата сравнения,
+    // поэтому в цикле нет ветвлений, зависящих от данных.
+    template <class T, class TCompare>
+    size_t SelectWhere(const T* values, const uint8_t* valid, uint32_t* selection, size_t count, double constant,
+                       TCompare compare) {
+        size_t selected = 0;
+        for (size_t k = 0; k < count; k++) {
+            const uint32_t row = selection[k];
+            selection[selected] = row;
+            selected += valid[row] & static_cast<uint8_t>(compare(static_cast<double>(values[row]), constant));
+        }
+        return selected;
+    }
+
+    // Фильтр "числовая колонка op константа". Строки без поля или с нечисловым значением отбрасываются.
+    class TBatchCompareFilter: public IBatchProcessor {
+    private:
+        std::string Field;
+        ECompareOp Op;
+        double Constant;
+
+        template <class T>
+        size_t Select(const T* values, const uint8_t* valid, uint32_t* selection, size_t count) const {
+            switch (Op) {
+                case ECompareOp::Less:
+                    return SelectWhere(values, valid, selection, count, Constant, std::less<double>());
+                case ECompareOp::LessEqual:
+                    return SelectWhere(values, valid, selection, count, Constant, std::less_equal<double>());
+                case ECompareOp::Greater:
+                    return SelectWhere(values, valid, selection, count, Constant, std::greater<double>());
+                case ECompareOp::GreaterEqual:
+                    return SelectWhere(values, valid, selection, count, Constant, std::greater_equal<double>());
+                case ECompareOp::Equal:
+                    return SelectWhere(values, valid, selection, count, Constant, std::equal_to<double>());
+                case ECompareOp::NotEqual:
+                    return SelectWhere(values, valid, selection, count, Constant, std::not_equal_to<double>());
+            }
+            return count;
+        }
+
+        bool Compare(double value) const {
+            const uint8_t valid = 1;
+            uint32_t row = 0;
+            return Select(&value, &valid, &row, 1) == 1;
+        }
+
+    public:
+        TBatchCompareFilter(std::string field, ECompareOp op, double constant)
+            : Field(std::move(field))
+            , Op(op)
+            , Constant(constant) {
+        }
+
+        bool Consume(TColumnBatch batch, TBatchSink& output) override {
+            const TColumn* column = batch.FindColumn(Field);
+            auto& selection = batch.MaterializeSelection();
+            size_t selected = 0;
+            if (column && column->Type == EColumnType::Int) {
+                selected = Select(column->Ints.data(), column->Valid.data(), selection.data(), selection.size());
+            } else if (column && column->Type == EColumnType::Double) {
+                selected = Select(column->Doubles.data(), column->Valid.data(), selection.data(), selection.size());
+            } else if (column && column->Type == EColumnType::Value) {
+                // Смешанная колонка: числа сравниваются по одному
+                for (uint32_t row : selection) {
+                    auto number = column->Valid[row] ? GetNumber(column->Values[row]) : std::nullopt;
+                    if (number && !std::holds_alternative<bool>(column->Values[row]) && Compare(*number)) {
+                        selection[selected++] = row;
+                    }
+                }
+            }
+            selection.resize(selected);
+            if (!selection.empty()) {
+                output.push_back(std::move(batch));
+            }
+            return true;
+        }
+
+        std::string GetDescription() const override {
+            static const char* names[] = {"<", "<=", ">", ">=", "==", "!="};
+            std::ostringstream out;
+            out << "Batch filter (" << Field << " " << names[static_cast<int>(Op)] << " " << Constant << ")";
+            return out.str();
+        }
+    };
+
+    enum class EArithmeticOp {
+        Add,
+        Subtract,
+        Multiply,
+        Divide,
+    };
+
+    // Операнд арифметики: колонка или константа
+    struct TBatchOperand {
+        std::string Column;
+        double Constant = 0.0;
+
+        static TBatchOperand Field(std::string column) {
+            return TBatchOperand{std::move(column), 0.0};
+        }
+
+        static TBatchOperand Value(double constant) {
+            return TBatchOperand{"", constant};
+        }
+    };
+
+    // Вычисляемая колонка output = left op right типа double.
+    // Считается по всем строкам пачки без учета выборки: плотный цикл без ветвлений
+    // дешевле выборочного доступа. Деление на ноль дает отсутствующее значение.
+    class TBatchArithmetic: public IBatchProcessor {
+    private:
+        std::string Output;
+        TBatchOperand Left;
+        EArithmeticOp Op;
+        TBatchOperand Right;
+        std::vector<double> LeftBuffer;
+        std::vector<double> RightBuffer;
+        std::vector<uint8_t> LeftValid;
+        std::vector<uint8_t> RightValid;
+        std::vector<uint8_t> AllValid;
+
+        // Значения операнда и маска наличия; nullptr, если колонки нет или она не числовая
+        const double* Load(TColumnBatch& batch, const TBatchOperand& operand, std::vector<double>& buffer,
+                           std::vector<uint8_t>& validBuffer, const uint8_t*& valid) {
+            if (operand.Column.empty()) {
+                buffer.assign(batch.RowCount, operand.Constant);
+                valid = AllValid.data();
+                return buffer.data();
+            }
+            const TColumn* column = batch.FindColumn(operand.Column);
+            if (!column || column->Type == EColumnType::Bool) {
+                return nullptr;
+            }
+            if (column->Type == EColumnType::Value) {
+                // Смешанная колонка: числа извлекаются по одному, остальное считается отсутствующим
+                buffer.assign(batch.RowCount, 0.0);
+                validBuffer.assign(batch.RowCount, 0);
+                for (size_t i = 0; i < batch.RowCount; i++) {
+                    auto number = column->Valid[i] ? GetNumber(column->Values[i]) : std::nullopt;
+                    if (number && !std::holds_alternative<bool>(column->Values[i])) {
+                        buffer[i] = *number;
+                        validBuffer[i] = 1;
+                    }
+                }
+                valid = validBuffer.data();
+                return buffer.data();
+            }
+            valid = column->Valid.data();
+            return column->AsDoubles(buffer);
+        }
+
+        template <class TOp>
+        static void Apply(const double* a, const double* b, const uint8_t* validA, const uint8_t* validB,
+                          double* out, uint8_t* valid, size_t rows, TOp op) {
+            for (size_t i = 0; i < rows; i++) {
+                out[i] = op(a[i], b[i]);
+                valid[i] = validA[i] & validB[i];
+            }
+        }
+
+    public:
+        TBatchArithmetic(std::string output, TBatchOperand left, EArithmeticOp op, TBatchOperand right)
+            : Output(std::move(output))
+            , Left(std::move(left))
+            , Op(op)
+            , Right(std::move(right)) {
+        }
+
+        bool Consume(TColumnBatch batch, TBatchSink& output) override {
+            AllValid.assign(batch.RowCount, 1);
+            const uint8_t* validA = nullptr;
+            const uint8_t* validB = nullptr;
+            const double* a = Load(batch, Left, LeftBuffer, LeftValid, validA);
+            const double* b = Load(batch, Right, RightBuffer, RightValid, validB);
+
+            // Операнды загружены до SetColumn: выходная колонка может совпадать с входной
+            std::vector<double> values(batch.RowCount);
+            std::vector<uint8_t> valid(batch.RowCount, 0);
+            if (a && b) {
+                switch (Op) {
+                    case EArithmeticOp::Add:
+                        Apply(a, b, validA, validB, values.data(), valid.data(), batch.RowCount, std::plus<double>());
+                        break;
+                    case EArithmeticOp::Subtract:
+                        Apply(a, b, validA, validB, values.data(), valid.data(), batch.RowCount, std::minus<double>());
+                        break;
+                    case EArithmeticOp::Multiply:
+                        Apply(a, b, validA, validB, values.data(), valid.data(), batch.RowCount, std::multiplies<double>());
+                        break;
+                    case EArithmeticOp::Divide:
+                        Apply(a, b, validA, validB, values.data(), valid.data(), batch.RowCount, std::divides<double>());
+                        for (size_t i = 0; i < batch.RowCount; i++) {
+                            valid[i] &= static_cast<uint8_t>(b[i] != 0.0);
+                        }
+                        break;
+                }
+            }
+
+            auto& column = batch.SetColumn(Output, EColumnType::Double);
+            column.Doubles = std::move(values);
+            column.Valid = std::move(valid);
+            output.push_back(std::move(batch));
+            return true;
+        }
+
+        std::string GetDescription() const override {
+            static const char* names[] = {"+", "-", "*", "/"};
+            auto describe = [](const TBatchOperand& operand) {
+                if (!operand.Column.empty()) {
+                    return operand.Column;
+                }
+                std::ostringstream out;
+                out << operand.Constant;
+                return out.str();
+            };
+            return "Batch compute " + Output + " = " + describe(Left) + " " + names[static_cast<int>(Op)] + " " +
+                   describe(Right);
+        }
+    };
+
+    // Агрегация sum/avg/count по пачкам. Результат совпадает по форме
+    // с TAggregationProcessor: одна строка field, operation, value, count.
+    class TBatchAggregate: public IBatchProcessor {
+    private:
+        std::string Field;
+        std::string Operation;
+        double Total = 0.0;
+        size_t Count = 0;
+        size_t Rows = 0;
+        std::optional<std::string> Error;
+
+        // Четыре независимых сумматора: сложение double не ассоциативно,
+        // и без них компилятор не может распараллелить редукцию
+        template <class T>
+        static void SumAll(const T* values, const uint8_t* valid, size_t rows, double& total, size_t& count) {
+            double partial[4] = {0.0, 0.0, 0.0, 0.0};
+            size_t counts[4] = {0, 0, 0, 0};
+            size_t i = 0;
+            for (; i + 4 <= rows; i += 4) {
+                for (size_t lane = 0; lane < 4; lane++) {
+                    partial[lane] += valid[i + lane] ? static_cast<double>(values[i + lane]) : 0.0;
+                    counts[lane] += valid[i + lane];
+                }
+            }
+            for (; i < rows; i++) {
+                partial[0] += valid[i] ? static_cast<double>(values[i]) : 0.0;
+                counts[0] += valid[i];
+            }
+            total += (partial[0] + partial[1]) + (partial[2] + partial[3]);
+            count += counts[0] + counts[1] + counts[2] + counts[3];
+        }
+
+        template <class T>
+        static void SumSelected(const T* values, const uint8_t* valid, const std::vector<uint32_t>& selection,
+                                double& total, size_t& count) {
+            for (uint32_t row : selection) {
+                total += valid[row] ? static_cast<double>(values[row]) : 0.0;
+                count += valid[row];
+            }
+        }
+
+        template <class T>
+        void Accumulate(const TColumnBatch& batch, const T* values, const uint8_t* valid) {
+            if (batch.AllSelected) {
+                SumAll(values, valid, batch.RowCount, Total, Count);
+            } else {
+                SumSelected(values, valid, batch.Selection, Total, Count);
+            }
+        }
+
+    public:
+        TBatchAggregate(std::string field, std::string operation)
+            : Field(std::move(field))
+            , Operation(std::move(operation)) {
+        }
+
+        bool Consume(TColumnBatch batch, TBatchSink&) override {
+            Rows += batch.GetSelectedCount();
+            if (Operation == "count") {
+                return true;
+            }
+            if (Operation != "sum" && Operation != "avg") {
+                Error = "Batch aggregate: unsupported operation '" + Operation + "'";
+                return false;
+            }
+
+            const TColumn* column = batch.FindColumn(Field);
+            if (!column) {
+                return true;
+            }
+            if (column->Type == EColumnType::Int) {
+                Accumulate(batch, column->Ints.data(), column->Valid.data());
+            } else if (column->Type == EColumnType::Double) {
+                Accumulate(batch, column->Doubles.data(), column->Valid.data());
+            } else if (column->Type == EColumnType::Value) {
+                auto add = [&](uint32_t row) {
+                    if (auto number = column->Valid[row] ? GetNumber(column->Values[row]) : std::nullopt;
+                        number && !std::holds_alternative<bool>(column->Values[row])) {
+                        Total += *number;
+                        Count++;
+                    }
+                };
+                if (batch.AllSelected) {
+                    for (uint32_t row = 0; row < batch.RowCount; row++) {
+                        add(row);
+                    }
+                } else {
+                    for (uint32_t row : batch.Selection) {
+                        add(row);
+                    }
+                }
+            }
+            return true;
+        }
+
+        bool Finish(TBatchSink& output) override {
+            if (Rows == 0) {
+                return true;
+            }
+
+            DataTable result(1);
+            DataRow& row = result.front();
+            row["field"] = Field;
+            if (Operation == "count") {
+                row["operation"] = std::string("count");
+                row["value"] = MakeInteger(static_cast<int64_t>(Rows));
+            } else {
+                if (Count == 0) {
+                    Error = "Field '" + Field + "' not found in data for aggregation";
+                    return false;
+                }
+                row["operation"] = std::string(Operation == "sum" ? "sum" : "average");
+                row["value"] = Operation == "sum" ? Total : Total / Count;
+                row["count"] = MakeInteger(static_cast<int64_t>(Count));
+            }
+            output.push_back(TColumnBatch::FromRows(result, 0, 1));
+            return true;
+        }
+
+        void Reset() override {
+            Total = 0.0;
+            Count = 0;
+            Rows = 0;
+            Error.reset();
+        }
+
+        std::string GetDescription() const override {
+            return "Batch " + Operation + " of " + Field;
+        }
+
+        std::optional<std::string> GetError() const override {
+            return Error;
+        }
+    };
+
+    // Адаптер обычного обработчика: пачки собираются в таблицу, которая
+    // целиком передается в Process, результат снова режется на пачки
+    class TRowProcessorAdapter: public IBatchProcessor {
+    private:
+        std::unique_ptr<IDataProcessor> Processor;
+        size_t BatchSize;
+        DataTable Buffer;
+        std::optional<std::string> Error;
+
+    public:
+        explicit TRowProcessorAdapter(std::unique_ptr<IDataProcessor> processor,
+                                      size_t batchSize = TColumnBatch::DefaultSize)
+            : Processor(std::move(processor))
+            , BatchSize(std::max<size_t>(batchSize, 1)) {
+        }
+
+        bool Consume(TColumnBatch batch, TBatchSink&) override {
+            batch.MoveSelectedRows(Buffer);
+            return true;
+        }
+
+        bool Finish(TBatchSink& output) override {
+            auto result = Processor->Process(std::move(Buffer));
+            Buffer.clear();
+            if (!result.Success) {
+                Error = result.ErrorMessage.value_or("Processor failed");
+                return false;
+            }
+            for (size_t begin = 0; begin < result.Data.size(); begin += BatchSize) {
+                output.push_back(TColumnBatch::FromRows(result.Data, begin, std::min(begin + BatchSize, result.Data.size())));
+            }
+            return true;
+        }
+
+        void Reset() override {
+            Buffer.clear();
+            Error.reset();
+        }
+
+        std::string GetDescription() const override {
+            return Processor->GetDescription();
+        }
+
+        std::optional<std::string> GetError() const override {
+            return Error;
+        }
+    };
+
+    // Цепочка обработчиков пачек, встроенная в обычный конвейер отчета.
+    // Таблица один раз переводится в колоночный вид и обратно.
+    class TBatchPipelineProcessor: public IDataProcessor {
+    private:
+        std::vector<std::unique_ptr<IBatchProcessor>> Stages;
+        size_t BatchSize;
+
+        bool Push(size_t stage, TColumnBatch batch, DataTable& output, std::string& error) {
+            if (stage == Stages.size()) {
+                batch.MoveSelectedRows(output);
+                return true;
+            }
+            TBatchSink sink;
+            if (!Stages[stage]->Consume(std::move(batch), sink)) {
+                error = Stages[stage]->GetError().value_or("Batch stage failed");
+                return false;
+            }
+            for (auto& next : sink) {
+                if (!Push(stage + 1, std::move(next), output, error)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+    public:
+        explicit TBatchPipelineProcessor(std::vector<std::unique_ptr<IBatchProcessor>> stages,
+                                         size_t batchSize = TColumnBatch::DefaultSize)
+            : Stages(std::move(stages))
+            , BatchSize(std::max<size_t>(batchSize, 1)) {
+        }
+
+        TOperationResult Process(DataTable data) override {
+            for (auto& stage : Stages) {
+                stage->Reset();
+            }
+            DataTable output;
+            std::string error;
+            for (size_t begin = 0; begin < data.size(); begin += BatchSize) {
+                auto batch = TColumnBatch::FromRows(data, begin, std::min(begin + BatchSize, data.size()));
+                if (!Push(0, std::move(batch), output, error)) {
+                    return TOperationResult::Error(error);
+                }
+            }
+            DataTable().swap(data);
+
+            for (size_t stage = 0; stage < Stages.size(); stage++) {
+                TBatchSink sink;
+                if (!Stages[stage]->Finish(sink)) {
+                    return TOperationResult::Error(Stages[stage]->GetError().value_or("Batch stage failed"));
+                }
+                for (auto& batch : sink) {
+                    if (!Push(stage + 1, std::move(batch), output, error)) {
+                        return TOperationResult::Error(error);
+                    }
+                }
+            }
+            return TOperationResult::Ok(std::move(output));
+        }
+
+        std::string GetDescription() const override {
+            std::string desc = "Batch pipeline:";
+            for (size_t i = 0; i < Stages.size(); i++) {
+                desc += (i ? " -> " : " ") + Stages[i]->GetDescription();
+            }
+            return desc;
+        }
+    };
+} // namespace report_builder
+
+#endif
@@ -0,0 +1,442 @@
+#ifndef REPORT_BUILDER_COMPACT_TABLE_H
+#define REPORT_BUILDER_COMPACT_TABLE_H
+
+#include <cstring>
+#include <unordered_map>
+
+#include "report_builder/interfaces.h"
+
+namespace report_builder {
+    // Хранилище длинных строк. Память выделяется блоками, адреса строк не меняются;
+    // одинаковые строки хранятся один раз.
+    class TStringArena {
+    private:
+        // Блоки растут вдвое от 4 КБ до 64 КБ, чтобы маленькие таблицы не платили за большой блок
+        static constexpr size_t MinBlockSize = 4 * 1024;
+        static constexpr size_t MaxBlockSize = 64 * 1024;
+
+        std::vector<std::unique_ptr<char[]>> Blocks;
+        std::vector<std::unique_ptr<char[]>> Large;
+        size_t BlockSize = 0;
+        size_t Used = 0;
+        size_t Bytes = 0;
+        std::unordered_map<std::string_view, const char*> Interned;
+
+    public:
+        TStringArena() = default;
+        TStringArena(const TStringArena&) = delete;
+        TStringArena& operator=(const TStringArena&) = delete;
+
+        const char* Store(std::string_view text) {
+            if (auto it = Interned.find(text); it != Interned.end()) {
+                return it->second;
+            }
+            char* place;
+            if (text.size() > MaxBlockSize / 4) {
+                // Большие строки - отдельным блоком, чтобы не терять хвост текущего
+                Large.push_back(std::make_unique<char[]>(text.size()));
+                place = Large.back().get();
+                Bytes += text.size();
+            } else {
+                if (Used + text.size() > BlockSize) {
+                    BlockSize = std::clamp(BlockSize * 2, MinBlockSize, MaxBlockSize);
+                    Blocks.push_back(std::make_unique<char[]>(BlockSize));
+                    Bytes += BlockSize;
+                    Used = 0;
+                }
+                place = Blocks.back().get() + Used;
+                Used += text.size();
+            }
+            std::memcpy(place, text.data(), text.size());
+            Interned.emplace(std::string_view(place, text.size()), place);
+            return place;
+        }
+
+        // Память блоков и индекса повторов
+        size_t GetBytes() const {
+            return Bytes + Interned.size() * (sizeof(std::string_view) + 2 * sizeof(void*));
+        }
+    };
+
+    enum class ECompactType : uint8_t {
+        Null,
+        Int,
+        Double,
+        Bool,
+        ShortString, // до 14 байт прямо в ячейке
+        LongString,  // указатель в TStringArena и длина
+        DictCode,    // код в словаре колонки TCompactTable
+        Timestamp,   // секунды TTimestamp
+    };
+
+    // Ячейка в 16 байт: целое, double, bool, дата, null или строка.
+    // Целые хранятся в 64 битах и возвращаются в DataValue через MakeInteger.
+    // Короткие строки лежат в самой ячейке, длинные - в арене таблицы.
+    // Байты 0..13 - данные, 14 - длина короткой строки, 15 - тип.
+    class TCompactValue {
+    public:
+        static constexpr size_t InlineCapacity = 14;
+
+    private:
+        alignas(8) unsigned char Bytes[16] = {};
+
+        template <class T>
+        void Put(const T& value, size_t offset = 0) {
+            std::memcpy(Bytes + offset, &value, sizeof(T));
+        }
+
+        template <class T>
+        T Take(size_t offset = 0) const {
+            T value;
+            std::memcpy(&value, Bytes + offset, sizeof(T));
+            return value;
+        }
+
+        void SetType(ECompactType type) {
+            Bytes[15] = static_cast<unsigned char>(type);
+        }
+
+    public:
+        TCompactValue() = default;
+
+        static TCompactValue FromInt(int64_t value) {
+            TCompactValue cell;
+            cell.Put(value);
+            cell.SetType(ECompactType::Int);
+            return cell;
+        }
+
+        static TCompactValue FromDouble(double value) {
+            TCompactValue cell;
+            cell.Put(value);
+            cell.SetType(ECompactType::Double);
+            return cell;
+        }
+
+        static TCompactValue FromBool(bool value) {
+            TCompactValue cell;
+            cell.Bytes[0] = value;
+            cell.SetType(ECompactType::Bool);
+            return cell;
+        }
+
+        static TCompactValue FromString(std::string_view value, TStringArena& arena) {
+            TCompactValue cell;
+            if (value.size() <= InlineCapacity) {
+                std::memcpy(cell.Bytes, value.data(), value.size());
+                cell.Bytes[14] = static_cast<unsigned char>(value.size());
+                cell.SetType(ECompactType::ShortString);
+            } else {
+                cell.Put(arena.Store(value));
+                cell.Put(static_cast<uint32_t>(value.size()), 8);
+                cell.SetType(ECompactType::LongString);
+            }
+            return cell;
+        }
+
+        static TCompactValue FromTimestamp(TTimestamp value) {
+            TCompactValue cell;
+            cell.Put(value.Seconds);
+            cell.SetType(ECompactType::Timestamp);
+            return cell;
+        }
+
+        static TCompactValue FromDictCode(uint32_t code) {
+            TCompactValue cell;
+            cell.Put(code);
+            cell.SetType(ECompactType::DictCode);
+            return cell;
+        }
+
+        ECompactType GetType() const {
+            return static_cast<ECompactType>(Bytes[15]);
+        }
+
+        bool IsNull() const {
+            return GetType() == ECompactType::Null;
+        }
+
+        bool IsString() const {
+            return GetType() == ECompactType::ShortString || GetType() == ECompactType::LongString;
+        }
+
+        int64_t AsInt() const {
+            return Take<int64_t>();
+        }
+
+        double AsDouble() const {
+            return Take<double>();
+        }
+
+        bool AsBool() const {
+            return Bytes[0] != 0;
+        }
+
+        TTimestamp AsTimestamp() const {
+            return {Take<int64_t>()};
+        }
+
+        uint32_t AsDictCode() const {
+            return Take<uint32_t>();
+        }
+
+        // Для ShortString и LongString
+        std::string_view AsString() const {
+            if (GetType() == ECompactType::ShortString) {
+                return std::string_view(reinterpret_cast<const char*>(Bytes), Bytes[14]);
+            }
+            return std::string_view(Take<const char*>(), Take<uint32_t>(8));
+        }
+
+        // Числовое значение, если ячейка содержит целое или double
+        std::optional<double> GetNumber() const {
+            if (GetType() == ECompactType::Int) {
+                return static_cast<double>(AsInt());
+            }
+            if (GetType() == ECompactType::Double) {
+                return AsDouble();
+            }
+            return std::nullopt;
+        }
+    };
+
+    static_assert(sizeof(TCompactValue) == 16, "TCompactValue must stay 16 bytes");
+
+    // Таблица из ячеек TCompactValue: общий список колонок и плотный массив
+    // ячеек по строкам. Отсутствующее в строке поле хранится как Null.
+    // Словарные колонки (TDictString) хранят коды и общий словарь колонки,
+    // поэтому обратное преобразование восстанавливает словарное кодирование.
+    // Таблица неизменяема после построения и может читаться из нескольких потоков.
+    class TCompactTable {
+    private:
+        std::vector<std::string> Columns;
+        std::vector<std::shared_ptr<const TStringDictionary>> Dictionaries;
+        std::vector<TCompactValue> Cells;
+        std::shared_ptr<TStringArena> Arena = std::make_shared<TStringArena>();
+        size_t RowCount = 0;
+        size_t NonNullCount = 0;
+
+        TCompactValue Encode(const DataValue& value, size_t column) {
+            if (auto i = GetInteger(value)) {
+                return TCompactValue::FromInt(*i);
+            }
+            if (const auto* d = std::get_if<double>(&value)) {
+                return TCompactValue::FromDouble(*d);
+            }
+            if (const auto* b = std::get_if<bool>(&value)) {
+                return TCompactValue::FromBool(*b);
+            }
+            if (const auto* time = std::get_if<TTimestamp>(&value)) {
+                return TCompactValue::FromTimestamp(*time);
+            }
+            if (const auto* dict = std::get_if<TDictString>(&value)) {
+                if (!Dictionaries[column]) {
+                    Dictionaries[column] = dict->Dict;
+                }
+                if (Dictionaries[column] == dict->Dict) {
+                    return TCompactValue::FromDictCode(dict->Code);
+                }
+                return TCompactValue::FromString(dict->Str(), *Arena);
+            }
+            return TCompactValue::FromString(std::get<std::string>(value), *Arena);
+        }
+
+    public:
+        // Колонки - в порядке первого появления
+        static TCompactTable FromRows(const DataTable& rows) {
+            TCompactTable table;
+            std::unordered_map<std::string_view, size_t> index;
+            for (const auto& row : rows) {
+                for (const auto& [name, value] : row) {
+                    if (index.emplace(name, table.Columns.size()).second) {
+                        table.Columns.push_back(name);
+                    }
+                }
+            }
+            table.Dictionaries.resize(table.Columns.size());
+            table.RowCount = rows.size();
+            table.Cells.resize(rows.size() * table.Columns.size());
+
+            // Строки обычно имеют одинаковый набор полей, поэтому колонка сначала
+            // угадывается по позиции поля в предыдущей строке
+            std::vector<size_t> order;
+            for (size_t r = 0; r < rows.size(); r++) {
+                TCompactValue* cells = table.Cells.data() + r * table.Columns.size();
+                size_t position = 0;
+                for (const auto& [name, value] : rows[r]) {
+                    size_t column;
+                    if (position < order.size() && table.Columns[order[position]] == name) {
+                        column = order[position];
+                    } else {
+                        column = index.find(name)->second;
+                        order.resize(position + 1);
+                        order[position] = column;
+                    }
+                    cells[column] = table.Encode(value, column);
+                    table.NonNullCount++;
+                    position++;
+                }
+            }
+            return table;
+        }
+
+        size_t size() const {
+            return RowCount;
+        }
+
+        const std::vector<std::string>& GetColumns() const {
+            return Columns;
+        }
+
+        std::optional<size_t> FindColumn(std::string_view name) const {
+            for (size_t i = 0; i < Columns.size(); i++) {
+                if (Columns[i] == name) {
+                    return i;
+                }
+            }
+            return std::nullopt;
+        }
+
+        const TCompactValue& At(size_t row, size_t column) const {
+            return Cells[row * Columns.size() + column];
+        }
+
+        // Строковое значение ячейки, включая словарные коды
+        std::optional<std::string_view> GetString(size_t row, size_t column) const {
+            const auto& cell = At(row, column);
+            if (cell.GetType() == ECompactType::DictCode) {
+                return std::string_view(Dictionaries[column]->Get(cell.AsDictCode()));
+            }
+            if (cell.IsString()) {
+                return cell.AsString();
+            }
+            return std::nullopt;
+        }
+
+        // Значение ячейки как DataValue; nullopt для Null
+        std::optional<DataValue> GetValue(size_t row, size_t column) const {
+            const auto& cell = At(row, column);
+            switch (cell.GetType()) {
+                case ECompactType::Null:
+                    return std::nullopt;
+                case ECompactType::Int:
+                    return MakeInteger(cell.AsInt());
+                case ECompactType::Double:
+                    return DataValue(cell.AsDouble());
+                case ECompactType::Bool:
+                    return DataValue(cell.AsBool());
+                case ECompactType::DictCode:
+                    return DataValue(TDictString{Dictionaries[column], cell.AsDictCode()});
+                case ECompactType::Timestamp:
+                    return DataValue(cell.AsTimestamp());
+                default:
+                    return DataValue(std::string(cell.AsString()));
+            }
+        }
+
+        size_t GetNonNullCount() const {
+            return NonNullCount;
+        }
+
+        DataRow GetRow(size_t row) const {
+            DataRow result;
+            auto hint = result.end();
+            for (size_t column = 0; column < Columns.size(); column++) {
+                if (auto value = GetValue(row, column)) {
+                    hint = result.emplace_hint(hint, Columns[column], std::move(*value));
+                }
+            }
+            return result;
+        }
+
+        DataTable ToRows() const {
+            DataTable rows;
+            rows.reserve(RowCount);
+            for (size_t row = 0; row < RowCount; row++) {
+                rows.push_back(GetRow(row));
+            }
+            return rows;
+        }
+
+        // Память таблицы: ячейки, арена строк и имена колонок
+        size_t GetMemoryBytes() const {
+            size_t bytes = sizeof(*this) + Cells.capacity() * sizeof(TCompactValue) + Arena->GetBytes();
+            for (const auto& column : Columns) {
+                bytes += sizeof(std::string) + column.capacity();
+            }
+            return bytes;
+        }
+    };
+
+    // Условие над ячейками строки компактной таблицы
+    using TCompactRowPredicate = std::function<bool(const TCompactTable& table, size_t row)>;
+
+    // Провайдер над общей компактной таблицей: каждый запуск получает свои строки.
+    // Фильтр, если задан, проверяется по ячейкам таблицы, и DataRow собирается
+    // только для прошедших его строк.
+    class TCompactDataProvider: public IDataProvider {
+    private:
+        std::shared_ptr<const TCompactTable> Table;
+        std::string SourceInfo;
+        TCompactRowPredicate Filter;
+        std::optional<TScanLimit> Limit;
+        std::optional<std::string> DataKey;
+
+    public:
+        TCompactDataProvider(std::shared_ptr<const TCompactTable> table, std::string sourceInfo,
+                             TCompactRowPredicate filter = {})
+            : Table(std::move(table))
+            , SourceInfo(std::move(sourceInfo))
+            , Filter(std::move(filter)) {
+        }
+
+        TOperationResult FetchData() override {
+            DataTable data;
+            if (!Filter && !Limit) {
+                data.reserve(Table->size());
+            }
+            for (size_t row = 0; row < Table->size() && !(Limit && data.size() >= Limit->Rows); row++) {
+                if (Filter && !Filter(*Table, row)) {
+                    continue;
+                }
+                DataRow values = Table->GetRow(row);
+                if (!Limit || Limit->Accepts(values)) {
+                    data.push_back(std::move(values));
+                }
+            }
+            return TOperationResult::Ok(std::move(data));
+        }
+
+        bool PushDownLimit(TScanLimit limit) override {
+            Limit = std::move(limit);
+            return true;
+        }
+
+        // Строки без фильтра: по одному полю DataRow на непустую ячейку
+        std::optional<size_t> EstimateBytes() const override {
+            if (Filter || Limit) {
+                return std::nullopt;
+            }
+            return sizeof(DataTable) + Table->size() * sizeof(DataRow) + Table->GetNonNullCount() * RowFieldBytes;
+        }
+
+        std::string GetSourceInfo() const override {
+            return SourceInfo + (Limit ? Limit->Describe() : "");
+        }
+
+        // Ключ таблицы вместе с фильтром: общее чтение - только по явному ключу
+        void SetDataKey(std::optional<std::string> key) {
+            DataKey = std::move(key);
+        }
+
+        std::optional<std::string> GetShareKey() const override {
+            auto limit = Limit ? Limit->ShareKey() : std::optional<std::string>("");
+            if (!DataKey || !limit) {
+                return std::nullopt;
+            }
+            return "Compact table " + *DataKey + *limit;
+        }
+    };
+} // namespace report_builder
+
+#endif
@@ -0,0 +1,567 @@
+#ifndef REPORT_BUILDER_COMPRESSION_H
+#define REPORT_BUILDER_COMPRESSION_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <streambuf>
+#include <string_view>
+#include <thread>
+#include <utility>
+
+#include "report_builder/data_types.h"
+
+// Кодек подключается CMake: gzip через zlib
+#if defined(REPORT_BUILDER_HAVE_ZLIB) && __has_include(<zlib.h>)
+#include <zlib.h>
+#define REPORT_BUILDER_GZIP_ENABLED 1
+#endif
+
+namespace report_builder {
+    enum class ECompression {
+        None,
+        Gzip,
+    };
+
+    // Параметры сжатия вывода
+    struct TCompressionOptions {
+        ECompression Codec = ECompression::None;
+        // Уровень сжатия; -1 - уровень кодека по умолчанию (gzip 1..9)
+        int Level = -1;
+        // Размер куска, который сжимается за один вызов кодека
+        size_t ChunkBytes = 64 * 1024;
+        // Сколько кусков может ждать в очереди между потоками: распакованных -
+        // читателя (TDecompressingReader), несжатых - потока сжатия (TCompressedFileWriter)
+        size_t QueueDepth = 8;
+    };
+
+    inline const char* CompressionName(ECompression codec) {
+        switch (codec) {
+            case ECompression::Gzip:
+                return "gzip";
+            default:
+                return "none";
+        }
+    }
+
+    // Расширение, добавляемое к имени сжатого файла
+    inline const char* CompressionExtension(ECompression codec) {
+        switch (codec) {
+            case ECompression::Gzip:
+                return ".gz";
+            default:
+                return "";
+        }
+    }
+
+    // Поддерживается ли кодек в этой сборке
+    inline bool IsCompressionAvailable(ECompression codec) {
+        switch (codec) {
+            case ECompression::None:
+                return true;
+            case ECompression::Gzip:
+#ifdef REPORT_BUILDER_GZIP_ENABLED
+                return true;
+#else
+                return false;
+#endif
+        }
+        return false;
+    }
+
+    // Потоковый компрессор: Compress можно вызывать много раз, Finish - один раз в конце.
+    // Сжатые байты дописываются в output.
+    class ICompressor {
+    public:
+        virtual ~ICompressor() = default;
+        virtual bool Compress(std::string_view input, std::string& output) = 0;
+        virtual bool Finish(std::string& output) = 0;
+    };
+
+    // Потоковый декомпрессор. Входные данные могут быть разрезаны где угодно.
+    class IDecompressor {
+    public:
+        virtual ~IDecompressor() = default;
+        virtual bool Decompress(std::string_view input, std::string& output) = 0;
+        // Входные данные закончились ровно на границе сжатого потока
+        virtual bool IsComplete() const = 0;
+    };
+
+    // Без сжатия: байты копируются как есть
+    class TIdentityCodec: public ICompressor, public IDecompressor {
+    public:
+        bool Compress(std::string_view input, std::string& output) override {
+            output.append(input);
+            return true;
+        }
+
+        bool Finish(std::string&) override {
+            return true;
+        }
+
+        bool Decompress(std::string_view input, std::string& output) override {
+            output.append(input);
+            return true;
+        }
+
+        bool IsComplete() const override {
+            return true;
+        }
+    };
+
+#ifdef REPORT_BUILDER_GZIP_ENABLED
+    class TGzipCompressor: public ICompressor {
+    private:
+        z_stream Stream{};
+        bool Initialized = false;
+
+        bool Run(std::string_view input, int flush, std::string& output) {
+            Stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+            Stream.avail_in = static_cast<uInt>(input.size());
+            char buffer[16 * 1024];
+            int code = Z_OK;
+            do {
+                Stream.next_out = reinterpret_cast<Bytef*>(buffer);
+                Stream.avail_out = sizeof(buffer);
+                code = deflate(&Stream, flush);
+                if (code == Z_STREAM_ERROR) {
+                    return false;
+                }
+                output.append(buffer, sizeof(buffer) - Stream.avail_out);
+            } while (Stream.avail_out == 0 || (flush == Z_FINISH && code != Z_STREAM_END));
+            return true;
+        }
+
+    public:
+        explicit TGzipCompressor(int level) {
+            // 15 + 16: окно 32 КБ и заголовок gzip вместо zlib
+            Initialized = deflateInit2(&Stream, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+        }
+
+        ~TGzipCompressor() override {
+            if (Initialized) {
+                deflateEnd(&Stream);
+            }
+        }
+
+        bool Compress(std::string_view input, std::string& output) override {
+            return Initialized && Run(input, Z_NO_FLUSH, output);
+        }
+
+        bool Finish(std::string& output) override {
+            return Initialized && Run({}, Z_FINISH, output);
+        }
+    };
+
+    class TGzipDecompressor: public IDecompressor {
+    private:
+        z_stream Stream{};
+        bool Initialized = false;
+        bool Complete = false;
+
+    public:
+        TGzipDecompressor() {
+            // 15 + 32: заголовок gzip или zlib определяется автоматически
+            Initialized = inflateInit2(&Stream, 15 + 32) == Z_OK;
+        }
+
+        ~TGzipDecompressor() override {
+            if (Initialized) {
+                inflateEnd(&Stream);
+            }
+        }
+
+        bool Decompress(std::string_view input, std::string& output) override {
+            if (!Initialized) {
+                return false;
+            }
+            if (Complete && !input.empty()) {
+                // Следующий gzip-член (например, файлы, склеенные cat)
+                inflateReset(&Stream);
+                Complete = false;
+            }
+            Stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+            Stream.avail_in = static_cast<uInt>(input.size());
+            char buffer[64 * 1024];
+            do {
+                Stream.next_out = reinterpret_cast<Bytef*>(buffer);
+                Stream.avail_out = sizeof(buffer);
+                const int code = inflate(&Stream, Z_NO_FLUSH);
+                if (code != Z_OK && code != Z_STREAM_END && code != Z_BUF_ERROR) {
+                    return false;
+                }
+                output.append(buffer, sizeof(buffer) - Stream.avail_out);
+                if (code == Z_STREAM_END) {
+                    Complete = true;
+                    if (Stream.avail_in == 0) {
+                        break;
+                    }
+                    inflateReset(&Stream);
+                    Complete = false;
+                }
+            } while (Stream.avail_in > 0 || Stream.avail_out == 0);
+            return true;
+        }
+
+        bool IsComplete() const override {
+            return Complete;
+        }
+    };
+#endif
+
+
+    // nullptr, если кодек недоступен в этой сборке
+    inline std::unique_ptr<ICompressor> MakeCompressor(ECompression codec, int level = -1) {
+        switch (codec) {
+            case ECompression::None:
+                return std::make_unique<TIdentityCodec>();
+#ifdef REPORT_BUILDER_GZIP_ENABLED
+            case ECompression::Gzip:
+                return std::make_unique<TGzipCompressor>(level < 0 ? Z_DEFAULT_COMPRESSION : level);
+#endif
+            default:
+                (void)level;
+                return nullptr;
+        }
+    }
+
+    inline std::unique_ptr<IDecompressor> MakeDecompressor(ECompression codec) {
+        switch (codec) {
+            case ECompression::None:
+                return std::make_unique<TIdentityCodec>();
+#ifdef REPORT_BUILDER_GZIP_ENABLED
+            case ECompression::Gzip:
+                return std::make_unique<TGzipDecompressor>();
+#endif
+            default:
+                return nullptr;
+        }
+    }
+
+    // Очередь фиксированной емкости между двумя потоками.
+    // Push ждет, пока есть место; Pop ждет элемент или закрытия очереди.
+    template <class T>
+    class TBoundedQueue {
+    private:
+        std::deque<T> Items;
+        const size_t Capacity;
+        bool Closed = false;
+        std::mutex Mutex;
+        std::condition_variable NotFull;
+        std::condition_variable NotEmpty;
+
+    public:
+        explicit TBoundedQueue(size_t capacity)
+            : Capacity(std::max<size_t>(capacity, 1)) {
+        }
+
+        // false, если очередь уже закрыта
+        bool Push(T item) {
+            std::unique_lock<std::mutex> lock(Mutex);
+            NotFull.wait(lock, [&] { return Closed || Items.size() < Capacity; });
+            if (Closed) {
+                return false;
+            }
+            Items.push_back(std::move(item));
+            NotEmpty.notify_one();
+            return true;
+        }
+
+        // false, когда очередь закрыта и пуста
+        bool Pop(T& item) {
+            std::unique_lock<std::mutex> lock(Mutex);
+            NotEmpty.wait(lock, [&] { return Closed || !Items.empty(); });
+            if (Items.empty()) {
+                return false;
+            }
+            item = std::move(Items.front());
+            Items.pop_front();
+            NotFull.notify_one();
+            return true;
+        }
+
+        // Новые элементы не принимаются, оставшиеся еще можно забрать
+        void Close() {
+            std::lock_guard<std::mutex> lock(Mutex);
+            Closed = true;
+            NotFull.notify_all();
+            NotEmpty.notify_all();
+        }
+    };
+
+    // Кодек по первым байтам данных (магическое число gzip)
+    inline ECompression DetectCompression(std::string_view header) {
+        if (header.size() >= 2 && header[0] == '\x1f' && header[1] == '\x8b') {
+            return ECompression::Gzip;
+        }
+        return ECompression::None;
+    }
+
+    // Кодек файла; None и для несжатых, и для неоткрывающихся файлов
+    inline ECompression DetectFileCompression(const std::string& path) {
+        std::ifstream file(path, std::ios::binary);
+        char header[2] = {};
+        file.read(header, sizeof(header));
+        return DetectCompression(std::string_view(header, static_cast<size_t>(file.gcount())));
+    }
+
+    // Чтение сжатого файла как обычного std::istream. Отдельный поток читает файл,
+    // распаковывает его и передает куски через ограниченную очередь, пока
+    // потребитель разбирает предыдущие.
+    class TDecompressingReader: public std::istream {
+    private:
+        class TBuffer: public std::streambuf {
+        private:
+            TBoundedQueue<std::string>& Chunks;
+            std::string Current;
+
+        public:
+            explicit TBuffer(TBoundedQueue<std::string>& chunks)
+                : Chunks(chunks) {
+            }
+
+        protected:
+            int_type underflow() override {
+                do {
+                    if (!Chunks.Pop(Current)) {
+                        return traits_type::eof();
+                    }
+                } while (Current.empty());
+                setg(Current.data(), Current.data(), Current.data() + Current.size());
+                return traits_type::to_int_type(Current.front());
+            }
+        };
+
+        TBoundedQueue<std::string> Chunks;
+        TBuffer Buffer{Chunks};
+        std::thread Worker;
+        // Пишется потоком распаковки; читается только после его завершения (Finish)
+        std::optional<std::string> Error;
+
+        void Run(std::string path, ECompression codec, size_t chunkBytes) {
+            auto decompressor = MakeDecompressor(codec);
+            std::ifstream file(path, std::ios::binary);
+            if (!decompressor) {
+                Error = std::string("Compression is not available in this build: ") + CompressionName(codec);
+            } else if (!file.is_open()) {
+                Error = "Cannot open file: " + path;
+            } else {
+                std::string block(chunkBytes, '\0');
+                std::string output;
+                while (file) {
+                    file.read(block.data(), static_cast<std::streamsize>(block.size()));
+                    const auto read = static_cast<size_t>(file.gcount());
+                    if (read == 0) {
+                        break;
+                    }
+                    if (!decompressor->Decompress(std::string_view(block.data(), read), output)) {
+                        Error = "Corrupted " + std::string(CompressionName(codec)) + " data in " + path;
+                        break;
+                    }
+                    if (!output.empty() && !Chunks.Push(std::exchange(output, std::string()))) {
+                        break; // читатель закрыт раньше конца файла
+                    }
+                }
+                if (!Error && !file.bad() && file.eof() && !decompressor->IsComplete()) {
+                    Error = "Truncated " + std::string(CompressionName(codec)) + " data in " + path;
+                }
+            }
+            Chunks.Close();
+        }
+
+    public:
+        TDecompressingReader(const std::string& path, ECompression codec, TCompressionOptions options = {})
+            : std::istream(nullptr)
+            , Chunks(options.QueueDepth) {
+            rdbuf(&Buffer);
+            Worker = std::thread([this, path, codec, chunkBytes = std::max<size_t>(options.ChunkBytes, 1)] {
+                Run(path, codec, chunkBytes);
+            });
+        }
+
+        ~TDecompressingReader() override {
+            Finish();
+        }
+
+        // Останавливает распаковку и возвращает ее ошибку. Непрочитанные данные
+        // отбрасываются, поэтому ошибка значима, только если поток дочитан до конца.
+        const std::optional<std::string>& Finish() {
+            Chunks.Close();
+            if (Worker.joinable()) {
+                Worker.join();
+            }
+            return Error;
+        }
+    };
+
+    // Запись в файл со сжатием. Write режет данные на куски по ChunkBytes и ставит
+    // их в очередь на QueueDepth кусков; отдельный поток сжимает куски и пишет их
+    // в файл, пока вызывающий поток форматирует следующие (см. TCompressingStream).
+    class TCompressedFileWriter {
+    private:
+        TCompressionOptions Options;
+        std::ofstream File;
+        std::unique_ptr<ICompressor> Compressor;
+        std::unique_ptr<TBoundedQueue<std::string>> Chunks;
+        std::thread Worker;
+        // Ставится потоком сжатия; после ошибки Write больше не ставит куски в очередь
+        std::atomic<bool> Failed{false};
+        // Пишется потоком сжатия; читается только после его завершения (Close)
+        uint64_t BytesWritten = 0;
+
+        bool WriteFile(const std::string& data) {
+            File.write(data.data(), static_cast<std::streamsize>(data.size()));
+            BytesWritten += data.size();
+            return static_cast<bool>(File);
+        }
+
+        // Очередь разбирается до закрытия и после ошибки, чтобы Write не ждал места вечно
+        void Run() {
+            std::string chunk;
+            std::string compressed;
+            while (Chunks->Pop(chunk)) {
+                compressed.clear();
+                if (!Failed && (!Compressor->Compress(chunk, compressed) || !WriteFile(compressed))) {
+                    Failed = true;
+                }
+            }
+        }
+
+    public:
+        explicit TCompressedFileWriter(TCompressionOptions options)
+            : Options(options) {
+        }
+
+        TCompressedFileWriter(const TCompressedFileWriter&) = delete;
+        TCompressedFileWriter& operator=(const TCompressedFileWriter&) = delete;
+
+        ~TCompressedFileWriter() {
+            Close();
+        }
+
+        // false, если кодек недоступен или файл не открылся
+        bool Open(const std::string& path) {
+            Compressor = MakeCompressor(Options.Codec, Options.Level);
+            if (Compressor) {
+                File.open(path, std::ios::binary | std::ios::trunc);
+            }
+            Failed = !File.is_open();
+            if (!Failed) {
+                BytesWritten = 0;
+                Chunks = std::make_unique<TBoundedQueue<std::string>>(Options.QueueDepth);
+                Worker = std::thread([this] { Run(); });
+            }
+            return !Failed;
+        }
+
+        // Ждет места в очереди, если поток сжатия отстает. false после ошибки сжатия или записи.
+        // Бросает std::logic_error, если файл не открыт (Open не вызван или уже был Close)
+        bool Write(std::string_view data) {
+            if (!Chunks) {
+                throw std::logic_error("TCompressedFileWriter::Write called without an open file");
+            }
+            const size_t chunkBytes = std::max<size_t>(Options.ChunkBytes, 1);
+            for (size_t offset = 0; offset < data.size() && !Failed; offset += chunkBytes) {
+                Chunks->Push(std::string(data.substr(offset, chunkBytes)));
+            }
+            return !Failed;
+        }
+
+        // Дожидается сжатия очереди, дожимает поток и закрывает файл; true, если все записано
+        bool Close() {
+            if (Chunks) {
+                Chunks->Close();
+                Worker.join();
+                Chunks.reset();
+                std::string compressed;
+                if (Failed || !Compressor->Finish(compressed) || !WriteFile(compressed)) {
+                    Failed = true;
+                }
+                File.close();
+                if (!File) {
+                    Failed = true;
+                }
+            }
+            return Compressor && !Failed;
+        }
+
+        size_t GetChunkBytes() const {
+            return std::max<size_t>(Options.ChunkBytes, 1);
+        }
+
+        // Размер сжатых данных в файле (после Close)
+        uint64_t GetBytesWritten() const {
+            return BytesWritten;
+        }
+    };
+
+    // Поток вывода в TCompressedFileWriter: текст копится в буфере на один кусок
+    // сжатия, и каждый заполненный кусок сразу уходит в очередь писателя.
+    // Перед Close писателя поток нужно сбросить (flush).
+    class TCompressingStream: public std::ostream {
+    private:
+        class TBuffer: public std::streambuf {
+        private:
+            TCompressedFileWriter& Writer;
+            std::string Pending;
+            uint64_t Bytes = 0;
+
+            bool Flush() {
+                const auto size = static_cast<size_t>(pptr() - pbase());
+                Bytes += size;
+                setp(Pending.data(), Pending.data() + Pending.size());
+                return size == 0 || Writer.Write(std::string_view(Pending.data(), size));
+            }
+
+        public:
+            explicit TBuffer(TCompressedFileWriter& writer)
+                : Writer(writer)
+                , Pending(writer.GetChunkBytes(), '\0') {
+                setp(Pending.data(), Pending.data() + Pending.size());
+            }
+
+            uint64_t GetBytes() const {
+                return Bytes + static_cast<uint64_t>(pptr() - pbase());
+            }
+
+        protected:
+            int_type overflow(int_type ch) override {
+                if (!Flush()) {
+                    return traits_type::eof();
+                }
+                if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+                    *pptr() = traits_type::to_char_type(ch);
+                    pbump(1);
+                }
+                return traits_type::not_eof(ch);
+            }
+
+            int sync() override {
+                return Flush() ? 0 : -1;
+            }
+        };
+
+        TBuffer Buffer;
+
+    public:
+        explicit TCompressingStream(TCompressedFileWriter& writer)
+            : std::ostream(nullptr)
+            , Buffer(writer) {
+            rdbuf(&Buffer);
+        }
+
+        // Сколько несжатых байт выведено в поток
+        uint64_t GetBytes() const {
+            return Buffer.GetBytes();
+        }
+    };
+} // namespace report_builder
+
+#endif
@@ -0,0 +1,181 @@
+#ifndef REPORT_BUILDER_CSV_SCHEMA_H
+#define REPORT_BUILDER_CSV_SCHEMA_H
+
+#include <algorithm>
+#include <charconv>
+#include <limits>
+
+#include "report_builder/data_types.h"
+
+namespace report_builder {
+    // Тип колонки CSV
+    enum class EFieldType {
+        Int,
+        Double,
+        Bool,
+        Timestamp,
+        String,
+    };
+
+    inline const char* FieldTypeName(EFieldType type) {
+        switch (type) {
+            case EFieldType::Int:
+                return "int";
+            case EFieldType::Double:
+                return "double";
+            case EFieldType::Bool:
+                return "bool";
+            case EFieldType::Timestamp:
+                return "timestamp";
+            default:
+                return "string";
+        }
+    }
+
+    // Схема CSV: типы колонок выводятся по первым SampleRows строкам,
+    // объявленные типы имеют приоритет над выведенными
+    struct TCsvSchemaOptions {
+        size_t SampleRows = 1000;
+        std::map<std::string, EFieldType> DeclaredTypes;
+        // Неподходящее значение завершает чтение ошибкой вместо пропуска ячейки
+        bool FailOnIssues = false;
+        // Сколько проблем сохранять для отчета (счетчик считает все)
+        size_t MaxReportedIssues = 100;
+    };
+
+    // Значение, не подошедшее к типу колонки. Ячейка сохраняется исходной строкой
+    // (см. ParseFieldOrRaw).
+    struct TParseIssue {
+        size_t Line = 0; // номер строки файла, заголовок - строка 1
+        std::string Column;
+        std::string Value;
+        EFieldType Expected = EFieldType::String;
+    };
+
+    // Разбор без исключений: все поле целиком, иначе nullopt
+    inline std::optional<int64_t> ParseInt(std::string_view text) {
+        int64_t value = 0;
+        const char* begin = text.data() + (!text.empty() && text.front() == '+' ? 1 : 0);
+        auto [end, ec] = std::from_chars(begin, text.data() + text.size(), value);
+        if (ec != std::errc() || end != text.data() + text.size() || begin == end) {
+            return std::nullopt;
+        }
+        return value;
+    }
+
+    inline std::optional<double> ParseDouble(std::string_view text) {
+        double value = 0.0;
+        const char* begin = text.data() + (!text.empty() && text.front() == '+' ? 1 : 0);
+        auto [end, ec] = std::from_chars(begin, text.data() + text.size(), value);
+        if (ec != std::errc() || end != text.data() + text.size() || begin == end) {
+            return std::nullopt;
+        }
+        return value;
+    }
+
+    inline std::optional<bool> ParseBool(std::string_view text) {
+        if (text == "true" || text == "TRUE" || text == "True") {
+            return true;
+        }
+        if (text == "false" || text == "FALSE" || text == "False") {
+            return false;
+        }
+        return std::nullopt;
+    }
+
+    // Значение поля заданного типа; nullopt, если текст не подходит
+    inline std::optional<DataValue> ParseField(std::string_view text, EFieldType type) {
+        switch (type) {
+            case EFieldType::Int:
+                if (auto value = ParseInt(text)) {
+                    return MakeInteger(*value);
+                }
+                return std::nullopt;
+            case EFieldType::Double:
+                if (auto value = ParseDouble(text)) {
+                    return DataValue(*value);
+                }
+                return std::nullopt;
+            case EFieldType::Bool:
+                if (auto value = ParseBool(text)) {
+                    return DataValue(*value);
+                }
+                return std::nullopt;
+            case EFieldType::Timestamp:
+                if (auto value = ParseTimestamp(text)) {
+                    return DataValue(*value);
+                }
+                return std::nullopt;
+            default:
+                return DataValue(std::string(text));
+        }
+    }
+
+    // Значение поля с запасным правилом, одинаковым для всех строк файла:
+    // целое, не влезающее в int64_t, расширяется до double, остальные неподходящие
+    // значения остаются исходной строкой. Второй элемент - false, если значение
+    // не подошло к типу (расширение проблемой не считается).
+    inline std::pair<DataValue, bool> ParseFieldOrRaw(std::string_view text, EFieldType type) {
+        if (auto value = ParseField(text, type)) {
+            return {std::move(*value), true};
+        }
+        if (type == EFieldType::Int) {
+            if (auto value = ParseDouble(text)) {
+                return {DataValue(*value), true};
+            }
+        }
+        return {DataValue(std::string(text)), false};
+    }
+
+    // Вывод типа колонки по образцу значений: самый узкий тип (int уже double,
+    // даты - ISO 8601), которому подходят почти все непустые значения. Единичные
+    // выбросы (не больше 1% образца, но одно значение допускается всегда) тип
+    // не меняют: при чтении они обрабатываются по ParseFieldOrRaw, как и за
+    // пределами образца. Пустая колонка считается строковой.
+    class TFieldTypeGuess {
+    private:
+        size_t Seen = 0;
+        size_t Ints = 0;
+        size_t Doubles = 0;
+        size_t Bools = 0;
+        size_t Timestamps = 0;
+
+        bool Fits(size_t matched) const {
+            const size_t mismatched = Seen - matched;
+            return matched > mismatched && mismatched <= std::max<size_t>(1, Seen / 100);
+        }
+
+    public:
+        void Add(std::string_view text) {
+            if (text.empty()) {
+                return;
+            }
+            Seen++;
+            Ints += ParseInt(text).has_value();
+            Doubles += ParseDouble(text).has_value();
+            Bools += ParseBool(text).has_value();
+            Timestamps += ParseTimestamp(text).has_value();
+        }
+
+        EFieldType Get() const {
+            if (!Seen) {
+                return EFieldType::String;
+            }
+            if (Fits(Ints)) {
+                return EFieldType::Int;
+            }
+            if (Fits(Doubles)) {
+                return EFieldType::Double;
+            }
+            if (Fits(Bools)) {
+                return EFieldType::Bool;
+            }
+            if (Fits(Timestamps)) {
+                return EFieldType::Timestamp;
+            }
+            return EFieldType::String;
+        }
+    };
+} // namespace report_builder
+
+#endif
@@ -7,14 +7,54 @@
 #include <sstream>
 #include <type_traits>
 
+#include "report_builder/approximate_aggregates.h"
+#include "report_builder/external_sort.h"
 #include "report_builder/interfaces.h"
 
 namespace report_builder {
-    // Фильтр данных
+    // Условие "поле равно строке". Для словарных колонок код искомого значения
+    // находится один раз на словарь, после чего сравниваются целые числа.
+    inline std::function<bool(const DataRow&)> FieldEquals(std::string field, std::string expected) {
+        const TStringDictionary* cachedDict = nullptr;
+        std::optional<uint32_t> cachedCode;
+        return [field = std::move(field), expected = std::move(expected), cachedDict, cachedCode](const DataRow& row) mutable {
+            auto it = row.find(field);
+            if (it == row.end()) {
+                return false;
+            }
+            if (const auto* dict = std::get_if<TDictString>(&it->second)) {
+                if (dict->Dict.get() != cachedDict) {
+                    cachedDict = dict->Dict.get();
+                    cachedCode = dict->Dict->Find(expected);
+                }
+                return cachedCode && *cachedCode == dict->Code;
+            }
+            if (const auto* str = std::get_if<std::string>(&it->second)) {
+                return *str == expected;
+            }
+            return false;
+        };
+    }
+
+    using TRowPredicate = std::function<bool(const DataRow&)>;
+
+    // Оставляет в таблице строки, удовлетворяющие условию. Строки переносятся на месте, без копий.
+    inline void RetainRows(DataTable& data, const TRowPredicate& predicate) {
+        data.erase(std::remove_if(data.begin(), data.end(), [&](const DataRow& row) { return !predicate(row); }),
+                   data.end());
+    }
+
+    inline std::string LimitSuffix(const std::optional<size_t>& limit) {
+        return limit ? " limit " + std::to_string(*limit) : "";
+    }
+
+    // Фильтр данных. С лимитом просмотр прекращается на limit-й подходящей строке.
     class TFilterProcessor: public IDataProcessor {
     private:
         std::function<bool(const DataRow&)> FilterFunc;
         std::string ConditionDesc;
+        std::optional<size_t> Limit;
+        std::optional<std::string> ConditionKey;
 
     public:
         TFilterProcessor(std::function<bool(const DataRow&)> func, std::string desc = "")
@@ -23,82 +63,350 @@ namespace report_builder {
         }
 
         TOperationResult Process(DataTable data) override {
-            DataTable filtered;
-            std::copy_if(data.begin(), data.end(), std::back_inserter(filtered), FilterFunc);
-            return TOperationResult::Ok(filtered);
+            if (!Limit) {
+                RetainRows(data, FilterFunc);
+                return TOperationResult::Ok(std::move(data));
+            }
+            auto out = data.begin();
+            for (auto it = data.begin(); it != data.end() && size_t(out - data.begin()) < *Limit; ++it) {
+                if (FilterFunc(*it)) {
+                    if (out != it) {
+                        *out = std::move(*it);
+                    }
+                    ++out;
+                }
+            }
+            data.erase(out, data.end());
+            return TOperationResult::Ok(std::move(data));
+        }
+
+        std::string GetDescription() const override {
+            return "Filter" + (ConditionDesc.empty() ? "" : " (" + ConditionDesc + ")") + LimitSuffix(Limit);
+        }
+
+        // Условие - произвольная функция, поэтому фильтр делится с другими отчетами,
+        // только если ключ условия задан явно (SetConditionKey)
+        std::optional<std::string> GetShareKey() const override {
+            if (!ConditionKey) {
+                return std::nullopt;
+            }
+            return "Filter (" + *ConditionKey + ")" + LimitSuffix(Limit);
+        }
+
+        // Ключ, однозначно определяющий условие (например, его исходный текст)
+        void SetConditionKey(std::optional<std::string> key) {
+            ConditionKey = std::move(key);
+        }
+
+        const std::optional<std::string>& GetConditionKey() const {
+            return ConditionKey;
+        }
+
+        void SetLimit(std::optional<size_t> limit) {
+            Limit = limit;
+        }
+
+        const std::optional<size_t>& GetLimit() const {
+            return Limit;
+        }
+
+        const TRowPredicate& GetPredicate() const {
+            return FilterFunc;
+        }
+
+        const std::string& GetCondition() const {
+            return ConditionDesc;
+        }
+    };
+
+    // Первые Limit строк. Планировщик сливает лимит с предшествующими фильтром
+    // или сортировкой и передает его поставщику, если между ними нет блокирующих этапов.
+    class TLimitProcessor: public IDataProcessor {
+    private:
+        size_t Limit;
+
+    public:
+        explicit TLimitProcessor(size_t limit)
+            : Limit(limit) {
+        }
+
+        TOperationResult Process(DataTable data) override {
+            if (data.size() > Limit) {
+                data.erase(data.begin() + Limit, data.end());
+            }
+            return TOperationResult::Ok(std::move(data));
         }
 
         std::string GetDescription() const override {
-            return "Filter" + (ConditionDesc.empty() ? "" : " (" + ConditionDesc + ")");
+            return "Limit " + std::to_string(Limit);
+        }
+
+        std::optional<std::string> GetShareKey() const override {
+            return GetDescription();
+        }
+
+        size_t GetLimit() const {
+            return Limit;
+        }
+    };
+
+    // Случайная выборка строк с весами в колонке SampleWeightColumn. Агрегации
+    // по взвешенной выборке оценивают итоги полной таблицы. Если выборка стоит
+    // первой, планировщик передает ее поставщику.
+    class TSampleProcessor: public IDataProcessor {
+    private:
+        TSampleOptions Options;
+
+    public:
+        explicit TSampleProcessor(TSampleOptions options)
+            : Options(std::move(options)) {
+        }
+
+        TOperationResult Process(DataTable data) override {
+            if (auto error = Options.Validate()) {
+                return TOperationResult::Error(*error);
+            }
+            TRowSampler sampler(Options);
+            DataTable sample;
+            for (auto& row : data) {
+                std::string stratum;
+                if (Options.Mode == ESampleMode::Stratified) {
+                    auto it = row.find(Options.StratifyBy);
+                    stratum = SampleStratumKey(it == row.end() ? nullptr : &it->second);
+                }
+                if (auto slot = sampler.Offer(stratum)) {
+                    if (*slot == sample.size()) {
+                        sample.push_back(std::move(row));
+                    } else {
+                        sample[*slot] = std::move(row);
+                    }
+                }
+            }
+            sampler.Finish(sample);
+            return TOperationResult::Ok(std::move(sample));
+        }
+
+        std::string GetDescription() const override {
+            return "Sample (" + Options.Describe() + ")";
+        }
+
+        std::optional<std::string> GetShareKey() const override {
+            return GetDescription();
+        }
+
+        const TSampleOptions& GetOptions() const {
+            return Options;
+        }
+    };
+
+    // Базовый класс агрегаций. Результат зависит от порядка входных строк только
+    // в пределах округления (суммы double, квантили t-digest), поэтому включенный
+    // планировщик может убрать сортировку перед агрегацией и слить предшествующий
+    // фильтр в предусловие агрегации.
+    class TAggregatingProcessor: public IDataProcessor {
+    private:
+        TRowPredicate PreFilter;
+        std::string PreFilterDesc;
+        std::optional<std::string> PreFilterKey;
+
+    protected:
+        void ApplyPreFilter(DataTable& data) const {
+            if (PreFilter) {
+                RetainRows(data, PreFilter);
+            }
+        }
+
+        std::string DescribeWithPreFilter(std::string desc) const {
+            if (PreFilter) {
+                while (!desc.empty() && desc.back() == ' ') {
+                    desc.pop_back();
+                }
+                desc += " where (" + PreFilterDesc + ")";
+            }
+            return desc;
+        }
+
+    public:
+        // Добавляет условие к уже заданному через AND. Без key (ключа условия,
+        // см. TFilterProcessor::SetConditionKey) агрегация не делится с другими отчетами.
+        void AddPreFilter(TRowPredicate predicate, const std::string& desc, const std::optional<std::string>& key = std::nullopt) {
+            if (PreFilter) {
+                PreFilter = [first = std::move(PreFilter), second = std::move(predicate)](const DataRow& row) {
+                    return first(row) && second(row);
+                };
+                PreFilterDesc += " AND " + desc;
+                PreFilterKey = PreFilterKey && key ? std::optional<std::string>(*PreFilterKey + " AND " + *key) : std::nullopt;
+            } else {
+                PreFilter = std::move(predicate);
+                PreFilterDesc = desc;
+                PreFilterKey = key;
+            }
+        }
+
+        // Описание агрегации полностью задает ее результат, кроме предусловия
+        std::optional<std::string> GetShareKey() const override {
+            if (!PreFilter) {
+                return GetDescription();
+            }
+            if (!PreFilterKey) {
+                return std::nullopt;
+            }
+            return GetDescription() + " [key " + *PreFilterKey + "]";
         }
     };
 
-    // Сортировщик данных
+    // Сортировщик данных. Если таблица не помещается в бюджет памяти,
+    // переключается на внешнюю сортировку слиянием через временные файлы.
     class TSortProcessor: public IDataProcessor {
     private:
         std::string SortField;
         bool Ascending;
+        size_t MemoryBudgetBytes;
+        size_t MemoryLimitBytes = std::numeric_limits<size_t>::max();
+        std::optional<size_t> Limit;
+
+        struct TRowLess {
+            const TSortProcessor* Owner;
+
+            bool operator()(const DataRow& a, const DataRow& b) const {
+                return Owner->Less(a, b);
+            }
+        };
+
+        bool Less(const DataRow& a, const DataRow& b) const {
+            auto itA = a.find(SortField);
+            auto itB = b.find(SortField);
+
+            if (itA == a.end() || itB == b.end()) {
+                // Строки без поля сортировки идут в конец
+                return itA != a.end() && itB == b.end();
+            }
+
+            // Числа сравниваются численно, строки одного словаря - по кодам
+            const int order = CompareValues(itA->second, itB->second);
+            return Ascending ? order < 0 : order > 0;
+        }
+
+        size_t GetBudget() const {
+            return std::min(MemoryBudgetBytes, MemoryLimitBytes);
+        }
+
+        bool ExceedsBudget(const DataTable& data) const {
+            size_t bytes = 0;
+            for (const auto& row : data) {
+                bytes += EstimateRowBytes(row);
+                if (bytes > GetBudget()) {
+                    return true;
+                }
+            }
+            return false;
+        }
 
     public:
-        TSortProcessor(std::string field, bool asc = true)
+        static constexpr size_t DefaultMemoryBudget = 512u << 20;
+        static constexpr size_t MinMemoryLimit = 1u << 20;
+
+        TSortProcessor(std::string field, bool asc = true, size_t memoryBudgetBytes = DefaultMemoryBudget)
             : SortField(std::move(field))
-            , Ascending(asc) {
+            , Ascending(asc)
+            , MemoryBudgetBytes(memoryBudgetBytes) {
         }
 
         TOperationResult Process(DataTable data) override {
-            std::sort(data.begin(), data.end(),
-                      [this](const DataRow& a, const DataRow& b) {
-                          auto itA = a.find(SortField);
-                          auto itB = b.find(SortField);
-
-                          if (itA == a.end() || itB == b.end()) {
-                              return false;
-                          }
-
-                          // Используем лямбду для преобразования значения в строку
-                          auto getStringValue = [](const DataValue& val) -> std::string {
-                              return std::visit(
-                                  [](auto&& v) -> std::string {
-                                      using T = std::decay_t<decltype(v)>;
-                                      if constexpr (std::is_same_v<T, std::string>) {
-                                          return v;
-                                      } else if constexpr (std::is_same_v<T, bool>) {
-                                          return v ? "true" : "false";
-                                      } else if constexpr (std::is_same_v<T, int> ||
-                                                           std::is_same_v<T, double>) {
-                                          return std::to_string(v);
-                                      }
-                                  },
-                                  val);
-                          };
-
-                          std::string strA = getStringValue(itA->second);
-                          std::string strB = getStringValue(itB->second);
-
-                          return Ascending ? strA < strB : strA > strB;
-                      });
-
-            return TOperationResult::Ok(data);
+            // Top-K: частичная сортировка первых Limit строк
+            if (Limit && *Limit < data.size()) {
+                std::partial_sort(data.begin(), data.begin() + *Limit, data.end(), TRowLess{this});
+                data.erase(data.begin() + *Limit, data.end());
+                return TOperationResult::Ok(std::move(data));
+            }
+            if (auto stream = ProcessStreaming(data)) {
+                DataTable sorted;
+                DataRow row;
+                while (stream->Next(row)) {
+                    sorted.push_back(std::move(row));
+                }
+                if (auto error = stream->GetError()) {
+                    return TOperationResult::Error(*error);
+                }
+                return TOperationResult::Ok(std::move(sorted));
+            }
+
+            std::sort(data.begin(), data.end(), TRowLess{this});
+            return TOperationResult::Ok(std::move(data));
+        }
+
+        std::unique_ptr<IRowStream> ProcessStreaming(DataTable& data) override {
+            if (Limit || !ExceedsBudget(data)) {
+                return nullptr;
+            }
+            return ExternalSort(data, GetBudget(), TRowLess{this});
+        }
+
+        // Строки от поставщика сразу раскладываются по сериям: таблица больше бюджета
+        // не собирается в памяти целиком. Так читается только источник, который по
+        // оценке поставщика в бюджет не помещается; остальные читаются FetchData
+        // (со словарным кодированием) и сортируются в памяти. С лимитом (top-K) -
+        // тоже обычный путь.
+        std::unique_ptr<IRowStream> ProcessSource(IDataProvider& source, size_t& rowsRead) override {
+            const auto estimate = source.EstimateBytes();
+            if (Limit || !estimate || *estimate <= GetBudget()) {
+                return nullptr;
+            }
+            TExternalSorter<TRowLess> sorter(GetBudget(), TRowLess{this});
+            rowsRead = 0;
+            auto fetched = source.FetchRows([&](DataRow&& row) {
+                rowsRead++;
+                sorter.Add(std::move(row));
+            });
+            if (!fetched) {
+                return nullptr;
+            }
+            if (!fetched->Success) {
+                return std::make_unique<TFailedRowStream>(fetched->ErrorMessage.value_or("Cannot read data source"));
+            }
+            return sorter.Finish();
+        }
+
+        // Не меньше MinMemoryLimit, чтобы сброс на диск не дробился на крошечные отрезки
+        bool LimitMemory(size_t bytes) override {
+            MemoryLimitBytes = bytes == std::numeric_limits<size_t>::max() ? bytes : std::max(bytes, MinMemoryLimit);
+            return true;
         }
 
         std::string GetDescription() const override {
-            return "Sort by " + SortField + " (" + (Ascending ? "asc" : "desc") + ")";
+            return "Sort by " + SortField + " (" + (Ascending ? "asc" : "desc") + ")" + LimitSuffix(Limit);
+        }
+
+        std::optional<std::string> GetShareKey() const override {
+            return GetDescription();
+        }
+
+        // С лимитом результатом становятся первые limit строк порядка (top-K)
+        void SetLimit(std::optional<size_t> limit) {
+            Limit = limit;
+        }
+
+        const std::optional<size_t>& GetLimit() const {
+            return Limit;
         }
     };
 
     // Агрегатор данных
-    class TAggregationProcessor: public IDataProcessor {
+    class TAggregationProcessor: public TAggregatingProcessor {
     private:
         std::string Field;
-        std::string Operation; // sum, avg, count
+        std::string Operation; // sum, avg, count, approx_distinct, p50/p95/p99/...
+        TApproxOptions ApproxOptions;
 
     public:
-        TAggregationProcessor(std::string field, std::string op)
+        TAggregationProcessor(std::string field, std::string op, TApproxOptions approxOptions = {})
             : Field(std::move(field))
-            , Operation(std::move(op)) {
+            , Operation(std::move(op))
+            , ApproxOptions(approxOptions) {
         }
 
         TOperationResult Process(DataTable data) override {
+            ApplyPreFilter(data);
             if (data.empty()) {
                 return TOperationResult::Ok(data);
             }
@@ -106,18 +414,21 @@ namespace report_builder {
             DataTable resultTable;
             DataRow summaryRow;
 
-            if (Operation == "sum" || Operation == "avg") {
+            if (IsWeightedSample(data) && (Operation == "sum" || Operation == "avg" || Operation == "count")) {
+                auto estimate = WeightedAggregate(data, Field, Operation);
+                if (!estimate) {
+                    return TOperationResult::Error("Field '" + Field + "' not found in data for aggregation");
+                }
+                summaryRow = std::move(*estimate);
+            } else if (Operation == "sum" || Operation == "avg") {
                 double total = 0.0;
-                int count = 0;
+                int64_t count = 0;
 
                 for (const auto& row : data) {
                     auto it = row.find(Field);
                     if (it != row.end()) {
-                        if (std::holds_alternative<int>(it->second)) {
-                            total += std::get<int>(it->second);
-                            count++;
-                        } else if (std::holds_alternative<double>(it->second)) {
-                            total += std::get<double>(it->second);
+                        if (auto number = GetNumber(it->second)) {
+                            total += *number;
                             count++;
                         }
                     }
@@ -133,17 +444,23 @@ namespace report_builder {
                     summaryRow["field"] = Field;
                     summaryRow["operation"] = std::string("sum");
                     summaryRow["value"] = total;
-                    summaryRow["count"] = count;
+                    summaryRow["count"] = MakeInteger(count);
                 } else { // avg
                     summaryRow["field"] = Field;
                     summaryRow["operation"] = std::string("average");
                     summaryRow["value"] = total / count; // count > 0 гарантировано
-                    summaryRow["count"] = count;
+                    summaryRow["count"] = MakeInteger(count);
                 }
             } else if (Operation == "count") {
                 summaryRow["field"] = Field;
                 summaryRow["operation"] = std::string("count");
-                summaryRow["value"] = static_cast<int>(data.size());
+                summaryRow["value"] = MakeInteger(static_cast<int64_t>(data.size()));
+            } else if (IsApproximateOperation(Operation)) {
+                auto approxRow = ApproximateAggregate(data, Field, Operation, ApproxOptions);
+                if (!approxRow) {
+                    return TOperationResult::Error("Field '" + Field + "' not found in data for aggregation");
+                }
+                summaryRow = std::move(*approxRow);
             }
 
             resultTable.push_back(summaryRow);
@@ -151,42 +468,51 @@ namespace report_builder {
         }
 
         std::string GetDescription() const override {
-            return Operation + " of " + Field;
+            return DescribeWithPreFilter(Operation + " of " + Field);
         }
     };
 
     // Новое: Процессор для множественной агрегации
-    class TMultiAggregationProcessor: public IDataProcessor {
+    class TMultiAggregationProcessor: public TAggregatingProcessor {
     private:
         std::vector<std::pair<std::string, std::string>> Aggregations; // поле -> операция
+        TApproxOptions ApproxOptions;
 
     public:
-        TMultiAggregationProcessor(std::vector<std::pair<std::string, std::string>> aggregations)
-            : Aggregations(std::move(aggregations)) {
+        TMultiAggregationProcessor(std::vector<std::pair<std::string, std::string>> aggregations,
+                                   TApproxOptions approxOptions = {})
+            : Aggregations(std::move(aggregations))
+            , ApproxOptions(approxOptions) {
         }
 
         TOperationResult Process(DataTable data) override {
+            ApplyPreFilter(data);
             if (data.empty()) {
                 return TOperationResult::Ok(data);
             }
 
             DataTable resultTable;
+            // Взвешенная выборка: sum, avg и count оценивают полную таблицу
+            const bool weighted = IsWeightedSample(data);
 
             for (const auto& [field, operation] : Aggregations) {
                 DataRow summaryRow;
 
-                if (operation == "sum" || operation == "avg") {
+                if (weighted && (operation == "sum" || operation == "avg" || operation == "count")) {
+                    auto estimate = WeightedAggregate(data, field, operation);
+                    if (!estimate) {
+                        continue;
+                    }
+                    summaryRow = std::move(*estimate);
+                } else if (operation == "sum" || operation == "avg") {
                     double total = 0.0;
-                    int count = 0;
+                    int64_t count = 0;
 
                     for (const auto& row : data) {
                         auto it = row.find(field);
                         if (it != row.end()) {
-                            if (std::holds_alternative<int>(it->second)) {
-                                total += std::get<int>(it->second);
-                                count++;
-                            } else if (std::holds_alternative<double>(it->second)) {
-                                total += std::get<double>(it->second);
+                            if (auto number = GetNumber(it->second)) {
+                                total += *number;
                                 count++;
                             }
                         }
@@ -201,17 +527,23 @@ namespace report_builder {
                         summaryRow["field"] = field;
                         summaryRow["operation"] = std::string("sum");
                         summaryRow["value"] = total;
-                        summaryRow["count"] = count;
+                        summaryRow["count"] = MakeInteger(count);
                     } else { // avg
                         summaryRow["field"] = field;
                         summaryRow["operation"] = std::string("average");
                         summaryRow["value"] = total / count;
-                        summaryRow["count"] = count;
+                        summaryRow["count"] = MakeInteger(count);
                     }
                 } else if (operation == "count") {
                     summaryRow["field"] = field;
                     summaryRow["operation"] = std::string("count");
-                    summaryRow["value"] = static_cast<int>(data.size());
+                    summaryRow["value"] = MakeInteger(static_cast<int64_t>(data.size()));
+                } else if (IsApproximateOperation(operation)) {
+                    auto approxRow = ApproximateAggregate(data, field, operation, ApproxOptions);
+                    if (!approxRow) {
+                        continue;
+                    }
+                    summaryRow = std::move(*approxRow);
                 }
 
                 resultTable.push_back(summaryRow);
@@ -225,7 +557,98 @@ namespace report_builder {
             for (const auto& [field, op] : Aggregations) {
                 desc += field + "(" + op + ") ";
             }
-            return desc;
+            return DescribeWithPreFilter(desc);
+        }
+    };
+
+    // Группировка с агрегацией по группам: поле -> операция (sum, avg, count).
+    // Ключи сравниваются через KeyValueLess: словарные строки одного словаря - по кодам,
+    // обычная и словарная строка с одним текстом попадают в одну группу.
+    class TGroupByProcessor: public TAggregatingProcessor {
+    private:
+        std::vector<std::string> KeyFields;
+        std::vector<std::pair<std::string, std::string>> Aggregations;
+
+        struct TAccumulator {
+            double Total = 0.0;
+            int64_t Count = 0;
+        };
+
+    public:
+        TGroupByProcessor(std::vector<std::string> keys, std::vector<std::pair<std::string, std::string>> aggregations)
+            : KeyFields(std::move(keys))
+            , Aggregations(std::move(aggregations)) {
+        }
+
+        TOperationResult Process(DataTable data) override {
+            ApplyPreFilter(data);
+            std::map<std::vector<DataValue>, std::pair<int64_t, std::vector<TAccumulator>>, TKeyLess> groups;
+
+            std::vector<DataValue> key;
+            for (const auto& row : data) {
+                key.clear();
+                for (const auto& field : KeyFields) {
+                    auto it = row.find(field);
+                    if (it == row.end()) {
+                        break;
+                    }
+                    key.push_back(it->second);
+                }
+                if (key.size() != KeyFields.size()) {
+                    // Строки без ключевых полей в группировку не попадают
+                    continue;
+                }
+
+                auto& [rows, accumulators] = groups[key];
+                accumulators.resize(Aggregations.size());
+                rows++;
+                for (size_t i = 0; i < Aggregations.size(); i++) {
+                    auto it = row.find(Aggregations[i].first);
+                    if (it == row.end()) {
+                        continue;
+                    }
+                    if (auto number = GetNumber(it->second)) {
+                        accumulators[i].Total += *number;
+                        accumulators[i].Count++;
+                    }
+                }
+            }
+
+            DataTable resultTable;
+            resultTable.reserve(groups.size());
+            for (const auto& [groupKey, group] : groups) {
+                const auto& [rows, accumulators] = group;
+                DataRow resultRow;
+                for (size_t i = 0; i < KeyFields.size(); i++) {
+                    resultRow[KeyFields[i]] = groupKey[i];
+                }
+                for (size_t i = 0; i < Aggregations.size(); i++) {
+                    const auto& [field, operation] = Aggregations[i];
+                    const auto& acc = accumulators[i];
+                    if (operation == "sum") {
+                        resultRow[field + "_sum"] = acc.Total;
+                    } else if (operation == "avg" && acc.Count > 0) {
+                        resultRow[field + "_avg"] = acc.Total / acc.Count;
+                    } else if (operation == "count") {
+                        resultRow[field + "_count"] = MakeInteger(rows);
+                    }
+                }
+                resultTable.push_back(std::move(resultRow));
+            }
+
+            return TOperationResult::Ok(resultTable);
+        }
+
+        std::string GetDescription() const override {
+            std::string desc = "Group by";
+            for (const auto& key : KeyFields) {
+                desc += " " + key;
+            }
+            desc += ": ";
+            for (const auto& [field, op] : Aggregations) {
+                desc += field + "(" + op + ") ";
+            }
+            return DescribeWithPreFilter(desc);
         }
     };
 } // namespace report_builder
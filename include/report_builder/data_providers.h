@@ -1,73 +1,312 @@
 #ifndef REPORT_BUILDER_DATA_PROVIDERS_H
 #define REPORT_BUILDER_DATA_PROVIDERS_H
 
+#include <filesystem>
 #include <fstream>
 #include <sstream>
 
+#include "report_builder/compression.h"
+#include "report_builder/csv_schema.h"
+#include "report_builder/dictionary_encoding.h"
 #include "report_builder/interfaces.h"
 
 namespace report_builder {
-    // CSV провайдер
+    // Параметры чтения CSV, влияющие на данные, - часть ключа GetShareKey
+    inline std::string DescribeCsvOptions(char delimiter, const TCsvSchemaOptions& schema,
+                                          const TDictionaryEncodingOptions& dictionary) {
+        std::ostringstream out;
+        out << "delimiter " << static_cast<int>(delimiter) << ", sample " << schema.SampleRows
+            << (schema.FailOnIssues ? ", strict" : "");
+        for (const auto& [name, type] : schema.DeclaredTypes) {
+            out << ", " << name << ": " << FieldTypeName(type);
+        }
+        if (dictionary.Enabled) {
+            out << ", dictionary " << dictionary.MinRows << "/" << dictionary.MaxDictionarySize << "/"
+                << dictionary.MaxCardinalityRatio;
+        }
+        return out.str();
+    }
+
+    // CSV провайдер. Типы колонок выводятся по первым строкам файла (или
+    // объявляются в TCsvSchemaOptions), после чего каждая колонка разбирается
+    // своим парсером без исключений; значения не своего типа остаются строками
+    // (большие целые - double) и попадают в GetParseIssues. Файлы gzip распознаются по содержимому
+    // и распаковываются на лету в отдельном потоке. Переданные планировщиком
+    // лимит и выборка применяются при чтении.
     class TCsvDataProvider: public IDataProvider {
     private:
         std::string Filepath;
         char Delimiter;
+        TDictionaryEncodingOptions DictionaryOptions;
+        TCsvSchemaOptions SchemaOptions;
+        std::vector<std::pair<std::string, EFieldType>> Schema;
+        std::vector<TParseIssue> ParseIssues;
+        size_t IssueCount = 0;
+        std::optional<TScanLimit> Limit;
+        std::optional<TSampleOptions> Sample;
+        TCounter* IssuesCounter = &TMetricsRegistry::Global().GetCounter(
+            "report_builder_csv_parse_issues", "CSV values that did not match the column type.");
 
-    public:
-        TCsvDataProvider(std::string path, char delim = ',')
-            : Filepath(std::move(path))
-            , Delimiter(delim) {
+        // Режет строку по разделителю; string_view указывают в line
+        void SplitFields(std::string_view line, std::vector<std::string_view>& fields) const {
+            fields.clear();
+            if (!line.empty() && line.back() == '\r') {
+                line.remove_suffix(1);
+            }
+            size_t start = 0;
+            while (true) {
+                const size_t end = line.find(Delimiter, start);
+                if (end == std::string_view::npos) {
+                    fields.push_back(line.substr(start));
+                    return;
+                }
+                fields.push_back(line.substr(start, end - start));
+                start = end + 1;
+            }
         }
 
-        TOperationResult FetchData() override {
-            std::ifstream file(Filepath);
-            if (!file.is_open()) {
-                return TOperationResult::Error("Cannot open file: " + Filepath);
+        // false, если встретилось неподходящее значение и FailOnIssues
+        bool ParseLine(std::string_view line, size_t lineNumber, std::vector<std::string_view>& fields, DataRow& row) {
+            SplitFields(line, fields);
+            const size_t count = std::min(fields.size(), Schema.size());
+            for (size_t i = 0; i < count; i++) {
+                const auto& [name, type] = Schema[i];
+                if (fields[i].empty() && type != EFieldType::String) {
+                    continue;
+                }
+                auto [value, fits] = ParseFieldOrRaw(fields[i], type);
+                row[name] = std::move(value);
+                if (fits) {
+                    continue;
+                }
+                IssueCount++;
+                IssuesCounter->Inc();
+                if (ParseIssues.size() < SchemaOptions.MaxReportedIssues) {
+                    ParseIssues.push_back({lineNumber, name, std::string(fields[i]), type});
+                }
+                if (SchemaOptions.FailOnIssues) {
+                    return false;
+                }
             }
+            return true;
+        }
 
-            DataTable table;
+        // Читает файл; с sink строки отдаются по одной, без таблицы и словарного кодирования
+        TOperationResult Read(const TRowSink* sink) {
+            std::unique_ptr<std::istream> input;
+            TDecompressingReader* reader = nullptr;
+            const ECompression codec = DetectFileCompression(Filepath);
+            if (codec == ECompression::None) {
+                auto plain = std::make_unique<std::ifstream>(Filepath);
+                if (!plain->is_open()) {
+                    return TOperationResult::Error("Cannot open file: " + Filepath);
+                }
+                input = std::move(plain);
+            } else {
+                if (!IsCompressionAvailable(codec)) {
+                    return TOperationResult::Error(std::string("Compression is not available in this build: ") +
+                                                   CompressionName(codec));
+                }
+                auto compressed = std::make_unique<TDecompressingReader>(Filepath, codec);
+                reader = compressed.get();
+                input = std::move(compressed);
+            }
+            std::istream& file = *input;
+
+            Schema.clear();
+            ParseIssues.clear();
+            IssueCount = 0;
             std::string line;
-            std::vector<std::string> headers;
+            std::vector<std::string_view> fields;
 
             // Читаем заголовки
             if (std::getline(file, line)) {
-                std::stringstream ss(line);
-                std::string header;
-                while (std::getline(ss, header, Delimiter)) {
-                    headers.push_back(header);
+                SplitFields(line, fields);
+                for (auto header : fields) {
+                    Schema.emplace_back(std::string(header), EFieldType::String);
                 }
             }
 
-            // Читаем данные
-            while (std::getline(file, line)) {
-                DataRow row;
-                std::stringstream ss(line);
-                std::string value;
-                size_t colIdx = 0;
-
-                while (std::getline(ss, value, Delimiter) && colIdx < headers.size()) {
-                    // Пытаемся определить тип данных
-                    try {
-                        if (value.find('.') != std::string::npos) {
-                            double dval = std::stod(value);
-                            row[headers[colIdx]] = dval;
-                        } else {
-                            int ival = std::stoi(value);
-                            row[headers[colIdx]] = ival;
+            // Первые строки - образец для вывода типов
+            std::vector<std::string> sample;
+            while (sample.size() < SchemaOptions.SampleRows && std::getline(file, line)) {
+                sample.push_back(std::move(line));
+            }
+            std::vector<TFieldTypeGuess> guesses(Schema.size());
+            for (const auto& sampleLine : sample) {
+                SplitFields(sampleLine, fields);
+                for (size_t i = 0; i < std::min(fields.size(), guesses.size()); i++) {
+                    guesses[i].Add(fields[i]);
+                }
+            }
+            for (size_t i = 0; i < Schema.size(); i++) {
+                auto declared = SchemaOptions.DeclaredTypes.find(Schema[i].first);
+                Schema[i].second = declared != SchemaOptions.DeclaredTypes.end() ? declared->second : guesses[i].Get();
+            }
+
+            // Читаем данные. Выборка решает до разбора, нужна ли строка:
+            // для страты из строки вырезается только одно поле.
+            std::optional<TRowSampler> sampler;
+            std::optional<size_t> stratumColumn;
+            if (Sample) {
+                sampler.emplace(*Sample);
+                if (Sample->Mode == ESampleMode::Stratified) {
+                    for (size_t i = 0; i < Schema.size() && !stratumColumn; i++) {
+                        if (Schema[i].first == Sample->StratifyBy) {
+                            stratumColumn = i;
                         }
-                    } catch (...) {
-                        row[headers[colIdx]] = value;
                     }
-                    colIdx++;
+                    if (!stratumColumn) {
+                        return TOperationResult::Error("Stratify column '" + Sample->StratifyBy + "' not found in " + Filepath);
+                    }
                 }
-                table.push_back(std::move(row));
+            }
+            DataTable table;
+            size_t accepted = 0;
+            size_t lineNumber = 1;
+            auto addLine = [&](std::string_view text) {
+                ++lineNumber;
+                std::optional<size_t> slot;
+                if (sampler) {
+                    // Страта - разобранное значение, как у TSampleProcessor: "1.50" и "1.5" - одна страта
+                    std::string stratum;
+                    if (stratumColumn) {
+                        SplitFields(text, fields);
+                        const EFieldType type = Schema[*stratumColumn].second;
+                        if (*stratumColumn < fields.size() && !(fields[*stratumColumn].empty() && type != EFieldType::String)) {
+                            const DataValue value = ParseFieldOrRaw(fields[*stratumColumn], type).first;
+                            stratum = SampleStratumKey(&value);
+                        }
+                    }
+                    slot = sampler->Offer(stratum);
+                    if (!slot) {
+                        return true;
+                    }
+                }
+                DataRow row;
+                if (!ParseLine(text, lineNumber, fields, row)) {
+                    return false;
+                }
+                // Резервуар вытесняет ранее выбранную строку; в выборке Бернулли место всегда новое
+                if (slot && *slot < table.size()) {
+                    table[*slot] = std::move(row);
+                } else if (!Limit || Limit->Accepts(row)) {
+                    accepted++;
+                    if (sink) {
+                        (*sink)(std::move(row));
+                    } else {
+                        table.push_back(std::move(row));
+                    }
+                }
+                return true;
+            };
+            // С лимитом чтение прекращается, как только набрано достаточно строк
+            auto enough = [&] {
+                return Limit && accepted >= Limit->Rows;
+            };
+            bool parsed = true;
+            for (size_t i = 0; i < sample.size() && parsed && !enough(); i++) {
+                parsed = addLine(sample[i]);
+            }
+            while (parsed && !enough() && std::getline(file, line)) {
+                parsed = addLine(line);
+            }
+            if (!parsed) {
+                const auto& issue = ParseIssues.back();
+                return TOperationResult::Error("Line " + std::to_string(issue.Line) + ": value '" + issue.Value +
+                                               "' in column '" + issue.Column + "' is not " +
+                                               FieldTypeName(issue.Expected));
+            }
+            // Ошибку распаковки проверяем после остановки ее потока; после досрочного
+            // конца чтения по лимиту хвост файла не важен
+            if (reader && !enough()) {
+                if (const auto& error = reader->Finish()) {
+                    return TOperationResult::Error(*error);
+                }
+            }
+            if (sampler) {
+                sampler->Finish(table);
             }
 
+            DictionaryEncode(table, DictionaryOptions);
             return TOperationResult::Ok(table);
         }
 
+    public:
+        TCsvDataProvider(std::string path, char delim = ',', TDictionaryEncodingOptions dictOptions = {},
+                         TCsvSchemaOptions schemaOptions = {})
+            : Filepath(std::move(path))
+            , Delimiter(delim)
+            , DictionaryOptions(dictOptions)
+            , SchemaOptions(std::move(schemaOptions)) {
+        }
+
+        TOperationResult FetchData() override {
+            return Read(nullptr);
+        }
+
+        // Выборке нужен весь файл до выдачи строк, поэтому с ней строки по одной не отдаются
+        std::optional<TOperationResult> FetchRows(const TRowSink& sink) override {
+            if (Sample) {
+                return std::nullopt;
+            }
+            return Read(&sink);
+        }
+
+        // Типы колонок последнего чтения
+        const std::vector<std::pair<std::string, EFieldType>>& GetSchema() const {
+            return Schema;
+        }
+
+        // Первые MaxReportedIssues значений, не подошедших к типу колонки
+        const std::vector<TParseIssue>& GetParseIssues() const {
+            return ParseIssues;
+        }
+
+        size_t GetIssueCount() const {
+            return IssueCount;
+        }
+
+        // Выборка фиксированного размера должна увидеть все строки, поэтому лимит с ней не совместим
+        bool PushDownLimit(TScanLimit limit) override {
+            if (Sample && Sample->Mode != ESampleMode::Bernoulli) {
+                return false;
+            }
+            Limit = std::move(limit);
+            return true;
+        }
+
+        // Строки, не попавшие в выборку, не разбираются
+        bool PushDownSample(const TSampleOptions& options) override {
+            if (Limit || options.Validate()) {
+                return false;
+            }
+            Sample = options;
+            return true;
+        }
+
+        // Разобранная таблица не меньше текста файла (сжатого - тем более)
+        std::optional<size_t> EstimateBytes() const override {
+            std::error_code ec;
+            const auto size = std::filesystem::file_size(Filepath, ec);
+            if (ec || Limit || Sample) {
+                return std::nullopt;
+            }
+            return static_cast<size_t>(size);
+        }
+
         std::string GetSourceInfo() const override {
-            return "CSV file: " + Filepath;
+            return "CSV file: " + Filepath + (Sample ? " (sample: " + Sample->Describe() + ")" : "") +
+                   (Limit ? Limit->Describe() : "");
+        }
+
+        std::optional<std::string> GetShareKey() const override {
+            auto limit = Limit ? Limit->ShareKey() : std::optional<std::string>("");
+            if (!limit) {
+                return std::nullopt;
+            }
+            return "CSV file: " + Filepath + " [" + DescribeCsvOptions(Delimiter, SchemaOptions, DictionaryOptions) + "]" +
+                   (Sample ? " (sample: " + Sample->Describe() + ")" : "") + *limit;
         }
     };
 
@@ -75,18 +314,55 @@ namespace report_builder {
     class TInMemoryDataProvider: public IDataProvider {
     private:
         DataTable StaticData;
+        std::optional<TScanLimit> Limit;
+        std::optional<std::string> DataKey;
 
     public:
-        TInMemoryDataProvider(DataTable data)
+        TInMemoryDataProvider(DataTable data, TDictionaryEncodingOptions dictOptions = {})
             : StaticData(std::move(data)) {
+            DictionaryEncode(StaticData, dictOptions);
         }
 
         TOperationResult FetchData() override {
-            return TOperationResult::Ok(StaticData);
+            if (!Limit) {
+                return TOperationResult::Ok(StaticData);
+            }
+            DataTable data;
+            for (size_t i = 0; i < StaticData.size() && data.size() < Limit->Rows; i++) {
+                if (Limit->Accepts(StaticData[i])) {
+                    data.push_back(StaticData[i]);
+                }
+            }
+            return TOperationResult::Ok(std::move(data));
+        }
+
+        bool PushDownLimit(TScanLimit limit) override {
+            Limit = std::move(limit);
+            return true;
+        }
+
+        std::optional<size_t> EstimateBytes() const override {
+            if (Limit) {
+                return std::nullopt;
+            }
+            return EstimateTableBytes(StaticData);
         }
 
         std::string GetSourceInfo() const override {
-            return "In-memory data (" + std::to_string(StaticData.size()) + " rows)";
+            return "In-memory data (" + std::to_string(StaticData.size()) + " rows)" + (Limit ? Limit->Describe() : "");
+        }
+
+        // Содержимое таблицы не сравнивается, поэтому общее чтение - только по явному ключу данных
+        void SetDataKey(std::optional<std::string> key) {
+            DataKey = std::move(key);
+        }
+
+        std::optional<std::string> GetShareKey() const override {
+            auto limit = Limit ? Limit->ShareKey() : std::optional<std::string>("");
+            if (!DataKey || !limit) {
+                return std::nullopt;
+            }
+            return "In-memory data " + *DataKey + *limit;
         }
     };
 
@@ -116,6 +392,10 @@ namespace report_builder {
         std::string GetSourceInfo() const override {
             return "JSON data provider";
         }
+
+        std::optional<std::string> GetShareKey() const override {
+            return "JSON: " + JsonContent;
+        }
     };
 } // namespace report_builder
 
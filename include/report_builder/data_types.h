@@ -1,16 +1,294 @@
 #ifndef REPORT_BUILDER_DATA_TYPES_H
 #define REPORT_BUILDER_DATA_TYPES_H
 
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <limits>
 #include <map>
 #include <memory>
 #include <optional>
+#include <ostream>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <variant>
 #include <vector>
 
 namespace report_builder {
-    // Тип для ячейки данных
-    using DataValue = std::variant<std::string, int, double, bool>;
+    // Словарь значений строковой колонки с низкой кардинальностью.
+    // Коды назначаются в порядке сортировки строк, поэтому сравнение кодов
+    // одного словаря эквивалентно сравнению самих строк.
+    class TStringDictionary {
+    private:
+        std::vector<std::string> Values;
+        std::vector<size_t> Hashes;
+
+    public:
+        // Принимает отсортированный список уникальных значений
+        explicit TStringDictionary(std::vector<std::string> sortedValues)
+            : Values(std::move(sortedValues)) {
+            Hashes.reserve(Values.size());
+            for (const auto& value : Values) {
+                Hashes.push_back(std::hash<std::string_view>{}(value));
+            }
+        }
+
+        const std::string& Get(uint32_t code) const {
+            return Values[code];
+        }
+
+        size_t GetHash(uint32_t code) const {
+            return Hashes[code];
+        }
+
+        std::optional<uint32_t> Find(std::string_view value) const {
+            auto it = std::lower_bound(Values.begin(), Values.end(), value);
+            if (it == Values.end() || *it != value) {
+                return std::nullopt;
+            }
+            return static_cast<uint32_t>(it - Values.begin());
+        }
+
+        size_t Size() const {
+            return Values.size();
+        }
+    };
+
+    // Строка, закодированная номером в общем словаре колонки. Пустой
+    // TDictString не бывает: словарь задается при создании.
+    struct TDictString {
+        std::shared_ptr<const TStringDictionary> Dict;
+        uint32_t Code = 0;
+
+        TDictString(std::shared_ptr<const TStringDictionary> dict, uint32_t code)
+            : Dict(std::move(dict))
+            , Code(code) {
+            if (!Dict || Code >= Dict->Size()) {
+                throw std::out_of_range("TDictString code " + std::to_string(code) + " is outside its dictionary");
+            }
+        }
+
+        const std::string& Str() const {
+            return Dict->Get(Code);
+        }
+    };
+
+    inline bool operator==(const TDictString& a, const TDictString& b) {
+        if (a.Dict == b.Dict) {
+            return a.Code == b.Code;
+        }
+        return a.Str() == b.Str();
+    }
+
+    inline bool operator!=(const TDictString& a, const TDictString& b) {
+        return !(a == b);
+    }
+
+    inline bool operator<(const TDictString& a, const TDictString& b) {
+        if (a.Dict == b.Dict) {
+            return a.Code < b.Code;
+        }
+        return a.Str() < b.Str();
+    }
+
+    inline bool operator>(const TDictString& a, const TDictString& b) {
+        return b < a;
+    }
+
+    inline bool operator<=(const TDictString& a, const TDictString& b) {
+        return !(b < a);
+    }
+
+    inline bool operator>=(const TDictString& a, const TDictString& b) {
+        return !(a < b);
+    }
+
+    inline std::ostream& operator<<(std::ostream& out, const TDictString& value) {
+        return out << value.Str();
+    }
+
+    inline constexpr int64_t SecondsPerDay = 86400;
+
+    // Деление с округлением вниз, в том числе для отрицательных
+    inline constexpr int64_t FloorDiv(int64_t value, int64_t divisor) {
+        return value / divisor - (value % divisor != 0 && (value < 0) != (divisor < 0));
+    }
+
+    // Дата григорианского календаря
+    struct TCivilDate {
+        int64_t Year = 1970;
+        unsigned Month = 1;
+        unsigned Day = 1;
+    };
+
+    // Номер дня от 1970-01-01 (алгоритм days_from_civil Говарда Хиннанта)
+    inline constexpr int64_t DaysFromCivil(int64_t year, unsigned month, unsigned day) {
+        year -= month <= 2;
+        const int64_t era = (year >= 0 ? year : year - 399) / 400;
+        const auto yoe = static_cast<unsigned>(year - era * 400);
+        const unsigned doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+        const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+        return era * 146097 + static_cast<int64_t>(doe) - 719468;
+    }
+
+    inline constexpr TCivilDate CivilFromDays(int64_t days) {
+        days += 719468;
+        const int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+        const auto doe = static_cast<unsigned>(days - era * 146097);
+        const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+        const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+        const unsigned mp = (5 * doy + 2) / 153;
+        const unsigned month = mp < 10 ? mp + 3 : mp - 9;
+        return {static_cast<int64_t>(yoe) + era * 400 + (month <= 2), month, doy - (153 * mp + 2) / 5 + 1};
+    }
+
+    // Момент времени: секунды от 1970-01-01T00:00:00 UTC. Поставщики разбирают
+    // текст даты один раз, дальше сравнение и группировка идут по целому числу.
+    struct TTimestamp {
+        int64_t Seconds = 0;
+
+        static constexpr TTimestamp FromDate(int64_t year, unsigned month, unsigned day, unsigned hour = 0,
+                                             unsigned minute = 0, unsigned second = 0) {
+            return {DaysFromCivil(year, month, day) * SecondsPerDay + hour * 3600 + minute * 60 + second};
+        }
+
+        int64_t Days() const {
+            return FloorDiv(Seconds, SecondsPerDay);
+        }
+
+        TCivilDate Date() const {
+            return CivilFromDays(Days());
+        }
+    };
+
+    inline bool operator==(TTimestamp a, TTimestamp b) {
+        return a.Seconds == b.Seconds;
+    }
+
+    inline bool operator!=(TTimestamp a, TTimestamp b) {
+        return a.Seconds != b.Seconds;
+    }
+
+    inline bool operator<(TTimestamp a, TTimestamp b) {
+        return a.Seconds < b.Seconds;
+    }
+
+    inline bool operator>(TTimestamp a, TTimestamp b) {
+        return a.Seconds > b.Seconds;
+    }
+
+    inline bool operator<=(TTimestamp a, TTimestamp b) {
+        return a.Seconds <= b.Seconds;
+    }
+
+    inline bool operator>=(TTimestamp a, TTimestamp b) {
+        return a.Seconds >= b.Seconds;
+    }
+
+    // Достаточный размер буфера для FormatTimestamp
+    inline constexpr size_t TimestampBufferSize = 32;
+
+    // ISO 8601 без выделения памяти, всегда с временем: "2024-01-31T00:00:00".
+    // Одна форма для всех значений колонки, в том числе для часовых интервалов
+    // с началом в полночь. Возвращает длину записанного текста.
+    inline size_t FormatTimestamp(TTimestamp value, char* out) {
+        const int64_t days = value.Days();
+        const auto time = static_cast<unsigned>(value.Seconds - days * SecondsPerDay);
+        const TCivilDate date = CivilFromDays(days);
+        char* pos = out;
+        auto put2 = [&pos](unsigned number) {
+            *pos++ = static_cast<char>('0' + number / 10);
+            *pos++ = static_cast<char>('0' + number % 10);
+        };
+        if (date.Year >= 0 && date.Year <= 9999) {
+            put2(static_cast<unsigned>(date.Year / 100));
+            put2(static_cast<unsigned>(date.Year % 100));
+        } else {
+            pos = std::to_chars(pos, out + TimestampBufferSize, date.Year).ptr;
+        }
+        *pos++ = '-';
+        put2(date.Month);
+        *pos++ = '-';
+        put2(date.Day);
+        *pos++ = 'T';
+        put2(time / 3600);
+        *pos++ = ':';
+        put2(time / 60 % 60);
+        *pos++ = ':';
+        put2(time % 60);
+        return static_cast<size_t>(pos - out);
+    }
+
+    inline std::string TimestampToString(TTimestamp value) {
+        char buffer[TimestampBufferSize];
+        return std::string(buffer, FormatTimestamp(value, buffer));
+    }
+
+    // Разбор "YYYY-MM-DD", "YYYY-MM-DDTHH:MM[:SS]" (или через пробел) с необязательным Z.
+    // Время считается UTC; nullopt, если текст не дата или дата не существует.
+    inline std::optional<TTimestamp> ParseTimestamp(std::string_view text) {
+        if (!text.empty() && text.back() == 'Z') {
+            text.remove_suffix(1);
+        }
+        auto digits = [text](size_t pos, size_t count) -> std::optional<unsigned> {
+            if (pos + count > text.size()) {
+                return std::nullopt;
+            }
+            unsigned value = 0;
+            for (size_t i = pos; i < pos + count; i++) {
+                if (text[i] < '0' || text[i] > '9') {
+                    return std::nullopt;
+                }
+                value = value * 10 + static_cast<unsigned>(text[i] - '0');
+            }
+            return value;
+        };
+
+        const auto year = digits(0, 4);
+        const auto month = digits(5, 2);
+        const auto day = digits(8, 2);
+        if (text.size() < 10 || !year || !month || !day || text[4] != '-' || text[7] != '-' ||
+            *month < 1 || *month > 12 || *day < 1) {
+            return std::nullopt;
+        }
+        const bool leap = *year % 4 == 0 && (*year % 100 != 0 || *year % 400 == 0);
+        constexpr unsigned monthDays[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+        if (*day > monthDays[*month - 1] + (*month == 2 && leap)) {
+            return std::nullopt;
+        }
+
+        unsigned hour = 0, minute = 0, second = 0;
+        if (text.size() > 10) {
+            const auto h = digits(11, 2);
+            const auto m = digits(14, 2);
+            if ((text[10] != 'T' && text[10] != ' ') || !h || !m || text[13] != ':' || *h > 23 || *m > 59) {
+                return std::nullopt;
+            }
+            hour = *h;
+            minute = *m;
+            if (text.size() > 16) {
+                const auto s = digits(17, 2);
+                if (text.size() != 19 || text[16] != ':' || !s || *s > 59) {
+                    return std::nullopt;
+                }
+                second = *s;
+            }
+        }
+        return TTimestamp::FromDate(*year, *month, *day, hour, minute, second);
+    }
+
+    inline std::ostream& operator<<(std::ostream& out, TTimestamp value) {
+        char buffer[TimestampBufferSize];
+        return out << std::string_view(buffer, FormatTimestamp(value, buffer));
+    }
+
+    // Тип для ячейки данных. Целые, не влезающие в int, хранятся как int64_t
+    // (см. MakeInteger), поэтому одно число всегда имеет один тип.
+    using DataValue = std::variant<std::string, int, double, bool, TDictString, TTimestamp, int64_t>;
 
     // Строка данных - пары "поле-значение"
     using DataRow = std::map<std::string, DataValue>;
@@ -18,11 +296,15 @@ namespace report_builder {
     // Таблица данных - вектор строк
     using DataTable = std::vector<DataRow>;
 
+    struct TPipelineStats;
+
     // Результат операции
     struct TOperationResult {
         bool Success;
         std::optional<std::string> ErrorMessage;
         DataTable Data;
+        // Статистика по этапам, если отчет выполнялся с инструментированием
+        std::shared_ptr<const TPipelineStats> Stats;
 
         TOperationResult(bool success, const std::string& message = "", DataTable data = {})
             : Success(success)
@@ -38,6 +320,230 @@ namespace report_builder {
             return {false, message, {}};
         }
     };
+
+    // Строковое представление значения (декодирует словарные строки, даты - в ISO 8601)
+    inline std::string ValueToString(const DataValue& value) {
+        return std::visit(
+            [](auto&& v) -> std::string {
+                using T = std::decay_t<decltype(v)>;
+                if constexpr (std::is_same_v<T, std::string>) {
+                    return v;
+                } else if constexpr (std::is_same_v<T, TDictString>) {
+                    return v.Str();
+                } else if constexpr (std::is_same_v<T, TTimestamp>) {
+                    return TimestampToString(v);
+                } else if constexpr (std::is_same_v<T, bool>) {
+                    return v ? "true" : "false";
+                } else {
+                    return std::to_string(v);
+                }
+            },
+            value);
+    }
+
+    // Целое в самом узком типе: int, если влезает, иначе int64_t
+    inline DataValue MakeInteger(int64_t value) {
+        if (value >= std::numeric_limits<int>::min() && value <= std::numeric_limits<int>::max()) {
+            return static_cast<int>(value);
+        }
+        return value;
+    }
+
+    // Целое значение ячейки, если она содержит int или int64_t
+    inline std::optional<int64_t> GetInteger(const DataValue& value) {
+        if (const auto* i = std::get_if<int>(&value)) {
+            return *i;
+        }
+        if (const auto* i = std::get_if<int64_t>(&value)) {
+            return *i;
+        }
+        return std::nullopt;
+    }
+
+    // Числовое значение ячейки, если она содержит int, int64_t или double
+    inline std::optional<double> GetNumber(const DataValue& value) {
+        if (const auto* i = std::get_if<int>(&value)) {
+            return static_cast<double>(*i);
+        }
+        if (const auto* i = std::get_if<int64_t>(&value)) {
+            return static_cast<double>(*i);
+        }
+        if (const auto* d = std::get_if<double>(&value)) {
+            return *d;
+        }
+        return std::nullopt;
+    }
+
+    // Доступ к строке без копирования: для обычных и словарных строк
+    inline std::optional<std::string_view> GetStringView(const DataValue& value) {
+        if (const auto* str = std::get_if<std::string>(&value)) {
+            return std::string_view(*str);
+        }
+        if (const auto* dict = std::get_if<TDictString>(&value)) {
+            return std::string_view(dict->Str());
+        }
+        return std::nullopt;
+    }
+
+    // Порядок видов значений при сравнении разных типов: числа, логические, даты, строки
+    inline int ValueKindRank(const DataValue& value) {
+        if (std::holds_alternative<int>(value) || std::holds_alternative<double>(value) ||
+            std::holds_alternative<int64_t>(value)) {
+            return 0;
+        }
+        if (std::holds_alternative<bool>(value)) {
+            return 1;
+        }
+        if (std::holds_alternative<TTimestamp>(value)) {
+            return 2;
+        }
+        return 3;
+    }
+
+    // Трехзначное сравнение со строгим слабым порядком: сначала по виду значения
+    // (ValueKindRank), внутри вида - по значению. Целые сравниваются точно, целые
+    // с double - как числа, NaN - после остальных чисел; строки одного словаря - по кодам
+    // (коды упорядочены как строки), остальные строки - по содержимому.
+    // Строки с датой не разбираются: значения разных видов не равны.
+    inline int CompareValues(const DataValue& a, const DataValue& b) {
+        const int kindA = ValueKindRank(a);
+        const int kindB = ValueKindRank(b);
+        if (kindA != kindB) {
+            return kindA < kindB ? -1 : 1;
+        }
+        switch (kindA) {
+            case 0: {
+                const auto intA = GetInteger(a);
+                const auto intB = GetInteger(b);
+                if (intA && intB) {
+                    return *intA < *intB ? -1 : (*intA > *intB ? 1 : 0);
+                }
+                const double x = *GetNumber(a);
+                const double y = *GetNumber(b);
+                if (std::isnan(x) || std::isnan(y)) {
+                    return std::isnan(x) == std::isnan(y) ? 0 : (std::isnan(x) ? 1 : -1);
+                }
+                return x < y ? -1 : (y < x ? 1 : 0);
+            }
+            case 1:
+                return static_cast<int>(std::get<bool>(a)) - static_cast<int>(std::get<bool>(b));
+            case 2: {
+                const auto& x = std::get<TTimestamp>(a);
+                const auto& y = std::get<TTimestamp>(b);
+                return x < y ? -1 : (y < x ? 1 : 0);
+            }
+            default: {
+                const auto* dictA = std::get_if<TDictString>(&a);
+                const auto* dictB = std::get_if<TDictString>(&b);
+                if (dictA && dictB && dictA->Dict == dictB->Dict) {
+                    return dictA->Code < dictB->Code ? -1 : (dictA->Code > dictB->Code ? 1 : 0);
+                }
+                const int cmp = GetStringView(a)->compare(*GetStringView(b));
+                return cmp < 0 ? -1 : (cmp > 0 ? 1 : 0);
+            }
+        }
+    }
+
+    // Сравнение значений как ключей группировки, партиций и соединения: обычные
+    // и словарные строки с одним текстом равны, остальные значения сравниваются
+    // как DataValue (в отличие от CompareValues, int и double - разные ключи).
+    inline size_t KeyValueIndex(const DataValue& value) {
+        return std::holds_alternative<TDictString>(value) ? 0 : value.index();
+    }
+
+    inline bool KeyValueLess(const DataValue& a, const DataValue& b) {
+        const size_t indexA = KeyValueIndex(a);
+        const size_t indexB = KeyValueIndex(b);
+        if (indexA != indexB) {
+            return indexA < indexB;
+        }
+        if (indexA == 0) {
+            return CompareValues(a, b) < 0;
+        }
+        return a < b;
+    }
+
+    inline bool KeyValueEqual(const DataValue& a, const DataValue& b) {
+        auto strA = GetStringView(a);
+        auto strB = GetStringView(b);
+        if (strA && strB) {
+            const auto* dictA = std::get_if<TDictString>(&a);
+            const auto* dictB = std::get_if<TDictString>(&b);
+            if (dictA && dictB && dictA->Dict == dictB->Dict) {
+                return dictA->Code == dictB->Code;
+            }
+            return *strA == *strB;
+        }
+        return a == b;
+    }
+
+    // Хеш, согласованный с KeyValueEqual: у строк - хеш текста
+    inline size_t HashKeyValue(const DataValue& value) {
+        return std::visit(
+            [](auto&& v) -> size_t {
+                using T = std::decay_t<decltype(v)>;
+                if constexpr (std::is_same_v<T, TDictString>) {
+                    return v.Dict->GetHash(v.Code);
+                } else if constexpr (std::is_same_v<T, std::string>) {
+                    return std::hash<std::string_view>{}(v);
+                } else if constexpr (std::is_same_v<T, TTimestamp>) {
+                    return std::hash<int64_t>{}(v.Seconds);
+                } else {
+                    return std::hash<T>{}(v);
+                }
+            },
+            value);
+    }
+
+    // Порядок составных ключей для std::map
+    struct TKeyLess {
+        bool operator()(const std::vector<DataValue>& a, const std::vector<DataValue>& b) const {
+            return std::lexicographical_compare(a.begin(), a.end(), b.begin(), b.end(), KeyValueLess);
+        }
+    };
+
+    // Память поля строки без длинных строк: узел красно-черного дерева (три
+    // указателя и цвет), ключ и значение
+    constexpr size_t RowFieldBytes = 4 * sizeof(void*) + sizeof(std::string) + sizeof(DataValue);
+
+    // Приблизительный объем памяти, занимаемый строкой таблицы
+    inline size_t EstimateRowBytes(const DataRow& row) {
+        constexpr size_t SsoCapacity = 15;
+
+        size_t bytes = sizeof(DataRow);
+        for (const auto& [key, value] : row) {
+            bytes += RowFieldBytes;
+            if (key.size() > SsoCapacity) {
+                bytes += key.capacity() + 1;
+            }
+            if (const auto* str = std::get_if<std::string>(&value); str && str->size() > SsoCapacity) {
+                bytes += str->capacity() + 1;
+            }
+        }
+        return bytes;
+    }
+
+    inline size_t EstimateTableBytes(const DataTable& table) {
+        size_t bytes = sizeof(DataTable);
+        for (const auto& row : table) {
+            bytes += EstimateRowBytes(row);
+        }
+        return bytes;
+    }
 } // namespace report_builder
 
+template <>
+struct std::hash<report_builder::TDictString> {
+    size_t operator()(const report_builder::TDictString& value) const {
+        return value.Dict->GetHash(value.Code);
+    }
+};
+
+template <>
+struct std::hash<report_builder::TTimestamp> {
+    size_t operator()(report_builder::TTimestamp value) const {
+        return std::hash<int64_t>{}(value.Seconds);
+    }
+};
+
 #endif
@@ -0,0 +1,81 @@
+#ifndef REPORT_BUILDER_DICTIONARY_ENCODING_H
+#define REPORT_BUILDER_DICTIONARY_ENCODING_H
+
+#include <unordered_map>
+#include <unordered_set>
+
+#include "report_builder/data_types.h"
+
+namespace report_builder {
+    // Параметры словарного кодирования строковых колонок. Кодирование включается
+    // явно для каждого поставщика: закодированная колонка хранит TDictString, и
+    // код, читающий ее через std::get<std::string>, перестанет ее видеть. Такой
+    // код должен читать строки через GetStringView или ValueToString.
+    struct TDictionaryEncodingOptions {
+        bool Enabled = false;
+        // Таблицы меньше этого размера не кодируются: выигрыша нет
+        size_t MinRows = 64;
+        // Максимальное число различных значений в колонке
+        size_t MaxDictionarySize = 65536;
+        // Максимальная доля различных значений относительно числа строк
+        double MaxCardinalityRatio = 0.5;
+    };
+
+    // Заменяет строки в колонках с низкой кардинальностью на коды общего словаря.
+    // Возвращает число закодированных колонок.
+    inline size_t DictionaryEncode(DataTable& table, const TDictionaryEncodingOptions& options = {}) {
+        if (!options.Enabled || table.size() < options.MinRows) {
+            return 0;
+        }
+
+        const size_t maxDistinct = std::min(options.MaxDictionarySize,
+                                            static_cast<size_t>(options.MaxCardinalityRatio * table.size()));
+
+        // Собираем различные значения колонок, в которых встречаются только строки
+        std::map<std::string, std::unordered_set<std::string>> candidates;
+        std::unordered_set<std::string> rejected;
+        for (const auto& row : table) {
+            for (const auto& [key, value] : row) {
+                if (rejected.count(key)) {
+                    continue;
+                }
+                const auto* str = std::get_if<std::string>(&value);
+                if (!str) {
+                    rejected.insert(key);
+                    candidates.erase(key);
+                    continue;
+                }
+                auto& distinct = candidates[key];
+                distinct.insert(*str);
+                if (distinct.size() > maxDistinct) {
+                    rejected.insert(key);
+                    candidates.erase(key);
+                }
+            }
+        }
+
+        for (auto& [column, distinct] : candidates) {
+            std::vector<std::string> sorted(distinct.begin(), distinct.end());
+            std::sort(sorted.begin(), sorted.end());
+
+            std::unordered_map<std::string, uint32_t> codes;
+            codes.reserve(sorted.size());
+            for (size_t i = 0; i < sorted.size(); i++) {
+                codes.emplace(sorted[i], static_cast<uint32_t>(i));
+            }
+
+            auto dict = std::make_shared<const TStringDictionary>(std::move(sorted));
+            for (auto& row : table) {
+                auto it = row.find(column);
+                if (it != row.end()) {
+                    uint32_t code = codes.at(std::get<std::string>(it->second));
+                    it->second = TDictString{dict, code};
+                }
+            }
+        }
+
+        return candidates.size();
+    }
+} // namespace report_builder
+
+#endif
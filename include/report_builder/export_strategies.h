@@ -1,58 +1,130 @@
 #ifndef REPORT_BUILDER_EXPORT_STRATEGIES_H
 #define REPORT_BUILDER_EXPORT_STRATEGIES_H
 
+#include <atomic>
 #include <ctime>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
 
+#include "report_builder/compression.h"
 #include "report_builder/interfaces.h"
 
 namespace report_builder {
 
     namespace fs = std::filesystem;
 
-    // Экспорт в файл
+    // Экспорт в файл. Текст пишется в файл по мере вывода; со сжатием файл получает
+    // расширение кодека, а куски сжимает отдельный поток (TCompressedFileWriter).
+    // Недописанный файл удаляется.
     class TFileExportStrategy: public IExportStrategy {
     private:
         std::string Directory;
+        TCompressionOptions Compression;
+        TCounter* BytesExported = &ExportedBytesCounter("file");
+        fs::path LastPath;
+
+        // Имя с временем и номером в процессе: несколько выходов одного отчета
+        // и отчеты, завершившиеся в одну секунду, не перезаписывают друг друга
+        fs::path NextPath() const {
+            static std::atomic<uint64_t> sequence{0};
+            const std::string extension = std::string(".html") + CompressionExtension(Compression.Codec);
+            const std::string stamp = "report_" + std::to_string(time(nullptr)) + "_";
+            fs::path path;
+            do {
+                path = fs::path(Directory) / (stamp + std::to_string(sequence.fetch_add(1)) + extension);
+            } while (fs::exists(path));
+            return path;
+        }
+
+        bool WriteCompressed(const fs::path& filepath, const std::function<bool(std::ostream&)>& write, size_t& bytes) {
+            TCompressedFileWriter writer(Compression);
+            if (!writer.Open(filepath.string())) {
+                return false;
+            }
+            TCompressingStream out(writer);
+            const bool complete = write(out) && out.flush();
+            bytes = out.GetBytes();
+            return writer.Close() && complete;
+        }
+
+        bool WritePlain(const fs::path& filepath, const std::function<bool(std::ostream&)>& write, size_t& bytes) {
+            std::ofstream file(filepath);
+            if (!file.is_open()) {
+                return false;
+            }
+            const bool complete = write(file) && file.flush();
+            bytes = complete ? static_cast<size_t>(file.tellp()) : 0;
+            file.close();
+            return complete && !file.fail();
+        }
 
     public:
-        TFileExportStrategy(std::string dir = "./reports/")
-            : Directory(std::move(dir)) {
+        TFileExportStrategy(std::string dir = "./reports/", TCompressionOptions compression = {})
+            : Directory(std::move(dir))
+            , Compression(compression) {
             // Создаем директорию рекурсивно (кроссплатформенно)
             fs::create_directories(Directory);
         }
 
         bool ExportData(const std::string& formattedData) override {
-            // Используем std::filesystem для кроссплатформенных путей
-            fs::path filepath = fs::path(Directory) / ("report_" + std::to_string(time(nullptr)) + ".html");
+            size_t bytes = 0;
+            return ExportStream(
+                [&](std::ostream& out) {
+                    out << formattedData;
+                    return true;
+                },
+                bytes);
+        }
 
-            std::ofstream file(filepath);
-            if (!file.is_open()) {
-                std::cerr << "Cannot write to file: " << filepath.string() << "\n";
+        bool ExportStream(const std::function<bool(std::ostream&)>& write, size_t& bytes) override {
+            if (!IsCompressionAvailable(Compression.Codec)) {
+                std::cerr << "Compression is not available in this build: " << CompressionName(Compression.Codec) << "\n";
                 return false;
             }
 
-            file << formattedData;
-            file.close();
+            // Используем std::filesystem для кроссплатформенных путей
+            fs::path filepath = NextPath();
+            bytes = 0;
+            const bool written = Compression.Codec != ECompression::None ? WriteCompressed(filepath, write, bytes)
+                                                                         : WritePlain(filepath, write, bytes);
+            if (!written) {
+                std::error_code ignored;
+                fs::remove(filepath, ignored);
+                std::cerr << "Cannot write to file: " << filepath.string() << "\n";
+                return false;
+            }
+            BytesExported->Inc(bytes);
+            LastPath = filepath;
 
             std::cout << "Report saved to: " << filepath.string() << "\n";
             return true;
         }
 
+        // Путь последнего записанного отчета
+        const fs::path& GetLastPath() const {
+            return LastPath;
+        }
+
         std::string GetMethodName() const override {
+            if (Compression.Codec != ECompression::None) {
+                return "File export to " + Directory + " (" + CompressionName(Compression.Codec) + ")";
+            }
             return "File export to " + Directory;
         }
     };
 
     // Экспорт в консоль (для тестирования)
     class TConsoleExportStrategy: public IExportStrategy {
+    private:
+        TCounter* BytesExported = &ExportedBytesCounter("console");
+
     public:
         bool ExportData(const std::string& formattedData) override {
             std::cout << "\n=== REPORT OUTPUT ===\n";
             std::cout << formattedData << "\n";
             std::cout << "=== END REPORT ===\n\n";
+            BytesExported->Inc(formattedData.size());
             return true;
         }
 
@@ -61,10 +133,33 @@ namespace report_builder {
         }
     };
 
+    // Экспорт в строку вызывающего кода (ответы сервера отчетов, тесты)
+    class TStringExportStrategy: public IExportStrategy {
+    private:
+        std::string* Target;
+        TCounter* BytesExported = &ExportedBytesCounter("string");
+
+    public:
+        explicit TStringExportStrategy(std::string* target)
+            : Target(target) {
+        }
+
+        bool ExportData(const std::string& formattedData) override {
+            *Target = formattedData;
+            BytesExported->Inc(formattedData.size());
+            return true;
+        }
+
+        std::string GetMethodName() const override {
+            return "String buffer";
+        }
+    };
+
     // Мок для email экспорта (для тестов)
     class TEmailExportStrategy: public IExportStrategy {
     private:
         std::string Recipient;
+        TCounter* BytesExported = &ExportedBytesCounter("email");
 
     public:
         TEmailExportStrategy(std::string to)
@@ -75,6 +170,7 @@ namespace report_builder {
             std::cout << "[MOCK] Email sent to: " << Recipient << "\n";
             std::cout << "[MOCK] Subject: Report generated at " << time(nullptr) << "\n";
             std::cout << "[MOCK] Body length: " << formattedData.length() << " chars\n";
+            BytesExported->Inc(formattedData.size());
             return true;
         }
 
@@ -0,0 +1,804 @@
+#ifndef REPORT_BUILDER_EXPRESSIONS_H
+#define REPORT_BUILDER_EXPRESSIONS_H
+
+#include <cctype>
+#include <cmath>
+
+#include "report_builder/interfaces.h"
+
+namespace report_builder {
+    // Выражения для вычисляемых колонок:
+    //   арифметика        + - * / %, унарный минус
+    //   сравнения         < <= > >= == != (строки сравниваются со строками, числа с числами)
+    //   логика            and or not, true false
+    //   функции           if(c, a, b), coalesce(a, b), min(a, b), max(a, b), abs(x),
+    //                     concat(a, b, ...), upper(s), lower(s), len(s)
+    //   литералы          12, 1.5, 'text' или "text"; имена колонок - идентификаторы или `в обратных кавычках`
+    //   даты              видны как текст ISO 8601, поэтому сравнение с '2024-01-31' идет по времени
+    // Отсутствующее поле, деление на ноль и несовместимые типы дают пустое значение:
+    // такая колонка не записывается в строку.
+
+    enum class EExprOp : uint8_t {
+        Column,
+        Number,
+        Boolean,
+        String,
+        Add,
+        Subtract,
+        Multiply,
+        Divide,
+        Modulo,
+        Negate,
+        Less,
+        LessEqual,
+        Greater,
+        GreaterEqual,
+        Equal,
+        NotEqual,
+        And,
+        Or,
+        Not,
+        If,
+        Coalesce,
+        Min,
+        Max,
+        Abs,
+        Concat,
+        Upper,
+        Lower,
+        Length,
+    };
+
+    // Инструкция байткода: результат в регистр Dst из регистров A, B, C.
+    // Для загрузок Operand - номер колонки или константы.
+    struct TExprInstruction {
+        EExprOp Op;
+        uint16_t Dst = 0;
+        uint16_t A = 0;
+        uint16_t B = 0;
+        uint16_t C = 0;
+        uint32_t Operand = 0;
+    };
+
+    // Скомпилированное выражение. Вычисляется пачками: каждая инструкция
+    // проходит плотным циклом по всей пачке, так что разбор байткода
+    // стоит одну итерацию на пачку, а не на строку.
+    class TExpression {
+    public:
+        static constexpr size_t BatchSize = 1024;
+
+    private:
+        enum class EKind : uint8_t {
+            Number,
+            Int, // целые значения, точно представимые в double
+            Bool,
+            String,
+        };
+
+        // Тип хранится для каждого значения: в одной колонке могут быть и числа,
+        // и строки, а целое, вышедшее за пределы точности double (2^53), записывается как double
+        struct TRegister {
+            std::vector<EKind> Kinds;
+            std::vector<double> Numbers;
+            std::vector<std::string_view> Texts; // строки: в строке таблицы, константе или Strings
+            std::vector<std::string> Strings;    // вычисленные строки
+            std::vector<uint8_t> Valid;
+        };
+
+        struct TNode {
+            EExprOp Op;
+            double Number = 0.0;
+            std::string Text;
+            std::vector<std::unique_ptr<TNode>> Args;
+        };
+
+        class TParser {
+        private:
+            const std::string& Text;
+            size_t Pos = 0;
+
+        public:
+            std::string Error;
+
+            explicit TParser(const std::string& text)
+                : Text(text) {
+            }
+
+            std::unique_ptr<TNode> Parse() {
+                auto node = ParseOr();
+                SkipSpaces();
+                if (node && Pos != Text.size()) {
+                    return Fail("unexpected '" + Text.substr(Pos, 1) + "'");
+                }
+                return node;
+            }
+
+        private:
+            std::unique_ptr<TNode> Fail(const std::string& message) {
+                if (Error.empty()) {
+                    Error = message + " at position " + std::to_string(Pos);
+                }
+                return nullptr;
+            }
+
+            void SkipSpaces() {
+                while (Pos < Text.size() && std::isspace(static_cast<unsigned char>(Text[Pos]))) {
+                    Pos++;
+                }
+            }
+
+            bool Accept(std::string_view token) {
+                SkipSpaces();
+                if (Text.compare(Pos, token.size(), token) != 0) {
+                    return false;
+                }
+                // Ключевые слова не должны быть префиксом идентификатора
+                const bool word = std::isalpha(static_cast<unsigned char>(token.front()));
+                const size_t end = Pos + token.size();
+                if (word && end < Text.size() && (std::isalnum(static_cast<unsigned char>(Text[end])) || Text[end] == '_')) {
+                    return false;
+                }
+                Pos = end;
+                return true;
+            }
+
+            static std::unique_ptr<TNode> Make(EExprOp op, std::vector<std::unique_ptr<TNode>> args) {
+                auto node = std::make_unique<TNode>();
+                node->Op = op;
+                node->Args = std::move(args);
+                return node;
+            }
+
+            template <class... TArgs>
+            static std::unique_ptr<TNode> Make(EExprOp op, TArgs... args) {
+                std::vector<std::unique_ptr<TNode>> list;
+                (list.push_back(std::move(args)), ...);
+                return Make(op, std::move(list));
+            }
+
+            std::unique_ptr<TNode> ParseOr() {
+                auto left = ParseAnd();
+                while (left && Accept("or")) {
+                    auto right = ParseAnd();
+                    if (!right) {
+                        return nullptr;
+                    }
+                    left = Make(EExprOp::Or, std::move(left), std::move(right));
+                }
+                return left;
+            }
+
+            std::unique_ptr<TNode> ParseAnd() {
+                auto left = ParseComparison();
+                while (left && Accept("and")) {
+                    auto right = ParseComparison();
+                    if (!right) {
+                        return nullptr;
+                    }
+                    left = Make(EExprOp::And, std::move(left), std::move(right));
+                }
+                return left;
+            }
+
+            std::unique_ptr<TNode> ParseComparison() {
+                auto left = ParseAdditive();
+                if (!left) {
+                    return nullptr;
+                }
+                static const std::pair<std::string_view, EExprOp> operators[] = {
+                    {"<=", EExprOp::LessEqual}, {">=", EExprOp::GreaterEqual}, {"==", EExprOp::Equal},
+                    {"!=", EExprOp::NotEqual},  {"<", EExprOp::Less},          {">", EExprOp::Greater},
+                    {"=", EExprOp::Equal},
+                };
+                for (const auto& [token, op] : operators) {
+                    if (Accept(token)) {
+                        auto right = ParseAdditive();
+                        return right ? Make(op, std::move(left), std::move(right)) : nullptr;
+                    }
+                }
+                return left;
+            }
+
+            std::unique_ptr<TNode> ParseAdditive() {
+                auto left = ParseMultiplicative();
+                while (left) {
+                    EExprOp op;
+                    if (Accept("+")) {
+                        op = EExprOp::Add;
+                    } else if (Accept("-")) {
+                        op = EExprOp::Subtract;
+                    } else {
+                        break;
+                    }
+                    auto right = ParseMultiplicative();
+                    if (!right) {
+                        return nullptr;
+                    }
+                    left = Make(op, std::move(left), std::move(right));
+                }
+                return left;
+            }
+
+            std::unique_ptr<TNode> ParseMultiplicative() {
+                auto left = ParseUnary();
+                while (left) {
+                    EExprOp op;
+                    if (Accept("*")) {
+                        op = EExprOp::Multiply;
+                    } else if (Accept("/")) {
+                        op = EExprOp::Divide;
+                    } else if (Accept("%")) {
+                        op = EExprOp::Modulo;
+                    } else {
+                        break;
+                    }
+                    auto right = ParseUnary();
+                    if (!right) {
+                        return nullptr;
+                    }
+                    left = Make(op, std::move(left), std::move(right));
+                }
+                return left;
+            }
+
+            std::unique_ptr<TNode> ParseUnary() {
+                if (Accept("-")) {
+                    auto arg = ParseUnary();
+                    return arg ? Make(EExprOp::Negate, std::move(arg)) : nullptr;
+                }
+                if (Accept("not")) {
+                    auto arg = ParseUnary();
+                    return arg ? Make(EExprOp::Not, std::move(arg)) : nullptr;
+                }
+                return ParsePrimary();
+            }
+
+            std::unique_ptr<TNode> ParsePrimary() {
+                SkipSpaces();
+                if (Pos == Text.size()) {
+                    return Fail("unexpected end of expression");
+                }
+
+                const char c = Text[Pos];
+                if (Accept("(")) {
+                    auto node = ParseOr();
+                    if (node && !Accept(")")) {
+                        return Fail("expected ')'");
+                    }
+                    return node;
+                }
+                if (std::isdigit(static_cast<unsigned char>(c)) || c == '.') {
+                    const char* begin = Text.c_str() + Pos;
+                    char* end = nullptr;
+                    const double value = std::strtod(begin, &end);
+                    if (end == begin) {
+                        return Fail("invalid number");
+                    }
+                    Pos += end - begin;
+                    auto node = Make(EExprOp::Number);
+                    node->Number = value;
+                    return node;
+                }
+                if (c == '\'' || c == '"' || c == '`') {
+                    const size_t close = Text.find(c, Pos + 1);
+                    if (close == std::string::npos) {
+                        return Fail("unterminated quote");
+                    }
+                    auto node = Make(c == '`' ? EExprOp::Column : EExprOp::String);
+                    node->Text = Text.substr(Pos + 1, close - Pos - 1);
+                    Pos = close + 1;
+                    return node;
+                }
+                if (!std::isalpha(static_cast<unsigned char>(c)) && c != '_') {
+                    return Fail("unexpected '" + std::string(1, c) + "'");
+                }
+
+                const size_t start = Pos;
+                while (Pos < Text.size() && (std::isalnum(static_cast<unsigned char>(Text[Pos])) || Text[Pos] == '_' ||
+                                             Text[Pos] == '.')) {
+                    Pos++;
+                }
+                std::string name = Text.substr(start, Pos - start);
+                if (name == "true" || name == "false") {
+                    auto node = Make(EExprOp::Boolean);
+                    node->Number = name == "true" ? 1.0 : 0.0;
+                    return node;
+                }
+                if (!Accept("(")) {
+                    auto node = Make(EExprOp::Column);
+                    node->Text = std::move(name);
+                    return node;
+                }
+                return ParseCall(name);
+            }
+
+            std::unique_ptr<TNode> ParseCall(const std::string& name) {
+                std::vector<std::unique_ptr<TNode>> args;
+                if (!Accept(")")) {
+                    do {
+                        auto arg = ParseOr();
+                        if (!arg) {
+                            return nullptr;
+                        }
+                        args.push_back(std::move(arg));
+                    } while (Accept(","));
+                    if (!Accept(")")) {
+                        return Fail("expected ')' after arguments of " + name);
+                    }
+                }
+
+                static const std::map<std::string, std::pair<EExprOp, size_t>> functions = {
+                    {"if", {EExprOp::If, 3}},          {"coalesce", {EExprOp::Coalesce, 2}}, {"min", {EExprOp::Min, 2}},
+                    {"max", {EExprOp::Max, 2}},        {"abs", {EExprOp::Abs, 1}},           {"upper", {EExprOp::Upper, 1}},
+                    {"lower", {EExprOp::Lower, 1}},    {"len", {EExprOp::Length, 1}},
+                };
+                if (name == "concat") {
+                    if (args.empty()) {
+                        return Fail("concat expects at least one argument");
+                    }
+                    // concat(a, b, c) -> concat(concat(a, b), c)
+                    auto node = std::move(args.front());
+                    if (args.size() == 1) {
+                        return Make(EExprOp::Concat, std::move(node), Make(EExprOp::String));
+                    }
+                    for (size_t i = 1; i < args.size(); i++) {
+                        node = Make(EExprOp::Concat, std::move(node), std::move(args[i]));
+                    }
+                    return node;
+                }
+                auto it = functions.find(name);
+                if (it == functions.end()) {
+                    return Fail("unknown function " + name);
+                }
+                if (args.size() != it->second.second) {
+                    return Fail(name + " expects " + std::to_string(it->second.second) + " arguments");
+                }
+                return Make(it->second.first, std::move(args));
+            }
+        };
+
+        std::string Source;
+        std::vector<TExprInstruction> Program;
+        std::vector<std::string> Columns;
+        std::vector<double> NumberConstants;
+        std::vector<std::string> StringConstants;
+        std::vector<uint16_t> ColumnRegisters; // регистр загрузки для каждой колонки из Columns
+        size_t ResultRegister = 0;
+        std::vector<TRegister> Registers;
+
+        uint16_t Emit(const TNode& node) {
+            // Каждая колонка читается из строк один раз за пачку
+            if (node.Op == EExprOp::Column) {
+                auto it = std::find(Columns.begin(), Columns.end(), node.Text);
+                if (it != Columns.end()) {
+                    return ColumnRegisters[it - Columns.begin()];
+                }
+            }
+            TExprInstruction instruction{node.Op};
+            uint16_t* args[] = {&instruction.A, &instruction.B, &instruction.C};
+            for (size_t i = 0; i < node.Args.size(); i++) {
+                *args[i] = Emit(*node.Args[i]);
+            }
+            instruction.Dst = static_cast<uint16_t>(Registers.size());
+            if (node.Op == EExprOp::Column) {
+                instruction.Operand = static_cast<uint32_t>(Columns.size());
+                Columns.push_back(node.Text);
+                ColumnRegisters.push_back(instruction.Dst);
+            } else if (node.Op == EExprOp::Number || node.Op == EExprOp::Boolean) {
+                instruction.Operand = static_cast<uint32_t>(NumberConstants.size());
+                NumberConstants.push_back(node.Number);
+            } else if (node.Op == EExprOp::String) {
+                instruction.Operand = static_cast<uint32_t>(StringConstants.size());
+                StringConstants.push_back(node.Text);
+            }
+            Registers.emplace_back();
+            Program.push_back(instruction);
+            return instruction.Dst;
+        }
+
+        static constexpr double MaxExactInteger = 9007199254740992.0; // 2^53
+
+        static bool IsInteger(double value) {
+            return std::fabs(value) <= MaxExactInteger && value == std::floor(value);
+        }
+
+        static bool IsNumeric(const TRegister& reg, size_t i) {
+            return reg.Kinds[i] != EKind::String;
+        }
+
+        // Целый результат из целых аргументов; иначе вещественный
+        static EKind ArithmeticKind(EKind a, EKind b) {
+            return a == EKind::Int && b == EKind::Int ? EKind::Int : EKind::Number;
+        }
+
+        static std::string NumberToString(const TRegister& reg, size_t i) {
+            if (reg.Kinds[i] == EKind::Bool) {
+                return reg.Numbers[i] != 0.0 ? "true" : "false";
+            }
+            if (reg.Kinds[i] == EKind::Int && IsInteger(reg.Numbers[i])) {
+                return std::to_string(static_cast<int64_t>(reg.Numbers[i]));
+            }
+            return ValueToString(reg.Numbers[i]);
+        }
+
+        static std::string_view TextAt(const TRegister& reg, size_t i, std::string& scratch) {
+            if (reg.Kinds[i] == EKind::String) {
+                return reg.Texts[i];
+            }
+            scratch = NumberToString(reg, i);
+            return scratch;
+        }
+
+        static void Prepare(TRegister& reg, size_t rows) {
+            reg.Kinds.assign(rows, EKind::Number);
+            reg.Valid.assign(rows, 0);
+            reg.Numbers.resize(rows);
+            reg.Texts.resize(rows);
+            reg.Strings.resize(rows);
+        }
+
+        static void SetNumber(TRegister& reg, size_t i, EKind kind, double value) {
+            reg.Kinds[i] = kind;
+            reg.Numbers[i] = value;
+            reg.Valid[i] = 1;
+        }
+
+        // Строка без копирования: в строке таблицы или в другом регистре той же пачки
+        static void SetText(TRegister& reg, size_t i, std::string_view text) {
+            reg.Kinds[i] = EKind::String;
+            reg.Texts[i] = text;
+            reg.Valid[i] = 1;
+        }
+
+        static void SetString(TRegister& reg, size_t i, std::string text) {
+            reg.Strings[i] = std::move(text);
+            SetText(reg, i, reg.Strings[i]);
+        }
+
+        // Строки и словарные строки читаются по ссылке, в текст переводятся только даты
+        void LoadColumn(TRegister& reg, const std::string& column, const DataTable& rows, size_t begin, size_t count) {
+            Prepare(reg, count);
+            for (size_t i = 0; i < count; i++) {
+                const DataRow& row = rows[begin + i];
+                auto it = row.find(column);
+                if (it == row.end()) {
+                    continue;
+                }
+                const DataValue& value = it->second;
+                if (auto text = GetStringView(value)) {
+                    SetText(reg, i, *text);
+                } else if (std::holds_alternative<TTimestamp>(value)) {
+                    SetString(reg, i, ValueToString(value));
+                } else if (const auto* b = std::get_if<bool>(&value)) {
+                    SetNumber(reg, i, EKind::Bool, *b ? 1.0 : 0.0);
+                } else if (auto integer = GetInteger(value)) {
+                    SetNumber(reg, i, EKind::Int, static_cast<double>(*integer));
+                } else {
+                    SetNumber(reg, i, EKind::Number, std::get<double>(value));
+                }
+            }
+        }
+
+        // kind(a, b) - тип результата по типам аргументов строки
+        template <class TKind, class TOp>
+        static void NumericBinary(TRegister& out, const TRegister& a, const TRegister& b, size_t n, TKind kind, TOp op) {
+            Prepare(out, n);
+            for (size_t i = 0; i < n; i++) {
+                if (a.Valid[i] && b.Valid[i] && IsNumeric(a, i) && IsNumeric(b, i)) {
+                    SetNumber(out, i, kind(a.Kinds[i], b.Kinds[i]), op(a.Numbers[i], b.Numbers[i]));
+                }
+            }
+        }
+
+        static EKind BoolKind(EKind, EKind) {
+            return EKind::Bool;
+        }
+
+        template <class TCompare>
+        static void Compare(TRegister& out, const TRegister& a, const TRegister& b, size_t n, TCompare compare) {
+            Prepare(out, n);
+            for (size_t i = 0; i < n; i++) {
+                if (!a.Valid[i] || !b.Valid[i]) {
+                    continue;
+                }
+                if (IsNumeric(a, i) && IsNumeric(b, i)) {
+                    SetNumber(out, i, EKind::Bool, compare(a.Numbers[i], b.Numbers[i]) ? 1.0 : 0.0);
+                } else if (!IsNumeric(a, i) && !IsNumeric(b, i)) {
+                    SetNumber(out, i, EKind::Bool, compare(a.Texts[i], b.Texts[i]) ? 1.0 : 0.0);
+                }
+            }
+        }
+
+        // Выбор между регистрами a и b по маске; значение сохраняет свой тип
+        template <class TPickA>
+        static void Select(TRegister& out, const TRegister& a, const TRegister& b, size_t n, TPickA pickA) {
+            Prepare(out, n);
+            for (size_t i = 0; i < n; i++) {
+                std::optional<bool> useA = pickA(i);
+                if (!useA) {
+                    continue;
+                }
+                const TRegister& source = *useA ? a : b;
+                if (!source.Valid[i]) {
+                    continue;
+                }
+                if (source.Kinds[i] == EKind::String) {
+                    SetText(out, i, source.Texts[i]);
+                } else {
+                    SetNumber(out, i, source.Kinds[i], source.Numbers[i]);
+                }
+            }
+        }
+
+        template <class TTransform>
+        static void StringUnary(TRegister& out, const TRegister& a, size_t n, TTransform transform) {
+            Prepare(out, n);
+            std::string scratch;
+            for (size_t i = 0; i < n; i++) {
+                if (a.Valid[i]) {
+                    SetString(out, i, transform(std::string(TextAt(a, i, scratch))));
+                }
+            }
+        }
+
+        void Execute(const TExprInstruction& ins, const DataTable& rows, size_t begin, size_t n) {
+            TRegister& out = Registers[ins.Dst];
+            const TRegister& a = Registers[ins.A];
+            const TRegister& b = Registers[ins.B];
+            const TRegister& c = Registers[ins.C];
+
+            switch (ins.Op) {
+                case EExprOp::Column:
+                    LoadColumn(out, Columns[ins.Operand], rows, begin, n);
+                    break;
+                case EExprOp::Number:
+                case EExprOp::Boolean: {
+                    const double value = NumberConstants[ins.Operand];
+                    const EKind kind = ins.Op == EExprOp::Boolean ? EKind::Bool : (IsInteger(value) ? EKind::Int : EKind::Number);
+                    Prepare(out, n);
+                    std::fill(out.Kinds.begin(), out.Kinds.end(), kind);
+                    std::fill(out.Numbers.begin(), out.Numbers.end(), value);
+                    std::fill(out.Valid.begin(), out.Valid.end(), 1);
+                    break;
+                }
+                case EExprOp::String:
+                    Prepare(out, n);
+                    for (size_t i = 0; i < n; i++) {
+                        SetText(out, i, StringConstants[ins.Operand]);
+                    }
+                    break;
+                case EExprOp::Add:
+                    NumericBinary(out, a, b, n, ArithmeticKind, std::plus<double>());
+                    break;
+                case EExprOp::Subtract:
+                    NumericBinary(out, a, b, n, ArithmeticKind, std::minus<double>());
+                    break;
+                case EExprOp::Multiply:
+                    NumericBinary(out, a, b, n, ArithmeticKind, std::multiplies<double>());
+                    break;
+                case EExprOp::Divide:
+                case EExprOp::Modulo:
+                    if (ins.Op == EExprOp::Divide) {
+                        NumericBinary(out, a, b, n, [](EKind, EKind) { return EKind::Number; },
+                                      [](double x, double y) { return x / y; });
+                    } else {
+                        NumericBinary(out, a, b, n, ArithmeticKind, [](double x, double y) { return std::fmod(x, y); });
+                    }
+                    for (size_t i = 0; i < n; i++) {
+                        out.Valid[i] &= static_cast<uint8_t>(b.Numbers[i] != 0.0);
+                    }
+                    break;
+                case EExprOp::Negate:
+                    NumericBinary(out, a, a, n, ArithmeticKind, [](double x, double) { return -x; });
+                    break;
+                case EExprOp::Less:
+                    Compare(out, a, b, n, [](const auto& x, const auto& y) { return x < y; });
+                    break;
+                case EExprOp::LessEqual:
+                    Compare(out, a, b, n, [](const auto& x, const auto& y) { return x <= y; });
+                    break;
+                case EExprOp::Greater:
+                    Compare(out, a, b, n, [](const auto& x, const auto& y) { return x > y; });
+                    break;
+                case EExprOp::GreaterEqual:
+                    Compare(out, a, b, n, [](const auto& x, const auto& y) { return x >= y; });
+                    break;
+                case EExprOp::Equal:
+                    Compare(out, a, b, n, [](const auto& x, const auto& y) { return x == y; });
+                    break;
+                case EExprOp::NotEqual:
+                    Compare(out, a, b, n, [](const auto& x, const auto& y) { return x != y; });
+                    break;
+                case EExprOp::And:
+                    NumericBinary(out, a, b, n, BoolKind, [](double x, double y) { return (x != 0.0 && y != 0.0) ? 1.0 : 0.0; });
+                    break;
+                case EExprOp::Or:
+                    NumericBinary(out, a, b, n, BoolKind, [](double x, double y) { return (x != 0.0 || y != 0.0) ? 1.0 : 0.0; });
+                    break;
+                case EExprOp::Not:
+                    NumericBinary(out, a, a, n, BoolKind, [](double x, double) { return x == 0.0 ? 1.0 : 0.0; });
+                    break;
+                case EExprOp::If:
+                    Select(out, b, c, n, [&](size_t i) -> std::optional<bool> {
+                        if (!a.Valid[i] || !IsNumeric(a, i)) {
+                            return std::nullopt;
+                        }
+                        return a.Numbers[i] != 0.0;
+                    });
+                    break;
+                case EExprOp::Coalesce:
+                    Select(out, a, b, n, [&](size_t i) -> std::optional<bool> { return a.Valid[i] != 0; });
+                    break;
+                case EExprOp::Min:
+                case EExprOp::Max:
+                    NumericBinary(out, a, b, n, ArithmeticKind, [&](double x, double y) {
+                        return ins.Op == EExprOp::Min ? std::min(x, y) : std::max(x, y);
+                    });
+                    break;
+                case EExprOp::Abs:
+                    NumericBinary(out, a, a, n, ArithmeticKind, [](double x, double) { return std::abs(x); });
+                    break;
+                case EExprOp::Concat: {
+                    Prepare(out, n);
+                    std::string scratchA;
+                    std::string scratchB;
+                    for (size_t i = 0; i < n; i++) {
+                        if (a.Valid[i] && b.Valid[i]) {
+                            std::string text(TextAt(a, i, scratchA));
+                            text += TextAt(b, i, scratchB);
+                            SetString(out, i, std::move(text));
+                        }
+                    }
+                    break;
+                }
+                case EExprOp::Upper:
+                    StringUnary(out, a, n, [](std::string s) {
+                        std::transform(s.begin(), s.end(), s.begin(), [](unsigned char ch) { return std::toupper(ch); });
+                        return s;
+                    });
+                    break;
+                case EExprOp::Lower:
+                    StringUnary(out, a, n, [](std::string s) {
+                        std::transform(s.begin(), s.end(), s.begin(), [](unsigned char ch) { return std::tolower(ch); });
+                        return s;
+                    });
+                    break;
+                case EExprOp::Length: {
+                    Prepare(out, n);
+                    std::string scratch;
+                    for (size_t i = 0; i < n; i++) {
+                        if (a.Valid[i]) {
+                            SetNumber(out, i, EKind::Int, static_cast<double>(TextAt(a, i, scratch).size()));
+                        }
+                    }
+                    break;
+                }
+            }
+        }
+
+    public:
+        // nullopt и текст ошибки в error, если выражение не разобрано
+        static std::optional<TExpression> Compile(const std::string& text, std::string* error = nullptr) {
+            TParser parser(text);
+            auto root = parser.Parse();
+            if (!root) {
+                if (error) {
+                    *error = parser.Error;
+                }
+                return std::nullopt;
+            }
+            TExpression expression;
+            expression.Source = text;
+            expression.ResultRegister = expression.Emit(*root);
+            return expression;
+        }
+
+        const std::string& GetSource() const {
+            return Source;
+        }
+
+        const std::vector<std::string>& GetColumns() const {
+            return Columns;
+        }
+
+        size_t GetInstructionCount() const {
+            return Program.size();
+        }
+
+        // Вычисляет выражение для строк [begin, begin + count) и записывает результат в колонку output
+        void EvaluateInto(DataTable& rows, size_t begin, size_t count, const std::string& output) {
+            for (const auto& instruction : Program) {
+                Execute(instruction, rows, begin, count);
+            }
+            TRegister& result = Registers[ResultRegister];
+            for (size_t i = 0; i < count; i++) {
+                if (!result.Valid[i]) {
+                    continue;
+                }
+                // Значение строится до записи: текст может ссылаться на эту же ячейку
+                DataValue value;
+                switch (result.Kinds[i]) {
+                    case EKind::String:
+                        if (result.Texts[i].data() == result.Strings[i].data()) {
+                            value = std::move(result.Strings[i]);
+                        } else {
+                            value = std::string(result.Texts[i]);
+                        }
+                        break;
+                    case EKind::Bool:
+                        value = result.Numbers[i] != 0.0;
+                        break;
+                    case EKind::Int:
+                        // Целое за пределами int записывается как int64_t (MakeInteger),
+                        // за пределами точности double - остается double
+                        if (IsInteger(result.Numbers[i])) {
+                            value = MakeInteger(static_cast<int64_t>(result.Numbers[i]));
+                        } else {
+                            value = result.Numbers[i];
+                        }
+                        break;
+                    case EKind::Number:
+                        value = result.Numbers[i];
+                        break;
+                }
+                rows[begin + i][output] = std::move(value);
+            }
+        }
+    };
+
+    // Добавляет в строки вычисляемые колонки. Колонки вычисляются по порядку,
+    // так что выражение может ссылаться на колонку, объявленную раньше.
+    class TComputedColumnsProcessor: public IDataProcessor {
+    private:
+        std::vector<std::pair<std::string, TExpression>> Columns;
+        std::vector<std::pair<std::string, std::string>> Definitions;
+        std::string CompileError;
+
+    public:
+        // columns: имя колонки -> выражение
+        explicit TComputedColumnsProcessor(std::vector<std::pair<std::string, std::string>> columns)
+            : Definitions(std::move(columns)) {
+            for (const auto& [name, text] : Definitions) {
+                std::string error;
+                auto expression = TExpression::Compile(text, &error);
+                if (!expression) {
+                    CompileError = "Expression for '" + name + "': " + error;
+                    break;
+                }
+                Columns.emplace_back(name, std::move(*expression));
+            }
+        }
+
+        // Ошибка разбора выражений; такой процессор завершает Process ошибкой
+        const std::string& GetCompileError() const {
+            return CompileError;
+        }
+
+        TOperationResult Process(DataTable data) override {
+            if (!CompileError.empty()) {
+                return TOperationResult::Error(CompileError);
+            }
+            for (size_t begin = 0; begin < data.size(); begin += TExpression::BatchSize) {
+                const size_t count = std::min(TExpression::BatchSize, data.size() - begin);
+                for (auto& [name, expression] : Columns) {
+                    expression.EvaluateInto(data, begin, count, name);
+                }
+            }
+            return TOperationResult::Ok(std::move(data));
+        }
+
+        std::string GetDescription() const override {
+            std::string desc = "Compute";
+            for (size_t i = 0; i < Definitions.size(); i++) {
+                desc += (i ? ", " : " ") + Definitions[i].first + " = " + Definitions[i].second;
+            }
+            return desc;
+        }
+
+        std::optional<std::string> GetShareKey() const override {
+            return GetDescription();
+        }
+    };
+} // namespace report_builder
+
+#endif
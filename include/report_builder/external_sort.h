@@ -0,0 +1,232 @@
+#ifndef REPORT_BUILDER_EXTERNAL_SORT_H
+#define REPORT_BUILDER_EXTERNAL_SORT_H
+
+#include "report_builder/interfaces.h"
+#include "report_builder/row_codec.h"
+
+namespace report_builder {
+    // Пустой поток, сообщающий об ошибке
+    class TFailedRowStream: public IRowStream {
+    private:
+        std::string Message;
+
+    public:
+        explicit TFailedRowStream(std::string message)
+            : Message(std::move(message)) {
+        }
+
+        bool Next(DataRow&) override {
+            return false;
+        }
+
+        std::optional<std::string> GetError() const override {
+            return Message;
+        }
+    };
+
+    // K-путевое слияние отсортированных серий на диске с помощью дерева проигравших.
+    // На каждую выдаваемую строку приходится log2(k) сравнений.
+    template <class TLess>
+    class TLoserTreeMergeStream: public IRowStream {
+    private:
+        std::vector<std::unique_ptr<TSpillFile>> Runs;
+        std::vector<DataRow> Heads;
+        std::vector<bool> Exhausted;
+        std::vector<size_t> RowsRead;
+        // Tree[0] - победитель, Tree[1..k-1] - проигравшие во внутренних узлах
+        std::vector<int> Tree;
+        TLess Less;
+        std::optional<std::string> Error;
+
+        // true, если серия a должна выдать строку раньше серии b
+        bool Beats(int a, int b) const {
+            if (Exhausted[a]) {
+                return false;
+            }
+            if (Exhausted[b]) {
+                return true;
+            }
+            return Less(Heads[a], Heads[b]);
+        }
+
+        void Advance(int run) {
+            if (Runs[run]->Read(Heads[run])) {
+                RowsRead[run]++;
+                return;
+            }
+            Exhausted[run] = true;
+            if (RowsRead[run] != Runs[run]->GetRowCount()) {
+                Error = "External sort: corrupted run file " + Runs[run]->GetPath().string();
+            }
+        }
+
+        void Replay(int leaf) {
+            const int k = static_cast<int>(Runs.size());
+            int winner = leaf;
+            for (int node = (leaf + k) / 2; node > 0; node /= 2) {
+                if (Beats(Tree[node], winner)) {
+                    std::swap(Tree[node], winner);
+                }
+            }
+            Tree[0] = winner;
+        }
+
+    public:
+        TLoserTreeMergeStream(std::vector<std::unique_ptr<TSpillFile>> runs, TLess less)
+            : Runs(std::move(runs))
+            , Heads(Runs.size())
+            , Exhausted(Runs.size(), false)
+            , RowsRead(Runs.size(), 0)
+            , Less(std::move(less)) {
+            const int k = static_cast<int>(Runs.size());
+            if (k == 0) {
+                return;
+            }
+            for (int i = 0; i < k; i++) {
+                if (!Runs[i]->FinishWrite()) {
+                    Error = "External sort: cannot reopen run file " + Runs[i]->GetPath().string();
+                    Exhausted.assign(k, true);
+                    Tree.assign(1, 0);
+                    return;
+                }
+                Advance(i);
+            }
+
+            // Первый пришедший в узел кандидат ждет второго, победитель поднимается выше
+            Tree.assign(k, -1);
+            for (int leaf = 0; leaf < k; leaf++) {
+                int winner = leaf;
+                int node = (leaf + k) / 2;
+                for (; node > 0; node /= 2) {
+                    if (Tree[node] == -1) {
+                        Tree[node] = winner;
+                        break;
+                    }
+                    if (Beats(Tree[node], winner)) {
+                        std::swap(Tree[node], winner);
+                    }
+                }
+                if (node == 0) {
+                    Tree[0] = winner;
+                }
+            }
+        }
+
+        bool Next(DataRow& row) override {
+            if (Tree.empty() || Error) {
+                return false;
+            }
+            const int winner = Tree[0];
+            if (Exhausted[winner]) {
+                return false;
+            }
+            row = std::move(Heads[winner]);
+            Advance(winner);
+            Replay(winner);
+            return true;
+        }
+
+        std::optional<std::string> GetError() const override {
+            return Error;
+        }
+    };
+
+    // Поток строк таблицы, которой он владеет
+    class TTableRowStream: public IRowStream {
+    private:
+        DataTable Rows;
+        size_t Position = 0;
+
+    public:
+        explicit TTableRowStream(DataTable rows)
+            : Rows(std::move(rows)) {
+        }
+
+        bool Next(DataRow& row) override {
+            if (Position == Rows.size()) {
+                return false;
+            }
+            row = std::move(Rows[Position++]);
+            return true;
+        }
+    };
+
+    // Сортировка строк, поступающих по одной: строки копятся серией не больше
+    // бюджета памяти, полная серия сортируется и сбрасывается во временный файл.
+    // Если все строки поместились в одну серию, сортировка идет в памяти.
+    template <class TLess>
+    class TExternalSorter {
+    private:
+        size_t MemoryBudgetBytes;
+        TLess Less;
+        std::shared_ptr<TRowCodec> Codec = std::make_shared<TRowCodec>();
+        std::vector<std::unique_ptr<TSpillFile>> Runs;
+        DataTable Run;
+        size_t RunBytes = 0;
+        std::optional<std::string> Error;
+
+        void Spill() {
+            TTraceSpan span("batch", "external sort run");
+            span.SetRows(Run.size(), Run.size());
+            std::sort(Run.begin(), Run.end(), Less);
+            auto file = std::make_unique<TSpillFile>(Codec, "sort_run");
+            for (const auto& row : Run) {
+                if (!file->Write(row)) {
+                    Error = "External sort: cannot write run file " + file->GetPath().string();
+                    break;
+                }
+            }
+            Runs.push_back(std::move(file));
+            Run.clear();
+            RunBytes = 0;
+        }
+
+    public:
+        TExternalSorter(size_t memoryBudgetBytes, TLess less)
+            : MemoryBudgetBytes(memoryBudgetBytes)
+            , Less(std::move(less)) {
+        }
+
+        void Add(DataRow&& row) {
+            if (Error) {
+                return;
+            }
+            const size_t bytes = EstimateRowBytes(row);
+            if (!Run.empty() && RunBytes + bytes > MemoryBudgetBytes) {
+                Spill();
+            }
+            RunBytes += bytes;
+            Run.push_back(std::move(row));
+        }
+
+        std::unique_ptr<IRowStream> Finish() {
+            if (!Error && Runs.empty()) {
+                std::sort(Run.begin(), Run.end(), Less);
+                return std::make_unique<TTableRowStream>(std::move(Run));
+            }
+            if (!Error && !Run.empty()) {
+                Spill();
+            }
+            if (Error) {
+                return std::make_unique<TFailedRowStream>(*Error);
+            }
+            DataTable().swap(Run);
+            return std::make_unique<TLoserTreeMergeStream<TLess>>(std::move(Runs), Less);
+        }
+    };
+
+    // Внешняя сортировка готовой таблицы. Таблица поглощается с конца,
+    // чтобы память освобождалась по мере сброса серий.
+    template <class TLess>
+    std::unique_ptr<IRowStream> ExternalSort(DataTable& data, size_t memoryBudgetBytes, const TLess& less) {
+        TExternalSorter<TLess> sorter(memoryBudgetBytes, less);
+        while (!data.empty()) {
+            sorter.Add(std::move(data.back()));
+            data.pop_back();
+        }
+        DataTable().swap(data);
+        return sorter.Finish();
+    }
+} // namespace report_builder
+
+#endif
@@ -7,15 +7,15 @@
 #include "report_builder/interfaces.h"
 
 namespace report_builder {
+    // Служебные колонки (вес строки выборки) нужны агрегациям, но в отчет не выводятся
+    inline bool IsHiddenColumn(const std::string& key) {
+        return key == SampleWeightColumn;
+    }
+
     // HTML форматировщик
     class THtmlFormatter: public IFormatter {
-    public:
-        std::string Format(const DataTable& data) override {
-            if (data.empty()) {
-                return "<p>No data</p>";
-            }
-
-            std::ostringstream html;
+    private:
+        static void WriteHeader(std::ostream& html, const DataRow& first) {
             html << "<!DOCTYPE html>\n<html>\n<head>\n";
             html << "  <style>\n";
             html << "    table { border-collapse: collapse; width: 100%; }\n";
@@ -27,26 +27,70 @@ namespace report_builder {
             html << "  <table>\n    <tr>\n";
 
             // Заголовки
-            for (const auto& [key, _] : data[0]) {
-                html << "      <th>" << key << "</th>\n";
+            for (const auto& [key, _] : first) {
+                if (!IsHiddenColumn(key)) {
+                    html << "      <th>" << key << "</th>\n";
+                }
             }
             html << "    </tr>\n";
+        }
 
-            // Данные
-            for (const auto& row : data) {
-                html << "    <tr>\n";
-                for (const auto& [_, value] : row) {
-                    html << "      <td>";
-                    std::visit([&](auto&& v) { html << v; }, value);
-                    html << "</td>\n";
+        static void WriteRow(std::ostream& html, const DataRow& row) {
+            html << "    <tr>\n";
+            for (const auto& [key, value] : row) {
+                if (IsHiddenColumn(key)) {
+                    continue;
                 }
-                html << "    </tr>\n";
+                html << "      <td>";
+                std::visit([&](auto&& v) { html << v; }, value);
+                html << "</td>\n";
             }
+            html << "    </tr>\n";
+        }
 
+        static void WriteFooter(std::ostream& html) {
             html << "  </table>\n</body>\n</html>";
+        }
+
+    public:
+        std::string Format(const DataTable& data) override {
+            if (data.empty()) {
+                return "<p>No data</p>";
+            }
+
+            std::ostringstream html;
+            WriteHeader(html, data[0]);
+
+            // Данные
+            for (const auto& row : data) {
+                WriteRow(html, row);
+            }
+
+            WriteFooter(html);
+            return html.str();
+        }
+
+        std::string FormatStream(IRowStream& rows) override {
+            std::ostringstream html;
+            FormatStreamTo(rows, html);
             return html.str();
         }
 
+        void FormatStreamTo(IRowStream& rows, std::ostream& html) override {
+            DataRow row;
+            if (!rows.Next(row)) {
+                html << "<p>No data</p>";
+                return;
+            }
+
+            WriteHeader(html, row);
+            do {
+                WriteRow(html, row);
+            } while (rows.Next(row));
+
+            WriteFooter(html);
+        }
+
         std::string GetFormatName() const override {
             return "HTML";
         }
@@ -68,22 +112,13 @@ namespace report_builder {
             std::map<std::string, size_t> colWidths;
             for (const auto& row : data) {
                 for (const auto& [key, value] : row) {
+                    if (IsHiddenColumn(key)) {
+                        continue;
+                    }
                     colWidths[key] = std::max(colWidths[key], key.length());
 
                     // Получаем строковое представление значения
-                    std::string strVal = std::visit(
-                        [](auto&& v) -> std::string {
-                            using T = std::decay_t<decltype(v)>;
-                            if constexpr (std::is_same_v<T, std::string>) {
-                                return v;
-                            } else if constexpr (std::is_same_v<T, bool>) {
-                                return v ? "true" : "false";
-                            } else if constexpr (std::is_same_v<T, int> ||
-                                                 std::is_same_v<T, double>) {
-                                return std::to_string(v);
-                            }
-                        },
-                        value);
+                    std::string strVal = ValueToString(value);
 
                     colWidths[key] = std::max(colWidths[key], strVal.length());
                 }
@@ -124,6 +159,31 @@ namespace report_builder {
 
     // Markdown форматировщик
     class TMarkdownFormatter: public IFormatter {
+    private:
+        static void WriteHeader(std::ostream& md, const DataRow& first) {
+            md << "# Report\n\n";
+
+            // Заголовки и разделитель
+            std::string separator;
+            for (const auto& [key, _] : first) {
+                if (!IsHiddenColumn(key)) {
+                    md << "| " << key << " ";
+                    separator += "| --- ";
+                }
+            }
+            md << "|\n" << separator << "|\n";
+        }
+
+        static void WriteRow(std::ostream& md, const DataRow& row) {
+            md << "| ";
+            for (const auto& [key, value] : row) {
+                if (!IsHiddenColumn(key)) {
+                    std::visit([&](auto&& v) { md << v << " | "; }, value);
+                }
+            }
+            md << "\n";
+        }
+
     public:
         std::string Format(const DataTable& data) override {
             if (data.empty()) {
@@ -131,32 +191,35 @@ namespace report_builder {
             }
 
             std::ostringstream md;
-            md << "# Report\n\n";
-
-            // Заголовки
-            for (const auto& [key, _] : data[0]) {
-                md << "| " << key << " ";
-            }
-            md << "|\n";
-
-            // Разделитель
-            for (size_t i = 0; i < data[0].size(); i++) {
-                md << "| --- ";
-            }
-            md << "|\n";
+            WriteHeader(md, data[0]);
 
             // Данные
             for (const auto& row : data) {
-                md << "| ";
-                for (const auto& [_, value] : row) {
-                    std::visit([&](auto&& v) { md << v << " | "; }, value);
-                }
-                md << "\n";
+                WriteRow(md, row);
             }
 
             return md.str();
         }
 
+        std::string FormatStream(IRowStream& rows) override {
+            std::ostringstream md;
+            FormatStreamTo(rows, md);
+            return md.str();
+        }
+
+        void FormatStreamTo(IRowStream& rows, std::ostream& md) override {
+            DataRow row;
+            if (!rows.Next(row)) {
+                md << "*No data*";
+                return;
+            }
+
+            WriteHeader(md, row);
+            do {
+                WriteRow(md, row);
+            } while (rows.Next(row));
+        }
+
         std::string GetFormatName() const override {
             return "Markdown";
         }
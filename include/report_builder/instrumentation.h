@@ -0,0 +1,241 @@
+#ifndef REPORT_BUILDER_INSTRUMENTATION_H
+#define REPORT_BUILDER_INSTRUMENTATION_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <iomanip>
+#include <new>
+#include <ostream>
+
+#include "report_builder/data_types.h"
+#include "report_builder/tracing.h"
+
+namespace report_builder {
+    // Статистика одного этапа конвейера
+    struct TStageStats {
+        std::string Stage; // provider, processor, formatter, exporter
+        std::string Name;
+        double WallMs = 0.0;
+        double CpuMs = 0.0;
+        size_t RowsIn = 0;
+        size_t RowsOut = 0;
+        size_t BytesProduced = 0;
+        // Пик выделенной памяти сверх уровня на начало этапа.
+        // Ноль, если учет аллокаций не подключен (см. REPORT_BUILDER_DEFINE_ALLOCATION_TRACKING)
+        size_t PeakAllocatedBytes = 0;
+    };
+
+    // Статистика выполнения отчета по этапам
+    struct TPipelineStats {
+        std::vector<TStageStats> Stages;
+        double TotalWallMs = 0.0;
+        // Пик резерва в бюджете памяти; 0, если бюджет не задан
+        size_t PeakReservedBytes = 0;
+
+        void Print(std::ostream& out) const {
+            out << "Pipeline Stats (total " << std::fixed << std::setprecision(3) << TotalWallMs << " ms):\n";
+            if (PeakReservedBytes > 0) {
+                out << "  memory reserved peak " << PeakReservedBytes << " bytes\n";
+            }
+            for (const auto& stage : Stages) {
+                out << "  " << stage.Stage << ": " << stage.Name << "\n";
+                out << "    wall " << stage.WallMs << " ms, cpu " << stage.CpuMs << " ms, rows "
+                    << stage.RowsIn << " -> " << stage.RowsOut << ", bytes " << stage.BytesProduced
+                    << ", peak alloc " << stage.PeakAllocatedBytes << "\n";
+            }
+            out << std::defaultfloat;
+        }
+    };
+
+    // Учет аллокаций. Счетчики обновляются только если в программе заменены
+    // operator new/delete макросом REPORT_BUILDER_DEFINE_ALLOCATION_TRACKING.
+    // Пик ведется отдельно в каждом потоке: этап выполняется в одном потоке, поэтому
+    // параллельные отчеты и задачи пула не сбрасывают и не завышают чужой пик.
+    // Память, которую этап выделяет в других потоках (распаковка, чтение разделов),
+    // в его пик не входит.
+    class TAllocationTracker {
+    private:
+        // Выделено потоком за вычетом освобожденного им; может быть отрицательным,
+        // если поток освобождает память, выделенную другим
+        struct TThreadCounters {
+            int64_t Current = 0;
+            int64_t Peak = 0;
+        };
+
+        static std::atomic<size_t>& CurrentCounter() {
+            static std::atomic<size_t> current{0};
+            return current;
+        }
+
+        static TThreadCounters& ThreadCounters() {
+            thread_local TThreadCounters counters;
+            return counters;
+        }
+
+    public:
+        static void OnAllocate(size_t size) {
+            CurrentCounter().fetch_add(size, std::memory_order_relaxed);
+            auto& counters = ThreadCounters();
+            counters.Current += static_cast<int64_t>(size);
+            counters.Peak = std::max(counters.Peak, counters.Current);
+        }
+
+        static void OnDeallocate(size_t size) {
+            CurrentCounter().fetch_sub(size, std::memory_order_relaxed);
+            ThreadCounters().Current -= static_cast<int64_t>(size);
+        }
+
+        // Занято всей программой
+        static size_t GetCurrent() {
+            return CurrentCounter().load(std::memory_order_relaxed);
+        }
+
+        // Сбрасывает пик текущего потока до его текущего уровня, возвращает этот уровень
+        static int64_t ResetPeak() {
+            auto& counters = ThreadCounters();
+            counters.Peak = counters.Current;
+            return counters.Current;
+        }
+
+        // Рост пика текущего потока над уровнем base, полученным из ResetPeak
+        static size_t GetPeakSince(int64_t base) {
+            const int64_t peak = ThreadCounters().Peak;
+            return peak > base ? static_cast<size_t>(peak - base) : 0;
+        }
+    };
+
+    // Процессорное время текущего потока в миллисекундах
+    inline double ThreadCpuMs() {
+#if defined(CLOCK_THREAD_CPUTIME_ID)
+        timespec ts{};
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+        return static_cast<double>(ts.tv_sec) * 1e3 + static_cast<double>(ts.tv_nsec) / 1e6;
+#else
+        return static_cast<double>(std::clock()) * 1e3 / CLOCKS_PER_SEC;
+#endif
+    }
+
+    // Замер одного этапа. При stats == nullptr и выключенной трассировке ничего не измеряет.
+    class TStageTimer {
+    private:
+        TPipelineStats* Stats;
+        const bool Tracing;
+        std::chrono::steady_clock::time_point WallStart;
+        double CpuStart = 0.0;
+        int64_t AllocBase = 0;
+        uint64_t TraceStartUs = 0;
+
+    public:
+        explicit TStageTimer(TPipelineStats* stats)
+            : Stats(stats)
+            , Tracing(TTracer::Global().IsEnabled()) {
+            Restart();
+        }
+
+        void Restart() {
+            if (Tracing) {
+                TraceStartUs = TTracer::Global().NowUs();
+            }
+            if (!Stats) {
+                return;
+            }
+            AllocBase = TAllocationTracker::ResetPeak();
+            CpuStart = ThreadCpuMs();
+            WallStart = std::chrono::steady_clock::now();
+        }
+
+        // name вычисляется только при сборе статистики или трассировке, bytes - только при сборе статистики
+        template <class TNameFn, class TBytesFn>
+        void Finish(const char* stage, TNameFn&& name, size_t rowsIn, size_t rowsOut, TBytesFn&& bytes) {
+            if (Tracing) {
+                auto& tracer = TTracer::Global();
+                tracer.Record(stage, name(), TraceStartUs, tracer.NowUs() - TraceStartUs, rowsIn, rowsOut);
+            }
+            if (!Stats) {
+                Restart();
+                return;
+            }
+            TStageStats stageStats;
+            stageStats.WallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - WallStart).count();
+            stageStats.CpuMs = ThreadCpuMs() - CpuStart;
+            stageStats.PeakAllocatedBytes = TAllocationTracker::GetPeakSince(AllocBase);
+            stageStats.Stage = stage;
+            stageStats.Name = name();
+            stageStats.RowsIn = rowsIn;
+            stageStats.RowsOut = rowsOut;
+            stageStats.BytesProduced = bytes();
+            Stats->TotalWallMs += stageStats.WallMs;
+            Stats->Stages.push_back(std::move(stageStats));
+            Restart();
+        }
+    };
+} // namespace report_builder
+
+// Подключает учет аллокаций для TStageStats::PeakAllocatedBytes.
+// Используется ровно в одной единице трансляции программы, вне пространств имен.
+#define REPORT_BUILDER_DEFINE_ALLOCATION_TRACKING()                                   \
+    namespace report_builder::allocation_tracking {                                   \
+        constexpr size_t HeaderSize = alignof(std::max_align_t);                      \
+        inline void* Allocate(size_t size) {                                          \
+            void* raw = std::malloc(size + HeaderSize);                               \
+            if (!raw) {                                                               \
+                throw std::bad_alloc();                                               \
+            }                                                                         \
+            *static_cast<size_t*>(raw) = size;                                        \
+            ::report_builder::TAllocationTracker::OnAllocate(size);                   \
+            return static_cast<char*>(raw) + HeaderSize;                              \
+        }                                                                             \
+        inline void Deallocate(void* ptr) noexcept {                                  \
+            if (!ptr) {                                                               \
+                return;                                                               \
+            }                                                                         \
+            void* raw = static_cast<char*>(ptr) - HeaderSize;                         \
+            ::report_builder::TAllocationTracker::OnDeallocate(*static_cast<size_t*>(raw)); \
+            std::free(raw);                                                           \
+        }                                                                             \
+    }                                                                                 \
+    void* operator new(size_t size) {                                                 \
+        return report_builder::allocation_tracking::Allocate(size);                   \
+    }                                                                                 \
+    void* operator new[](size_t size) {                                               \
+        return report_builder::allocation_tracking::Allocate(size);                   \
+    }                                                                                 \
+    void operator delete(void* ptr) noexcept {                                        \
+        report_builder::allocation_tracking::Deallocate(ptr);                         \
+    }                                                                                 \
+    void operator delete[](void* ptr) noexcept {                                      \
+        report_builder::allocation_tracking::Deallocate(ptr);                         \
+    }                                                                                 \
+    void operator delete(void* ptr, size_t) noexcept {                                \
+        report_builder::allocation_tracking::Deallocate(ptr);                         \
+    }                                                                                 \
+    void operator delete[](void* ptr, size_t) noexcept {                              \
+        report_builder::allocation_tracking::Deallocate(ptr);                         \
+    }                                                                                 \
+    /* nothrow-версии заменяются вместе с обычными: память из них освобождается */    \
+    /* обычным delete (например, временный буфер std::stable_sort) */                 \
+    void* operator new(size_t size, const std::nothrow_t&) noexcept {                 \
+        try {                                                                         \
+            return report_builder::allocation_tracking::Allocate(size);               \
+        } catch (...) {                                                               \
+            return nullptr;                                                           \
+        }                                                                             \
+    }                                                                                 \
+    void* operator new[](size_t size, const std::nothrow_t&) noexcept {               \
+        try {                                                                         \
+            return report_builder::allocation_tracking::Allocate(size);               \
+        } catch (...) {                                                               \
+            return nullptr;                                                           \
+        }                                                                             \
+    }                                                                                 \
+    void operator delete(void* ptr, const std::nothrow_t&) noexcept {                 \
+        report_builder::allocation_tracking::Deallocate(ptr);                         \
+    }                                                                                 \
+    void operator delete[](void* ptr, const std::nothrow_t&) noexcept {               \
+        report_builder::allocation_tracking::Deallocate(ptr);                         \
+    }
+
+#endif
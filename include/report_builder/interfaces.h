@@ -2,18 +2,101 @@
 #define REPORT_BUILDER_INTERFACES_H
 
 #include <functional>
+#include <future>
 #include <memory>
 #include <iostream>
+#include <sstream>
 
 #include "report_builder/data_types.h"
+#include "report_builder/instrumentation.h"
+#include "report_builder/memory_budget.h"
+#include "report_builder/metrics.h"
+#include "report_builder/sampling.h"
+#include "report_builder/task_pool.h"
 
 namespace report_builder {
+    // Ограничение чтения, переданное поставщику планировщиком: достаточно первых
+    // Rows строк, удовлетворяющих Filter (пустой фильтр - любых)
+    struct TScanLimit {
+        size_t Rows = 0;
+        std::function<bool(const DataRow&)> Filter;
+        std::string Condition;
+        // Ключ условия для GetShareKey поставщика (см. IDataProcessor::GetShareKey)
+        std::optional<std::string> ConditionKey = std::nullopt;
+
+        bool Accepts(const DataRow& row) const {
+            return !Filter || Filter(row);
+        }
+
+        // Дополнение к ключу поставщика; nullopt, если у условия нет ключа
+        std::optional<std::string> ShareKey() const {
+            if (Filter && !ConditionKey) {
+                return std::nullopt;
+            }
+            return " (first " + std::to_string(Rows) + " rows" + (Filter ? " where " + *ConditionKey : "") + ")";
+        }
+
+        // Дополнение к GetSourceInfo: поставщики с разными ограничениями не должны считаться одинаковыми
+        std::string Describe() const {
+            return " (first " + std::to_string(Rows) + " rows" + (Condition.empty() ? "" : " where " + Condition) + ")";
+        }
+    };
+
+    // Получатель строк, которые поставщик отдает по одной
+    using TRowSink = std::function<void(DataRow&&)>;
+
     // Базовый класс для поставщика данных
     class IDataProvider {
     public:
         virtual ~IDataProvider() = default;
         virtual TOperationResult FetchData() = 0;
         virtual std::string GetSourceInfo() const = 0;
+
+        // Идентичность данных для общего чтения несколькими отчетами (TBatchReportExecutor):
+        // поставщики с одинаковым ключом обязаны возвращать одинаковые данные.
+        // nullopt - поставщик не делится с другими отчетами.
+        virtual std::optional<std::string> GetShareKey() const {
+            return std::nullopt;
+        }
+
+        // Разрешает прекратить чтение после limit.Rows подходящих строк.
+        // false - поставщик читает все, ограничение применят обработчики.
+        virtual bool PushDownLimit(TScanLimit limit) {
+            (void)limit;
+            return false;
+        }
+
+        // Разрешает отбирать строки выборки при чтении, не разбирая остальные.
+        // Строки выборки должны получить веса (TRowSampler::Finish).
+        virtual bool PushDownSample(const TSampleOptions& options) {
+            (void)options;
+            return false;
+        }
+
+        // Оценка памяти таблицы FetchData снизу (в единицах EstimateTableBytes),
+        // известная до чтения; по ней отчет резервирует память заранее.
+        // nullopt - оценки нет, память резервируется после чтения.
+        virtual std::optional<size_t> EstimateBytes() const {
+            return std::nullopt;
+        }
+
+        // Отдает строки в sink по мере чтения, не собирая таблицу; Data результата пуст.
+        // nullopt - поставщик так не умеет (sink не вызывался), нужен FetchData.
+        virtual std::optional<TOperationResult> FetchRows(const TRowSink& sink) {
+            (void)sink;
+            return std::nullopt;
+        }
+    };
+
+    // Последовательный поток строк для обработки без материализации таблицы
+    class IRowStream {
+    public:
+        virtual ~IRowStream() = default;
+        // Возвращает false, когда строки закончились или произошла ошибка
+        virtual bool Next(DataRow& row) = 0;
+        virtual std::optional<std::string> GetError() const {
+            return std::nullopt;
+        }
     };
 
     // Базовый класс для обработчика данных
@@ -22,6 +105,39 @@ namespace report_builder {
         virtual ~IDataProcessor() = default;
         virtual TOperationResult Process(DataTable data) = 0;
         virtual std::string GetDescription() const = 0;
+
+        // Идентичность обработки для общего выполнения несколькими отчетами: одинаковый
+        // ключ обязан означать одинаковый результат на одинаковых данных. Описание
+        // для этого не годится (например, у фильтра без описания оно всегда "Filter").
+        // nullopt - обработчик не делится с другими отчетами.
+        virtual std::optional<std::string> GetShareKey() const {
+            return std::nullopt;
+        }
+
+        // Потоковый вариант Process для последнего обработчика конвейера.
+        // nullptr означает, что обработчик предпочитает Process, и data не тронута;
+        // иначе data поглощена и результат читается из возвращенного потока.
+        virtual std::unique_ptr<IRowStream> ProcessStreaming(DataTable& data) {
+            (void)data;
+            return nullptr;
+        }
+
+        // Обработка строк прямо от поставщика (FetchRows), без исходной таблицы в памяти.
+        // rowsRead - сколько строк отдал поставщик. nullptr - обработчик так не умеет
+        // или поставщик не отдает строки по одной; тогда данные читаются FetchData.
+        virtual std::unique_ptr<IRowStream> ProcessSource(IDataProvider& source, size_t& rowsRead) {
+            (void)source;
+            (void)rowsRead;
+            return nullptr;
+        }
+
+        // Ограничивает рабочую память обработчика на время следующего запуска
+        // (максимум size_t снимает ограничение). true, если обработчик умеет
+        // укладываться в лимит, например сбрасывая данные на диск.
+        virtual bool LimitMemory(size_t bytes) {
+            (void)bytes;
+            return false;
+        }
     };
 
     // Базовый класс для форматировщика
@@ -30,6 +146,23 @@ namespace report_builder {
         virtual ~IFormatter() = default;
         virtual std::string Format(const DataTable& data) = 0;
         virtual std::string GetFormatName() const = 0;
+
+        // Форматирование потока строк. По умолчанию поток собирается в таблицу,
+        // форматировщики, которым не нужны все строки сразу, переопределяют метод.
+        virtual std::string FormatStream(IRowStream& rows) {
+            DataTable data;
+            DataRow row;
+            while (rows.Next(row)) {
+                data.push_back(std::move(row));
+            }
+            return Format(data);
+        }
+
+        // Форматирование потока строк прямо в out, без всего текста в памяти.
+        // По умолчанию текст собирается FormatStream и выводится целиком.
+        virtual void FormatStreamTo(IRowStream& rows, std::ostream& out) {
+            out << FormatStream(rows);
+        }
     };
 
     // Базовый класс для стратегии экспорта
@@ -38,6 +171,102 @@ namespace report_builder {
         virtual ~IExportStrategy() = default;
         virtual bool ExportData(const std::string& formattedData) = 0;
         virtual std::string GetMethodName() const = 0;
+
+        // Экспорт текста, который write выводит в поток по частям; bytes - сколько
+        // байт выведено. write возвращает false, если текст не получен целиком,
+        // и тогда экспорт отменяется. По умолчанию текст собирается в строку для ExportData.
+        virtual bool ExportStream(const std::function<bool(std::ostream&)>& write, size_t& bytes) {
+            std::ostringstream out;
+            const bool complete = write(out);
+            const std::string text = out.str();
+            bytes = text.size();
+            return complete && ExportData(text);
+        }
+    };
+
+    // Поток, считающий прошедшие через него строки
+    class TCountingRowStream: public IRowStream {
+    private:
+        IRowStream& Inner;
+        size_t Count = 0;
+
+    public:
+        explicit TCountingRowStream(IRowStream& inner)
+            : Inner(inner) {
+        }
+
+        bool Next(DataRow& row) override {
+            if (Inner.Next(row)) {
+                Count++;
+                return true;
+            }
+            return false;
+        }
+
+        std::optional<std::string> GetError() const override {
+            return Inner.GetError();
+        }
+
+        size_t GetCount() const {
+            return Count;
+        }
+    };
+
+    // Поток, отмечающий в трассировке каждую пачку строк. Интервал пачки включает
+    // и выдачу строк источником, и их обработку потребителем.
+    class TTracedRowStream: public IRowStream {
+    private:
+        IRowStream& Inner;
+        std::string Name;
+        size_t BatchRows;
+        size_t InBatch = 0;
+        uint64_t BatchStartUs = 0;
+
+        void FinishBatch() {
+            auto& tracer = TTracer::Global();
+            tracer.Record("batch", Name, BatchStartUs, tracer.NowUs() - BatchStartUs, InBatch, InBatch);
+            InBatch = 0;
+        }
+
+    public:
+        TTracedRowStream(IRowStream& inner, std::string name, size_t batchRows = 4096)
+            : Inner(inner)
+            , Name(std::move(name))
+            , BatchRows(std::max<size_t>(batchRows, 1)) {
+        }
+
+        bool Next(DataRow& row) override {
+            if (InBatch == 0) {
+                BatchStartUs = TTracer::Global().NowUs();
+            }
+            if (!Inner.Next(row)) {
+                if (InBatch > 0) {
+                    FinishBatch();
+                }
+                return false;
+            }
+            if (++InBatch == BatchRows) {
+                FinishBatch();
+            }
+            return true;
+        }
+
+        std::optional<std::string> GetError() const override {
+            return Inner.GetError();
+        }
+    };
+
+    // Общий префикс, выполненный за отчет TBatchReportExecutor: его этапы и число
+    // прочитанных строк учитываются в статистике и метриках отчета
+    struct TSharedPrefix {
+        size_t SourceRows = 0;
+        std::vector<TStageStats> Stages;
+    };
+
+    // Результат планирования: исходная цепочка обработчиков и примененные переписывания
+    struct TPlanInfo {
+        std::vector<std::string> Original;
+        std::vector<std::string> Rewrites;
     };
 
     // Класс отчета
@@ -47,6 +276,17 @@ namespace report_builder {
         std::vector<std::unique_ptr<IDataProcessor>> Processors;
         std::unique_ptr<IFormatter> Formatter;
         std::unique_ptr<IExportStrategy> Exporter;
+        // Дополнительные выходы: те же данные в другом формате и другим способом
+        std::vector<std::pair<std::unique_ptr<IFormatter>, std::unique_ptr<IExportStrategy>>> ExtraOutputs;
+        bool Instrumentation = false;
+        bool StreamingOutput = false;
+        std::shared_ptr<const TPipelineStats> LastStats;
+        std::string ReportType = "custom";
+        TReportMetrics Metrics{ReportType};
+        std::optional<TPlanInfo> PlanInfo;
+        TMemoryBudget* MemoryBudget = nullptr;
+        TAdmissionOptions Admission;
+        size_t LastPeakReservedBytes = 0;
 
     public:
         TReport(std::unique_ptr<IDataProvider> source,
@@ -59,29 +299,439 @@ namespace report_builder {
             , Exporter(std::move(exporter)) {
         }
 
-        TOperationResult Generate() {
-            auto rawData = DataSource->FetchData();
-            if (!rawData.Success) {
-                return rawData;
+        // Тип отчета, которым помечаются метрики (обычно имя фабрики)
+        void SetReportType(const std::string& reportType) {
+            ReportType = reportType;
+            Metrics = TReportMetrics(ReportType);
+        }
+
+        const std::string& GetReportType() const {
+            return ReportType;
+        }
+
+        // Добавляет выход отчета. Конвейер данных выполняется один раз,
+        // форматировщики всех выходов работают параллельно над общей таблицей.
+        void AddOutput(std::unique_ptr<IFormatter> formatter, std::unique_ptr<IExportStrategy> exporter) {
+            ExtraOutputs.emplace_back(std::move(formatter), std::move(exporter));
+        }
+
+        // Сведения планировщика для Explain; без них план считается неоптимизированным
+        void SetPlanInfo(TPlanInfo info) {
+            PlanInfo = std::move(info);
+        }
+
+        // Учет данных отчета в бюджете памяти. Таблицы после каждого этапа и
+        // отформатированный текст резервируются в budget; что делать при нехватке,
+        // задает options. Без бюджета память не оценивается.
+        void SetMemoryBudget(TMemoryBudget& budget, TAdmissionOptions options = {}) {
+            MemoryBudget = &budget;
+            Admission = options;
+        }
+
+        // Разрешает последнему обработчику отдавать строки форматировщику потоком
+        // (внешняя сортировка читает серии с диска). Таблица тогда не собирается,
+        // и Data результата Generate пуст.
+        void EnableStreamingOutput(bool enabled = true) {
+            StreamingOutput = enabled;
+        }
+
+        // Включает сбор статистики по этапам; без него накладные расходы - одна проверка на этап
+        void EnableInstrumentation(bool enabled = true) {
+            Instrumentation = enabled;
+        }
+
+    private:
+        // Доводит резерв отчета до bytes; текст ошибки, если бюджет этого не позволяет.
+        // wait = false - не ждать памяти даже в режимах Queue и Degrade.
+        std::optional<std::string> Admit(TMemoryReservation* reservation, size_t bytes, const std::string& stage,
+                                         bool wait = true) {
+            if (!reservation) {
+                return std::nullopt;
+            }
+            const size_t before = reservation->GetBytes();
+            TAdmissionOptions options = Admission;
+            if (!wait) {
+                options.Mode = EAdmissionMode::FailFast;
+            }
+            if (!reservation->Resize(bytes, options)) {
+                return "Memory budget exceeded at " + stage + ": need " + std::to_string(bytes) + " bytes, " +
+                       std::to_string(MemoryBudget->GetAvailableBytes() + before) + " of " +
+                       std::to_string(MemoryBudget->GetLimit()) + " available (" + AdmissionModeName(Admission.Mode) + ")";
+            }
+            Metrics.ReservedBytes->Add(static_cast<int64_t>(reservation->GetBytes()) - static_cast<int64_t>(before));
+            return std::nullopt;
+        }
+
+        // Форматирование всех выходов параллельно, затем экспорт по порядку
+        TOperationResult FanOut(DataTable processed, TPipelineStats* stats, TStageTimer& timer,
+                                TMemoryReservation* reservation) {
+            std::vector<std::pair<IFormatter*, IExportStrategy*>> outputs = {{Formatter.get(), Exporter.get()}};
+            for (const auto& [formatter, exporter] : ExtraOutputs) {
+                outputs.emplace_back(formatter.get(), exporter.get());
+            }
+
+            const DataTable& shared = processed;
+            auto format = [&shared, stats](IFormatter* formatter) {
+                TTraceSpan span("formatter", formatter->GetFormatName());
+                span.SetRows(shared.size(), shared.size());
+                TStageStats stageStats;
+                const auto started = std::chrono::steady_clock::now();
+                const double cpuStarted = stats ? ThreadCpuMs() : 0.0;
+                // Пик считается в потоке, где идет форматирование (см. TAllocationTracker)
+                const int64_t allocBase = stats ? TAllocationTracker::ResetPeak() : 0;
+                std::string formatted = formatter->Format(shared);
+                if (stats) {
+                    stageStats.PeakAllocatedBytes = TAllocationTracker::GetPeakSince(allocBase);
+                    stageStats.Stage = "formatter";
+                    stageStats.Name = formatter->GetFormatName();
+                    stageStats.WallMs =
+                        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+                    stageStats.CpuMs = ThreadCpuMs() - cpuStarted;
+                    stageStats.RowsIn = stageStats.RowsOut = shared.size();
+                    stageStats.BytesProduced = formatted.size();
+                }
+                return std::make_pair(std::move(formatted), std::move(stageStats));
+            };
+
+            // Первый выход форматируется в текущем потоке, остальные - в общем пуле
+            std::vector<std::future<std::pair<std::string, TStageStats>>> pending;
+            for (size_t i = 1; i < outputs.size(); i++) {
+                pending.push_back(TTaskPool::Global().Submit([&format, formatter = outputs[i].first] {
+                    return format(formatter);
+                }));
+            }
+            std::vector<std::pair<std::string, TStageStats>> formatted;
+            std::exception_ptr error;
+            try {
+                formatted.push_back(format(outputs[0].first));
+            } catch (...) {
+                error = std::current_exception();
+            }
+            // Задачи пула ссылаются на локальные данные: дожидаемся всех до выхода
+            for (auto& future : pending) {
+                future.wait();
+            }
+            if (error) {
+                std::rethrow_exception(error);
+            }
+            for (auto& future : pending) {
+                formatted.push_back(future.get());
+            }
+
+            if (stats) {
+                // Этапы шли параллельно: в общее время входит самый долгий
+                double slowest = 0.0;
+                for (auto& [text, stageStats] : formatted) {
+                    slowest = std::max(slowest, stageStats.WallMs);
+                    stats->Stages.push_back(std::move(stageStats));
+                }
+                stats->TotalWallMs += slowest;
             }
+            timer.Restart();
 
-            DataTable processed = std::move(rawData.Data);
-            for (auto& processor : Processors) {
-                auto result = processor->Process(processed);
+            if (reservation) {
+                size_t textBytes = 0;
+                for (const auto& [text, stageStats] : formatted) {
+                    textBytes += text.size();
+                }
+                if (auto error = Admit(reservation, reservation->GetBytes() + textBytes, "formatter")) {
+                    return TOperationResult::Error(*error);
+                }
+            }
+
+            std::string failed;
+            for (size_t i = 0; i < outputs.size(); i++) {
+                const std::string& text = formatted[i].first;
+                bool exported = outputs[i].second->ExportData(text);
+                timer.Finish("exporter", [&] { return outputs[i].second->GetMethodName(); }, 0, 0,
+                             [&] { return exported ? text.size() : 0; });
+                if (!exported) {
+                    failed += (failed.empty() ? "" : ", ") + outputs[i].second->GetMethodName();
+                }
+            }
+            if (!failed.empty()) {
+                return TOperationResult::Error("Export failed: " + failed);
+            }
+            return TOperationResult::Ok(std::move(processed));
+        }
+
+        // Выполняет отчет с обработчика firstProcessor. Без input данные берутся у поставщика.
+        TOperationResult Execute(std::optional<DataTable> input, size_t firstProcessor, const TSharedPrefix* prefix = nullptr) {
+            const auto started = std::chrono::steady_clock::now();
+            std::shared_ptr<TPipelineStats> stats = Instrumentation ? std::make_shared<TPipelineStats>() : nullptr;
+            TTraceSpan reportSpan("report", ReportType);
+            std::optional<TMemoryReservation> reservation;
+            if (MemoryBudget) {
+                reservation.emplace(*MemoryBudget);
+            }
+            auto finish = [&](TOperationResult result, TCounter* failures = nullptr) {
+                reportSpan.SetRows(0, result.Data.size());
+                if (reservation) {
+                    LastPeakReservedBytes = reservation->GetPeakBytes();
+                    Metrics.ReservedBytes->Add(-static_cast<int64_t>(reservation->GetBytes()));
+                    reservation.reset();
+                    if (stats) {
+                        stats->PeakReservedBytes = LastPeakReservedBytes;
+                    }
+                }
+                if (stats) {
+                    result.Stats = stats;
+                    LastStats = stats;
+                }
+                (failures && !result.Success ? failures : Metrics.Generated)->Inc();
+                Metrics.Duration->Observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count());
+                return result;
+            };
+            TStageTimer timer(stats.get());
+
+            DataTable processed;
+            std::unique_ptr<IRowStream> stream;
+            size_t nextProcessor = firstProcessor;
+            if (input) {
+                processed = std::move(*input);
+                if (prefix) {
+                    Metrics.Rows->Inc(prefix->SourceRows);
+                    if (stats) {
+                        for (const auto& stage : prefix->Stages) {
+                            stats->TotalWallMs += stage.WallMs;
+                            stats->Stages.push_back(stage);
+                        }
+                    }
+                }
+            } else {
+                // Оценка резервируется до чтения, чтобы таблица не заняла память в обход бюджета
+                if (auto estimate = reservation ? DataSource->EstimateBytes() : std::nullopt) {
+                    if (auto error = Admit(&*reservation, *estimate, DataSource->GetSourceInfo())) {
+                        return finish(TOperationResult::Error(*error), Metrics.MemoryFailures);
+                    }
+                }
+
+                // Первый обработчик может забирать строки прямо у поставщика: внешняя
+                // сортировка сбрасывает серии на диск по ходу чтения, и исходная
+                // таблица целиком в памяти не собирается
+                size_t rowsRead = 0;
+                std::unique_ptr<IRowStream> sourced;
+                if (!Processors.empty()) {
+                    const bool limited = reservation && Admission.Mode == EAdmissionMode::Degrade &&
+                                         Processors[0]->LimitMemory(MemoryBudget->GetAvailableBytes());
+                    sourced = Processors[0]->ProcessSource(*DataSource, rowsRead);
+                    if (limited) {
+                        Processors[0]->LimitMemory(std::numeric_limits<size_t>::max());
+                    }
+                }
+                if (sourced) {
+                    // Время чтения включает построение серий
+                    timer.Finish("provider", [&] { return DataSource->GetSourceInfo(); }, 0, rowsRead,
+                                 [] { return size_t{0}; });
+                    if (auto error = sourced->GetError()) {
+                        return finish(TOperationResult::Error(*error), Metrics.ProviderFailures);
+                    }
+                    Metrics.Rows->Inc(rowsRead);
+                    nextProcessor = 1;
+                    if (StreamingOutput && Processors.size() == 1 && ExtraOutputs.empty()) {
+                        stream = std::move(sourced);
+                        timer.Finish("processor", [&] { return Processors[0]->GetDescription() + " [streaming]"; }, rowsRead,
+                                     0, [] { return size_t{0}; });
+                    } else {
+                        DataRow row;
+                        while (sourced->Next(row)) {
+                            processed.push_back(std::move(row));
+                        }
+                        timer.Finish("processor", [&] { return Processors[0]->GetDescription(); }, rowsRead, processed.size(),
+                                     [&] { return EstimateTableBytes(processed); });
+                        if (auto error = sourced->GetError()) {
+                            return finish(TOperationResult::Error(*error), Metrics.ProcessorFailures);
+                        }
+                    }
+                } else {
+                    auto rawData = DataSource->FetchData();
+                    timer.Finish("provider", [&] { return DataSource->GetSourceInfo(); }, 0, rawData.Data.size(),
+                                 [&] { return EstimateTableBytes(rawData.Data); });
+                    if (!rawData.Success) {
+                        return finish(std::move(rawData), Metrics.ProviderFailures);
+                    }
+                    Metrics.Rows->Inc(rawData.Data.size());
+                    processed = std::move(rawData.Data);
+                }
+            }
+            if (reservation) {
+                if (auto error = Admit(&*reservation, EstimateTableBytes(processed), DataSource->GetSourceInfo())) {
+                    return finish(TOperationResult::Error(*error), Metrics.MemoryFailures);
+                }
+            }
+
+            for (size_t i = nextProcessor; i < Processors.size(); i++) {
+                const size_t rowsIn = processed.size();
+                bool limited = false;
+                if (reservation) {
+                    // Во время Process в памяти и вход, и результат; результат оценивается
+                    // размером входа. При деградации, если места под него нет, обработчик
+                    // со сбросом на диск работает в остатке бюджета: сброс поглощает вход
+                    // по ходу работы, и вторая копия таблицы не нужна.
+                    const size_t inputBytes = reservation->GetBytes();
+                    const bool degrade = Admission.Mode == EAdmissionMode::Degrade;
+                    if (degrade && Admit(&*reservation, inputBytes * 2, Processors[i]->GetDescription(), false)) {
+                        limited = Processors[i]->LimitMemory(MemoryBudget->GetAvailableBytes());
+                    }
+                    if (!limited && reservation->GetBytes() < inputBytes * 2) {
+                        if (auto error = Admit(&*reservation, inputBytes * 2, Processors[i]->GetDescription())) {
+                            return finish(TOperationResult::Error(*error), Metrics.MemoryFailures);
+                        }
+                    }
+                }
+                // Поток можно прочитать один раз, поэтому при нескольких выходах таблица материализуется
+                if (StreamingOutput && i + 1 == Processors.size() && ExtraOutputs.empty()) {
+                    stream = Processors[i]->ProcessStreaming(processed);
+                    if (stream) {
+                        timer.Finish("processor", [&] { return Processors[i]->GetDescription() + " [streaming]"; }, rowsIn, 0,
+                                     [] { return size_t{0}; });
+                        if (limited) {
+                            Processors[i]->LimitMemory(std::numeric_limits<size_t>::max());
+                        }
+                        // Поглощенная потоком часть таблицы больше не держит память
+                        if (reservation) {
+                            Admit(&*reservation, EstimateTableBytes(processed), Processors[i]->GetDescription());
+                        }
+                        break;
+                    }
+                }
+                auto result = Processors[i]->Process(std::move(processed));
+                if (limited) {
+                    Processors[i]->LimitMemory(std::numeric_limits<size_t>::max());
+                }
+                timer.Finish("processor", [&] { return Processors[i]->GetDescription(); }, rowsIn, result.Data.size(),
+                             [&] { return EstimateTableBytes(result.Data); });
                 if (!result.Success) {
-                    return result;
+                    return finish(std::move(result), Metrics.ProcessorFailures);
                 }
                 processed = std::move(result.Data);
+                if (reservation) {
+                    if (auto error = Admit(&*reservation, EstimateTableBytes(processed), Processors[i]->GetDescription())) {
+                        return finish(TOperationResult::Error(*error), Metrics.MemoryFailures);
+                    }
+                }
             }
 
-            auto formatted = Formatter->Format(processed);
+            if (!ExtraOutputs.empty()) {
+                return finish(FanOut(std::move(processed), stats.get(), timer, reservation ? &*reservation : nullptr),
+                              Metrics.ExporterFailures);
+            }
+
+            // В потоковом режиме строки идут прямо в форматировщик и в результат не попадают,
+            // а текст уходит в экспорт по частям: файл пишется (и сжимается), пока
+            // форматируются следующие строки. Время этапа formatter включает запись.
+            if (stream) {
+                std::optional<TTracedRowStream> traced;
+                if (TTracer::Global().IsEnabled()) {
+                    traced.emplace(*stream, Processors.back()->GetDescription());
+                }
+                TCountingRowStream counted(traced ? static_cast<IRowStream&>(*traced) : *stream);
+                size_t bytes = 0;
+                const bool exported = Exporter->ExportStream(
+                    [&](std::ostream& out) {
+                        Formatter->FormatStreamTo(counted, out);
+                        return !stream->GetError();
+                    },
+                    bytes);
+                timer.Finish("formatter", [&] { return Formatter->GetFormatName(); }, counted.GetCount(), counted.GetCount(),
+                             [&] { return bytes; });
+                if (auto error = stream->GetError()) {
+                    return finish(TOperationResult::Error(*error), Metrics.FormatterFailures);
+                }
+                timer.Finish("exporter", [&] { return Exporter->GetMethodName(); }, 0, 0, [&] { return exported ? bytes : 0; });
+                if (!exported) {
+                    return finish(TOperationResult::Error("Export failed"), Metrics.ExporterFailures);
+                }
+                return finish(TOperationResult::Ok(std::move(processed)));
+            }
+
+            std::string formatted = Formatter->Format(processed);
+            timer.Finish("formatter", [&] { return Formatter->GetFormatName(); }, processed.size(), processed.size(),
+                         [&] { return formatted.size(); });
+            if (reservation) {
+                if (auto error = Admit(&*reservation, reservation->GetBytes() + formatted.size(), Formatter->GetFormatName())) {
+                    return finish(TOperationResult::Error(*error), Metrics.MemoryFailures);
+                }
+            }
             bool exported = Exporter->ExportData(formatted);
+            timer.Finish("exporter", [&] { return Exporter->GetMethodName(); }, 0, 0, [&] { return exported ? formatted.size() : 0; });
 
             if (!exported) {
-                return TOperationResult::Error("Export failed");
+                return finish(TOperationResult::Error("Export failed"), Metrics.ExporterFailures);
             }
 
-            return TOperationResult::Ok(processed);
+            return finish(TOperationResult::Ok(std::move(processed)));
+        }
+
+    public:
+        TOperationResult Generate() {
+            return Execute(std::nullopt, 0);
+        }
+
+        // Продолжает отчет с данными, уже прошедшими через первые firstProcessor обработчиков
+        // (например, общий префикс нескольких отчетов). Поставщик не вызывается;
+        // этапы prefix попадают в статистику и метрики отчета.
+        TOperationResult GenerateFrom(DataTable data, size_t firstProcessor, const TSharedPrefix* prefix = nullptr) {
+            return Execute(std::move(data), std::min(firstProcessor, Processors.size()), prefix);
+        }
+
+        IDataProvider& GetDataSource() const {
+            return *DataSource;
+        }
+
+        const std::vector<std::unique_ptr<IDataProcessor>>& GetProcessors() const {
+            return Processors;
+        }
+
+        // Пик резерва в бюджете памяти за последний запуск; 0 без бюджета
+        size_t GetLastPeakReservedBytes() const {
+            return LastPeakReservedBytes;
+        }
+
+        // Статистика последнего инструментированного запуска или nullptr
+        std::shared_ptr<const TPipelineStats> GetLastStats() const {
+            return LastStats;
+        }
+
+        void PrintStats() const {
+            if (LastStats) {
+                LastStats->Print(std::cout);
+            } else {
+                std::cout << "Pipeline Stats: instrumentation disabled\n";
+            }
+        }
+
+        // Исходный и оптимизированный планы рядом с перечнем переписываний
+        std::string Explain() const {
+            std::ostringstream out;
+            auto printPlan = [&](const char* title, const std::vector<std::string>& processors) {
+                out << title << ":\n";
+                out << "  Source: " << DataSource->GetSourceInfo() << "\n";
+                for (size_t i = 0; i < processors.size(); i++) {
+                    out << "  " << i + 1 << ". " << processors[i] << "\n";
+                }
+                out << "  Formatter: " << Formatter->GetFormatName() << "\n";
+                out << "  Exporter: " << Exporter->GetMethodName() << "\n";
+                for (const auto& [formatter, exporter] : ExtraOutputs) {
+                    out << "  Output: " << formatter->GetFormatName() << " -> " << exporter->GetMethodName() << "\n";
+                }
+            };
+
+            std::vector<std::string> current;
+            for (const auto& processor : Processors) {
+                current.push_back(processor->GetDescription());
+            }
+            printPlan("Original plan", PlanInfo ? PlanInfo->Original : current);
+            printPlan("Optimized plan", current);
+            out << "Rewrites:\n";
+            if (!PlanInfo || PlanInfo->Rewrites.empty()) {
+                out << "  (none)\n";
+            } else {
+                for (const auto& rewrite : PlanInfo->Rewrites) {
+                    out << "  - " << rewrite << "\n";
+                }
+            }
+            return out.str();
         }
 
         void PrintPipeline() const {
@@ -92,6 +742,9 @@ namespace report_builder {
             }
             std::cout << "  Formatter: " << Formatter->GetFormatName() << "\n";
             std::cout << "  Exporter: " << Exporter->GetMethodName() << "\n";
+            for (const auto& [formatter, exporter] : ExtraOutputs) {
+                std::cout << "  Output: " << formatter->GetFormatName() << " -> " << exporter->GetMethodName() << "\n";
+            }
         }
     };
 } // namespace report_builder
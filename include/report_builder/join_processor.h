@@ -0,0 +1,370 @@
+#ifndef REPORT_BUILDER_JOIN_PROCESSOR_H
+#define REPORT_BUILDER_JOIN_PROCESSOR_H
+
+#include <tuple>
+#include <unordered_map>
+
+#include "report_builder/interfaces.h"
+#include "report_builder/row_codec.h"
+
+namespace report_builder {
+    enum class EJoinType {
+        Inner,
+        Left,
+    };
+
+    struct TJoinOptions {
+        EJoinType Type = EJoinType::Inner;
+        // Префикс для неключевых колонок правой таблицы
+        std::string RightPrefix;
+        // Бюджет памяти на сторону построения; при превышении - grace hash join через диск
+        size_t MaxBuildBytes = 256u << 20;
+        size_t SpillPartitions = 16;
+    };
+
+    // Ключ соединения. Обычные и словарные строки с одинаковым текстом равны.
+    using TJoinKey = std::vector<DataValue>;
+
+    struct TJoinKeyHash {
+        size_t operator()(const TJoinKey& key) const {
+            size_t seed = key.size();
+            for (const auto& value : key) {
+                seed ^= HashKeyValue(value) + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2);
+            }
+            return seed;
+        }
+    };
+
+    struct TJoinKeyEqual {
+        bool operator()(const TJoinKey& a, const TJoinKey& b) const {
+            return std::equal(a.begin(), a.end(), b.begin(), b.end(), KeyValueEqual);
+        }
+    };
+
+    // Hash join основной таблицы с таблицей второго поставщика.
+    // Хеш-таблица строится по меньшей из сторон, другая сторона ее зондирует.
+    class THashJoinProcessor: public IDataProcessor {
+    private:
+        std::unique_ptr<IDataProvider> RightSource;
+        std::vector<std::string> LeftKeys;
+        std::vector<std::string> RightKeys;
+        TJoinOptions Options;
+
+        using THashTable = std::unordered_map<TJoinKey, std::vector<size_t>, TJoinKeyHash, TJoinKeyEqual>;
+
+        static bool ExtractKey(const DataRow& row, const std::vector<std::string>& fields, TJoinKey& key) {
+            key.clear();
+            for (const auto& field : fields) {
+                auto it = row.find(field);
+                if (it == row.end()) {
+                    return false;
+                }
+                key.push_back(it->second);
+            }
+            return true;
+        }
+
+        DataRow Combine(const DataRow& left, const DataRow* right) const {
+            DataRow result = left;
+            if (right) {
+                for (const auto& [key, value] : *right) {
+                    if (std::find(RightKeys.begin(), RightKeys.end(), key) != RightKeys.end()) {
+                        continue;
+                    }
+                    // При совпадении имен сохраняется значение левой таблицы
+                    result.emplace(Options.RightPrefix + key, value);
+                }
+            }
+            return result;
+        }
+
+        // Хеш-таблица по стороне построения; строки другой стороны зондируют ее по одной
+        struct TProbeState {
+            const DataTable* Build = nullptr;
+            bool BuildLeft = false;
+            THashTable Table;
+            std::vector<bool> Matched;
+        };
+
+        TProbeState BuildTable(const DataTable& build, bool buildLeft) const {
+            TProbeState state;
+            state.Build = &build;
+            state.BuildLeft = buildLeft;
+            state.Table.reserve(build.size());
+            TJoinKey key;
+            for (size_t i = 0; i < build.size(); i++) {
+                if (ExtractKey(build[i], buildLeft ? LeftKeys : RightKeys, key)) {
+                    state.Table[key].push_back(i);
+                }
+            }
+            state.Matched.assign(buildLeft ? build.size() : 0, false);
+            return state;
+        }
+
+        void Probe(TProbeState& state, const DataRow& probeRow, TJoinKey& key, DataTable& output) const {
+            const DataTable& build = *state.Build;
+            const std::vector<size_t>* matches = nullptr;
+            if (ExtractKey(probeRow, state.BuildLeft ? RightKeys : LeftKeys, key)) {
+                auto it = state.Table.find(key);
+                if (it != state.Table.end()) {
+                    matches = &it->second;
+                }
+            }
+
+            if (state.BuildLeft) {
+                if (matches) {
+                    for (size_t idx : *matches) {
+                        state.Matched[idx] = true;
+                        output.push_back(Combine(build[idx], &probeRow));
+                    }
+                }
+            } else if (matches) {
+                for (size_t idx : *matches) {
+                    output.push_back(Combine(probeRow, &build[idx]));
+                }
+            } else if (Options.Type == EJoinType::Left) {
+                output.push_back(Combine(probeRow, nullptr));
+            }
+        }
+
+        // Строки левой стороны построения без пары - в конец результата левого соединения
+        void FinishProbe(const TProbeState& state, DataTable& output) const {
+            if (!state.BuildLeft || Options.Type != EJoinType::Left) {
+                return;
+            }
+            for (size_t i = 0; i < state.Build->size(); i++) {
+                if (!state.Matched[i]) {
+                    output.push_back(Combine((*state.Build)[i], nullptr));
+                }
+            }
+        }
+
+        // Соединение двух таблиц, целиком помещающихся в память
+        void JoinInMemory(const DataTable& left, const DataTable& right, DataTable& output) const {
+            const bool buildLeft = left.size() < right.size();
+            auto state = BuildTable(buildLeft ? left : right, buildLeft);
+            TJoinKey key;
+            for (const auto& probeRow : buildLeft ? right : left) {
+                Probe(state, probeRow, key, output);
+            }
+            FinishProbe(state, output);
+        }
+
+        // Сторона соединения, разложенная по партициям на диске
+        struct TSpilledSide {
+            std::shared_ptr<TRowCodec> Codec;
+            std::vector<std::unique_ptr<TSpillFile>> Parts;
+            // Память строк партиции после чтения (EstimateRowBytes)
+            std::vector<size_t> Bytes;
+
+            TSpilledSide(std::shared_ptr<TRowCodec> codec, size_t partitions, const std::string& prefix)
+                : Codec(std::move(codec))
+                , Bytes(partitions, 0) {
+                for (size_t i = 0; i < partitions; i++) {
+                    Parts.push_back(std::make_unique<TSpillFile>(Codec, prefix));
+                }
+            }
+
+            bool Write(size_t part, const DataRow& row) {
+                Bytes[part] += EstimateRowBytes(row);
+                return Parts[part]->Write(row);
+            }
+        };
+
+        // Глубина повторного разбиения партиций, которые больше бюджета
+        static constexpr size_t MaxSpillDepth = 4;
+
+        // Партиция ключа на уровне разбиения depth. На каждом уровне хеш перемешивается
+        // по-своему, иначе ключи большой партиции снова попали бы в одну партицию.
+        static size_t PartitionOf(const TJoinKey& key, size_t depth, size_t partitions) {
+            uint64_t h = TJoinKeyHash{}(key) + (depth + 1) * 0x9e3779b97f4a7c15ULL;
+            h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+            return static_cast<size_t>((h ^ (h >> 31)) % partitions);
+        }
+
+        size_t PartitionCount() const {
+            return std::max<size_t>(Options.SpillPartitions, 1);
+        }
+
+        // Кладет строку в партицию по ключу. Строка без ключа ни с чем не соединится:
+        // у левой стороны левого соединения она сразу идет в результат.
+        bool SpillRow(const DataRow& row, bool isLeft, TSpilledSide& side, TJoinKey& key, DataTable& output) const {
+            if (!ExtractKey(row, isLeft ? LeftKeys : RightKeys, key)) {
+                if (isLeft && Options.Type == EJoinType::Left) {
+                    output.push_back(Combine(row, nullptr));
+                }
+                return true;
+            }
+            return side.Write(PartitionOf(key, 0, side.Parts.size()), row);
+        }
+
+        // Читает партицию целиком; false, если файл прочитан не полностью
+        static bool LoadPartition(TSpillFile& part, DataTable& rows) {
+            DataRow row;
+            rows.reserve(part.GetRowCount());
+            while (part.Read(row)) {
+                rows.push_back(std::move(row));
+            }
+            return rows.size() == part.GetRowCount();
+        }
+
+        // Grace hash join по партициям. Партиция, у которой обе стороны больше бюджета,
+        // разбивается заново (до MaxSpillDepth уровней; глубже - например, когда почти
+        // все строки имеют один ключ - соединяется в памяти).
+        std::optional<std::string> JoinSpilled(TSpilledSide& left, TSpilledSide& right, size_t depth,
+                                               DataTable& output) const {
+            const size_t partitions = left.Parts.size();
+            for (size_t i = 0; i < partitions; i++) {
+                if (!left.Parts[i]->FinishWrite() || !right.Parts[i]->FinishWrite()) {
+                    return "Join: failed to reopen spill partition";
+                }
+                if (std::min(left.Bytes[i], right.Bytes[i]) > Options.MaxBuildBytes && depth < MaxSpillDepth &&
+                    partitions > 1) {
+                    TSpilledSide leftSub(left.Codec, partitions, "join_left");
+                    TSpilledSide rightSub(right.Codec, partitions, "join_right");
+                    for (auto [side, sub, keys] : {std::make_tuple(&left, &leftSub, &LeftKeys),
+                                                   std::make_tuple(&right, &rightSub, &RightKeys)}) {
+                        DataRow row;
+                        TJoinKey key;
+                        size_t rows = 0;
+                        while (side->Parts[i]->Read(row)) {
+                            rows++;
+                            ExtractKey(row, *keys, key);
+                            if (!sub->Write(PartitionOf(key, depth + 1, partitions), row)) {
+                                return "Join: failed to write spill partition";
+                            }
+                        }
+                        if (rows != side->Parts[i]->GetRowCount()) {
+                            return "Join: corrupted spill partition";
+                        }
+                        side->Parts[i].reset();
+                    }
+                    if (auto error = JoinSpilled(leftSub, rightSub, depth + 1, output)) {
+                        return error;
+                    }
+                    continue;
+                }
+
+                TTraceSpan span("batch", "join partition");
+                const size_t outputBefore = output.size();
+                DataTable leftPart;
+                DataTable rightPart;
+                if (!LoadPartition(*left.Parts[i], leftPart) || !LoadPartition(*right.Parts[i], rightPart)) {
+                    return "Join: corrupted spill partition";
+                }
+                JoinInMemory(leftPart, rightPart, output);
+                span.SetRows(leftPart.size() + rightPart.size(), output.size() - outputBefore);
+                left.Parts[i].reset();
+                right.Parts[i].reset();
+            }
+            return std::nullopt;
+        }
+
+    public:
+        THashJoinProcessor(std::unique_ptr<IDataProvider> right,
+                           std::vector<std::string> leftKeys,
+                           std::vector<std::string> rightKeys,
+                           TJoinOptions options = {})
+            : RightSource(std::move(right))
+            , LeftKeys(std::move(leftKeys))
+            , RightKeys(std::move(rightKeys))
+            , Options(std::move(options)) {
+        }
+
+        // Правая сторона читается по строкам (FetchRows) и копится в памяти, пока
+        // помещается в MaxBuildBytes. Когда бюджет превышен:
+        //  - если левая сторона в бюджет помещается, по ней строится хеш-таблица,
+        //    и правые строки зондируют ее по мере чтения, не накапливаясь;
+        //  - иначе накопленные и все следующие правые строки уходят в партиции на
+        //    диске, затем туда же раскладывается левая сторона (grace hash join).
+        // Поставщик без FetchRows читается FetchData целиком, и до раскладки
+        // в памяти находятся обе стороны.
+        TOperationResult Process(DataTable data) override {
+            if (LeftKeys.empty() || LeftKeys.size() != RightKeys.size()) {
+                return TOperationResult::Error("Join: key lists must be non-empty and of equal length");
+            }
+
+            const bool leftFits = EstimateTableBytes(data) <= Options.MaxBuildBytes;
+            DataTable output;
+            DataTable right;
+            size_t rightBytes = 0;
+            std::optional<TProbeState> probe;
+            std::optional<TSpilledSide> rightSpill;
+            bool writeFailed = false;
+            TJoinKey key;
+            auto addRight = [&](DataRow&& row) {
+                if (probe) {
+                    Probe(*probe, row, key, output);
+                    return;
+                }
+                if (rightSpill) {
+                    writeFailed = writeFailed || !SpillRow(row, false, *rightSpill, key, output);
+                    return;
+                }
+                rightBytes += EstimateRowBytes(row);
+                right.push_back(std::move(row));
+                if (rightBytes <= Options.MaxBuildBytes) {
+                    return;
+                }
+                if (leftFits) {
+                    probe = BuildTable(data, true);
+                    for (const auto& pending : right) {
+                        Probe(*probe, pending, key, output);
+                    }
+                } else {
+                    rightSpill.emplace(std::make_shared<TRowCodec>(), PartitionCount(), "join_right");
+                    for (const auto& pending : right) {
+                        writeFailed = writeFailed || !SpillRow(pending, false, *rightSpill, key, output);
+                    }
+                }
+                DataTable().swap(right);
+            };
+
+            auto fetched = RightSource->FetchRows(addRight);
+            if (!fetched) {
+                auto rightData = RightSource->FetchData();
+                if (!rightData.Success) {
+                    return rightData;
+                }
+                for (auto& row : rightData.Data) {
+                    addRight(std::move(row));
+                }
+            } else if (!fetched->Success) {
+                return std::move(*fetched);
+            }
+            if (writeFailed) {
+                return TOperationResult::Error("Join: failed to write spill partition");
+            }
+
+            if (probe) {
+                FinishProbe(*probe, output);
+            } else if (rightSpill) {
+                TSpilledSide leftSpill(rightSpill->Codec, PartitionCount(), "join_left");
+                for (const auto& row : data) {
+                    if (!SpillRow(row, true, leftSpill, key, output)) {
+                        return TOperationResult::Error("Join: failed to write spill partition");
+                    }
+                }
+                DataTable().swap(data);
+                if (auto error = JoinSpilled(leftSpill, *rightSpill, 0, output)) {
+                    return TOperationResult::Error(*error);
+                }
+            } else {
+                JoinInMemory(data, right, output);
+            }
+            return TOperationResult::Ok(std::move(output));
+        }
+
+        std::string GetDescription() const override {
+            std::string desc = Options.Type == EJoinType::Inner ? "Inner join" : "Left join";
+            desc += " with " + RightSource->GetSourceInfo() + " on";
+            for (size_t i = 0; i < LeftKeys.size() && i < RightKeys.size(); i++) {
+                desc += " " + LeftKeys[i] + "=" + RightKeys[i];
+            }
+            return desc;
+        }
+    };
+} // namespace report_builder
+
+#endif
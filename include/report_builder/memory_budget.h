@@ -0,0 +1,206 @@
+#ifndef REPORT_BUILDER_MEMORY_BUDGET_H
+#define REPORT_BUILDER_MEMORY_BUDGET_H
+
+#include <chrono>
+#include <condition_variable>
+
+#include "report_builder/metrics.h"
+
+namespace report_builder {
+    // Что делать отчету, которому не хватает памяти в бюджете
+    enum class EAdmissionMode {
+        Queue,    // ждать, пока другие отчеты освободят память
+        Degrade,  // обработчики со сбросом на диск работают в остатке бюджета вместо копии таблицы, остальные ждут
+        FailFast, // сразу завершиться ошибкой
+    };
+
+    inline const char* AdmissionModeName(EAdmissionMode mode) {
+        switch (mode) {
+            case EAdmissionMode::Queue:
+                return "queue";
+            case EAdmissionMode::Degrade:
+                return "degrade";
+            default:
+                return "fail-fast";
+        }
+    }
+
+    struct TAdmissionOptions {
+        EAdmissionMode Mode = EAdmissionMode::Queue;
+        // Сколько ждать памяти в режимах Queue и Degrade
+        std::chrono::milliseconds QueueTimeout{30000};
+    };
+
+    // Общий на процесс бюджет памяти. Компоненты конвейера резервируют в нем
+    // оценку занятой памяти (EstimateTableBytes, размер отформатированного текста)
+    // через TMemoryReservation. Лимит 0 - без ограничения, только учет.
+    class TMemoryBudget {
+    private:
+        mutable std::mutex Mutex;
+        std::condition_variable Released;
+        size_t Limit;
+        size_t Used = 0;
+        size_t Peak = 0;
+        TGauge* UsedGauge;
+        TCounter* Waits;
+        TCounter* Rejections;
+
+        bool Fits(size_t bytes) const {
+            return Limit == 0 || Used + bytes <= Limit;
+        }
+
+        void Take(size_t bytes) {
+            Used += bytes;
+            Peak = std::max(Peak, Used);
+            UsedGauge->Add(static_cast<int64_t>(bytes));
+        }
+
+    public:
+        explicit TMemoryBudget(size_t limit = 0, const std::string& name = "custom")
+            : Limit(limit) {
+            auto& registry = TMetricsRegistry::Global();
+            const TMetricLabels labels = {{"budget", name}};
+            UsedGauge = &registry.GetGauge("report_builder_memory_reserved_bytes", "Bytes reserved in a memory budget.", labels);
+            Waits = &registry.GetCounter("report_builder_memory_admission_waits", "Reservations that waited for memory.", labels);
+            Rejections = &registry.GetCounter("report_builder_memory_admission_rejections",
+                                              "Reservations refused by a memory budget.", labels);
+        }
+
+        TMemoryBudget(const TMemoryBudget&) = delete;
+        TMemoryBudget& operator=(const TMemoryBudget&) = delete;
+
+        ~TMemoryBudget() {
+            UsedGauge->Add(-static_cast<int64_t>(Used));
+        }
+
+        static TMemoryBudget& Global() {
+            static TMemoryBudget budget(0, "global");
+            return budget;
+        }
+
+        void SetLimit(size_t limit) {
+            std::lock_guard lock(Mutex);
+            Limit = limit;
+            Released.notify_all();
+        }
+
+        size_t GetLimit() const {
+            std::lock_guard lock(Mutex);
+            return Limit;
+        }
+
+        size_t GetUsedBytes() const {
+            std::lock_guard lock(Mutex);
+            return Used;
+        }
+
+        size_t GetPeakBytes() const {
+            std::lock_guard lock(Mutex);
+            return Peak;
+        }
+
+        // Свободная часть бюджета; без лимита - максимум size_t
+        size_t GetAvailableBytes() const {
+            std::lock_guard lock(Mutex);
+            return Limit == 0 ? std::numeric_limits<size_t>::max() : Limit - std::min(Used, Limit);
+        }
+
+        bool TryReserve(size_t bytes) {
+            std::lock_guard lock(Mutex);
+            if (!Fits(bytes)) {
+                Rejections->Inc();
+                return false;
+            }
+            Take(bytes);
+            return true;
+        }
+
+        // Ждет освобождения памяти не дольше timeout. held - память, которую
+        // вызывающий уже держит: если held + bytes больше лимита, ждать бесполезно.
+        // На время ожидания held возвращается в бюджет, иначе отчеты, ждущие друг
+        // друга с частью памяти на руках, простоят до таймаута; затем held + bytes
+        // берутся разом. При отказе held возвращается вызывающему, даже сверх лимита.
+        bool Reserve(size_t bytes, std::chrono::milliseconds timeout, size_t held = 0) {
+            std::unique_lock lock(Mutex);
+            if (!Fits(bytes)) {
+                Waits->Inc();
+                held = std::min(held, Used);
+                Used -= held;
+                UsedGauge->Add(-static_cast<int64_t>(held));
+                Released.notify_all();
+                const bool admitted = Released.wait_for(lock, timeout, [&] {
+                    return Fits(held + bytes) || (Limit != 0 && held + bytes > Limit);
+                });
+                if (!admitted || !Fits(held + bytes)) {
+                    Take(held);
+                    Rejections->Inc();
+                    return false;
+                }
+                bytes += held;
+            }
+            Take(bytes);
+            return true;
+        }
+
+        void Release(size_t bytes) {
+            {
+                std::lock_guard lock(Mutex);
+                bytes = std::min(bytes, Used);
+                Used -= bytes;
+                UsedGauge->Add(-static_cast<int64_t>(bytes));
+            }
+            Released.notify_all();
+        }
+    };
+
+    // Резерв одного отчета в бюджете. Размер меняется по ходу конвейера,
+    // при разрушении память возвращается в бюджет.
+    class TMemoryReservation {
+    private:
+        TMemoryBudget* Budget;
+        size_t Bytes = 0;
+        size_t Peak = 0;
+
+    public:
+        explicit TMemoryReservation(TMemoryBudget& budget)
+            : Budget(&budget) {
+        }
+
+        TMemoryReservation(const TMemoryReservation&) = delete;
+        TMemoryReservation& operator=(const TMemoryReservation&) = delete;
+
+        ~TMemoryReservation() {
+            Budget->Release(Bytes);
+        }
+
+        // Устанавливает размер резерва. Уменьшение всегда успешно, увеличение
+        // ведется по правилам options; при отказе резерв не меняется.
+        bool Resize(size_t bytes, const TAdmissionOptions& options) {
+            if (bytes <= Bytes) {
+                Budget->Release(Bytes - bytes);
+                Bytes = bytes;
+                return true;
+            }
+            const size_t delta = bytes - Bytes;
+            const bool reserved = options.Mode == EAdmissionMode::FailFast
+                                      ? Budget->TryReserve(delta)
+                                      : Budget->Reserve(delta, options.QueueTimeout, Bytes);
+            if (!reserved) {
+                return false;
+            }
+            Bytes = bytes;
+            Peak = std::max(Peak, Bytes);
+            return true;
+        }
+
+        size_t GetBytes() const {
+            return Bytes;
+        }
+
+        size_t GetPeakBytes() const {
+            return Peak;
+        }
+    };
+} // namespace report_builder
+
+#endif
@@ -0,0 +1,430 @@
+#ifndef REPORT_BUILDER_METRICS_H
+#define REPORT_BUILDER_METRICS_H
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+    #include <netinet/in.h>
+    #include <sys/socket.h>
+    #include <sys/time.h>
+    #include <unistd.h>
+    #define REPORT_BUILDER_HAVE_SOCKETS 1
+#endif
+
+#include "report_builder/data_types.h"
+
+namespace report_builder {
+    using TMetricLabels = std::vector<std::pair<std::string, std::string>>;
+
+    // Монотонный счетчик. Обновление - одна атомарная операция без блокировок.
+    class TCounter {
+    private:
+        std::atomic<uint64_t> Value{0};
+
+    public:
+        void Inc(uint64_t delta = 1) {
+            Value.fetch_add(delta, std::memory_order_relaxed);
+        }
+
+        uint64_t Get() const {
+            return Value.load(std::memory_order_relaxed);
+        }
+    };
+
+    // Текущее значение (например, занятая память). Обновление без блокировок.
+    class TGauge {
+    private:
+        std::atomic<int64_t> Value{0};
+
+    public:
+        void Add(int64_t delta) {
+            Value.fetch_add(delta, std::memory_order_relaxed);
+        }
+
+        void Set(int64_t value) {
+            Value.store(value, std::memory_order_relaxed);
+        }
+
+        int64_t Get() const {
+            return Value.load(std::memory_order_relaxed);
+        }
+    };
+
+    // Гистограмма с фиксированными границами корзин. Обновление без блокировок.
+    class THistogram {
+    private:
+        std::vector<double> Bounds;
+        std::unique_ptr<std::atomic<uint64_t>[]> Buckets;
+        std::atomic<uint64_t> Count{0};
+        std::atomic<double> Sum{0.0};
+
+    public:
+        explicit THistogram(std::vector<double> bounds)
+            : Bounds(std::move(bounds))
+            , Buckets(new std::atomic<uint64_t>[Bounds.size() + 1]) {
+            std::sort(Bounds.begin(), Bounds.end());
+            for (size_t i = 0; i <= Bounds.size(); i++) {
+                Buckets[i].store(0, std::memory_order_relaxed);
+            }
+        }
+
+        void Observe(double value) {
+            size_t bucket = std::lower_bound(Bounds.begin(), Bounds.end(), value) - Bounds.begin();
+            Buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+            Count.fetch_add(1, std::memory_order_relaxed);
+            double sum = Sum.load(std::memory_order_relaxed);
+            while (!Sum.compare_exchange_weak(sum, sum + value, std::memory_order_relaxed)) {
+            }
+        }
+
+        const std::vector<double>& GetBounds() const {
+            return Bounds;
+        }
+
+        // Накопленное число наблюдений в корзинах до i-й включительно
+        uint64_t GetCumulativeCount(size_t bucket) const {
+            uint64_t total = 0;
+            for (size_t i = 0; i <= bucket && i <= Bounds.size(); i++) {
+                total += Buckets[i].load(std::memory_order_relaxed);
+            }
+            return total;
+        }
+
+        uint64_t GetCount() const {
+            return Count.load(std::memory_order_relaxed);
+        }
+
+        double GetSum() const {
+            return Sum.load(std::memory_order_relaxed);
+        }
+    };
+
+    // Реестр метрик. Мьютекс берется только при регистрации серии и при выгрузке;
+    // вызывающий код сохраняет ссылку на серию и обновляет ее без блокировок.
+    class TMetricsRegistry {
+    private:
+        enum class EType {
+            Counter,
+            Gauge,
+            Histogram,
+        };
+
+        struct TFamily {
+            EType Type;
+            std::string Help;
+            std::map<std::string, std::unique_ptr<TCounter>> Counters;
+            std::map<std::string, std::unique_ptr<TGauge>> Gauges;
+            std::map<std::string, std::unique_ptr<THistogram>> Histograms;
+        };
+
+        mutable std::mutex Mutex;
+        std::map<std::string, TFamily> Families;
+
+        static std::string EscapeLabel(const std::string& value) {
+            std::string result;
+            for (char c : value) {
+                if (c == '\\' || c == '"') {
+                    result += '\\';
+                    result += c;
+                } else if (c == '\n') {
+                    result += "\\n";
+                } else {
+                    result += c;
+                }
+            }
+            return result;
+        }
+
+        static std::string FormatLabels(const TMetricLabels& labels) {
+            std::string result;
+            for (const auto& [key, value] : labels) {
+                result += (result.empty() ? "" : ",") + key + "=\"" + EscapeLabel(value) + "\"";
+            }
+            return result;
+        }
+
+        // Кратчайшая запись, которая читается обратно в то же число
+        static std::string FormatNumber(double value) {
+            std::string text;
+            for (int precision = 15; precision <= 17; precision++) {
+                std::ostringstream out;
+                out.precision(precision);
+                out << value;
+                text = out.str();
+                if (std::strtod(text.c_str(), nullptr) == value) {
+                    break;
+                }
+            }
+            return text;
+        }
+
+        TFamily& GetFamily(const std::string& name, EType type, const std::string& help) {
+            auto [it, inserted] = Families.try_emplace(name);
+            if (inserted) {
+                it->second.Type = type;
+                it->second.Help = help;
+            } else if (it->second.Type != type) {
+                throw std::logic_error("Metric '" + name + "' registered with a different type");
+            }
+            return it->second;
+        }
+
+    public:
+        static constexpr const char* ContentType = "application/openmetrics-text; version=1.0.0; charset=utf-8";
+
+        static TMetricsRegistry& Global() {
+            static TMetricsRegistry registry;
+            return registry;
+        }
+
+        static std::vector<double> DefaultLatencyBuckets() {
+            return {0.001, 0.005, 0.01, 0.05, 0.1, 0.25, 0.5, 1.0, 2.5, 5.0, 10.0, 30.0, 60.0};
+        }
+
+        // Имя счетчика указывается без суффикса _total, он добавляется при выгрузке
+        TCounter& GetCounter(const std::string& name, const std::string& help, const TMetricLabels& labels = {}) {
+            std::lock_guard lock(Mutex);
+            auto& series = GetFamily(name, EType::Counter, help).Counters[FormatLabels(labels)];
+            if (!series) {
+                series = std::make_unique<TCounter>();
+            }
+            return *series;
+        }
+
+        TGauge& GetGauge(const std::string& name, const std::string& help, const TMetricLabels& labels = {}) {
+            std::lock_guard lock(Mutex);
+            auto& series = GetFamily(name, EType::Gauge, help).Gauges[FormatLabels(labels)];
+            if (!series) {
+                series = std::make_unique<TGauge>();
+            }
+            return *series;
+        }
+
+        THistogram& GetHistogram(const std::string& name, const std::string& help, const TMetricLabels& labels = {},
+                                 std::vector<double> bounds = DefaultLatencyBuckets()) {
+            std::lock_guard lock(Mutex);
+            auto& series = GetFamily(name, EType::Histogram, help).Histograms[FormatLabels(labels)];
+            if (!series) {
+                series = std::make_unique<THistogram>(std::move(bounds));
+            }
+            return *series;
+        }
+
+        // Текст в формате OpenMetrics
+        std::string Expose() const {
+            std::lock_guard lock(Mutex);
+            std::ostringstream out;
+            for (const auto& [name, family] : Families) {
+                static const char* const TypeNames[] = {" counter\n", " gauge\n", " histogram\n"};
+                out << "# TYPE " << name << TypeNames[static_cast<int>(family.Type)];
+                out << "# HELP " << name << " " << family.Help << "\n";
+                for (const auto& [labels, counter] : family.Counters) {
+                    out << name << "_total" << (labels.empty() ? "" : "{" + labels + "}") << " " << counter->Get() << "\n";
+                }
+                for (const auto& [labels, gauge] : family.Gauges) {
+                    out << name << (labels.empty() ? "" : "{" + labels + "}") << " " << gauge->Get() << "\n";
+                }
+                for (const auto& [labels, histogram] : family.Histograms) {
+                    const std::string prefix = labels.empty() ? "" : labels + ",";
+                    const auto& bounds = histogram->GetBounds();
+                    for (size_t i = 0; i < bounds.size(); i++) {
+                        out << name << "_bucket{" << prefix << "le=\"" << FormatNumber(bounds[i]) << "\"} "
+                            << histogram->GetCumulativeCount(i) << "\n";
+                    }
+                    out << name << "_bucket{" << prefix << "le=\"+Inf\"} " << histogram->GetCumulativeCount(bounds.size()) << "\n";
+                    const std::string suffix = labels.empty() ? "" : "{" + labels + "}";
+                    out << name << "_sum" << suffix << " " << FormatNumber(histogram->GetSum()) << "\n";
+                    out << name << "_count" << suffix << " " << histogram->GetCount() << "\n";
+                }
+            }
+            out << "# EOF\n";
+            return out.str();
+        }
+
+        // Атомарная запись выгрузки в файл (через временный файл и переименование)
+        bool DumpToFile(const std::string& path) const {
+            const std::string tmpPath = path + ".tmp";
+            {
+                std::ofstream file(tmpPath);
+                if (!file.is_open()) {
+                    return false;
+                }
+                file << Expose();
+                if (!file) {
+                    return false;
+                }
+            }
+            std::error_code ec;
+            std::filesystem::rename(tmpPath, path, ec);
+            return !ec;
+        }
+    };
+
+#ifdef REPORT_BUILDER_HAVE_SOCKETS
+    // Минимальный HTTP-эндпоинт для сбора метрик Prometheus на 127.0.0.1.
+    // На любой запрос отвечает выгрузкой реестра.
+    class TMetricsHttpServer {
+    private:
+        TMetricsRegistry& Registry;
+        int ListenFd = -1;
+        uint16_t Port = 0;
+        std::atomic<bool> Running{false};
+        std::thread Worker;
+        std::chrono::milliseconds ClientTimeout;
+
+        void Serve() {
+            while (true) {
+                int client = accept(ListenFd, nullptr, nullptr);
+                if (client < 0) {
+                    // После shutdown из Stop accept завершается ошибкой - это выход
+                    if (!Running.load()) {
+                        return;
+                    }
+                    // Оборванное клиентом соединение не мешает следующим. Прочие ошибки
+                    // (например, кончились дескрипторы) повторяются с паузой, без холостого цикла
+                    if (errno != EINTR && errno != ECONNABORTED) {
+                        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                    }
+                    continue;
+                }
+                // Соединения обслуживаются по одному, поэтому клиент, который молчит
+                // или не читает ответ, держит сервер не дольше ClientTimeout
+                timeval timeout{};
+                timeout.tv_sec = static_cast<time_t>(ClientTimeout.count() / 1000);
+                timeout.tv_usec = static_cast<suseconds_t>(ClientTimeout.count() % 1000 * 1000);
+                setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+                setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+                // Запрос читаем до конца заголовков и не разбираем
+                std::string request;
+                char buffer[1024];
+                while (request.find("\r\n\r\n") == std::string::npos) {
+                    ssize_t got = recv(client, buffer, sizeof(buffer), 0);
+                    if (got <= 0) {
+                        break;
+                    }
+                    request.append(buffer, static_cast<size_t>(got));
+                }
+
+                std::string body = Registry.Expose();
+                std::string response = "HTTP/1.1 200 OK\r\nContent-Type: " + std::string(TMetricsRegistry::ContentType) +
+                                       "\r\nContent-Length: " + std::to_string(body.size()) +
+                                       "\r\nConnection: close\r\n\r\n" + body;
+                size_t sent = 0;
+                while (sent < response.size()) {
+                    ssize_t written = send(client, response.data() + sent, response.size() - sent, 0);
+                    if (written <= 0) {
+                        break;
+                    }
+                    sent += static_cast<size_t>(written);
+                }
+                close(client);
+            }
+        }
+
+    public:
+        explicit TMetricsHttpServer(TMetricsRegistry& registry = TMetricsRegistry::Global(),
+                                    std::chrono::milliseconds clientTimeout = std::chrono::seconds(5))
+            : Registry(registry)
+            , ClientTimeout(clientTimeout) {
+        }
+
+        ~TMetricsHttpServer() {
+            Stop();
+        }
+
+        // port == 0 - выбрать свободный порт, см. GetPort()
+        bool Start(uint16_t port = 0) {
+            ListenFd = socket(AF_INET, SOCK_STREAM, 0);
+            if (ListenFd < 0) {
+                return false;
+            }
+            int reuse = 1;
+            setsockopt(ListenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+            sockaddr_in addr{};
+            addr.sin_family = AF_INET;
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            addr.sin_port = htons(port);
+            socklen_t len = sizeof(addr);
+            if (bind(ListenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(ListenFd, 16) < 0 ||
+                getsockname(ListenFd, reinterpret_cast<sockaddr*>(&addr), &len) < 0) {
+                close(ListenFd);
+                ListenFd = -1;
+                return false;
+            }
+            Port = ntohs(addr.sin_port);
+            Running = true;
+            Worker = std::thread([this] { Serve(); });
+            return true;
+        }
+
+        void Stop() {
+            if (!Running.exchange(false)) {
+                return;
+            }
+            // Прерываем accept. Дескриптор закрывается только после остановки потока:
+            // иначе Serve может прочитать ListenFd во время записи или принять
+            // соединение на уже переиспользованном номере дескриптора
+            shutdown(ListenFd, SHUT_RDWR);
+            if (Worker.joinable()) {
+                Worker.join();
+            }
+            close(ListenFd);
+            ListenFd = -1;
+        }
+
+        uint16_t GetPort() const {
+            return Port;
+        }
+    };
+#endif
+
+    // Метрики отчета одного типа. Серии находятся в реестре один раз,
+    // дальше обновляются без блокировок.
+    struct TReportMetrics {
+        TCounter* Generated;
+        TCounter* Rows;
+        THistogram* Duration;
+        TCounter* ProviderFailures;
+        TCounter* ProcessorFailures;
+        TCounter* FormatterFailures;
+        TCounter* ExporterFailures;
+        TCounter* MemoryFailures;
+        TGauge* ReservedBytes;
+
+        explicit TReportMetrics(const std::string& reportType, TMetricsRegistry& registry = TMetricsRegistry::Global()) {
+            const TMetricLabels labels = {{"report", reportType}};
+            Generated = &registry.GetCounter("report_builder_reports_generated", "Reports generated successfully.", labels);
+            Rows = &registry.GetCounter("report_builder_rows_processed", "Rows fetched from data providers.", labels);
+            Duration = &registry.GetHistogram("report_builder_report_duration_seconds", "Report generation latency.", labels);
+            auto failures = [&](const char* stage) {
+                return &registry.GetCounter("report_builder_report_failures", "Failed report generations by stage.",
+                                            {{"report", reportType}, {"stage", stage}});
+            };
+            ProviderFailures = failures("provider");
+            ProcessorFailures = failures("processor");
+            FormatterFailures = failures("formatter");
+            ExporterFailures = failures("exporter");
+            MemoryFailures = failures("memory");
+            ReservedBytes = &registry.GetGauge("report_builder_report_reserved_bytes",
+                                               "Memory reserved by running reports.", labels);
+        }
+    };
+
+    // Счетчик экспортированных байт для стратегии экспорта
+    inline TCounter& ExportedBytesCounter(const std::string& exporter) {
+        return TMetricsRegistry::Global().GetCounter("report_builder_exported_bytes", "Bytes passed to exporters.",
+                                                     {{"exporter", exporter}});
+    }
+} // namespace report_builder
+
+#endif
@@ -0,0 +1,419 @@
+#ifndef REPORT_BUILDER_PARTITIONED_PROVIDER_H
+#define REPORT_BUILDER_PARTITIONED_PROVIDER_H
+
+#include <atomic>
+#include <filesystem>
+#include <set>
+#include <thread>
+
+#include "report_builder/data_providers.h"
+
+namespace report_builder {
+    struct TPartitionedCsvOptions {
+        char Delimiter = ',';
+        // Число потоков чтения; 0 - по числу ядер
+        size_t Threads = 0;
+        // Применяется к каждому файлу; объявленные типы действуют и на колонки разделов
+        TCsvSchemaOptions Schema;
+        // Кодирование строк выполняется один раз над общей таблицей
+        TDictionaryEncodingOptions Dictionary;
+    };
+
+    // Файл набора и значения разделов из его пути
+    struct TPartitionFile {
+        std::filesystem::path Path;
+        DataRow Partition;
+    };
+
+    // Совпадение имени с шаблоном из * (любая последовательность) и ? (один символ)
+    inline bool MatchGlob(std::string_view pattern, std::string_view text) {
+        size_t p = 0, t = 0;
+        size_t starP = std::string_view::npos, starT = 0;
+        while (t < text.size()) {
+            if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == text[t])) {
+                p++;
+                t++;
+            } else if (p < pattern.size() && pattern[p] == '*') {
+                starP = p++;
+                starT = t;
+            } else if (starP != std::string_view::npos) {
+                p = starP + 1;
+                t = ++starT;
+            } else {
+                return false;
+            }
+        }
+        while (p < pattern.size() && pattern[p] == '*') {
+            p++;
+        }
+        return p == pattern.size();
+    }
+
+    // Провайдер набора CSV-файлов, разложенных по разделам:
+    //   sales/region=North/date=2024-01-01.csv
+    // Сегменты пути вида key=value становятся колонками каждой строки файла.
+    // Источник - каталог (все *.csv, в том числе сжатые, на любой глубине) или
+    // шаблон пути, где * и ? действуют внутри сегмента, а ** - на любое число
+    // сегментов. Фильтры по колонкам разделов проверяются до открытия файлов,
+    // оставшиеся файлы читаются параллельно; строки идут в порядке путей.
+    class TPartitionedCsvDataProvider: public IDataProvider {
+    private:
+        struct TPartitionFilter {
+            std::string Key;
+            std::function<bool(const DataValue&)> Predicate;
+            std::string Description;
+            std::optional<std::string> ShareKey;
+        };
+
+        std::string Source;
+        TPartitionedCsvOptions Options;
+        std::vector<TPartitionFilter> Filters;
+        std::optional<TScanLimit> Limit;
+        size_t FilesRead = 0;
+        size_t FilesPruned = 0;
+        TCounter* ReadCounter;
+        TCounter* PrunedCounter;
+
+        static bool HasWildcards(std::string_view segment) {
+            return segment.find_first_of("*?") != std::string_view::npos;
+        }
+
+        static bool IsCsvFile(const std::filesystem::path& path) {
+            std::string name = path.filename().string();
+            const std::string_view suffix(".gz");
+            if (name.size() > suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0) {
+                name.resize(name.size() - suffix.size());
+            }
+            return std::filesystem::path(name).extension() == ".csv";
+        }
+
+        // Значение раздела без %XX-экранирования и расширений файла
+        static std::string DecodeValue(std::string_view text, bool fileName) {
+            if (fileName) {
+                for (const char* extension : {".gz", ".csv"}) {
+                    const std::string_view suffix(extension);
+                    if (text.size() > suffix.size() && text.substr(text.size() - suffix.size()) == suffix) {
+                        text.remove_suffix(suffix.size());
+                    }
+                }
+            }
+            std::string value;
+            for (size_t i = 0; i < text.size(); i++) {
+                int code = 0;
+                if (text[i] == '%' && i + 2 < text.size() &&
+                    std::from_chars(text.data() + i + 1, text.data() + i + 3, code, 16).ptr == text.data() + i + 3) {
+                    value += static_cast<char>(code);
+                    i += 2;
+                } else {
+                    value += text[i];
+                }
+            }
+            return value;
+        }
+
+        // Совпадение сегментов пути с сегментами шаблона; ** - любое число сегментов
+        static bool MatchSegments(const std::vector<std::string>& pattern, size_t p,
+                                  const std::vector<std::string>& path, size_t s) {
+            if (p == pattern.size()) {
+                return s == path.size();
+            }
+            if (pattern[p] == "**") {
+                for (size_t skip = s; skip <= path.size(); skip++) {
+                    if (MatchSegments(pattern, p + 1, path, skip)) {
+                        return true;
+                    }
+                }
+                return false;
+            }
+            return s < path.size() && MatchGlob(pattern[p], path[s]) && MatchSegments(pattern, p + 1, path, s + 1);
+        }
+
+        // Файлы источника, отсортированные по пути; root - часть источника без шаблонов
+        std::vector<std::filesystem::path> ListFiles(std::filesystem::path& root, std::string& error) const {
+            namespace fs = std::filesystem;
+            std::vector<std::string> pattern;
+            for (const auto& part : fs::path(Source)) {
+                const std::string segment = part.string();
+                if (pattern.empty() && !HasWildcards(segment)) {
+                    root /= part;
+                } else if (!segment.empty()) {
+                    pattern.push_back(segment);
+                }
+            }
+
+            if (root.empty()) {
+                root = ".";
+            }
+
+            std::vector<fs::path> files;
+            std::error_code ec;
+            if (pattern.empty() && fs::is_regular_file(root, ec)) {
+                files.push_back(root);
+                root = root.parent_path();
+                return files;
+            }
+            if (!fs::is_directory(root, ec)) {
+                error = "Cannot open partitioned source: " + Source;
+                return files;
+            }
+            for (fs::recursive_directory_iterator it(root, ec), end; !ec && it != end; it.increment(ec)) {
+                if (!it->is_regular_file(ec)) {
+                    continue;
+                }
+                if (pattern.empty()) {
+                    if (IsCsvFile(it->path())) {
+                        files.push_back(it->path());
+                    }
+                    continue;
+                }
+                std::vector<std::string> relative;
+                for (const auto& part : it->path().lexically_relative(root)) {
+                    relative.push_back(part.string());
+                }
+                if (MatchSegments(pattern, 0, relative, 0)) {
+                    files.push_back(it->path());
+                }
+            }
+            if (ec) {
+                error = "Cannot list partitioned source " + Source + ": " + ec.message();
+            }
+            std::sort(files.begin(), files.end());
+            return files;
+        }
+
+        // Значения разделов из сегментов key=value ниже root; типы выводятся по всем файлам
+        std::vector<TPartitionFile> ResolvePartitions(const std::filesystem::path& root,
+                                                      const std::vector<std::filesystem::path>& files) const {
+            std::vector<std::vector<std::pair<std::string, std::string>>> raw(files.size());
+            std::map<std::string, TFieldTypeGuess> guesses;
+            for (size_t i = 0; i < files.size(); i++) {
+                const auto relative = files[i].lexically_relative(root);
+                const auto last = std::prev(relative.end());
+                for (auto part = relative.begin(); part != relative.end(); ++part) {
+                    const std::string segment = part->string();
+                    const size_t eq = segment.find('=');
+                    if (eq == std::string::npos || eq == 0) {
+                        continue;
+                    }
+                    std::string key = segment.substr(0, eq);
+                    std::string value = DecodeValue(std::string_view(segment).substr(eq + 1), part == last);
+                    guesses[key].Add(value);
+                    raw[i].emplace_back(std::move(key), std::move(value));
+                }
+            }
+
+            std::vector<TPartitionFile> result;
+            result.reserve(files.size());
+            for (size_t i = 0; i < files.size(); i++) {
+                TPartitionFile file{files[i], {}};
+                for (auto& [key, value] : raw[i]) {
+                    auto declared = Options.Schema.DeclaredTypes.find(key);
+                    const EFieldType type =
+                        declared != Options.Schema.DeclaredTypes.end() ? declared->second : guesses[key].Get();
+                    file.Partition[key] = ParseFieldOrRaw(value, type).first;
+                }
+                result.push_back(std::move(file));
+            }
+            return result;
+        }
+
+        bool Accepts(const DataRow& partition) const {
+            for (const auto& filter : Filters) {
+                auto it = partition.find(filter.Key);
+                if (it == partition.end() || !filter.Predicate(it->second)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+    public:
+        explicit TPartitionedCsvDataProvider(std::string source, TPartitionedCsvOptions options = {})
+            : Source(std::move(source))
+            , Options(std::move(options)) {
+            auto& registry = TMetricsRegistry::Global();
+            const std::string help = "Partition files read or skipped by partition filters.";
+            ReadCounter = &registry.GetCounter("report_builder_partition_files", help, {{"state", "read"}});
+            PrunedCounter = &registry.GetCounter("report_builder_partition_files", help, {{"state", "pruned"}});
+        }
+
+        // Фильтр по колонке раздела. Файлы, не прошедшие фильтр, не открываются;
+        // файлы без такой колонки тоже пропускаются. Без shareKey, однозначно
+        // задающего условие, поставщик не делится с другими отчетами.
+        TPartitionedCsvDataProvider& AddPartitionFilter(std::string key, std::function<bool(const DataValue&)> predicate,
+                                                        std::string description,
+                                                        std::optional<std::string> shareKey = std::nullopt) {
+            Filters.push_back({std::move(key), std::move(predicate), std::move(description), std::move(shareKey)});
+            return *this;
+        }
+
+        // Равенство колонки раздела значению. Строка с датой совпадает и с разделом-датой.
+        TPartitionedCsvDataProvider& WherePartition(const std::string& key, DataValue value) {
+            const std::string description = key + " = " + ValueToString(value);
+            auto text = GetStringView(value);
+            std::optional<DataValue> time;
+            if (auto parsed = text ? ParseTimestamp(*text) : std::nullopt) {
+                time = *parsed;
+            }
+            return AddPartitionFilter(
+                key,
+                [value = std::move(value), time](const DataValue& actual) {
+                    return CompareValues(actual, value) == 0 || (time && CompareValues(actual, *time) == 0);
+                },
+                description, description);
+        }
+
+        TOperationResult FetchData() override {
+            std::string error;
+            std::filesystem::path root;
+            auto listed = ListFiles(root, error);
+            if (!error.empty()) {
+                return TOperationResult::Error(error);
+            }
+            const auto files = ResolvePartitions(root, listed);
+            std::vector<const TPartitionFile*> selected;
+            for (const auto& file : files) {
+                if (Accepts(file.Partition)) {
+                    selected.push_back(&file);
+                }
+            }
+
+            // Каждый поток берет следующий файл; результаты лежат по номеру файла
+            struct TFileResult {
+                std::optional<TOperationResult> Result;
+                std::vector<std::pair<std::string, EFieldType>> Schema;
+            };
+            // Файлы берутся по порядку, поэтому начатые файлы - всегда префикс списка:
+            // когда в нем набралось Limit строк, остальные файлы можно не открывать
+            std::vector<TFileResult> results(selected.size());
+            std::atomic<size_t> next{0};
+            std::atomic<size_t> collected{0};
+            auto worker = [&] {
+                TCsvSchemaOptions schema = Options.Schema;
+                TDictionaryEncodingOptions noDictionary;
+                noDictionary.Enabled = false;
+                while (!Limit || collected.load() < Limit->Rows) {
+                    const size_t i = next++;
+                    if (i >= selected.size()) {
+                        break;
+                    }
+                    TCsvDataProvider provider(selected[i]->Path.string(), Options.Delimiter, noDictionary, schema);
+                    // Условие лимита может ссылаться на колонки разделов, которых нет в файле,
+                    // поэтому в файл передается только число строк и только без условия
+                    if (Limit && !Limit->Filter) {
+                        provider.PushDownLimit(TScanLimit{Limit->Rows, {}, {}});
+                    }
+                    try {
+                        auto result = provider.FetchData();
+                        for (auto& row : result.Data) {
+                            for (const auto& [key, value] : selected[i]->Partition) {
+                                row.insert_or_assign(key, value);
+                            }
+                        }
+                        if (Limit && Limit->Filter) {
+                            result.Data.erase(std::remove_if(result.Data.begin(), result.Data.end(),
+                                                             [&](const DataRow& row) { return !Limit->Accepts(row); }),
+                                              result.Data.end());
+                        }
+                        results[i].Result = std::move(result);
+                    } catch (const std::exception& e) {
+                        results[i].Result = TOperationResult::Error(e.what());
+                    }
+                    results[i].Schema = provider.GetSchema();
+                    collected += results[i].Result->Data.size();
+                }
+            };
+            const size_t threads = std::min(selected.size(),
+                                            Options.Threads ? Options.Threads
+                                                            : std::max<size_t>(1, std::thread::hardware_concurrency()));
+            std::vector<std::thread> pool;
+            for (size_t i = 1; i < threads; i++) {
+                pool.emplace_back(worker);
+            }
+            worker();
+            for (auto& thread : pool) {
+                thread.join();
+            }
+            FilesRead = std::min(next.load(), selected.size());
+            FilesPruned = files.size() - selected.size();
+            ReadCounter->Inc(FilesRead);
+            PrunedCounter->Inc(FilesPruned);
+
+            // Колонка, выведенная в одних файлах как int, а в других как double, везде становится double
+            std::set<std::string> doubles;
+            for (const auto& result : results) {
+                for (const auto& [name, type] : result.Schema) {
+                    if (type == EFieldType::Double) {
+                        doubles.insert(name);
+                    }
+                }
+            }
+
+            DataTable table;
+            for (size_t i = 0; i < selected.size() && results[i].Result; i++) {
+                auto& result = *results[i].Result;
+                if (!result.Success) {
+                    return TOperationResult::Error(selected[i]->Path.string() + ": " +
+                                                   result.ErrorMessage.value_or("read failed"));
+                }
+                for (auto& row : result.Data) {
+                    for (const auto& name : doubles) {
+                        auto it = row.find(name);
+                        if (auto integer = it != row.end() ? GetInteger(it->second) : std::nullopt) {
+                            it->second = static_cast<double>(*integer);
+                        }
+                    }
+                    table.push_back(std::move(row));
+                }
+            }
+            if (Limit && table.size() > Limit->Rows) {
+                table.erase(table.begin() + Limit->Rows, table.end());
+            }
+
+            DictionaryEncode(table, Options.Dictionary);
+            return TOperationResult::Ok(std::move(table));
+        }
+
+        // Условие лимита проверяется после добавления колонок разделов;
+        // чтение файлов прекращается, когда строк достаточно
+        bool PushDownLimit(TScanLimit limit) override {
+            Limit = std::move(limit);
+            return true;
+        }
+
+        // Число файлов, прочитанных и отсеченных при последнем FetchData
+        size_t GetFilesRead() const {
+            return FilesRead;
+        }
+
+        size_t GetFilesPruned() const {
+            return FilesPruned;
+        }
+
+        std::string GetSourceInfo() const override {
+            std::string info = "Partitioned CSV: " + Source;
+            for (size_t i = 0; i < Filters.size(); i++) {
+                info += (i == 0 ? " where " : " AND ") + Filters[i].Description;
+            }
+            return info + (Limit ? Limit->Describe() : "");
+        }
+
+        std::optional<std::string> GetShareKey() const override {
+            auto limit = Limit ? Limit->ShareKey() : std::optional<std::string>("");
+            if (!limit) {
+                return std::nullopt;
+            }
+            std::string key = "Partitioned CSV: " + Source + " [" +
+                              DescribeCsvOptions(Options.Delimiter, Options.Schema, Options.Dictionary) + "]";
+            for (const auto& filter : Filters) {
+                if (!filter.ShareKey) {
+                    return std::nullopt;
+                }
+                key += " AND " + *filter.ShareKey;
+            }
+            return key + *limit;
+        }
+    };
+} // namespace report_builder
+
+#endif
@@ -0,0 +1,206 @@
+#ifndef REPORT_BUILDER_QUERY_PLANNER_H
+#define REPORT_BUILDER_QUERY_PLANNER_H
+
+#include "report_builder/data_processors.h"
+
+namespace report_builder {
+    // Планировщик переставляет и сливает обработчики, не меняя результата отчета.
+    // Обработчики неизвестных типов считаются барьерами: через них ничего не переносится.
+    //
+    // Правила (применяются до неподвижной точки):
+    //   Sort, Filter        -> Filter, Sort        фильтр переносится раньше сортировки
+    //   Sort, Sort          -> Sort                std::sort неустойчива, первый порядок теряется
+    //   Sort, Aggregation   -> Aggregation         порядок не доходит до результата агрегации
+    //   Filter, Filter      -> Filter (a AND b)    один проход вместо двух
+    //   Filter, Aggregation -> Aggregation where   фильтр становится предусловием агрегации
+    //   Sort, Limit         -> Sort limit          top-K вместо полной сортировки
+    //   Filter, Limit       -> Filter limit        просмотр прекращается на limit-й строке
+    //   Limit, Limit        -> Limit               меньший из двух
+    // Сортировка и фильтр с лимитом выбирают строки, поэтому правила перестановки
+    // и слияния через них не действуют. Лимит в начале цепочки, за фильтрами,
+    // передается поставщику (PushDownLimit), как и выборка в самом начале (PushDownSample).
+    // Без сортировки агрегация видит строки в другом порядке: суммы по double могут
+    // отличаться в последних знаках, квантили t-digest - в пределах погрешности.
+    // Поэтому планировщик включается явно (TReportBuilder::EnableQueryPlanner).
+    class TQueryPlanner {
+    private:
+        using TProcessors = std::vector<std::unique_ptr<IDataProcessor>>;
+
+        static TFilterProcessor* AsFilter(const std::unique_ptr<IDataProcessor>& processor) {
+            return dynamic_cast<TFilterProcessor*>(processor.get());
+        }
+
+        static TSortProcessor* AsSort(const std::unique_ptr<IDataProcessor>& processor) {
+            return dynamic_cast<TSortProcessor*>(processor.get());
+        }
+
+        static TLimitProcessor* AsLimit(const std::unique_ptr<IDataProcessor>& processor) {
+            return dynamic_cast<TLimitProcessor*>(processor.get());
+        }
+
+        static size_t MinLimit(const std::optional<size_t>& current, size_t limit) {
+            return current ? std::min(*current, limit) : limit;
+        }
+
+        static TAggregatingProcessor* AsAggregation(const std::unique_ptr<IDataProcessor>& processor) {
+            return dynamic_cast<TAggregatingProcessor*>(processor.get());
+        }
+
+        static std::string ConditionOf(const TFilterProcessor& filter) {
+            return filter.GetCondition().empty() ? "<predicate>" : filter.GetCondition();
+        }
+
+        // Применяет первое подходящее правило к паре (i, i + 1)
+        static bool RewritePair(TProcessors& processors, size_t i, std::vector<std::string>& rewrites) {
+            auto& first = processors[i];
+            auto& second = processors[i + 1];
+
+            if (auto* limit = AsLimit(second)) {
+                const std::string description = first->GetDescription();
+                if (auto* sort = AsSort(first)) {
+                    sort->SetLimit(MinLimit(sort->GetLimit(), limit->GetLimit()));
+                } else if (auto* filter = AsFilter(first)) {
+                    filter->SetLimit(MinLimit(filter->GetLimit(), limit->GetLimit()));
+                } else if (auto* previous = AsLimit(first)) {
+                    first = std::make_unique<TLimitProcessor>(std::min(previous->GetLimit(), limit->GetLimit()));
+                } else {
+                    return false;
+                }
+                rewrites.push_back("fused " + second->GetDescription() + " into " + description);
+                processors.erase(processors.begin() + i + 1);
+                return true;
+            }
+
+            auto* sort = AsSort(first);
+            if (sort && sort->GetLimit()) {
+                return false;
+            }
+            auto* filter = AsFilter(first);
+            if (filter && filter->GetLimit()) {
+                return false;
+            }
+
+            if (sort && AsFilter(second) && !AsFilter(second)->GetLimit()) {
+                rewrites.push_back("pushed " + second->GetDescription() + " below " + first->GetDescription());
+                std::swap(first, second);
+                return true;
+            }
+
+            if (sort && (AsSort(second) || AsAggregation(second))) {
+                rewrites.push_back("dropped " + first->GetDescription() + ": order is discarded by " +
+                                   second->GetDescription());
+                processors.erase(processors.begin() + i);
+                return true;
+            }
+
+            if (auto* nextFilter = filter ? AsFilter(second) : nullptr) {
+                rewrites.push_back("fused " + first->GetDescription() + " and " + second->GetDescription());
+                auto fused = std::make_unique<TFilterProcessor>(
+                    [a = filter->GetPredicate(), b = nextFilter->GetPredicate()](const DataRow& row) {
+                        return a(row) && b(row);
+                    },
+                    ConditionOf(*filter) + " AND " + ConditionOf(*nextFilter));
+                fused->SetLimit(nextFilter->GetLimit());
+                if (filter->GetConditionKey() && nextFilter->GetConditionKey()) {
+                    fused->SetConditionKey(*filter->GetConditionKey() + " AND " + *nextFilter->GetConditionKey());
+                }
+                second = std::move(fused);
+                processors.erase(processors.begin() + i);
+                return true;
+            }
+
+            if (auto* aggregation = filter ? AsAggregation(second) : nullptr) {
+                rewrites.push_back("fused " + first->GetDescription() + " into " + second->GetDescription());
+                aggregation->AddPreFilter(filter->GetPredicate(), ConditionOf(*filter), filter->GetConditionKey());
+                processors.erase(processors.begin() + i);
+                return true;
+            }
+
+            return false;
+        }
+
+    public:
+        // Оптимизирует цепочку обработчиков на месте
+        static TPlanInfo Optimize(TProcessors& processors) {
+            TPlanInfo info;
+            for (const auto& processor : processors) {
+                info.Original.push_back(processor->GetDescription());
+            }
+
+            bool changed = true;
+            while (changed) {
+                changed = false;
+                for (size_t i = 0; i + 1 < processors.size() && !changed; i++) {
+                    changed = RewritePair(processors, i, info.Rewrites);
+                }
+            }
+            return info;
+        }
+
+        // Выборка в начале цепочки переходит в поставщика, который отбирает строки
+        // до разбора; обработчик выборки при этом убирается
+        static void PushDownSample(IDataProvider& provider, TProcessors& processors, TPlanInfo& info) {
+            auto* sample = processors.empty() ? nullptr : dynamic_cast<TSampleProcessor*>(processors.front().get());
+            if (!sample || sample->GetOptions().Validate()) {
+                return;
+            }
+            const std::string source = provider.GetSourceInfo();
+            if (provider.PushDownSample(sample->GetOptions())) {
+                info.Rewrites.push_back("pushed " + sample->GetDescription() + " into " + source);
+                processors.erase(processors.begin());
+            }
+        }
+
+        // Передает поставщику лимит, перед которым стоят только фильтры: поставщик
+        // может остановиться, как только наберет нужное число подходящих строк
+        static void PushDownLimit(IDataProvider& provider, const TProcessors& processors, TPlanInfo& info) {
+            std::vector<TRowPredicate> filters;
+            std::string condition;
+            std::optional<std::string> conditionKey = std::string();
+            std::optional<size_t> limit;
+            for (const auto& processor : processors) {
+                if (auto* filter = AsFilter(processor)) {
+                    filters.push_back(filter->GetPredicate());
+                    condition += (condition.empty() ? "" : " AND ") + ConditionOf(*filter);
+                    if (conditionKey && filter->GetConditionKey()) {
+                        *conditionKey += (conditionKey->empty() ? "" : " AND ") + *filter->GetConditionKey();
+                    } else {
+                        conditionKey.reset();
+                    }
+                    limit = filter->GetLimit();
+                } else if (auto* limitProcessor = AsLimit(processor)) {
+                    limit = limitProcessor->GetLimit();
+                }
+                if (limit || !(AsFilter(processor) || AsLimit(processor))) {
+                    break;
+                }
+            }
+            if (!limit) {
+                return;
+            }
+
+            TScanLimit scan{*limit, {}, condition};
+            if (!filters.empty()) {
+                scan.Filter = [filters](const DataRow& row) {
+                    return std::all_of(filters.begin(), filters.end(), [&](const TRowPredicate& filter) { return filter(row); });
+                };
+                scan.ConditionKey = conditionKey;
+            }
+            const std::string source = provider.GetSourceInfo();
+            if (provider.PushDownLimit(std::move(scan))) {
+                info.Rewrites.push_back("pushed limit " + std::to_string(*limit) + " into " + source);
+            }
+        }
+
+        // Полный план отчета: перестановки обработчиков, затем передача выборки
+        // и лимита поставщику. Общий для TReportBuilder и IReportFactory.
+        static TPlanInfo Plan(IDataProvider& provider, TProcessors& processors) {
+            TPlanInfo info = Optimize(processors);
+            PushDownSample(provider, processors, info);
+            PushDownLimit(provider, processors, info);
+            return info;
+        }
+    };
+} // namespace report_builder
+
+#endif
@@ -3,11 +3,21 @@
 
 #include <memory>
 
+#include "report_builder/batch_execution.h"
+#include "report_builder/compact_table.h"
 #include "report_builder/data_processors.h"
 #include "report_builder/data_providers.h"
 #include "report_builder/export_strategies.h"
+#include "report_builder/expressions.h"
 #include "report_builder/formatters.h"
 #include "report_builder/interfaces.h"
+#include "report_builder/join_processor.h"
+#include "report_builder/partitioned_provider.h"
+#include "report_builder/query_planner.h"
+#include "report_builder/shared_pipelines.h"
+#include "report_builder/static_pipeline.h"
+#include "report_builder/time_buckets.h"
+#include "report_builder/window_processor.h"
 
 namespace report_builder {
 
@@ -17,6 +27,13 @@ namespace report_builder {
         std::vector<std::unique_ptr<IDataProcessor>> Processors;
         std::unique_ptr<IFormatter> Formatter;
         std::unique_ptr<IExportStrategy> Exporter;
+        std::vector<std::pair<std::unique_ptr<IFormatter>, std::unique_ptr<IExportStrategy>>> Outputs;
+        bool Instrumentation = false;
+        bool StreamingOutput = false;
+        bool Planning = false;
+        std::string ReportType = "custom";
+        TMemoryBudget* MemoryBudget = nullptr;
+        TAdmissionOptions Admission;
 
     public:
         TReportBuilder() = default;
@@ -41,13 +58,77 @@ namespace report_builder {
             return *this;
         }
 
+        // Еще один выход отчета с собственным форматом и способом экспорта.
+        // Если SetFormatter/SetExportStrategy не вызывались, основным становится первый выход.
+        TReportBuilder& AddOutput(std::unique_ptr<IFormatter> fmt, std::unique_ptr<IExportStrategy> exp) {
+            Outputs.emplace_back(std::move(fmt), std::move(exp));
+            return *this;
+        }
+
+        TReportBuilder& SetReportType(std::string reportType) {
+            ReportType = std::move(reportType);
+            return *this;
+        }
+
+        TReportBuilder& EnableInstrumentation(bool enabled = true) {
+            Instrumentation = enabled;
+            return *this;
+        }
+
+        // Потоковый вывод последнего обработчика (см. TReport::EnableStreamingOutput)
+        TReportBuilder& EnableStreamingOutput(bool enabled = true) {
+            StreamingOutput = enabled;
+            return *this;
+        }
+
+        // Учет памяти отчета в общем бюджете (см. TReport::SetMemoryBudget)
+        TReportBuilder& SetMemoryBudget(TMemoryBudget& budget, TAdmissionOptions options = {}) {
+            MemoryBudget = &budget;
+            Admission = options;
+            return *this;
+        }
+
+        // Перестановка и слияние обработчиков планировщиком. Выключено по умолчанию:
+        // планировщик убирает сортировку перед агрегацией, а от порядка строк
+        // зависят округление сумм по double и квантили t-digest
+        TReportBuilder& EnableQueryPlanner(bool enabled = true) {
+            Planning = enabled;
+            return *this;
+        }
+
         std::unique_ptr<TReport> Build() {
+            if (!Formatter && !Exporter && !Outputs.empty()) {
+                Formatter = std::move(Outputs.front().first);
+                Exporter = std::move(Outputs.front().second);
+                Outputs.erase(Outputs.begin());
+            }
             if (!DataSource || !Formatter || !Exporter) {
                 throw std::runtime_error("Incomplete report configuration");
             }
 
-            return std::make_unique<TReport>(std::move(DataSource), std::move(Processors),
-                                             std::move(Formatter), std::move(Exporter));
+            std::optional<TPlanInfo> planInfo;
+            if (Planning) {
+                planInfo = TQueryPlanner::Plan(*DataSource, Processors);
+            }
+            auto report = std::make_unique<TReport>(std::move(DataSource), std::move(Processors),
+                                                    std::move(Formatter), std::move(Exporter));
+            report->EnableInstrumentation(Instrumentation);
+            report->EnableStreamingOutput(StreamingOutput);
+            report->SetReportType(ReportType);
+            if (MemoryBudget) {
+                report->SetMemoryBudget(*MemoryBudget, Admission);
+            }
+            for (auto& [formatter, exporter] : Outputs) {
+                if (!formatter || !exporter) {
+                    throw std::runtime_error("Incomplete report output");
+                }
+                report->AddOutput(std::move(formatter), std::move(exporter));
+            }
+            Outputs.clear();
+            if (planInfo) {
+                report->SetPlanInfo(std::move(*planInfo));
+            }
+            return report;
         }
     };
 
@@ -6,10 +6,14 @@
 #include "report_builder/export_strategies.h"
 #include "report_builder/formatters.h"
 #include "report_builder/interfaces.h"
+#include "report_builder/query_planner.h"
 
 namespace report_builder {
 
     class IReportFactory {
+    private:
+        bool Planning = false;
+
     public:
         virtual ~IReportFactory() = default;
         virtual std::unique_ptr<IDataProvider> CreateDataProvider() = 0;
@@ -17,9 +21,30 @@ namespace report_builder {
         virtual std::unique_ptr<IFormatter> CreateFormatter() = 0;
         virtual std::unique_ptr<IExportStrategy> CreateExportStrategy() = 0;
 
+        // Тип отчета для метрик
+        virtual std::string GetReportType() const {
+            return "custom";
+        }
+
+        // Планировщик для создаваемых отчетов (см. TReportBuilder::EnableQueryPlanner)
+        void EnableQueryPlanner(bool enabled = true) {
+            Planning = enabled;
+        }
+
         std::unique_ptr<TReport> CreateReport() {
-            return std::make_unique<TReport>(CreateDataProvider(), CreateProcessors(),
-                                             CreateFormatter(), CreateExportStrategy());
+            auto provider = CreateDataProvider();
+            auto processors = CreateProcessors();
+            std::optional<TPlanInfo> planInfo;
+            if (Planning) {
+                planInfo = TQueryPlanner::Plan(*provider, processors);
+            }
+            auto report = std::make_unique<TReport>(std::move(provider), std::move(processors),
+                                                    CreateFormatter(), CreateExportStrategy());
+            report->SetReportType(GetReportType());
+            if (planInfo) {
+                report->SetPlanInfo(std::move(*planInfo));
+            }
+            return report;
         }
     };
 
@@ -28,10 +53,10 @@ namespace report_builder {
     public:
         std::unique_ptr<IDataProvider> CreateDataProvider() override {
             DataTable sampleData = {
-                {{"date", "2024-01-01"}, {"revenue", 15000}, {"expenses", 8000}},
-                {{"date", "2024-01-02"}, {"revenue", 18000}, {"expenses", 8500}},
-                {{"date", "2024-01-03"}, {"revenue", 12000}, {"expenses", 7000}},
-                {{"date", "2024-01-04"}, {"revenue", 22000}, {"expenses", 9500}},
+                {{"date", TTimestamp::FromDate(2024, 1, 1)}, {"revenue", 15000}, {"expenses", 8000}},
+                {{"date", TTimestamp::FromDate(2024, 1, 2)}, {"revenue", 18000}, {"expenses", 8500}},
+                {{"date", TTimestamp::FromDate(2024, 1, 3)}, {"revenue", 12000}, {"expenses", 7000}},
+                {{"date", TTimestamp::FromDate(2024, 1, 4)}, {"revenue", 22000}, {"expenses", 9500}},
             };
             return std::make_unique<TInMemoryDataProvider>(sampleData);
         }
@@ -56,6 +81,10 @@ namespace report_builder {
         std::unique_ptr<IExportStrategy> CreateExportStrategy() override {
             return std::make_unique<TFileExportStrategy>("reports/finance/");
         }
+
+        std::string GetReportType() const override {
+            return "finance";
+        }
     };
 
     // Фабрика отчетов по продажам
@@ -93,6 +122,10 @@ namespace report_builder {
         std::unique_ptr<IExportStrategy> CreateExportStrategy() override {
             return std::make_unique<TEmailExportStrategy>("sales@company.com");
         }
+
+        std::string GetReportType() const override {
+            return "sales";
+        }
     };
 } // namespace report_builder
 
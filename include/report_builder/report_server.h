@@ -0,0 +1,798 @@
+#ifndef REPORT_BUILDER_REPORT_SERVER_H
+#define REPORT_BUILDER_REPORT_SERVER_H
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <set>
+
+#include "report_builder/compact_table.h"
+#include "report_builder/compression.h"
+#include "report_builder/report_builder.h"
+#include "report_builder/report_factories.h"
+
+#ifdef REPORT_BUILDER_HAVE_SOCKETS
+    #include <sys/time.h>
+    #include <sys/un.h>
+#endif
+
+namespace report_builder {
+    // Ответ сервера отчетов: текст отчета или сообщение об ошибке
+    struct TServerResponse {
+        bool Success = false;
+        std::string Payload;
+    };
+
+    // Разобранные наборы данных, общие для всех запросов. Таблицы хранятся в
+    // компактном виде и неизменяемы, поэтому их можно читать из нескольких
+    // потоков без блокировок. Суммарная память наборов ограничена: при
+    // превышении вытесняются давно не использованные наборы (запросы,
+    // которые их уже читают, держат свою копию указателя).
+    class TDatasetCache {
+    private:
+        struct TEntry {
+            std::shared_ptr<const TCompactTable> Table;
+            std::filesystem::file_time_type Version;
+            uint64_t LastUsed = 0;
+        };
+
+        std::mutex Mutex;
+        std::map<std::string, TEntry> Entries;
+        size_t MemoryLimit;
+        size_t MemoryBytes = 0;
+        uint64_t Clock = 0;
+        TCounter* Hits;
+        TCounter* Misses;
+        TCounter* Evictions;
+
+        // Вытесняет наборы, кроме keep, пока память превышает лимит. Под Mutex.
+        void Evict(const std::string& keep) {
+            while (MemoryBytes > MemoryLimit) {
+                auto victim = Entries.end();
+                for (auto it = Entries.begin(); it != Entries.end(); ++it) {
+                    if (it->first != keep && (victim == Entries.end() || it->second.LastUsed < victim->second.LastUsed)) {
+                        victim = it;
+                    }
+                }
+                if (victim == Entries.end()) {
+                    return;
+                }
+                MemoryBytes -= victim->second.Table->GetMemoryBytes();
+                Entries.erase(victim);
+                Evictions->Inc();
+            }
+        }
+
+    public:
+        static constexpr size_t DefaultMemoryLimit = size_t(1) << 30;
+
+        explicit TDatasetCache(TMetricsRegistry& registry = TMetricsRegistry::Global(),
+                               size_t memoryLimit = DefaultMemoryLimit)
+            : MemoryLimit(memoryLimit)
+            , Hits(&registry.GetCounter("report_builder_server_dataset_hits", "Requests served from resident datasets."))
+            , Misses(&registry.GetCounter("report_builder_server_dataset_loads", "Datasets loaded by the report server."))
+            , Evictions(&registry.GetCounter("report_builder_server_dataset_evictions",
+                                             "Datasets evicted from the report server to stay within its memory limit.")) {
+        }
+
+        // Набор по ключу; загружается заново, если его версия изменилась.
+        // Два одновременных промаха по одному ключу могут загрузить набор дважды.
+        std::shared_ptr<const TCompactTable> Get(const std::string& key, std::filesystem::file_time_type version,
+                                             const std::function<TOperationResult()>& load, std::string& error) {
+            {
+                std::lock_guard<std::mutex> lock(Mutex);
+                auto it = Entries.find(key);
+                if (it != Entries.end() && it->second.Version == version) {
+                    it->second.LastUsed = ++Clock;
+                    Hits->Inc();
+                    return it->second.Table;
+                }
+            }
+
+            Misses->Inc();
+            auto result = load();
+            if (!result.Success) {
+                error = result.ErrorMessage.value_or("Cannot load " + key);
+                return nullptr;
+            }
+            auto table = std::make_shared<const TCompactTable>(TCompactTable::FromRows(result.Data));
+            std::lock_guard<std::mutex> lock(Mutex);
+            auto& entry = Entries[key];
+            if (entry.Table) {
+                MemoryBytes -= entry.Table->GetMemoryBytes();
+            }
+            entry = {table, version, ++Clock};
+            MemoryBytes += table->GetMemoryBytes();
+            Evict(key);
+            return table;
+        }
+
+        // CSV файл; перечитывается после изменения файла
+        std::shared_ptr<const TCompactTable> GetCsv(const std::string& path, std::string& error) {
+            std::error_code ec;
+            const auto modified = std::filesystem::last_write_time(path, ec);
+            if (ec) {
+                error = "Cannot open file: " + path;
+                return nullptr;
+            }
+            return Get("csv:" + path, modified, [&] { return TCsvDataProvider(path).FetchData(); }, error);
+        }
+
+        size_t GetDatasetCount() {
+            std::lock_guard<std::mutex> lock(Mutex);
+            return Entries.size();
+        }
+
+        // Память всех резидентных наборов
+        size_t GetMemoryBytes() {
+            std::lock_guard<std::mutex> lock(Mutex);
+            return MemoryBytes;
+        }
+
+        // Лимит памяти наборов; только что загруженный набор не вытесняется,
+        // даже если он один больше лимита
+        void SetMemoryLimit(size_t bytes) {
+            std::lock_guard<std::mutex> lock(Mutex);
+            MemoryLimit = bytes;
+            Evict("");
+        }
+
+        size_t GetMemoryLimit() {
+            std::lock_guard<std::mutex> lock(Mutex);
+            return MemoryLimit;
+        }
+
+        uint64_t GetHitCount() const {
+            return Hits->Get();
+        }
+
+        uint64_t GetLoadCount() const {
+            return Misses->Get();
+        }
+
+        uint64_t GetEvictionCount() const {
+            return Evictions->Get();
+        }
+
+        void Clear() {
+            std::lock_guard<std::mutex> lock(Mutex);
+            Entries.clear();
+            MemoryBytes = 0;
+        }
+    };
+
+    // Сервер отчетов: держит разобранные источники в памяти и выполняет запросы.
+    // Запрос - одна строка:
+    //   factory <name> [| format <html|text|markdown>]
+    //   source <csv path> [| stage]... [| format <html|text|markdown>]
+    //   stats
+    // Стадии:
+    //   where <field> <op> <value>     op: > >= < <= == !=, строки и даты в кавычках
+    //   compute <name> = <expression>  см. expressions.h
+    //   sort <field> [asc|desc]
+    //   aggregate <sum|avg|count|approx_distinct|p<percent>> <field>
+    //   groupby <key> <sum|avg|count> <field>
+    //   bucket <field> <hour|day|week|month> [as <name>]
+    //   limit <rows>
+    //   sample bernoulli <fraction> | reservoir <rows> | stratified <rows> <field> [seed <n>]
+    //
+    // Handle можно вызывать напрямую; Start обслуживает запросы на Unix-сокете.
+    // Протокол: запрос заканчивается '\n', ответ - строка "OK <n>" или "ERROR <n>"
+    // и n байт текста. В одном соединении можно отправить несколько запросов.
+    class TReportServer {
+    private:
+        using TFactoryMaker = std::function<std::unique_ptr<IReportFactory>()>;
+
+        std::map<std::string, TFactoryMaker> Factories;
+        TDatasetCache Datasets;
+        TMemoryBudget* MemoryBudget = &TMemoryBudget::Global();
+        TAdmissionOptions Admission;
+
+        static std::string Trim(const std::string& text) {
+            const size_t begin = text.find_first_not_of(" \t\r\n");
+            if (begin == std::string::npos) {
+                return "";
+            }
+            return text.substr(begin, text.find_last_not_of(" \t\r\n") - begin + 1);
+        }
+
+        static std::vector<std::string> Split(const std::string& text, char separator) {
+            std::vector<std::string> parts;
+            std::stringstream ss(text);
+            std::string part;
+            while (std::getline(ss, part, separator)) {
+                parts.push_back(Trim(part));
+            }
+            return parts;
+        }
+
+        static std::unique_ptr<IFormatter> MakeFormatter(const std::string& name) {
+            if (name == "html") {
+                return std::make_unique<THtmlFormatter>();
+            }
+            if (name == "text") {
+                return std::make_unique<TPlainTextFormatter>();
+            }
+            if (name == "markdown") {
+                return std::make_unique<TMarkdownFormatter>();
+            }
+            return nullptr;
+        }
+
+        // Разобранное условие "field op value"
+        struct TCondition {
+            std::string Field;
+            bool Accepts[3] = {}; // значение условия для результата сравнения -1, 0, 1
+            bool Quoted = false;  // литерал в кавычках: строка или дата
+            std::string Literal;
+            std::optional<TTimestamp> Time; // литерал-дата разбирается один раз
+            double Number = 0.0;
+
+            bool Matches(int cmp) const {
+                return Accepts[cmp < 0 ? 0 : cmp == 0 ? 1 : 2];
+            }
+
+            // Ячейки-даты сравниваются с литералом-датой как числа, строки - как строки
+            bool MatchesText(std::optional<TTimestamp> cell, std::optional<std::string_view> text) const {
+                if (cell) {
+                    return Time && Matches(*cell < *Time ? -1 : *cell > *Time ? 1 : 0);
+                }
+                return text && Matches(text->compare(Literal));
+            }
+
+            bool MatchesNumber(std::optional<double> x) const {
+                return x && Matches(*x < Number ? -1 : *x > Number ? 1 : 0);
+            }
+        };
+
+        // nullopt и текст в error при ошибке
+        static std::optional<TCondition> ParseCondition(const std::string& text, std::string& error) {
+            std::istringstream in(text);
+            TCondition condition;
+            std::string op, value;
+            in >> condition.Field >> op;
+            std::getline(in, value);
+            value = Trim(value);
+            static const std::set<std::string> ops = {">", ">=", "<", "<=", "==", "!="};
+            if (condition.Field.empty() || !ops.count(op) || value.empty()) {
+                error = "Bad condition: " + text;
+                return std::nullopt;
+            }
+            condition.Accepts[0] = op == "<" || op == "<=" || op == "!=";
+            condition.Accepts[1] = op == "<=" || op == ">=" || op == "==";
+            condition.Accepts[2] = op == ">" || op == ">=" || op == "!=";
+
+            if (value.size() >= 2 && (value.front() == '\'' || value.front() == '"') && value.back() == value.front()) {
+                condition.Quoted = true;
+                condition.Literal = value.substr(1, value.size() - 2);
+                condition.Time = ParseTimestamp(condition.Literal);
+                return condition;
+            }
+            char* end = nullptr;
+            condition.Number = std::strtod(value.c_str(), &end);
+            if (end != value.c_str() + value.size()) {
+                error = "Bad value in condition: " + text;
+                return std::nullopt;
+            }
+            return condition;
+        }
+
+        // Условие над строкой для стадии where; пустая функция и текст в error при ошибке
+        static TRowPredicate MakeCondition(const std::string& text, std::string& error) {
+            auto condition = ParseCondition(text, error);
+            if (!condition) {
+                return {};
+            }
+            return [condition = std::move(*condition)](const DataRow& row) {
+                auto it = row.find(condition.Field);
+                if (it == row.end()) {
+                    return false;
+                }
+                if (condition.Quoted) {
+                    const auto* time = std::get_if<TTimestamp>(&it->second);
+                    return condition.MatchesText(time ? std::optional<TTimestamp>(*time) : std::nullopt,
+                                                 GetStringView(it->second));
+                }
+                return condition.MatchesNumber(GetNumber(it->second));
+            };
+        }
+
+        // То же условие над ячейками резидентной таблицы: строка не собирается в DataRow
+        static TCompactRowPredicate MakeScanCondition(const std::string& text, const TCompactTable& table,
+                                                      std::string& error) {
+            auto condition = ParseCondition(text, error);
+            if (!condition) {
+                return {};
+            }
+            const auto column = table.FindColumn(condition->Field);
+            if (!column) {
+                return [](const TCompactTable&, size_t) { return false; };
+            }
+            return [condition = std::move(*condition), column = *column](const TCompactTable& table, size_t row) {
+                const auto& cell = table.At(row, column);
+                if (condition.Quoted) {
+                    return condition.MatchesText(cell.GetType() == ECompactType::Timestamp
+                                                     ? std::optional<TTimestamp>(cell.AsTimestamp())
+                                                     : std::nullopt,
+                                                 table.GetString(row, column));
+                }
+                return condition.MatchesNumber(cell.GetNumber());
+            };
+        }
+
+        static bool IsExactAggregate(const std::string& op) {
+            return op == "sum" || op == "avg" || op == "count";
+        }
+
+        // Добавляет стадию конвейера; false и текст в error при ошибке
+        static bool AddStage(const std::string& stage, TReportBuilder& builder, std::unique_ptr<IFormatter>& formatter,
+                             std::string& error) {
+            std::istringstream in(stage);
+            std::string verb;
+            in >> verb;
+            std::string rest;
+            std::getline(in, rest);
+            rest = Trim(rest);
+            std::istringstream args(rest);
+
+            if (verb == "where") {
+                auto condition = MakeCondition(rest, error);
+                if (!condition) {
+                    return false;
+                }
+                auto filter = std::make_unique<TFilterProcessor>(std::move(condition), rest);
+                // Условие полностью задано текстом стадии
+                filter->SetConditionKey(rest);
+                builder.AddProcessor(std::move(filter));
+            } else if (verb == "compute") {
+                const size_t eq = rest.find('=');
+                if (eq == std::string::npos) {
+                    error = "Bad compute stage: " + stage;
+                    return false;
+                }
+                auto processor = std::make_unique<TComputedColumnsProcessor>(
+                    std::vector<std::pair<std::string, std::string>>{{Trim(rest.substr(0, eq)), Trim(rest.substr(eq + 1))}});
+                if (!processor->GetCompileError().empty()) {
+                    error = processor->GetCompileError();
+                    return false;
+                }
+                builder.AddProcessor(std::move(processor));
+            } else if (verb == "sort") {
+                std::string field, order = "asc";
+                args >> field >> order;
+                if (field.empty() || (order != "asc" && order != "desc")) {
+                    error = "Bad sort stage: " + stage;
+                    return false;
+                }
+                builder.AddProcessor(std::make_unique<TSortProcessor>(field, order == "asc"));
+            } else if (verb == "aggregate") {
+                std::string op, field;
+                args >> op >> field;
+                if (field.empty() || !(IsExactAggregate(op) || IsApproximateOperation(op))) {
+                    error = "Bad aggregate stage: " + stage;
+                    return false;
+                }
+                builder.AddProcessor(std::make_unique<TAggregationProcessor>(field, op));
+            } else if (verb == "groupby") {
+                std::string key, op, field;
+                args >> key >> op >> field;
+                if (field.empty() || !IsExactAggregate(op)) {
+                    error = "Bad groupby stage: " + stage;
+                    return false;
+                }
+                builder.AddProcessor(std::make_unique<TGroupByProcessor>(
+                    std::vector<std::string>{key}, std::vector<std::pair<std::string, std::string>>{{field, op}}));
+            } else if (verb == "bucket") {
+                std::string field, unit, as, output;
+                args >> field >> unit;
+                auto bucket = ParseTimeBucket(unit);
+                if (field.empty() || !bucket || ((args >> as) && (as != "as" || !(args >> output)))) {
+                    error = "Bad bucket stage: " + stage;
+                    return false;
+                }
+                builder.AddProcessor(std::make_unique<TTimeBucketProcessor>(field, *bucket, output));
+            } else if (verb == "limit") {
+                long long rows = -1;
+                args >> rows;
+                if (rows < 0) {
+                    error = "Bad limit stage: " + stage;
+                    return false;
+                }
+                builder.AddProcessor(std::make_unique<TLimitProcessor>(static_cast<size_t>(rows)));
+            } else if (verb == "sample") {
+                std::string mode, word;
+                TSampleOptions options;
+                options.Fraction = 0.0;
+                options.Rows = 0;
+                args >> mode;
+                if (mode == "bernoulli") {
+                    options.Mode = ESampleMode::Bernoulli;
+                    args >> options.Fraction;
+                } else if (mode == "reservoir" || mode == "stratified") {
+                    options.Mode = mode == "reservoir" ? ESampleMode::Reservoir : ESampleMode::Stratified;
+                    args >> options.Rows;
+                    if (mode == "stratified") {
+                        args >> options.StratifyBy;
+                    }
+                } else {
+                    error = "Bad sample stage: " + stage;
+                    return false;
+                }
+                if (args >> word && (word != "seed" || !(args >> options.Seed))) {
+                    error = "Bad sample stage: " + stage;
+                    return false;
+                }
+                if (auto invalid = options.Validate()) {
+                    error = *invalid;
+                    return false;
+                }
+                builder.AddProcessor(std::make_unique<TSampleProcessor>(options));
+            } else if (verb == "format") {
+                formatter = MakeFormatter(rest);
+                if (!formatter) {
+                    error = "Unknown format: " + rest;
+                    return false;
+                }
+            } else {
+                error = "Unknown stage: " + stage;
+                return false;
+            }
+            return true;
+        }
+
+    public:
+        TReportServer() {
+            RegisterFactory("finance", [] { return std::make_unique<TFinanceReportFactory>(); });
+            RegisterFactory("sales", [] { return std::make_unique<TSalesReportFactory>(); });
+        }
+
+        // Регистрировать фабрики нужно до Start
+        void RegisterFactory(const std::string& name, TFactoryMaker maker) {
+            Factories[name] = std::move(maker);
+        }
+
+        // Бюджет, в котором резервируют память отчеты всех запросов (по умолчанию глобальный)
+        void SetMemoryBudget(TMemoryBudget& budget, TAdmissionOptions options = {}) {
+            MemoryBudget = &budget;
+            Admission = options;
+        }
+
+        TDatasetCache& GetDatasets() {
+            return Datasets;
+        }
+
+        // Выполняет один запрос; потокобезопасно
+        TServerResponse Handle(const std::string& request) {
+            const auto segments = Split(request, '|');
+            if (segments.empty() || segments[0].empty()) {
+                return {false, "Empty request"};
+            }
+
+            std::istringstream head(segments[0]);
+            std::string verb, target;
+            head >> verb;
+            std::getline(head, target);
+            target = Trim(target);
+
+            if (verb == "stats" && segments.size() == 1) {
+                std::ostringstream out;
+                out << "datasets: " << Datasets.GetDatasetCount() << "\n"
+                    << "memory_bytes: " << Datasets.GetMemoryBytes() << "\n"
+                    << "hits: " << Datasets.GetHitCount() << "\n"
+                    << "loads: " << Datasets.GetLoadCount() << "\n"
+                    << "evictions: " << Datasets.GetEvictionCount() << "\n"
+                    << "reserved_bytes: " << MemoryBudget->GetUsedBytes() << "\n"
+                    << "peak_reserved_bytes: " << MemoryBudget->GetPeakBytes() << "\n"
+                    << "memory_limit_bytes: " << MemoryBudget->GetLimit() << "\n";
+                return {true, out.str()};
+            }
+
+            TReportBuilder builder;
+            std::unique_ptr<IFormatter> formatter;
+            std::shared_ptr<const TCompactTable> table;
+            std::string sourceInfo;
+            std::string error;
+
+            if (verb == "factory") {
+                auto maker = Factories.find(target);
+                if (maker == Factories.end()) {
+                    return {false, "Unknown factory: " + target};
+                }
+                auto factory = maker->second();
+                table = Datasets.Get("factory:" + target, {}, [&] { return factory->CreateDataProvider()->FetchData(); },
+                                     error);
+                sourceInfo = "Resident dataset of factory " + target;
+                for (auto& processor : factory->CreateProcessors()) {
+                    builder.AddProcessor(std::move(processor));
+                }
+                formatter = factory->CreateFormatter();
+                builder.SetReportType(factory->GetReportType());
+            } else if (verb == "source") {
+                table = Datasets.GetCsv(target, error);
+                sourceInfo = "Resident CSV file: " + target;
+                builder.SetReportType("server");
+            } else {
+                return {false, "Unknown request: " + segments[0]};
+            }
+            if (!table) {
+                return {false, error};
+            }
+
+            // Первое условие над исходной таблицей проверяется при чтении строк из кэша
+            size_t firstStage = 1;
+            TCompactRowPredicate scanFilter;
+            if (verb == "source" && segments.size() > 1 && segments[1].rfind("where ", 0) == 0) {
+                const std::string condition = Trim(segments[1].substr(6));
+                scanFilter = MakeScanCondition(condition, *table, error);
+                if (!scanFilter) {
+                    return {false, error};
+                }
+                sourceInfo += " where " + condition;
+                firstStage = 2;
+            }
+            for (size_t i = firstStage; i < segments.size(); i++) {
+                if (!AddStage(segments[i], builder, formatter, error)) {
+                    return {false, error};
+                }
+            }
+
+            std::string output;
+            auto report = builder.SetDataSource(std::make_unique<TCompactDataProvider>(table, sourceInfo, std::move(scanFilter)))
+                              .SetFormatter(formatter ? std::move(formatter) : std::make_unique<TPlainTextFormatter>())
+                              .SetExportStrategy(std::make_unique<TStringExportStrategy>(&output))
+                              .SetMemoryBudget(*MemoryBudget, Admission)
+                              .Build();
+            auto result = report->Generate();
+            if (!result.Success) {
+                return {false, result.ErrorMessage.value_or("Report failed")};
+            }
+            return {true, std::move(output)};
+        }
+
+#ifdef REPORT_BUILDER_HAVE_SOCKETS
+    private:
+        std::string SocketPath;
+        int ListenFd = -1;
+        std::atomic<bool> Running{false};
+        std::thread Acceptor;
+        std::vector<std::thread> Workers;
+        std::unique_ptr<TBoundedQueue<int>> Clients;
+        std::mutex ClientsMutex;
+        std::set<int> ActiveClients;
+        std::chrono::milliseconds IdleTimeout{30000};
+
+        static bool SendAll(int fd, const std::string& data) {
+    #ifdef MSG_NOSIGNAL
+            const int flags = MSG_NOSIGNAL; // клиент мог уйти, не дождавшись ответа
+    #else
+            const int flags = 0;
+    #endif
+            size_t sent = 0;
+            while (sent < data.size()) {
+                ssize_t written = send(fd, data.data() + sent, data.size() - sent, flags);
+                if (written <= 0) {
+                    return false;
+                }
+                sent += static_cast<size_t>(written);
+            }
+            return true;
+        }
+
+        void Serve(int client) {
+            std::string buffer;
+            char chunk[4096];
+            while (true) {
+                size_t newline;
+                while ((newline = buffer.find('\n')) == std::string::npos) {
+                    // По таймауту простоя recv вернет ошибку, и соединение закроется
+                    ssize_t got = recv(client, chunk, sizeof(chunk), 0);
+                    if (got <= 0) {
+                        return;
+                    }
+                    buffer.append(chunk, static_cast<size_t>(got));
+                }
+                const std::string request = buffer.substr(0, newline);
+                buffer.erase(0, newline + 1);
+
+                TServerResponse response;
+                try {
+                    response = Handle(request);
+                } catch (const std::exception& e) {
+                    // Ошибка одного запроса не должна ронять сервер
+                    response = {false, std::string("Request failed: ") + e.what()};
+                }
+                std::string header = (response.Success ? "OK " : "ERROR ") + std::to_string(response.Payload.size()) + "\n";
+                if (!SendAll(client, header + response.Payload)) {
+                    return;
+                }
+            }
+        }
+
+        void Work() {
+            int client = -1;
+            while (Clients->Pop(client)) {
+                {
+                    std::lock_guard<std::mutex> lock(ClientsMutex);
+                    if (!Running.load()) {
+                        close(client);
+                        continue;
+                    }
+                    ActiveClients.insert(client);
+                }
+                Serve(client);
+                {
+                    std::lock_guard<std::mutex> lock(ClientsMutex);
+                    ActiveClients.erase(client);
+                }
+                close(client);
+            }
+        }
+
+        void Accept(int listenFd) {
+            std::chrono::milliseconds backoff{0};
+            while (Running.load()) {
+                int client = accept(listenFd, nullptr, nullptr);
+                if (client < 0) {
+                    if (errno == EINTR || errno == ECONNABORTED) {
+                        continue;
+                    }
+                    // Нехватка дескрипторов или памяти (EMFILE, ENFILE, ENOBUFS) не
+                    // проходит сразу: ждем, пока освободятся соединения, вместо холостого цикла
+                    backoff = std::min(std::max(backoff * 2, std::chrono::milliseconds(1)), std::chrono::milliseconds(100));
+                    std::this_thread::sleep_for(backoff);
+                    continue;
+                }
+                backoff = std::chrono::milliseconds(0);
+                if (IdleTimeout.count() > 0) {
+                    timeval timeout{};
+                    timeout.tv_sec = static_cast<time_t>(IdleTimeout.count() / 1000);
+                    timeout.tv_usec = static_cast<suseconds_t>(IdleTimeout.count() % 1000 * 1000);
+                    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+                }
+                if (!Clients->Push(client)) {
+                    close(client);
+                }
+            }
+        }
+
+    public:
+        ~TReportServer() {
+            Stop();
+        }
+
+        // Сколько соединение может простаивать между запросами, прежде чем сервер
+        // его закроет и освободит обработчик; 0 - без ограничения. Задается до Start.
+        void SetIdleTimeout(std::chrono::milliseconds timeout) {
+            IdleTimeout = timeout;
+        }
+
+        // workers == 0 - по числу ядер
+        bool Start(const std::string& socketPath, size_t workers = 0) {
+            sockaddr_un addr{};
+            if (Running.load() || socketPath.size() >= sizeof(addr.sun_path)) {
+                return false;
+            }
+            ListenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+            if (ListenFd < 0) {
+                return false;
+            }
+            addr.sun_family = AF_UNIX;
+            std::memcpy(addr.sun_path, socketPath.c_str(), socketPath.size() + 1);
+            unlink(socketPath.c_str()); // сокет от предыдущего запуска
+            if (bind(ListenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(ListenFd, 64) < 0) {
+                close(ListenFd);
+                ListenFd = -1;
+                return false;
+            }
+
+            SocketPath = socketPath;
+            workers = workers ? workers : std::max(2u, std::thread::hardware_concurrency());
+            Clients = std::make_unique<TBoundedQueue<int>>(workers * 4);
+            Running = true;
+            for (size_t i = 0; i < workers; i++) {
+                Workers.emplace_back([this] { Work(); });
+            }
+            Acceptor = std::thread([this, listenFd = ListenFd] { Accept(listenFd); });
+            return true;
+        }
+
+        void Stop() {
+            if (!Running.exchange(false)) {
+                return;
+            }
+            // Прерываем accept и чтение открытых соединений
+            shutdown(ListenFd, SHUT_RDWR);
+            Acceptor.join();
+            close(ListenFd);
+            ListenFd = -1;
+            Clients->Close();
+            {
+                std::lock_guard<std::mutex> lock(ClientsMutex);
+                for (int client : ActiveClients) {
+                    shutdown(client, SHUT_RDWR);
+                }
+            }
+            for (auto& worker : Workers) {
+                worker.join();
+            }
+            Workers.clear();
+            unlink(SocketPath.c_str());
+        }
+
+        const std::string& GetSocketPath() const {
+            return SocketPath;
+        }
+#endif
+    };
+
+#ifdef REPORT_BUILDER_HAVE_SOCKETS
+    // Клиент сервера отчетов: одно соединение на запрос
+    class TReportClient {
+    private:
+        std::string SocketPath;
+
+    public:
+        explicit TReportClient(std::string socketPath)
+            : SocketPath(std::move(socketPath)) {
+        }
+
+        TServerResponse Request(const std::string& request) {
+            sockaddr_un addr{};
+            if (SocketPath.size() >= sizeof(addr.sun_path)) {
+                return {false, "Socket path is too long: " + SocketPath};
+            }
+            int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+            if (fd < 0) {
+                return {false, "Cannot create socket"};
+            }
+            addr.sun_family = AF_UNIX;
+            std::memcpy(addr.sun_path, SocketPath.c_str(), SocketPath.size() + 1);
+            if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+                close(fd);
+                return {false, "Cannot connect to " + SocketPath};
+            }
+
+            const std::string line = request + "\n";
+            size_t sent = 0;
+            while (sent < line.size()) {
+                ssize_t written = send(fd, line.data() + sent, line.size() - sent, 0);
+                if (written <= 0) {
+                    close(fd);
+                    return {false, "Cannot send request"};
+                }
+                sent += static_cast<size_t>(written);
+            }
+
+            // Заголовок "OK <n>" или "ERROR <n>", затем n байт
+            std::string data;
+            char chunk[64 * 1024];
+            size_t newline = std::string::npos;
+            size_t expected = 0;
+            bool success = false;
+            while (true) {
+                if (newline == std::string::npos && (newline = data.find('\n')) != std::string::npos) {
+                    std::istringstream header(data.substr(0, newline));
+                    std::string status;
+                    header >> status >> expected;
+                    success = status == "OK";
+                }
+                if (newline != std::string::npos && data.size() - newline - 1 >= expected) {
+                    break;
+                }
+                ssize_t got = recv(fd, chunk, sizeof(chunk), 0);
+                if (got <= 0) {
+                    close(fd);
+                    return {false, "Connection closed before the response was complete"};
+                }
+                data.append(chunk, static_cast<size_t>(got));
+            }
+            close(fd);
+            return {success, data.substr(newline + 1, expected)};
+        }
+    };
+#endif
+} // namespace report_builder
+
+#endif
@@ -0,0 +1,301 @@
+#ifndef REPORT_BUILDER_ROW_CODEC_H
+#define REPORT_BUILDER_ROW_CODEC_H
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <unordered_map>
+
+#include "report_builder/data_types.h"
+
+namespace report_builder {
+    // Компактное бинарное кодирование строк таблицы для сброса на диск.
+    // Имена колонок и словари заменяются номерами в реестре кодека,
+    // поэтому закодированные данные читаются только тем же экземпляром кодека.
+    class TRowCodec {
+    private:
+        enum ETag : uint8_t {
+            String = 0,
+            Int = 1,
+            Double = 2,
+            Bool = 3,
+            Dict = 4,
+            Timestamp = 5,
+            Int64 = 6,
+        };
+
+        std::vector<std::string> Columns;
+        std::unordered_map<std::string, uint32_t> ColumnIds;
+        std::vector<std::shared_ptr<const TStringDictionary>> Dictionaries;
+        std::unordered_map<const TStringDictionary*, uint32_t> DictionaryIds;
+
+        static void PutVarint(std::string& out, uint64_t value) {
+            while (value >= 0x80) {
+                out.push_back(static_cast<char>(value | 0x80));
+                value >>= 7;
+            }
+            out.push_back(static_cast<char>(value));
+        }
+
+        static bool GetVarint(const char*& pos, const char* end, uint64_t& value) {
+            value = 0;
+            for (int shift = 0; shift < 64 && pos < end; shift += 7) {
+                auto byte = static_cast<uint8_t>(*pos++);
+                value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+                if (!(byte & 0x80)) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        uint32_t GetColumnId(const std::string& name) {
+            auto [it, inserted] = ColumnIds.emplace(name, static_cast<uint32_t>(Columns.size()));
+            if (inserted) {
+                Columns.push_back(name);
+            }
+            return it->second;
+        }
+
+        uint32_t GetDictionaryId(const std::shared_ptr<const TStringDictionary>& dict) {
+            auto [it, inserted] = DictionaryIds.emplace(dict.get(), static_cast<uint32_t>(Dictionaries.size()));
+            if (inserted) {
+                Dictionaries.push_back(dict);
+            }
+            return it->second;
+        }
+
+    public:
+        // Дописывает закодированную строку в конец out
+        void Encode(const DataRow& row, std::string& out) {
+            PutVarint(out, row.size());
+            for (const auto& [key, value] : row) {
+                PutVarint(out, GetColumnId(key));
+                std::visit(
+                    [&](auto&& v) {
+                        using T = std::decay_t<decltype(v)>;
+                        if constexpr (std::is_same_v<T, std::string>) {
+                            out.push_back(static_cast<char>(String));
+                            PutVarint(out, v.size());
+                            out.append(v);
+                        } else if constexpr (std::is_same_v<T, int> || std::is_same_v<T, int64_t>) {
+                            // zigzag, чтобы отрицательные числа были короткими
+                            out.push_back(static_cast<char>(std::is_same_v<T, int> ? Int : Int64));
+                            auto wide = static_cast<int64_t>(v);
+                            PutVarint(out, (static_cast<uint64_t>(wide) << 1) ^ static_cast<uint64_t>(wide >> 63));
+                        } else if constexpr (std::is_same_v<T, double>) {
+                            out.push_back(static_cast<char>(Double));
+                            char bytes[sizeof(double)];
+                            std::memcpy(bytes, &v, sizeof(double));
+                            out.append(bytes, sizeof(double));
+                        } else if constexpr (std::is_same_v<T, bool>) {
+                            out.push_back(static_cast<char>(Bool));
+                            out.push_back(v ? 1 : 0);
+                        } else if constexpr (std::is_same_v<T, TDictString>) {
+                            out.push_back(static_cast<char>(Dict));
+                            PutVarint(out, GetDictionaryId(v.Dict));
+                            PutVarint(out, v.Code);
+                        } else if constexpr (std::is_same_v<T, TTimestamp>) {
+                            out.push_back(static_cast<char>(Timestamp));
+                            PutVarint(out, (static_cast<uint64_t>(v.Seconds) << 1) ^ static_cast<uint64_t>(v.Seconds >> 63));
+                        }
+                    },
+                    value);
+            }
+        }
+
+        // Декодирует одну строку, сдвигая pos. Возвращает false при повреждении данных.
+        bool Decode(const char*& pos, const char* end, DataRow& row) const {
+            row.clear();
+            uint64_t fields = 0;
+            if (!GetVarint(pos, end, fields)) {
+                return false;
+            }
+            for (uint64_t i = 0; i < fields; i++) {
+                uint64_t columnId = 0;
+                if (!GetVarint(pos, end, columnId) || columnId >= Columns.size() || pos >= end) {
+                    return false;
+                }
+                auto hint = row.end();
+                const std::string& key = Columns[columnId];
+                const auto tag = static_cast<uint8_t>(*pos++);
+                switch (tag) {
+                    case String: {
+                        uint64_t len = 0;
+                        if (!GetVarint(pos, end, len) || static_cast<uint64_t>(end - pos) < len) {
+                            return false;
+                        }
+                        row.emplace_hint(hint, key, std::string(pos, len));
+                        pos += len;
+                        break;
+                    }
+                    case Int:
+                    case Int64: {
+                        uint64_t zigzag = 0;
+                        if (!GetVarint(pos, end, zigzag)) {
+                            return false;
+                        }
+                        auto wide = static_cast<int64_t>(zigzag >> 1) ^ -static_cast<int64_t>(zigzag & 1);
+                        if (tag == Int) {
+                            row.emplace_hint(hint, key, static_cast<int>(wide));
+                        } else {
+                            row.emplace_hint(hint, key, wide);
+                        }
+                        break;
+                    }
+                    case Double: {
+                        if (static_cast<size_t>(end - pos) < sizeof(double)) {
+                            return false;
+                        }
+                        double value = 0;
+                        std::memcpy(&value, pos, sizeof(double));
+                        pos += sizeof(double);
+                        row.emplace_hint(hint, key, value);
+                        break;
+                    }
+                    case Bool: {
+                        if (pos >= end) {
+                            return false;
+                        }
+                        row.emplace_hint(hint, key, *pos++ != 0);
+                        break;
+                    }
+                    case Dict: {
+                        uint64_t dictId = 0;
+                        uint64_t code = 0;
+                        if (!GetVarint(pos, end, dictId) || !GetVarint(pos, end, code) ||
+                            dictId >= Dictionaries.size()) {
+                            return false;
+                        }
+                        row.emplace_hint(hint, key, TDictString{Dictionaries[dictId], static_cast<uint32_t>(code)});
+                        break;
+                    }
+                    case Timestamp: {
+                        uint64_t zigzag = 0;
+                        if (!GetVarint(pos, end, zigzag)) {
+                            return false;
+                        }
+                        row.emplace_hint(hint, key, TTimestamp{static_cast<int64_t>(zigzag >> 1) ^ -static_cast<int64_t>(zigzag & 1)});
+                        break;
+                    }
+                    default:
+                        return false;
+                }
+            }
+            return true;
+        }
+    };
+
+    // Временный файл для сброса строк на диск. Удаляется в деструкторе.
+    // Сначала строки только пишутся, после FinishWrite() - только читаются.
+    class TSpillFile {
+    private:
+        std::filesystem::path Path;
+        std::shared_ptr<TRowCodec> Codec;
+        std::ofstream Out;
+        std::ifstream In;
+        std::string Buffer;
+        std::vector<char> ReadBuffer;
+        size_t RowCount = 0;
+        uint64_t BytesWritten = 0;
+
+        static std::filesystem::path MakeTempPath(const std::string& prefix) {
+            static std::atomic<uint64_t> counter{0};
+            static const uint64_t salt = std::random_device{}();
+            auto stamp = std::chrono::steady_clock::now().time_since_epoch().count();
+            std::string name = "report_builder_" + prefix + "_" + std::to_string(salt) + "_" +
+                               std::to_string(stamp) + "_" + std::to_string(counter++) + ".bin";
+            return std::filesystem::temp_directory_path() / name;
+        }
+
+        bool FlushBuffer() {
+            Out.write(Buffer.data(), static_cast<std::streamsize>(Buffer.size()));
+            BytesWritten += Buffer.size();
+            Buffer.clear();
+            return static_cast<bool>(Out);
+        }
+
+    public:
+        explicit TSpillFile(std::shared_ptr<TRowCodec> codec, const std::string& prefix = "spill")
+            : Path(MakeTempPath(prefix))
+            , Codec(std::move(codec))
+            , Out(Path, std::ios::binary) {
+        }
+
+        TSpillFile(const TSpillFile&) = delete;
+        TSpillFile& operator=(const TSpillFile&) = delete;
+
+        ~TSpillFile() {
+            Out.close();
+            In.close();
+            std::error_code ec;
+            std::filesystem::remove(Path, ec);
+        }
+
+        bool Write(const DataRow& row) {
+            if (!Out.is_open()) {
+                return false;
+            }
+            // Запись: длина в виде varint и закодированная строка
+            thread_local std::string encoded;
+            encoded.clear();
+            Codec->Encode(row, encoded);
+            uint64_t len = encoded.size();
+            while (len >= 0x80) {
+                Buffer.push_back(static_cast<char>(len | 0x80));
+                len >>= 7;
+            }
+            Buffer.push_back(static_cast<char>(len));
+            Buffer.append(encoded);
+            RowCount++;
+
+            constexpr size_t FlushThreshold = 1 << 16;
+            return Buffer.size() < FlushThreshold || FlushBuffer();
+        }
+
+        bool FinishWrite() {
+            bool ok = FlushBuffer();
+            Out.close();
+            In.open(Path, std::ios::binary);
+            return ok && In.is_open();
+        }
+
+        // Читает следующую строку. Возвращает false в конце файла или при ошибке.
+        bool Read(DataRow& row) {
+            uint64_t len = 0;
+            for (int shift = 0;; shift += 7) {
+                int byte = In.get();
+                if (byte == EOF || shift >= 64) {
+                    return false;
+                }
+                len |= static_cast<uint64_t>(byte & 0x7F) << shift;
+                if (!(byte & 0x80)) {
+                    break;
+                }
+            }
+            ReadBuffer.resize(len);
+            if (!In.read(ReadBuffer.data(), static_cast<std::streamsize>(len))) {
+                return false;
+            }
+            const char* pos = ReadBuffer.data();
+            return Codec->Decode(pos, pos + len, row);
+        }
+
+        size_t GetRowCount() const {
+            return RowCount;
+        }
+
+        uint64_t GetBytesWritten() const {
+            return BytesWritten;
+        }
+
+        const std::filesystem::path& GetPath() const {
+            return Path;
+        }
+    };
+} // namespace report_builder
+
+#endif
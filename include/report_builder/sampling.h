@@ -0,0 +1,227 @@
+#ifndef REPORT_BUILDER_SAMPLING_H
+#define REPORT_BUILDER_SAMPLING_H
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <unordered_map>
+
+#include "report_builder/data_types.h"
+
+namespace report_builder {
+    // Колонка веса строки выборки: сколько строк полной таблицы она представляет.
+    // Нужна агрегациям, в отчет форматировщиками не выводится.
+    inline constexpr const char* SampleWeightColumn = "_weight";
+
+    // Ключ страты по значению поля (nullptr - поля нет в строке). Один для выборки
+    // в обработчике и в поставщике, чтобы обе отбирали одни и те же строки.
+    inline std::string SampleStratumKey(const DataValue* value) {
+        return value ? ValueToString(*value) : std::string();
+    }
+
+    enum class ESampleMode {
+        Bernoulli,  // каждая строка независимо с вероятностью Fraction
+        Reservoir,  // ровно Rows строк, равновероятно
+        Stratified, // до Rows строк на каждое значение StratifyBy
+    };
+
+    struct TSampleOptions {
+        ESampleMode Mode = ESampleMode::Bernoulli;
+        double Fraction = 0.01;
+        size_t Rows = 1000;
+        std::string StratifyBy;
+        // Одинаковый seed на одних данных дает одну и ту же выборку
+        uint64_t Seed = 42;
+
+        std::string Describe() const {
+            std::ostringstream out;
+            switch (Mode) {
+                case ESampleMode::Bernoulli:
+                    out << "bernoulli " << Fraction * 100 << "%";
+                    break;
+                case ESampleMode::Reservoir:
+                    out << "reservoir " << Rows << " rows";
+                    break;
+                default:
+                    out << Rows << " rows per " << StratifyBy;
+                    break;
+            }
+            out << ", seed " << Seed;
+            return out.str();
+        }
+
+        std::optional<std::string> Validate() const {
+            if (Mode == ESampleMode::Bernoulli && !(Fraction > 0.0 && Fraction <= 1.0)) {
+                return "Sample fraction must be in (0, 1]";
+            }
+            if (Mode != ESampleMode::Bernoulli && Rows == 0) {
+                return "Sample size must be positive";
+            }
+            if (Mode == ESampleMode::Stratified && StratifyBy.empty()) {
+                return "Stratified sample needs a column";
+            }
+            return std::nullopt;
+        }
+    };
+
+    // Потоковый выбор строк. Решение принимается до разбора строки: Offer
+    // возвращает место строки в выборке (новое или вытесняемое) либо nullopt,
+    // и строку, не попавшую в выборку, можно не разбирать.
+    //
+    //   if (auto slot = sampler.Offer(stratum)) {
+    //       *slot == rows.size() ? rows.push_back(row) : (void)(rows[*slot] = row);
+    //   }
+    //   sampler.Finish(rows); // проставляет веса
+    //
+    // Reservoir - алгоритм R, Stratified - отдельный резервуар на каждую страту.
+    class TRowSampler {
+    private:
+        struct TStratum {
+            uint64_t Seen = 0;
+            std::vector<size_t> Slots;
+        };
+
+        TSampleOptions Options;
+        uint64_t State;
+        std::unordered_map<std::string, size_t> StratumIndex;
+        std::vector<TStratum> Strata;
+        std::vector<size_t> SlotStratum;
+        size_t Size = 0;
+
+        // splitmix64: одинаковая последовательность на всех платформах
+        uint64_t NextRandom() {
+            uint64_t z = (State += 0x9E3779B97F4A7C15ull);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            return z ^ (z >> 31);
+        }
+
+    public:
+        explicit TRowSampler(TSampleOptions options)
+            : Options(std::move(options))
+            , State(Options.Seed) {
+        }
+
+        // stratum учитывается только в режиме Stratified
+        std::optional<size_t> Offer(std::string_view stratum = {}) {
+            if (Options.Mode == ESampleMode::Bernoulli) {
+                const double u = static_cast<double>(NextRandom() >> 11) * 0x1.0p-53;
+                return u < Options.Fraction ? std::optional<size_t>(Size++) : std::nullopt;
+            }
+
+            const std::string_view key = Options.Mode == ESampleMode::Stratified ? stratum : std::string_view();
+            auto [it, inserted] = StratumIndex.try_emplace(std::string(key), Strata.size());
+            if (inserted) {
+                Strata.emplace_back();
+            }
+            TStratum& current = Strata[it->second];
+            current.Seen++;
+            if (current.Slots.size() < Options.Rows) {
+                current.Slots.push_back(Size);
+                SlotStratum.push_back(it->second);
+                return Size++;
+            }
+            const uint64_t j = NextRandom() % current.Seen;
+            if (j < Options.Rows) {
+                return current.Slots[j];
+            }
+            return std::nullopt;
+        }
+
+        // Проставляет веса выбранным строкам; вес уже взвешенной строки умножается
+        void Finish(DataTable& rows) const {
+            for (size_t slot = 0; slot < rows.size(); slot++) {
+                double weight = 1.0 / Options.Fraction;
+                if (Options.Mode != ESampleMode::Bernoulli) {
+                    const TStratum& stratum = Strata[SlotStratum[slot]];
+                    weight = static_cast<double>(stratum.Seen) / static_cast<double>(stratum.Slots.size());
+                }
+                auto it = rows[slot].find(SampleWeightColumn);
+                if (it != rows[slot].end()) {
+                    weight *= GetNumber(it->second).value_or(1.0);
+                }
+                rows[slot].insert_or_assign(SampleWeightColumn, weight);
+            }
+        }
+
+        const TSampleOptions& GetOptions() const {
+            return Options;
+        }
+    };
+
+    // Таблица содержит взвешенную выборку. Проверяются все строки: после соединения
+    // или объединения таблиц вес может быть не у первой строки
+    inline bool IsWeightedSample(const DataTable& data) {
+        return std::any_of(data.begin(), data.end(), [](const DataRow& row) { return row.count(SampleWeightColumn) > 0; });
+    }
+
+    // Оценка sum, avg или count полной таблицы по взвешенной выборке с 95%
+    // доверительным интервалом (оценка Хорвица-Томпсона, дисперсия как при
+    // независимом отборе строк; для выборок фиксированного размера интервал
+    // получается консервативным). nullopt, если поле не встретилось.
+    inline std::optional<DataRow> WeightedAggregate(const DataTable& data, const std::string& field,
+                                                    const std::string& operation) {
+        constexpr double Z95 = 1.959963984540054;
+        auto weightOf = [](const DataRow& row) {
+            auto it = row.find(SampleWeightColumn);
+            return it == row.end() ? 1.0 : GetNumber(it->second).value_or(1.0);
+        };
+
+        DataRow summaryRow;
+        summaryRow["field"] = field;
+        double value = 0.0;
+        double variance = 0.0;
+        int64_t count = 0;
+
+        if (operation == "count") {
+            summaryRow["operation"] = std::string("count");
+            for (const auto& row : data) {
+                const double w = weightOf(row);
+                value += w;
+                variance += w * (w - 1.0);
+            }
+            count = static_cast<int64_t>(data.size());
+        } else {
+            double weightTotal = 0.0;
+            for (const auto& row : data) {
+                auto it = row.find(field);
+                auto number = it == row.end() ? std::nullopt : GetNumber(it->second);
+                if (!number) {
+                    continue;
+                }
+                const double w = weightOf(row);
+                value += w * *number;
+                weightTotal += w;
+                variance += w * (w - 1.0) * *number * *number;
+                count++;
+            }
+            if (count == 0) {
+                return std::nullopt;
+            }
+            if (operation == "avg") {
+                // Отношение двух оценок: дисперсия по отклонениям от среднего
+                const double mean = value / weightTotal;
+                variance = 0.0;
+                for (const auto& row : data) {
+                    auto it = row.find(field);
+                    if (auto number = it == row.end() ? std::nullopt : GetNumber(it->second)) {
+                        const double w = weightOf(row);
+                        variance += w * (w - 1.0) * (*number - mean) * (*number - mean);
+                    }
+                }
+                variance /= weightTotal * weightTotal;
+                value = mean;
+            }
+            summaryRow["operation"] = std::string(operation == "avg" ? "average" : "sum");
+        }
+
+        const double margin = Z95 * std::sqrt(std::max(variance, 0.0));
+        summaryRow["value"] = value;
+        summaryRow["count"] = MakeInteger(count);
+        summaryRow["ci_low"] = value - margin;
+        summaryRow["ci_high"] = value + margin;
+        return summaryRow;
+    }
+} // namespace report_builder
+
+#endif
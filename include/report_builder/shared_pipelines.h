@@ -0,0 +1,184 @@
+#ifndef REPORT_BUILDER_SHARED_PIPELINES_H
+#define REPORT_BUILDER_SHARED_PIPELINES_H
+
+#include <sstream>
+
+#include "report_builder/interfaces.h"
+
+namespace report_builder {
+    // Выполняет набор отчетов, вычисляя общие префиксы конвейеров один раз.
+    //
+    // Отчеты раскладываются в префиксное дерево: первый уровень - поставщики,
+    // далее - обработчики; узлы сливаются по GetShareKey. Узел, через который
+    // проходят несколько отчетов, вычисляется один раз, и его результат передается
+    // всем дочерним ветвям. Ветвь с единственным отчетом дорабатывает сам отчет
+    // через TReport::GenerateFrom, получая статистику общих этапов.
+    //
+    // Этапы без ключа (nullopt) никогда не сливаются: с них ветвь каждого отчета своя.
+    class TBatchReportExecutor {
+    private:
+        struct TNode {
+            std::string Signature;       // описание этапа для Explain
+            std::optional<std::string> Key;
+            size_t Depth = 0;            // 1 - поставщик, 2 - первый обработчик и т.д.
+            std::vector<size_t> Reports; // отчеты, проходящие через узел
+            std::vector<std::unique_ptr<TNode>> Children;
+
+            TNode* Child(const std::string& signature, const std::optional<std::string>& key) {
+                if (key) {
+                    for (const auto& child : Children) {
+                        if (child->Key == key) {
+                            return child.get();
+                        }
+                    }
+                }
+                Children.push_back(std::make_unique<TNode>());
+                Children.back()->Signature = signature;
+                Children.back()->Key = key;
+                Children.back()->Depth = Depth + 1;
+                return Children.back().get();
+            }
+        };
+
+        std::vector<std::unique_ptr<TReport>> Reports;
+        TNode Root;
+        size_t SharedStages = 0;
+
+        // Узел источника имеет Depth 1, поэтому число пройденных обработчиков - Depth - 1
+        static size_t ProcessorsDone(const TNode& node) {
+            return node.Depth - 1;
+        }
+
+        // Общий этап; его статистика дописывается в prefix, который получат все отчеты ветви
+        template <class TStage>
+        TOperationResult RunStage(const char* category, const std::string& name, size_t rowsIn, TStage&& stage,
+                                  TSharedPrefix& prefix) {
+            TPipelineStats stats;
+            TStageTimer timer(&stats);
+            auto result = stage();
+            timer.Finish(category, [&] { return name; }, rowsIn, result.Data.size(),
+                         [&] { return EstimateTableBytes(result.Data); });
+            prefix.Stages.push_back(std::move(stats.Stages.back()));
+            SharedStages++;
+            return result;
+        }
+
+        void Finish(const TNode& node, DataTable data, const TSharedPrefix& prefix, std::vector<TOperationResult>& results) {
+            const size_t done = ProcessorsDone(node);
+            std::vector<size_t> ending;
+            for (size_t report : node.Reports) {
+                if (Reports[report]->GetProcessors().size() == done) {
+                    ending.push_back(report);
+                }
+            }
+
+            // Последний потребитель забирает таблицу, остальные получают копию
+            size_t consumers = ending.size() + node.Children.size();
+            auto take = [&]() -> DataTable {
+                if (--consumers == 0) {
+                    return std::move(data);
+                }
+                return data;
+            };
+
+            for (size_t report : ending) {
+                results[report] = Reports[report]->GenerateFrom(take(), done, &prefix);
+            }
+            for (const auto& child : node.Children) {
+                if (child->Reports.size() == 1) {
+                    const size_t report = child->Reports.front();
+                    results[report] = Reports[report]->GenerateFrom(take(), done, &prefix);
+                    continue;
+                }
+
+                // Общий обработчик выполняется экземпляром первого отчета ветви
+                IDataProcessor& processor = *Reports[child->Reports.front()]->GetProcessors()[done];
+                DataTable input = take();
+                const size_t rowsIn = input.size();
+                TSharedPrefix childPrefix = prefix;
+                auto result = RunStage("processor", processor.GetDescription(), rowsIn,
+                                       [&] { return processor.Process(std::move(input)); }, childPrefix);
+                if (!result.Success) {
+                    for (size_t report : child->Reports) {
+                        results[report] = result;
+                    }
+                    continue;
+                }
+                Finish(*child, std::move(result.Data), childPrefix, results);
+            }
+        }
+
+        static void Describe(const TNode& node, int indent, std::ostream& out) {
+            for (const auto& child : node.Children) {
+                out << std::string(indent * 2, ' ') << child->Signature;
+                if (child->Reports.size() > 1) {
+                    out << " [shared by " << child->Reports.size() << " reports]";
+                }
+                out << "\n";
+                Describe(*child, indent + 1, out);
+            }
+        }
+
+    public:
+        // Добавляет отчет и возвращает его номер в результатах Run
+        size_t Add(std::unique_ptr<TReport> report) {
+            const size_t index = Reports.size();
+            TNode* node = Root.Child(report->GetDataSource().GetSourceInfo(), report->GetDataSource().GetShareKey());
+            node->Reports.push_back(index);
+            for (const auto& processor : report->GetProcessors()) {
+                node = node->Child(processor->GetDescription(), processor->GetShareKey());
+                node->Reports.push_back(index);
+            }
+            Reports.push_back(std::move(report));
+            return index;
+        }
+
+        TReport& GetReport(size_t index) {
+            return *Reports[index];
+        }
+
+        size_t GetReportCount() const {
+            return Reports.size();
+        }
+
+        // Число общих узлов (поставщиков и обработчиков), выполненных за последний Run
+        size_t GetSharedStageCount() const {
+            return SharedStages;
+        }
+
+        // Выполняет все отчеты; результаты идут в порядке добавления
+        std::vector<TOperationResult> Run() {
+            std::vector<TOperationResult> results(Reports.size(), TOperationResult::Error("Report was not executed"));
+            SharedStages = 0;
+            for (const auto& source : Root.Children) {
+                if (source->Reports.size() == 1) {
+                    results[source->Reports.front()] = Reports[source->Reports.front()]->Generate();
+                    continue;
+                }
+
+                // Источник читается один раз на всю пачку
+                IDataProvider& provider = Reports[source->Reports.front()]->GetDataSource();
+                TSharedPrefix prefix;
+                auto rawData = RunStage("provider", provider.GetSourceInfo(), 0, [&] { return provider.FetchData(); }, prefix);
+                if (!rawData.Success) {
+                    for (size_t report : source->Reports) {
+                        results[report] = rawData;
+                    }
+                    continue;
+                }
+                prefix.SourceRows = rawData.Data.size();
+                Finish(*source, std::move(rawData.Data), prefix, results);
+            }
+            return results;
+        }
+
+        // Дерево общих префиксов
+        std::string Explain() const {
+            std::ostringstream out;
+            Describe(Root, 0, out);
+            return out.str();
+        }
+    };
+} // namespace report_builder
+
+#endif
@@ -0,0 +1,251 @@
+#ifndef REPORT_BUILDER_STATIC_PIPELINE_H
+#define REPORT_BUILDER_STATIC_PIPELINE_H
+
+#include <tuple>
+#include <utility>
+
+#include "report_builder/interfaces.h"
+
+namespace report_builder {
+    // Конвейер, собранный из конкретных типов стадий на этапе компиляции.
+    // Строка проталкивается через все стадии вызовами, которые компилятор встраивает,
+    // поэтому фильтр -> агрегация превращается в один цикл без виртуальных вызовов
+    // и std::function на строку. Снаружи это обычный IDataProcessor.
+
+    // Фильтр с условием произвольного типа (обычно лямбда)
+    template <class TPredicate>
+    class TStaticFilter {
+    private:
+        TPredicate Predicate;
+        std::string Description;
+
+    public:
+        TStaticFilter(TPredicate predicate, std::string description)
+            : Predicate(std::move(predicate))
+            , Description(std::move(description)) {
+        }
+
+        template <class TNext>
+        void Push(DataRow&& row, TNext&& next) {
+            if (Predicate(row)) {
+                next(std::move(row));
+            }
+        }
+
+        std::string GetDescription() const {
+            return "Filter" + (Description.empty() ? "" : " (" + Description + ")");
+        }
+    };
+
+    // Преобразование строки на месте, например вычисляемая колонка
+    template <class TTransform>
+    class TStaticMap {
+    private:
+        TTransform Transform;
+        std::string Description;
+
+    public:
+        TStaticMap(TTransform transform, std::string description)
+            : Transform(std::move(transform))
+            , Description(std::move(description)) {
+        }
+
+        template <class TNext>
+        void Push(DataRow&& row, TNext&& next) {
+            Transform(row);
+            next(std::move(row));
+        }
+
+        std::string GetDescription() const {
+            return "Map" + (Description.empty() ? "" : " (" + Description + ")");
+        }
+    };
+
+    // Завершающая стадия: собирает строки в таблицу
+    class TStaticCollect {
+    private:
+        DataTable Rows;
+
+    public:
+        void Consume(DataRow&& row) {
+            Rows.push_back(std::move(row));
+        }
+
+        TOperationResult Finish() {
+            return TOperationResult::Ok(std::exchange(Rows, DataTable()));
+        }
+
+        std::string GetDescription() const {
+            return "Collect";
+        }
+    };
+
+    enum class EStaticAggregation {
+        Sum,
+        Avg,
+        Count,
+    };
+
+    // Завершающая стадия: агрегация с операцией, известной при компиляции.
+    // Результат совпадает с TAggregationProcessor.
+    template <EStaticAggregation Operation>
+    class TStaticAggregate {
+    private:
+        std::string Field;
+        double Total = 0.0;
+        int64_t Count = 0;
+        int64_t Rows = 0;
+
+    public:
+        explicit TStaticAggregate(std::string field)
+            : Field(std::move(field)) {
+        }
+
+        void Consume(DataRow&& row) {
+            Rows++;
+            if constexpr (Operation != EStaticAggregation::Count) {
+                auto it = row.find(Field);
+                if (it == row.end()) {
+                    return;
+                }
+                if (auto value = GetNumber(it->second)) {
+                    Total += *value;
+                    Count++;
+                }
+            }
+        }
+
+        TOperationResult Finish() {
+            const double total = std::exchange(Total, 0.0);
+            const int64_t count = std::exchange(Count, 0);
+            const int64_t rows = std::exchange(Rows, 0);
+            if (rows == 0) {
+                return TOperationResult::Ok({});
+            }
+
+            DataRow summaryRow;
+            summaryRow["field"] = Field;
+            if constexpr (Operation == EStaticAggregation::Count) {
+                summaryRow["operation"] = std::string("count");
+                summaryRow["value"] = MakeInteger(rows);
+            } else {
+                if (count == 0) {
+                    return TOperationResult::Error("Field '" + Field + "' not found in data for aggregation");
+                }
+                if constexpr (Operation == EStaticAggregation::Sum) {
+                    summaryRow["operation"] = std::string("sum");
+                    summaryRow["value"] = total;
+                } else {
+                    summaryRow["operation"] = std::string("average");
+                    summaryRow["value"] = total / count;
+                }
+                summaryRow["count"] = MakeInteger(count);
+            }
+            return TOperationResult::Ok({summaryRow});
+        }
+
+        std::string GetDescription() const {
+            static const char* names[] = {"sum", "avg", "count"};
+            return std::string(names[static_cast<int>(Operation)]) + " of " + Field;
+        }
+    };
+
+    // Процессор из стадий TStages: все, кроме последней, имеют Push(row, next),
+    // последняя - Consume(row) и Finish()
+    template <class... TStages>
+    class TStaticPipelineProcessor: public IDataProcessor {
+    private:
+        std::tuple<TStages...> Stages;
+
+        template <size_t I>
+        void Push(DataRow&& row) {
+            if constexpr (I + 1 == sizeof...(TStages)) {
+                std::get<I>(Stages).Consume(std::move(row));
+            } else {
+                std::get<I>(Stages).Push(std::move(row), [this](DataRow&& next) { Push<I + 1>(std::move(next)); });
+            }
+        }
+
+        template <size_t... I>
+        std::string Describe(std::index_sequence<I...>) const {
+            std::string desc = "Static pipeline:";
+            ((desc += (I ? " -> " : " ") + std::get<I>(Stages).GetDescription()), ...);
+            return desc;
+        }
+
+    public:
+        explicit TStaticPipelineProcessor(std::tuple<TStages...> stages)
+            : Stages(std::move(stages)) {
+        }
+
+        TOperationResult Process(DataTable data) override {
+            for (auto& row : data) {
+                Push<0>(std::move(row));
+            }
+            DataTable().swap(data);
+            return std::get<sizeof...(TStages) - 1>(Stages).Finish();
+        }
+
+        std::string GetDescription() const override {
+            return Describe(std::index_sequence_for<TStages...>());
+        }
+    };
+
+    // Строитель статического конвейера. Каждый вызов возвращает строитель
+    // нового типа, в котором добавленная стадия - часть типа. Готовый процессор
+    // передается в TReportBuilder::AddProcessor, как и любой другой.
+    //
+    //   auto processor = TStaticPipelineBuilder<>()
+    //                        .Filter([](const DataRow& row) { ... }, "price > 500")
+    //                        .Aggregate<EStaticAggregation::Sum>("units");
+    template <class... TStages>
+    class TStaticPipelineBuilder {
+    private:
+        std::tuple<TStages...> Stages;
+
+        template <class... TOther>
+        friend class TStaticPipelineBuilder;
+
+        explicit TStaticPipelineBuilder(std::tuple<TStages...> stages)
+            : Stages(std::move(stages)) {
+        }
+
+        template <class TStage>
+        TStaticPipelineBuilder<TStages..., TStage> Append(TStage stage) {
+            return TStaticPipelineBuilder<TStages..., TStage>(
+                std::tuple_cat(std::move(Stages), std::make_tuple(std::move(stage))));
+        }
+
+        template <class TSink>
+        std::unique_ptr<IDataProcessor> Finish(TSink sink) {
+            return std::make_unique<TStaticPipelineProcessor<TStages..., TSink>>(
+                std::tuple_cat(std::move(Stages), std::make_tuple(std::move(sink))));
+        }
+
+    public:
+        TStaticPipelineBuilder() = default;
+
+        template <class TPredicate>
+        auto Filter(TPredicate predicate, std::string description = "") {
+            return Append(TStaticFilter<TPredicate>(std::move(predicate), std::move(description)));
+        }
+
+        template <class TTransform>
+        auto Map(TTransform transform, std::string description = "") {
+            return Append(TStaticMap<TTransform>(std::move(transform), std::move(description)));
+        }
+
+        // Завершает конвейер агрегацией
+        template <EStaticAggregation Operation>
+        std::unique_ptr<IDataProcessor> Aggregate(std::string field) {
+            return Finish(TStaticAggregate<Operation>(std::move(field)));
+        }
+
+        // Завершает конвейер сбором строк в таблицу
+        std::unique_ptr<IDataProcessor> Collect() {
+            return Finish(TStaticCollect());
+        }
+    };
+} // namespace report_builder
+
+#endif
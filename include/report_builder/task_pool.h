@@ -0,0 +1,89 @@
+#ifndef REPORT_BUILDER_TASK_POOL_H
+#define REPORT_BUILDER_TASK_POOL_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace report_builder {
+    // Пул потоков фиксированного размера для коротких задач внутри отчета
+    // (форматирование дополнительных выходов). Задачи не должны ждать других задач пула.
+    class TTaskPool {
+    private:
+        std::mutex Mutex;
+        std::condition_variable HasTasks;
+        std::deque<std::function<void()>> Tasks;
+        bool Stopping = false;
+        std::vector<std::thread> Workers;
+
+        void Run() {
+            while (true) {
+                std::function<void()> task;
+                {
+                    std::unique_lock<std::mutex> lock(Mutex);
+                    HasTasks.wait(lock, [&] { return Stopping || !Tasks.empty(); });
+                    if (Tasks.empty()) {
+                        return;
+                    }
+                    task = std::move(Tasks.front());
+                    Tasks.pop_front();
+                }
+                task();
+            }
+        }
+
+    public:
+        explicit TTaskPool(size_t threads) {
+            threads = std::max<size_t>(threads, 1);
+            Workers.reserve(threads);
+            for (size_t i = 0; i < threads; i++) {
+                Workers.emplace_back([this] { Run(); });
+            }
+        }
+
+        TTaskPool(const TTaskPool&) = delete;
+        TTaskPool& operator=(const TTaskPool&) = delete;
+
+        // Оставшиеся в очереди задачи выполняются до остановки потоков
+        ~TTaskPool() {
+            {
+                std::lock_guard<std::mutex> lock(Mutex);
+                Stopping = true;
+            }
+            HasTasks.notify_all();
+            for (auto& worker : Workers) {
+                worker.join();
+            }
+        }
+
+        // Общий пул по числу ядер
+        static TTaskPool& Global() {
+            static TTaskPool pool(std::thread::hardware_concurrency());
+            return pool;
+        }
+
+        template <class TFunc>
+        std::future<std::invoke_result_t<TFunc>> Submit(TFunc func) {
+            auto task = std::make_shared<std::packaged_task<std::invoke_result_t<TFunc>()>>(std::move(func));
+            auto result = task->get_future();
+            {
+                std::lock_guard<std::mutex> lock(Mutex);
+                Tasks.emplace_back([task] { (*task)(); });
+            }
+            HasTasks.notify_one();
+            return result;
+        }
+
+        size_t GetThreadCount() const {
+            return Workers.size();
+        }
+    };
+} // namespace report_builder
+
+#endif
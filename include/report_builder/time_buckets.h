@@ -0,0 +1,109 @@
+#ifndef REPORT_BUILDER_TIME_BUCKETS_H
+#define REPORT_BUILDER_TIME_BUCKETS_H
+
+#include "report_builder/interfaces.h"
+
+namespace report_builder {
+    enum class ETimeBucket {
+        Hour,
+        Day,
+        Week,  // неделя с понедельника
+        Month,
+    };
+
+    inline const char* TimeBucketName(ETimeBucket bucket) {
+        switch (bucket) {
+            case ETimeBucket::Hour:
+                return "hour";
+            case ETimeBucket::Day:
+                return "day";
+            case ETimeBucket::Week:
+                return "week";
+            default:
+                return "month";
+        }
+    }
+
+    inline std::optional<ETimeBucket> ParseTimeBucket(std::string_view name) {
+        for (auto bucket : {ETimeBucket::Hour, ETimeBucket::Day, ETimeBucket::Week, ETimeBucket::Month}) {
+            if (name == TimeBucketName(bucket)) {
+                return bucket;
+            }
+        }
+        return std::nullopt;
+    }
+
+    // Начало интервала, в который попадает момент времени
+    inline TTimestamp TruncateTimestamp(TTimestamp value, ETimeBucket bucket) {
+        switch (bucket) {
+            case ETimeBucket::Hour:
+                return {FloorDiv(value.Seconds, 3600) * 3600};
+            case ETimeBucket::Day:
+                return {value.Days() * SecondsPerDay};
+            case ETimeBucket::Week: {
+                // 1970-01-01 - четверг, то есть третий день от понедельника
+                const int64_t days = value.Days();
+                return {(days - (days + 3 - FloorDiv(days + 3, 7) * 7)) * SecondsPerDay};
+            }
+            default: {
+                const TCivilDate date = value.Date();
+                return TTimestamp::FromDate(date.Year, date.Month, 1);
+            }
+        }
+    }
+
+    // Добавляет колонку с началом интервала (час, день, неделя, месяц) для поля даты.
+    // Результат - обычная колонка TTimestamp, по которой работают группировка
+    // и оконные функции. Строковые значения разбираются как ISO 8601;
+    // строки без даты остаются без новой колонки.
+    class TTimeBucketProcessor: public IDataProcessor {
+    private:
+        std::string Field;
+        ETimeBucket Bucket;
+        std::string OutputField;
+
+    public:
+        // По умолчанию колонка называется <field>_<bucket>, например date_month
+        TTimeBucketProcessor(std::string field, ETimeBucket bucket, std::string outputField = "")
+            : Field(std::move(field))
+            , Bucket(bucket)
+            , OutputField(std::move(outputField)) {
+            if (OutputField.empty()) {
+                OutputField = Field + "_" + TimeBucketName(Bucket);
+            }
+        }
+
+        TOperationResult Process(DataTable data) override {
+            for (auto& row : data) {
+                auto it = row.find(Field);
+                if (it == row.end()) {
+                    continue;
+                }
+                std::optional<TTimestamp> time;
+                if (const auto* value = std::get_if<TTimestamp>(&it->second)) {
+                    time = *value;
+                } else if (auto text = GetStringView(it->second)) {
+                    time = ParseTimestamp(*text);
+                }
+                if (time) {
+                    row.insert_or_assign(OutputField, TruncateTimestamp(*time, Bucket));
+                }
+            }
+            return TOperationResult::Ok(std::move(data));
+        }
+
+        std::string GetDescription() const override {
+            return std::string("Time bucket ") + TimeBucketName(Bucket) + "(" + Field + ") as " + OutputField;
+        }
+
+        std::optional<std::string> GetShareKey() const override {
+            return GetDescription();
+        }
+
+        const std::string& GetOutputField() const {
+            return OutputField;
+        }
+    };
+} // namespace report_builder
+
+#endif
@@ -0,0 +1,292 @@
+#ifndef REPORT_BUILDER_TRACING_H
+#define REPORT_BUILDER_TRACING_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <ostream>
+#include <string_view>
+
+#include "report_builder/data_types.h"
+
+namespace report_builder {
+    // Завершенный интервал трассировки (событие "X" формата Chrome trace-event)
+    struct TTraceEvent {
+        const char* Category = ""; // строковый литерал: provider, processor, batch...
+        char Name[64] = {};        // имя обрезается, чтобы запись не выделяла память
+        uint64_t StartUs = 0;
+        uint64_t DurationUs = 0;
+        uint32_t ThreadId = 0;
+        uint64_t RowsIn = 0;
+        uint64_t RowsOut = 0;
+    };
+
+    // Кольцевой буфер одного потока: пишет только поток-владелец, читает только сборщик.
+    // При переполнении событие отбрасывается, запись никогда не ждет.
+    class TTraceRing {
+    private:
+        std::vector<TTraceEvent> Slots;
+        const size_t Mask;
+        const uint32_t ThreadId;
+        alignas(64) std::atomic<size_t> Head{0};
+        alignas(64) std::atomic<size_t> Tail{0};
+        std::atomic<uint64_t> Dropped{0};
+
+    public:
+        // capacity - степень двойки
+        TTraceRing(size_t capacity, uint32_t threadId)
+            : Slots(capacity)
+            , Mask(capacity - 1)
+            , ThreadId(threadId) {
+        }
+
+        uint32_t GetThreadId() const {
+            return ThreadId;
+        }
+
+        uint64_t GetDroppedCount() const {
+            return Dropped.load(std::memory_order_relaxed);
+        }
+
+        bool Push(const TTraceEvent& event) {
+            const size_t head = Head.load(std::memory_order_relaxed);
+            if (head - Tail.load(std::memory_order_acquire) == Slots.size()) {
+                Dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            Slots[head & Mask] = event;
+            Head.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        template <class TConsumer>
+        void Drain(TConsumer&& consume) {
+            size_t tail = Tail.load(std::memory_order_relaxed);
+            const size_t head = Head.load(std::memory_order_acquire);
+            for (; tail != head; tail++) {
+                consume(Slots[tail & Mask]);
+            }
+            Tail.store(tail, std::memory_order_release);
+        }
+    };
+
+    // Глобальный трассировщик. Выключенный стоит одной атомарной загрузки на интервал.
+    // Включенный пишет в буфер своего потока без блокировок; мьютекс берется
+    // только при первой записи потока, при его завершении и при сборе событий.
+    // Буфер завершившегося потока сливается в собранные события и освобождается.
+    class TTracer {
+    public:
+        static constexpr size_t RingCapacity = 1u << 13;
+
+    private:
+        std::atomic<bool> Enabled{false};
+        std::atomic<uint32_t> NextThreadId{1};
+        const std::chrono::steady_clock::time_point Epoch = std::chrono::steady_clock::now();
+
+        mutable std::mutex Mutex;
+        std::vector<std::shared_ptr<TTraceRing>> Rings;
+        std::vector<TTraceEvent> Collected;
+        uint64_t RetiredDropped = 0; // отброшенные события завершившихся потоков
+
+        // Буфер потока; при завершении потока отдает события трассировщику
+        struct TLocalRing {
+            TTracer* Tracer = nullptr;
+            std::shared_ptr<TTraceRing> Ring;
+
+            ~TLocalRing() {
+                if (Ring) {
+                    Tracer->Retire(Ring);
+                }
+            }
+        };
+
+        TTracer() = default;
+
+        TTraceRing& LocalRing() {
+            thread_local TLocalRing local;
+            if (!local.Ring) {
+                local.Tracer = this;
+                local.Ring = std::make_shared<TTraceRing>(RingCapacity, NextThreadId.fetch_add(1, std::memory_order_relaxed));
+                std::lock_guard<std::mutex> lock(Mutex);
+                Rings.push_back(local.Ring);
+            }
+            return *local.Ring;
+        }
+
+        void Retire(const std::shared_ptr<TTraceRing>& ring) {
+            std::lock_guard<std::mutex> lock(Mutex);
+            ring->Drain([&](const TTraceEvent& event) { Collected.push_back(event); });
+            RetiredDropped += ring->GetDroppedCount();
+            Rings.erase(std::remove(Rings.begin(), Rings.end(), ring), Rings.end());
+        }
+
+        // Вызывается под Mutex
+        void DrainLocked() {
+            for (const auto& ring : Rings) {
+                ring->Drain([&](const TTraceEvent& event) { Collected.push_back(event); });
+            }
+        }
+
+        static void WriteEscaped(std::ostream& out, std::string_view text) {
+            for (char c : text) {
+                if (c == '"' || c == '\\') {
+                    out << '\\' << c;
+                } else if (static_cast<unsigned char>(c) < 0x20) {
+                    out << ' ';
+                } else {
+                    out << c;
+                }
+            }
+        }
+
+    public:
+        TTracer(const TTracer&) = delete;
+        TTracer& operator=(const TTracer&) = delete;
+
+        static TTracer& Global() {
+            static TTracer tracer;
+            return tracer;
+        }
+
+        void Enable(bool enabled = true) {
+            Enabled.store(enabled, std::memory_order_relaxed);
+        }
+
+        bool IsEnabled() const {
+            return Enabled.load(std::memory_order_relaxed);
+        }
+
+        // Микросекунды от создания трассировщика
+        uint64_t NowUs() const {
+            return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - Epoch).count();
+        }
+
+        void Record(const char* category, std::string_view name, uint64_t startUs, uint64_t durationUs,
+                    uint64_t rowsIn = 0, uint64_t rowsOut = 0) {
+            auto& ring = LocalRing();
+            TTraceEvent event;
+            event.Category = category;
+            const size_t length = std::min(name.size(), sizeof(event.Name) - 1);
+            std::memcpy(event.Name, name.data(), length);
+            event.Name[length] = '\0';
+            event.StartUs = startUs;
+            event.DurationUs = durationUs;
+            event.ThreadId = ring.GetThreadId();
+            event.RowsIn = rowsIn;
+            event.RowsOut = rowsOut;
+            ring.Push(event);
+        }
+
+        // Забирает накопленные события из буферов всех потоков
+        std::vector<TTraceEvent> Collect() {
+            std::lock_guard<std::mutex> lock(Mutex);
+            DrainLocked();
+            auto events = Collected;
+            std::sort(events.begin(), events.end(),
+                      [](const TTraceEvent& a, const TTraceEvent& b) { return a.StartUs < b.StartUs; });
+            return events;
+        }
+
+        uint64_t GetDroppedCount() const {
+            std::lock_guard<std::mutex> lock(Mutex);
+            uint64_t dropped = RetiredDropped;
+            for (const auto& ring : Rings) {
+                dropped += ring->GetDroppedCount();
+            }
+            return dropped;
+        }
+
+        // Число буферов потоков, которые еще работают и писали события
+        size_t GetThreadBufferCount() const {
+            std::lock_guard<std::mutex> lock(Mutex);
+            return Rings.size();
+        }
+
+        // Удаляет собранные события; счетчики отброшенных событий не сбрасываются
+        void Clear() {
+            std::lock_guard<std::mutex> lock(Mutex);
+            DrainLocked();
+            Collected.clear();
+        }
+
+        // JSON для chrome://tracing и Perfetto
+        void WriteChromeTrace(std::ostream& out) {
+            const auto events = Collect();
+            out << "{\"displayTimeUnit\":\"ms\",\"otherData\":{\"dropped_events\":" << GetDroppedCount()
+                << "},\"traceEvents\":[";
+            for (size_t i = 0; i < events.size(); i++) {
+                const auto& event = events[i];
+                out << (i ? ",\n" : "\n") << "{\"name\":\"";
+                WriteEscaped(out, event.Name);
+                out << "\",\"cat\":\"";
+                WriteEscaped(out, event.Category);
+                out << "\",\"ph\":\"X\",\"ts\":" << event.StartUs << ",\"dur\":" << event.DurationUs
+                    << ",\"pid\":1,\"tid\":" << event.ThreadId << ",\"args\":{\"rows_in\":" << event.RowsIn
+                    << ",\"rows_out\":" << event.RowsOut << "}}";
+            }
+            out << "\n]}\n";
+        }
+
+        bool DumpToFile(const std::string& path) {
+            const std::string tmpPath = path + ".tmp";
+            {
+                std::ofstream file(tmpPath);
+                if (!file.is_open()) {
+                    return false;
+                }
+                WriteChromeTrace(file);
+                if (!file) {
+                    return false;
+                }
+            }
+            std::error_code ec;
+            std::filesystem::rename(tmpPath, path, ec);
+            return !ec;
+        }
+    };
+
+    // Интервал трассировки от конструктора до деструктора.
+    // Если трассировка выключена при создании, ничего не делает.
+    class TTraceSpan {
+    private:
+        const char* Category;
+        bool Active;
+        uint64_t StartUs = 0;
+        uint64_t RowsIn = 0;
+        uint64_t RowsOut = 0;
+        char Name[sizeof(TTraceEvent::Name)] = {};
+
+    public:
+        TTraceSpan(const char* category, std::string_view name)
+            : Category(category)
+            , Active(TTracer::Global().IsEnabled()) {
+            if (!Active) {
+                return;
+            }
+            const size_t length = std::min(name.size(), sizeof(Name) - 1);
+            std::memcpy(Name, name.data(), length);
+            StartUs = TTracer::Global().NowUs();
+        }
+
+        TTraceSpan(const TTraceSpan&) = delete;
+        TTraceSpan& operator=(const TTraceSpan&) = delete;
+
+        ~TTraceSpan() {
+            if (Active) {
+                auto& tracer = TTracer::Global();
+                tracer.Record(Category, Name, StartUs, tracer.NowUs() - StartUs, RowsIn, RowsOut);
+            }
+        }
+
+        void SetRows(uint64_t rowsIn, uint64_t rowsOut) {
+            RowsIn = rowsIn;
+            RowsOut = rowsOut;
+        }
+    };
+} // namespace report_builder
+
+#endif
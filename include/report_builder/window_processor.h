@@ -0,0 +1,281 @@
+#ifndef REPORT_BUILDER_WINDOW_PROCESSOR_H
+#define REPORT_BUILDER_WINDOW_PROCESSOR_H
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+#include "report_builder/interfaces.h"
+
+namespace report_builder {
+    enum class EWindowFunction {
+        CumulativeSum, // нарастающий итог
+        MovingSum,     // сумма по скользящему окну из Size строк
+        MovingAverage, // среднее по скользящему окну из Size строк
+        Lag,           // значение Size строк назад
+        Lead,          // значение Size строк вперед
+        Delta,         // разница с значением Size строк назад
+    };
+
+    struct TWindowSpec {
+        EWindowFunction Function;
+        std::string Field;
+        std::string OutputField;
+        size_t Size = 1;
+    };
+
+    // Сумма с компенсацией ошибки округления (Ноймайер): ошибка не накапливается
+    // с числом операций, но результат не точный. Скользящее окно прибавляет
+    // и вычитает одни и те же значения, и без компенсации ошибка от больших значений
+    // остается в сумме после их выхода из окна.
+    class TCompensatedSum {
+    private:
+        double Sum = 0.0;
+        double Compensation = 0.0;
+
+    public:
+        void Add(double value) {
+            const double total = Sum + value;
+            if (std::abs(Sum) >= std::abs(value)) {
+                Compensation += (Sum - total) + value;
+            } else {
+                Compensation += (value - total) + Sum;
+            }
+            Sum = total;
+        }
+
+        double Get() const {
+            return Sum + Compensation;
+        }
+    };
+
+    // Оконные функции: строки разбиваются на партиции, упорядочиваются внутри
+    // партиции, и к каждой строке добавляются вычисленные колонки.
+    // Скользящие окна пересчитываются инкрементально, за O(n) на партицию.
+    // Порядок строк задается CompareValues, как и в TSortProcessor.
+    class TWindowProcessor: public IDataProcessor {
+    private:
+        std::vector<std::string> PartitionBy;
+        std::string OrderBy;
+        bool Ascending;
+        std::vector<TWindowSpec> Specs;
+
+        using TPartitionKey = std::vector<std::optional<DataValue>>;
+
+        struct TPartitionKeyLess {
+            bool operator()(const TPartitionKey& a, const TPartitionKey& b) const {
+                return std::lexicographical_compare(
+                    a.begin(), a.end(), b.begin(), b.end(), [](const auto& x, const auto& y) {
+                        if (!x || !y) {
+                            return x.has_value() && !y.has_value();
+                        }
+                        return KeyValueLess(*x, *y);
+                    });
+            }
+        };
+
+        static std::string FunctionName(EWindowFunction function) {
+            switch (function) {
+                case EWindowFunction::CumulativeSum:
+                    return "cumsum";
+                case EWindowFunction::MovingSum:
+                    return "moving_sum";
+                case EWindowFunction::MovingAverage:
+                    return "moving_avg";
+                case EWindowFunction::Lag:
+                    return "lag";
+                case EWindowFunction::Lead:
+                    return "lead";
+                case EWindowFunction::Delta:
+                    return "delta";
+            }
+            return "unknown";
+        }
+
+        void Apply(const TWindowSpec& spec, DataTable& rows) const {
+            const size_t n = rows.size();
+            std::vector<std::optional<double>> numbers(n);
+            for (size_t i = 0; i < n; i++) {
+                auto it = rows[i].find(spec.Field);
+                if (it != rows[i].end()) {
+                    numbers[i] = GetNumber(it->second);
+                }
+            }
+
+            switch (spec.Function) {
+                case EWindowFunction::CumulativeSum: {
+                    TCompensatedSum total;
+                    for (size_t i = 0; i < n; i++) {
+                        total.Add(numbers[i].value_or(0.0));
+                        rows[i][spec.OutputField] = total.Get();
+                    }
+                    break;
+                }
+                case EWindowFunction::MovingSum:
+                case EWindowFunction::MovingAverage: {
+                    const size_t size = std::max<size_t>(spec.Size, 1);
+                    // NaN и бесконечности в сумму не попадают: вычитание их не убирает
+                    // (inf - inf = NaN). Пока такие значения в окне, сумма окна
+                    // пересчитывается заново.
+                    TCompensatedSum total;
+                    size_t count = 0;
+                    size_t nonFinite = 0;
+                    for (size_t i = 0; i < n; i++) {
+                        // Добавляем вошедшую в окно строку и вычитаем вышедшую
+                        if (numbers[i]) {
+                            if (std::isfinite(*numbers[i])) {
+                                total.Add(*numbers[i]);
+                            } else {
+                                nonFinite++;
+                            }
+                            count++;
+                        }
+                        if (i >= size && numbers[i - size]) {
+                            if (std::isfinite(*numbers[i - size])) {
+                                total.Add(-*numbers[i - size]);
+                            } else {
+                                nonFinite--;
+                            }
+                            count--;
+                        }
+                        double sum = total.Get();
+                        if (nonFinite > 0) {
+                            sum = 0.0;
+                            for (size_t j = i + 1 - std::min(i + 1, size); j <= i; j++) {
+                                sum += numbers[j].value_or(0.0);
+                            }
+                        }
+                        if (spec.Function == EWindowFunction::MovingSum) {
+                            rows[i][spec.OutputField] = sum;
+                        } else if (count > 0) {
+                            rows[i][spec.OutputField] = sum / static_cast<double>(count);
+                        }
+                    }
+                    break;
+                }
+                case EWindowFunction::Lag:
+                case EWindowFunction::Lead: {
+                    const bool lag = spec.Function == EWindowFunction::Lag;
+                    // Значения копируются заранее, чтобы запись в строки не влияла на чтение
+                    std::vector<std::optional<DataValue>> values(n);
+                    for (size_t i = 0; i < n; i++) {
+                        auto it = rows[i].find(spec.Field);
+                        if (it != rows[i].end()) {
+                            values[i] = it->second;
+                        }
+                    }
+                    for (size_t i = 0; i < n; i++) {
+                        if (lag ? i < spec.Size : i + spec.Size >= n) {
+                            continue;
+                        }
+                        const auto& source = values[lag ? i - spec.Size : i + spec.Size];
+                        if (source) {
+                            rows[i][spec.OutputField] = *source;
+                        }
+                    }
+                    break;
+                }
+                case EWindowFunction::Delta: {
+                    for (size_t i = spec.Size; i < n; i++) {
+                        if (numbers[i] && numbers[i - spec.Size]) {
+                            rows[i][spec.OutputField] = *numbers[i] - *numbers[i - spec.Size];
+                        }
+                    }
+                    break;
+                }
+            }
+        }
+
+    public:
+        TWindowProcessor(std::vector<std::string> partitionBy, std::string orderBy,
+                         std::vector<TWindowSpec> specs, bool ascending = true)
+            : PartitionBy(std::move(partitionBy))
+            , OrderBy(std::move(orderBy))
+            , Ascending(ascending)
+            , Specs(std::move(specs)) {
+            for (auto& spec : Specs) {
+                if (spec.OutputField.empty()) {
+                    spec.OutputField = spec.Field + "_" + FunctionName(spec.Function);
+                }
+            }
+        }
+
+        TOperationResult Process(DataTable data) override {
+            // Партиции в порядке ключей; отсутствующее поле - отдельное значение ключа,
+            // не равное пустой строке, и такие партиции идут после остальных
+            std::map<TPartitionKey, std::vector<size_t>, TPartitionKeyLess> partitions;
+            TPartitionKey key;
+            for (size_t i = 0; i < data.size(); i++) {
+                key.clear();
+                for (const auto& field : PartitionBy) {
+                    auto it = data[i].find(field);
+                    key.push_back(it != data[i].end() ? std::optional<DataValue>(it->second) : std::nullopt);
+                }
+                partitions[key].push_back(i);
+            }
+
+            DataTable result;
+            result.reserve(data.size());
+            DataTable partition;
+            for (auto& [_, indices] : partitions) {
+                if (!OrderBy.empty()) {
+                    std::stable_sort(indices.begin(), indices.end(), [&](size_t a, size_t b) {
+                        auto itA = data[a].find(OrderBy);
+                        auto itB = data[b].find(OrderBy);
+                        if (itA == data[a].end() || itB == data[b].end()) {
+                            // Строки без поля сортировки идут в конец
+                            return itA != data[a].end() && itB == data[b].end();
+                        }
+                        int cmp = CompareValues(itA->second, itB->second);
+                        return Ascending ? cmp < 0 : cmp > 0;
+                    });
+                }
+
+                partition.clear();
+                partition.reserve(indices.size());
+                for (size_t idx : indices) {
+                    partition.push_back(std::move(data[idx]));
+                }
+                for (const auto& spec : Specs) {
+                    Apply(spec, partition);
+                }
+                std::move(partition.begin(), partition.end(), std::back_inserter(result));
+            }
+
+            return TOperationResult::Ok(std::move(result));
+        }
+
+        // Описание не включает имена выходных колонок, поэтому они добавляются к ключу
+        std::optional<std::string> GetShareKey() const override {
+            std::string key = GetDescription() + " ->";
+            for (const auto& spec : Specs) {
+                key += " " + spec.OutputField;
+            }
+            return key;
+        }
+
+        std::string GetDescription() const override {
+            std::string desc = "Window";
+            if (!PartitionBy.empty()) {
+                desc += " partition by";
+                for (const auto& field : PartitionBy) {
+                    desc += " " + field;
+                }
+            }
+            if (!OrderBy.empty()) {
+                desc += " order by " + OrderBy + (Ascending ? " (asc)" : " (desc)");
+            }
+            desc += ":";
+            for (const auto& spec : Specs) {
+                desc += " " + FunctionName(spec.Function) + "(" + spec.Field;
+                if (spec.Function != EWindowFunction::CumulativeSum) {
+                    desc += ", " + std::to_string(spec.Size);
+                }
+                desc += ")";
+            }
+            return desc;
+        }
+    };
+} // namespace report_builder
+
+#endif
@@ -1,8 +1,11 @@
 #include <iostream>
 #include <fstream>
+#include <csignal>
+#include <cstring>
 
 #include "report_builder/report_builder.h"
 #include "report_builder/report_factories.h"
+#include "report_builder/report_server.h"
 
 using namespace report_builder;
 
@@ -17,7 +20,50 @@ void CreateSampleCSV() {
     std::cout << "Created sample CSV: sales.csv\n";
 }
 
-int main() {
+#ifdef REPORT_BUILDER_HAVE_SOCKETS
+volatile std::sig_atomic_t StopRequested = 0;
+
+// Сервер отчетов до SIGINT/SIGTERM
+int Serve(const std::string& socketPath) {
+    TReportServer server;
+    if (!server.Start(socketPath)) {
+        std::cerr << "Cannot listen on " << socketPath << "\n";
+        return 1;
+    }
+    std::signal(SIGINT, [](int) { StopRequested = 1; });
+    std::signal(SIGTERM, [](int) { StopRequested = 1; });
+    std::cout << "Serving reports on " << socketPath << "\n";
+    while (!StopRequested) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    server.Stop();
+    return 0;
+}
+
+// Один запрос к запущенному серверу
+int Query(const std::string& socketPath, const std::string& request) {
+    auto response = TReportClient(socketPath).Request(request);
+    (response.Success ? std::cout : std::cerr) << response.Payload << "\n";
+    return response.Success ? 0 : 1;
+}
+#endif
+
+int main(int argc, char** argv) {
+#ifdef REPORT_BUILDER_HAVE_SOCKETS
+    // report_builder --serve <socket>
+    // report_builder --query <socket> "<request>"
+    if (argc == 3 && std::strcmp(argv[1], "--serve") == 0) {
+        return Serve(argv[2]);
+    }
+    if (argc == 4 && std::strcmp(argv[1], "--query") == 0) {
+        return Query(argv[2], argv[3]);
+    }
+#endif
+    if (argc > 1) {
+        std::cerr << "Usage: " << argv[0] << " [--serve <socket> | --query <socket> <request>]\n";
+        return 1;
+    }
+
     std::cout << "=== Report Builder System ===\n\n";
 
     // Создаем тестовый CSV файл
@@ -26,8 +72,9 @@ int main() {
     // Пример 1: Использование фабрики
     std::cout << "\n1. Using Finance Report Factory:\n";
     auto financeFactory = std::make_unique<TFinanceReportFactory>();
+    financeFactory->EnableQueryPlanner();
     auto financeReport = financeFactory->CreateReport();
-    financeReport->PrintPipeline();
+    std::cout << financeReport->Explain();
 
     auto result = financeReport->Generate();
     if (result.Success) {
@@ -1,8 +1,10 @@
 #include <gtest/gtest.h>
 #include <fstream>
+#include <arpa/inet.h>
 
 #include "report_builder/report_builder.h"
 #include "report_builder/report_factories.h"
+#include "report_builder/report_server.h"
 
 using namespace report_builder;
 
@@ -93,3 +95,184 @@ TEST_F(IntegrationTest, ReportHandlesMissingFileGracefully) {
     EXPECT_TRUE(result.ErrorMessage.has_value());
     EXPECT_NE(result.ErrorMessage.value().find("Cannot open file"), std::string::npos);
 }
+
+TEST_F(IntegrationTest, MetricsEndpointServesReportMetrics) {
+    auto report = std::make_unique<TSalesReportFactory>()->CreateReport();
+    testing::internal::CaptureStdout();
+    ASSERT_TRUE(report->Generate().Success);
+    testing::internal::GetCapturedStdout();
+
+    TMetricsHttpServer server(TMetricsRegistry::Global(), std::chrono::milliseconds(200));
+    ASSERT_TRUE(server.Start());
+
+    auto connectToServer = [&server] {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(server.GetPort());
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        EXPECT_EQ(connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)), 0);
+        return fd;
+    };
+
+    // Клиент, который ничего не присылает, задерживает сервер только до таймаута
+    int silent = connectToServer();
+    ASSERT_GE(silent, 0);
+
+    // Локальный сбор метрик, как это делает Prometheus
+    int fd = connectToServer();
+    ASSERT_GE(fd, 0);
+    std::string request = "GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    ASSERT_EQ(send(fd, request.data(), request.size(), 0), static_cast<ssize_t>(request.size()));
+
+    std::string response;
+    char buffer[4096];
+    ssize_t got;
+    while ((got = recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+        response.append(buffer, static_cast<size_t>(got));
+    }
+    close(fd);
+    close(silent);
+    server.Stop();
+
+    EXPECT_NE(response.find("HTTP/1.1 200 OK"), std::string::npos);
+    EXPECT_NE(response.find("application/openmetrics-text"), std::string::npos);
+    EXPECT_NE(response.find("report_builder_reports_generated_total{report=\"sales\"}"), std::string::npos);
+    EXPECT_NE(response.find("report_builder_report_duration_seconds_count{report=\"sales\"}"), std::string::npos);
+    EXPECT_NE(response.find("report_builder_exported_bytes_total{exporter=\"email\"}"), std::string::npos);
+    EXPECT_NE(response.find("# EOF"), std::string::npos);
+}
+
+TEST_F(IntegrationTest, ReportServerAnswersFromResidentDatasets) {
+    const std::string socketPath = "/tmp/report_builder_test_" + std::to_string(getpid()) + ".sock";
+    TReportServer server;
+    ASSERT_TRUE(server.Start(socketPath, 4));
+    TReportClient client(socketPath);
+
+    const std::string request = "source test_integration.csv | where price > 500 | sort units desc | format markdown";
+    auto first = client.Request(request);
+    ASSERT_TRUE(first.Success) << first.Payload;
+
+    // Тот же отчет, собранный напрямую
+    std::string expected;
+    auto report = TReportBuilder()
+                      .SetDataSource(std::make_unique<TCsvDataProvider>("test_integration.csv"))
+                      .AddProcessor(std::make_unique<TFilterProcessor>(
+                          [](const DataRow& row) { return std::get<double>(row.at("price")) > 500.0; }, "price > 500"))
+                      .AddProcessor(std::make_unique<TSortProcessor>("units", false))
+                      .SetFormatter(std::make_unique<TMarkdownFormatter>())
+                      .SetExportStrategy(std::make_unique<TStringExportStrategy>(&expected))
+                      .Build();
+    ASSERT_TRUE(report->Generate().Success);
+    EXPECT_EQ(first.Payload, expected);
+
+    // Повторные и параллельные запросы не разбирают файл заново
+    const uint64_t loads = server.GetDatasets().GetLoadCount();
+    std::vector<std::thread> clients;
+    std::atomic<int> matched{0};
+    for (int i = 0; i < 4; i++) {
+        clients.emplace_back([&] {
+            for (int j = 0; j < 5; j++) {
+                auto response = TReportClient(socketPath).Request(request);
+                matched += response.Success && response.Payload == expected;
+            }
+        });
+    }
+    for (auto& thread : clients) {
+        thread.join();
+    }
+    EXPECT_EQ(matched.load(), 20);
+    EXPECT_EQ(server.GetDatasets().GetLoadCount(), loads);
+
+    // Предпросмотр: первые строки того же отчета
+    auto preview = client.Request("source test_integration.csv | where price > 500 | limit 1 | format text");
+    ASSERT_TRUE(preview.Success) << preview.Payload;
+    EXPECT_NE(preview.Payload.find("Laptop"), std::string::npos);
+    EXPECT_EQ(preview.Payload.find("Phone"), std::string::npos);
+    EXPECT_FALSE(client.Request("source test_integration.csv | limit -1").Success);
+    auto sampled = client.Request("source test_integration.csv | sample reservoir 2 seed 1 | aggregate count units");
+    ASSERT_TRUE(sampled.Success) << sampled.Payload;
+    EXPECT_NE(sampled.Payload.find("ci_high"), std::string::npos);
+    EXPECT_FALSE(client.Request("source test_integration.csv | sample bernoulli 2").Success);
+    {
+        std::ofstream dates("test_integration_dates.csv");
+        dates << "date,amount\n2024-01-02,1\n2024-01-10,2\n2024-01-12T18:30:00,3\n2024-01-16,4\n";
+    }
+    auto weekly = client.Request("source test_integration_dates.csv | where date >= '2024-01-10' | bucket date week as week"
+                                 " | groupby week sum amount | format text");
+    ASSERT_TRUE(weekly.Success) << weekly.Payload;
+    EXPECT_NE(weekly.Payload.find("5           2024-01-08"), std::string::npos) << weekly.Payload;
+    EXPECT_NE(weekly.Payload.find("4           2024-01-15"), std::string::npos) << weekly.Payload;
+    EXPECT_FALSE(client.Request("source test_integration_dates.csv | bucket date fortnight").Success);
+    std::remove("test_integration_dates.csv");
+
+    auto aggregated = client.Request("source test_integration.csv | groupby region sum units | format text");
+    ASSERT_TRUE(aggregated.Success) << aggregated.Payload;
+    EXPECT_NE(aggregated.Payload.find("units_sum"), std::string::npos);
+
+    auto factory = client.Request("factory sales | format markdown");
+    ASSERT_TRUE(factory.Success) << factory.Payload;
+    EXPECT_NE(factory.Payload.find("units"), std::string::npos);
+
+    auto bad = client.Request("source test_integration.csv | explode");
+    EXPECT_FALSE(bad.Success);
+    EXPECT_EQ(bad.Payload, "Unknown stage: explode");
+    EXPECT_FALSE(client.Request("source test_integration.csv | aggregate foo price").Success);
+    EXPECT_FALSE(client.Request("source test_integration.csv | groupby region p95 price").Success);
+    EXPECT_TRUE(client.Request("source test_integration.csv | aggregate p50 price").Success);
+
+    server.Stop();
+    EXPECT_FALSE(std::filesystem::exists(socketPath));
+    EXPECT_FALSE(TReportClient(socketPath).Request("stats").Success);
+}
+
+TEST_F(IntegrationTest, ReportServerClosesIdleConnections) {
+    const std::string socketPath = "/tmp/report_builder_idle_" + std::to_string(getpid()) + ".sock";
+    TReportServer server;
+    server.SetIdleTimeout(std::chrono::milliseconds(50));
+    ASSERT_TRUE(server.Start(socketPath, 1));
+
+    // Простаивающий клиент не держит единственный обработчик
+    int idle = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, socketPath.c_str(), socketPath.size() + 1);
+    ASSERT_EQ(connect(idle, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)), 0);
+    char byte;
+    EXPECT_EQ(recv(idle, &byte, 1, 0), 0);
+    close(idle);
+
+    auto response = TReportClient(socketPath).Request("stats");
+    EXPECT_TRUE(response.Success) << response.Payload;
+    server.Stop();
+}
+
+TEST_F(IntegrationTest, DatasetCacheEvictsLeastRecentlyUsed) {
+    TMetricsRegistry registry;
+    TDatasetCache cache(registry);
+    auto load = [](int rows) {
+        return [rows] {
+            DataTable data(static_cast<size_t>(rows), DataRow{{"value", 1}});
+            return TOperationResult::Ok(std::move(data));
+        };
+    };
+    std::string error;
+    auto first = cache.Get("a", {}, load(100), error);
+    ASSERT_TRUE(first);
+    const size_t tableBytes = first->GetMemoryBytes();
+    cache.SetMemoryLimit(tableBytes * 2);
+    ASSERT_TRUE(cache.Get("b", {}, load(100), error));
+    ASSERT_TRUE(cache.Get("a", {}, load(100), error)); // "a" использован последним
+    ASSERT_TRUE(cache.Get("c", {}, load(100), error));
+
+    EXPECT_EQ(cache.GetDatasetCount(), 2u);
+    EXPECT_EQ(cache.GetEvictionCount(), 1u);
+    EXPECT_LE(cache.GetMemoryBytes(), tableBytes * 2);
+    const uint64_t loads = cache.GetLoadCount();
+    cache.Get("a", {}, load(100), error);
+    EXPECT_EQ(cache.GetLoadCount(), loads);
+    cache.Get("b", {}, load(100), error);
+    EXPECT_EQ(cache.GetLoadCount(), loads + 1);
+    // Вытесненная таблица остается доступной тем, кто ее уже читает
+    EXPECT_EQ(first->size(), 100u);
+}
@@ -1,14 +1,22 @@
 #include <gtest/gtest.h>
 #include <filesystem>
 #include <fstream>
+#include <set>
+#include <thread>
 
 #include "report_builder/data_types.h"
+#include "report_builder/dictionary_encoding.h"
 #include "report_builder/interfaces.h"
 #include "report_builder/data_providers.h"
 #include "report_builder/data_processors.h"
 #include "report_builder/formatters.h"
+#include "report_builder/join_processor.h"
 #include "report_builder/export_strategies.h"
 #include "report_builder/report_builder.h"
+#include "report_builder/report_factories.h"
+#include "report_builder/window_processor.h"
+
+REPORT_BUILDER_DEFINE_ALLOCATION_TRACKING()
 
 namespace fs = std::filesystem;
 using namespace report_builder;
@@ -65,6 +73,273 @@ TEST_F(DataProvidersTest, CsvDataProviderWorks) {
     }
 }
 
+TEST_F(DataProvidersTest, CsvDataProviderReadsCompressedFiles) {
+    std::string csv = "id,region,price\n";
+    for (int i = 0; i < 20000; i++) {
+        csv += std::to_string(i) + "," + (i % 3 ? "east" : "west") + "," + std::to_string(i * 0.5) + "\n";
+    }
+    {
+        std::ofstream file("test_compressed.csv");
+        file << csv;
+    }
+    auto expected = TCsvDataProvider("test_compressed.csv").FetchData();
+    ASSERT_TRUE(expected.Success);
+    std::remove("test_compressed.csv");
+
+    const ECompression codec = ECompression::Gzip;
+    if (!IsCompressionAvailable(codec)) {
+        GTEST_SKIP() << "gzip is not available in this build";
+    }
+    const std::string path = std::string("test_compressed.csv") + CompressionExtension(codec);
+    TCompressionOptions options;
+    options.Codec = codec;
+    {
+        TCompressedFileWriter writer(options);
+        EXPECT_THROW(writer.Write(csv), std::logic_error);
+        ASSERT_TRUE(writer.Open(path));
+        ASSERT_TRUE(writer.Write(csv));
+        ASSERT_TRUE(writer.Close());
+        EXPECT_THROW(writer.Write(csv), std::logic_error);
+    }
+    EXPECT_EQ(DetectFileCompression(path), codec);
+
+    auto result = TCsvDataProvider(path).FetchData();
+    ASSERT_TRUE(result.Success) << *result.ErrorMessage;
+    EXPECT_EQ(result.Data, expected.Data);
+
+    // Чтение по лимиту останавливает распаковку, не дочитав файл
+    TCsvDataProvider head(path);
+    ASSERT_TRUE(head.PushDownLimit({10, {}, ""}));
+    auto first = head.FetchData();
+    ASSERT_TRUE(first.Success);
+    ASSERT_EQ(first.Data.size(), 10);
+    EXPECT_EQ(std::get<int>(first.Data.back()["id"]), 9);
+
+    // Обрезанный архив - ошибка, а не молча потерянные строки
+    std::ifstream in(path, std::ios::binary);
+    std::string compressed((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    in.close();
+    std::ofstream(path, std::ios::binary | std::ios::trunc) << compressed.substr(0, compressed.size() / 2);
+    auto truncated = TCsvDataProvider(path).FetchData();
+    EXPECT_FALSE(truncated.Success);
+    EXPECT_NE(truncated.ErrorMessage->find("Truncated"), std::string::npos);
+    std::remove(path.c_str());
+}
+
+TEST_F(DataProvidersTest, CsvDataProviderInfersColumnTypes) {
+    {
+        std::ofstream file("test_schema.csv");
+        file << "id,price,code,flag,note\r\n";
+        file << "9,1.5,007,true,a\r\n";
+        file << "10,2,x12,false,\r\n";
+        file << "+11,,42,TRUE,c\r\n";
+        file << "n/a,4.25,13,maybe,d\r\n";
+    }
+
+    TCsvSchemaOptions options;
+    options.SampleRows = 3;
+    options.DeclaredTypes["code"] = EFieldType::String;
+    TCsvDataProvider provider("test_schema.csv", ',', {}, options);
+    auto result = provider.FetchData();
+    ASSERT_TRUE(result.Success);
+    ASSERT_EQ(result.Data.size(), 4);
+
+    // Тип выводится по первым трем строкам; объявленный тип важнее
+    const std::vector<std::pair<std::string, EFieldType>> schema = {
+        {"id", EFieldType::Int},
+        {"price", EFieldType::Double},
+        {"code", EFieldType::String},
+        {"flag", EFieldType::Bool},
+        {"note", EFieldType::String},
+    };
+    EXPECT_EQ(provider.GetSchema(), schema);
+    EXPECT_EQ(std::get<int>(result.Data[2]["id"]), 11);
+    EXPECT_EQ(std::get<double>(result.Data[1]["price"]), 2.0);
+    EXPECT_EQ(std::get<std::string>(result.Data[0]["code"]), "007");
+    EXPECT_EQ(std::get<bool>(result.Data[2]["flag"]), true);
+    EXPECT_EQ(std::get<std::string>(result.Data[1]["note"]), "");
+    EXPECT_EQ(result.Data[2].count("price"), 0);
+
+    // Значения не своего типа остаются строками и попадают в отчет
+    ASSERT_EQ(provider.GetIssueCount(), 2);
+    EXPECT_EQ(provider.GetParseIssues()[0].Line, 5);
+    EXPECT_EQ(provider.GetParseIssues()[0].Column, "id");
+    EXPECT_EQ(provider.GetParseIssues()[0].Value, "n/a");
+    EXPECT_EQ(provider.GetParseIssues()[1].Expected, EFieldType::Bool);
+    EXPECT_EQ(std::get<std::string>(result.Data[3]["id"]), "n/a");
+    EXPECT_EQ(std::get<std::string>(result.Data[3]["flag"]), "maybe");
+    EXPECT_EQ(std::get<double>(result.Data[3]["price"]), 4.25);
+
+    // Сортировка видит числа, а не строки: 9 < 10 < 11
+    auto sorted = TSortProcessor("id").Process(result.Data);
+    ASSERT_TRUE(sorted.Success);
+    EXPECT_EQ(std::get<int>(sorted.Data[0]["id"]), 9);
+    EXPECT_EQ(std::get<int>(sorted.Data[2]["id"]), 11);
+
+    options.FailOnIssues = true;
+    auto strict = TCsvDataProvider("test_schema.csv", ',', {}, options).FetchData();
+    EXPECT_FALSE(strict.Success);
+    EXPECT_NE(strict.ErrorMessage->find("Line 5"), std::string::npos);
+    std::remove("test_schema.csv");
+}
+
+TEST_F(DataProvidersTest, CsvDataProviderKeepsValuesOutsideInferredType) {
+    {
+        std::ofstream file("test_outliers.csv");
+        file << "id,price\n";
+        file << "1,10\n2,n/a\n";
+        for (int i = 3; i <= 20; i++) {
+            file << i << "," << i << "\n";
+        }
+        file << "21,3000000000\n22,oops\n";
+    }
+    TCsvSchemaOptions options;
+    options.SampleRows = 10;
+    TCsvDataProvider provider("test_outliers.csv", ',', {}, options);
+    auto result = provider.FetchData();
+    ASSERT_TRUE(result.Success);
+    ASSERT_EQ(result.Data.size(), 22);
+
+    // Один выброс в образце не делает колонку строковой; за образцом правило то же
+    EXPECT_EQ(provider.GetSchema()[1].second, EFieldType::Int);
+    EXPECT_EQ(std::get<std::string>(result.Data[1]["price"]), "n/a");
+    EXPECT_EQ(std::get<int64_t>(result.Data[20]["price"]), 3000000000);
+    EXPECT_EQ(std::get<std::string>(result.Data[21]["price"]), "oops");
+    EXPECT_EQ(provider.GetIssueCount(), 2);
+
+    auto sum = TAggregationProcessor("price", "sum").Process(result.Data);
+    ASSERT_TRUE(sum.Success);
+    EXPECT_EQ(std::get<double>(sum.Data[0]["value"]), 10.0 + 207.0 + 3000000000.0);
+    EXPECT_EQ(std::get<int>(sum.Data[0]["count"]), 20);
+    std::remove("test_outliers.csv");
+}
+
+TEST_F(DataProvidersTest, CsvDataProviderKeepsLargeIntegersExact) {
+    {
+        std::ofstream file("test_wide.csv");
+        file << "id,units\n";
+        file << "9007199254740993,1\n-2147483649,2\n99999999999999999999,3\n9007199254740992,4\n";
+    }
+    auto result = TCsvDataProvider("test_wide.csv").FetchData();
+    std::remove("test_wide.csv");
+    ASSERT_TRUE(result.Success);
+    ASSERT_EQ(result.Data.size(), 4);
+
+    // Целые за пределами int - int64_t без потери точности, за пределами int64_t - double
+    EXPECT_EQ(std::get<int64_t>(result.Data[0]["id"]), 9007199254740993);
+    EXPECT_EQ(std::get<int64_t>(result.Data[1]["id"]), -2147483649);
+    EXPECT_DOUBLE_EQ(std::get<double>(result.Data[2]["id"]), 1e20);
+    EXPECT_EQ(std::get<int>(result.Data[0]["units"]), 1);
+    EXPECT_EQ(std::get<int64_t>(MakeInteger(int64_t{1} << 31)), int64_t{1} << 31);
+    EXPECT_EQ(std::get<int>(MakeInteger(-5)), -5);
+
+    // Соседние значения, неразличимые в double, сортируются точно
+    auto sorted = TSortProcessor("id").Process(result.Data);
+    ASSERT_TRUE(sorted.Success);
+    EXPECT_EQ(std::get<int>(sorted.Data[0]["units"]), 2);
+    EXPECT_EQ(std::get<int>(sorted.Data[1]["units"]), 4);
+    EXPECT_EQ(std::get<int>(sorted.Data[2]["units"]), 1);
+    EXPECT_EQ(std::get<int>(sorted.Data[3]["units"]), 3);
+
+    EXPECT_EQ(TCompactTable::FromRows(result.Data).ToRows(), result.Data);
+    TRowCodec codec;
+    std::string encoded;
+    for (const auto& row : result.Data) {
+        codec.Encode(row, encoded);
+    }
+    const char* pos = encoded.data();
+    for (const auto& row : result.Data) {
+        DataRow decoded;
+        ASSERT_TRUE(codec.Decode(pos, encoded.data() + encoded.size(), decoded));
+        EXPECT_EQ(decoded, row);
+    }
+
+    auto grouped = TGroupByProcessor({"id"}, {{"units", "count"}}).Process(result.Data);
+    ASSERT_TRUE(grouped.Success);
+    EXPECT_EQ(grouped.Data.size(), 4);
+}
+
+TEST(PartitionedProviderTest, PrunesFilesByPartitionColumns) {
+    const fs::path root = "test_partitions";
+    fs::remove_all(root);
+    for (const char* region : {"North", "South", "West%20Coast"}) {
+        fs::create_directories(root / (std::string("region=") + region));
+        for (int day = 1; day <= 3; day++) {
+            std::ofstream file(root / (std::string("region=") + region) / ("day=" + std::to_string(day) + ".csv"));
+            file << "product,units\n";
+            file << "apple," << day * 10 << "\n";
+            file << "pear," << day << (day == 2 ? ".5" : "") << "\n";
+        }
+    }
+    std::ofstream(root / "README.txt") << "not a partition";
+
+    TPartitionedCsvOptions options;
+    options.Threads = 4;
+    TPartitionedCsvDataProvider all(root.string(), options);
+    auto everything = all.FetchData();
+    ASSERT_TRUE(everything.Success) << *everything.ErrorMessage;
+    EXPECT_EQ(everything.Data.size(), 18);
+    EXPECT_EQ(all.GetFilesRead(), 9);
+    // Строки идут в порядке путей, значения разделов типизированы и раскодированы
+    EXPECT_EQ(everything.Data[0].at("region"), DataValue(std::string("North")));
+    EXPECT_EQ(std::get<int>(everything.Data[0].at("day")), 1);
+    EXPECT_EQ(ValueToString(everything.Data.back().at("region")), "West Coast");
+    // В одном файле units дробные, поэтому колонка везде double
+    EXPECT_TRUE(std::holds_alternative<double>(everything.Data[0].at("units")));
+
+    // День и регион - один файл из девяти
+    TPartitionedCsvDataProvider oneDay(root.string(), options);
+    oneDay.WherePartition("region", std::string("South")).WherePartition("day", 2);
+    auto result = oneDay.FetchData();
+    ASSERT_TRUE(result.Success);
+    EXPECT_EQ(oneDay.GetFilesRead(), 1);
+    EXPECT_EQ(oneDay.GetFilesPruned(), 8);
+    ASSERT_EQ(result.Data.size(), 2);
+    EXPECT_EQ(std::get<double>(result.Data[1].at("units")), 2.5);
+    EXPECT_EQ(oneDay.GetSourceInfo(), "Partitioned CSV: test_partitions where region = South AND day = 2");
+
+    // Шаблон пути
+    TPartitionedCsvDataProvider glob((root / "*" / "day=?.csv").string(), options);
+    glob.AddPartitionFilter("day", [](const DataValue& day) { return std::get<int>(day) >= 2; }, "day >= 2");
+    ASSERT_TRUE(glob.FetchData().Success);
+    EXPECT_EQ(glob.GetFilesRead(), 6);
+
+    // С лимитом файлы открываются, пока не наберется нужное число строк
+    options.Threads = 1;
+    TPartitionedCsvDataProvider preview(root.string(), options);
+    ASSERT_TRUE(preview.PushDownLimit({3, {}, ""}));
+    auto head = preview.FetchData();
+    ASSERT_TRUE(head.Success);
+    EXPECT_EQ(head.Data, DataTable(everything.Data.begin(), everything.Data.begin() + 3));
+    EXPECT_EQ(preview.GetFilesRead(), 2);
+
+    // Условие лимита по колонке раздела проверяется после добавления колонок разделов
+    TPartitionedCsvDataProvider south(root.string(), options);
+    ASSERT_TRUE(south.PushDownLimit(
+        {3, [](const DataRow& row) { return std::get<std::string>(row.at("region")) == "South"; }, "region = South"}));
+    auto southHead = south.FetchData();
+    ASSERT_TRUE(southHead.Success);
+    ASSERT_EQ(southHead.Data.size(), 3);
+    EXPECT_EQ(ValueToString(southHead.Data[2].at("region")), "South");
+
+    auto limited = TReportBuilder()
+                       .SetDataSource(std::make_unique<TPartitionedCsvDataProvider>(root.string(), options))
+                       .AddProcessor(std::make_unique<TFilterProcessor>(FieldEquals("region", "South"), "region = South"))
+                       .AddProcessor(std::make_unique<TLimitProcessor>(1))
+                       .SetFormatter(std::make_unique<TPlainTextFormatter>())
+                       .SetExportStrategy(std::make_unique<TConsoleExportStrategy>())
+                       .EnableQueryPlanner(true)
+                       .Build();
+    EXPECT_NE(limited->Explain().find("first 1 rows where region = South"), std::string::npos);
+    auto limitedResult = limited->Generate();
+    ASSERT_TRUE(limitedResult.Success);
+    ASSERT_EQ(limitedResult.Data.size(), 1);
+    EXPECT_EQ(ValueToString(limitedResult.Data[0].at("region")), "South");
+
+    EXPECT_FALSE(TPartitionedCsvDataProvider("test_partitions_missing").FetchData().Success);
+    fs::remove_all(root);
+}
+
 TEST(DataProcessorsTest, FilterProcessorWorks) {
     DataTable testData = {
         {{"id", 1}, {"age", 25}, {"active", true}},
@@ -104,6 +379,133 @@ TEST(DataProcessorsTest, SortProcessorWorks) {
     EXPECT_EQ(std::get<int>(result.Data[2]["age"]), 20); // Самый маленький последний
 }
 
+TEST(DataProcessorsTest, ExternalSortReadsRowsFromSource) {
+    {
+        std::ofstream file("test_sort_source.csv");
+        file << "id,key,group\n";
+        for (int i = 0; i < 500; i++) {
+            file << i << ",key_" << (i * 7919) % 1000 << ",g" << i % 5 << "\n";
+        }
+    }
+    TDictionaryEncodingOptions dictionary;
+    dictionary.Enabled = true;
+    auto makeReport = [&dictionary](bool streaming, std::string* output, size_t budget = 4096) {
+        return TReportBuilder()
+            .SetDataSource(std::make_unique<TCsvDataProvider>("test_sort_source.csv", ',', dictionary))
+            .AddProcessor(std::make_unique<TSortProcessor>("key", true, budget))
+            .SetFormatter(std::make_unique<TPlainTextFormatter>())
+            .SetExportStrategy(std::make_unique<TStringExportStrategy>(output))
+            .EnableStreamingOutput(streaming)
+            .EnableInstrumentation()
+            .Build();
+    };
+
+    // Серии пишутся по ходу чтения; без потокового вывода результат собирается в таблицу
+    std::string materializedText;
+    auto materialized = makeReport(false, &materializedText);
+    auto result = materialized->Generate();
+    ASSERT_TRUE(result.Success);
+    ASSERT_EQ(result.Data.size(), 500);
+    EXPECT_TRUE(std::is_sorted(result.Data.begin(), result.Data.end(), [](const DataRow& a, const DataRow& b) {
+        return CompareValues(a.at("key"), b.at("key")) < 0;
+    }));
+    const auto& stages = materialized->GetLastStats()->Stages;
+    ASSERT_GE(stages.size(), 2);
+    EXPECT_EQ(stages[0].Stage, "provider");
+    EXPECT_EQ(stages[0].RowsOut, 500);
+    EXPECT_EQ(stages[1].RowsOut, 500);
+    // Строки, прошедшие мимо таблицы поставщика, словарем не кодируются
+    EXPECT_TRUE(std::holds_alternative<std::string>(result.Data[0]["group"]));
+
+    // Файл, который помещается в бюджет, читается целиком и сортируется в памяти
+    std::string inMemoryText;
+    auto inMemory = makeReport(false, &inMemoryText, TSortProcessor::DefaultMemoryBudget)->Generate();
+    ASSERT_TRUE(inMemory.Success);
+    EXPECT_TRUE(std::holds_alternative<TDictString>(inMemory.Data[0]["group"]));
+    EXPECT_EQ(inMemoryText, materializedText);
+
+    std::string streamedText;
+    auto streamed = makeReport(true, &streamedText)->Generate();
+    ASSERT_TRUE(streamed.Success);
+    EXPECT_TRUE(streamed.Data.empty());
+    EXPECT_EQ(streamedText, materializedText);
+    std::remove("test_sort_source.csv");
+}
+
+TEST(DataProcessorsTest, SortProcessorOrdersMixedKinds) {
+    // Столбец после CSV с выбросами: числа, строки, даты и строки без поля
+    DataTable testData = {
+        {{"id", 1}, {"v", std::string("n/a")}},
+        {{"id", 2}, {"v", 10}},
+        {{"id", 3}},
+        {{"id", 4}, {"v", TTimestamp::FromDate(2024, 1, 1)}},
+        {{"id", 5}, {"v", 2.5}},
+        {{"id", 6}, {"v", std::string("2023-12-31")}},
+        {{"id", 7}, {"v", std::nan("")}},
+        {{"id", 8}, {"v", true}},
+    };
+
+    auto result = TSortProcessor("v").Process(testData);
+    ASSERT_TRUE(result.Success);
+    std::vector<int> ids;
+    for (auto& row : result.Data) {
+        ids.push_back(std::get<int>(row["id"]));
+    }
+    // Числа (NaN последним), логические, даты, строки, строки без поля
+    EXPECT_EQ(ids, (std::vector<int>{5, 2, 7, 8, 4, 6, 1, 3}));
+    for (size_t i = 0; i < testData.size(); i++) {
+        for (size_t j = 0; j < testData.size(); j++) {
+            if (testData[i].count("v") && testData[j].count("v")) {
+                EXPECT_EQ(CompareValues(testData[i]["v"], testData[j]["v"]),
+                          -CompareValues(testData[j]["v"], testData[i]["v"]));
+            }
+        }
+    }
+}
+
+TEST(DataProcessorsTest, SortProcessorSpillsToDiskOverBudget) {
+    DataTable testData;
+    for (int i = 0; i < 500; i++) {
+        testData.push_back({{"id", i}, {"key", "k" + std::to_string((i * 7919) % 1000)}});
+    }
+
+    auto inMemory = std::make_unique<TSortProcessor>("key")->Process(testData);
+    auto external = std::make_unique<TSortProcessor>("key", true, 4096)->Process(testData);
+
+    EXPECT_TRUE(external.Success);
+    ASSERT_EQ(external.Data.size(), inMemory.Data.size());
+    for (size_t i = 0; i < external.Data.size(); i++) {
+        EXPECT_EQ(std::get<std::string>(external.Data[i]["key"]), std::get<std::string>(inMemory.Data[i]["key"]));
+    }
+}
+
+TEST(DataProcessorsTest, ExternalSortStreamsIntoFormatter) {
+    DataTable testData;
+    for (int i = 0; i < 100; i++) {
+        testData.push_back({{"n", std::to_string(100 + (i * 37) % 100)}});
+    }
+
+    auto report = TReportBuilder()
+                      .SetDataSource(std::make_unique<TInMemoryDataProvider>(testData))
+                      .AddProcessor(std::make_unique<TSortProcessor>("n", false, 1024))
+                      .SetFormatter(std::make_unique<TMarkdownFormatter>())
+                      .SetExportStrategy(std::make_unique<TConsoleExportStrategy>())
+                      .EnableStreamingOutput()
+                      .Build();
+
+    testing::internal::CaptureStdout();
+    auto result = report->Generate();
+    std::string output = testing::internal::GetCapturedStdout();
+
+    EXPECT_TRUE(result.Success);
+    EXPECT_TRUE(result.Data.empty()); // Строки ушли в форматировщик потоком
+    auto first = output.find("| 199 |");
+    auto last = output.find("| 100 |");
+    ASSERT_NE(first, std::string::npos);
+    ASSERT_NE(last, std::string::npos);
+    EXPECT_LT(first, last);
+}
+
 TEST(DataProcessorsTest, AggregationProcessorWorks) {
     DataTable testData = {
         {{"id", 1}, {"salary", 50000}},
@@ -191,6 +593,604 @@ TEST(DataProcessorsTest, AggregationProcessorSumWorks) {
     EXPECT_DOUBLE_EQ(std::get<double>(aggRow["value"]), 600.0); // 100+200+300
 }
 
+TEST(DictionaryEncodingTest, EncodesLowCardinalityColumns) {
+    DataTable testData;
+    const std::vector<std::string> regions = {"North", "South", "East"};
+    for (int i = 0; i < 90; i++) {
+        testData.push_back({{"id", i}, {"region", regions[i % 3]}, {"name", "Item" + std::to_string(i)}});
+    }
+
+    // Кодирование включается явно: без него строки остаются std::string
+    EXPECT_EQ(DictionaryEncode(testData), 0);
+    EXPECT_TRUE(std::holds_alternative<std::string>(testData[0]["region"]));
+    TDictionaryEncodingOptions dictionary;
+    dictionary.Enabled = true;
+    EXPECT_EQ(DictionaryEncode(testData, dictionary), 1);
+    EXPECT_TRUE(std::holds_alternative<TDictString>(testData[0]["region"]));
+    EXPECT_THROW(TDictString(nullptr, 0), std::out_of_range);
+    EXPECT_THROW(TDictString(std::get<TDictString>(testData[0]["region"]).Dict, 3), std::out_of_range);
+    EXPECT_TRUE(std::holds_alternative<std::string>(testData[0]["name"]));
+    EXPECT_EQ(std::get<TDictString>(testData[1]["region"]).Str(), "South");
+    EXPECT_EQ(std::get<TDictString>(testData[0]["region"]).Dict->Size(), 3);
+
+    // Фильтр и сортировка работают по кодам
+    auto filter = std::make_unique<TFilterProcessor>(FieldEquals("region", "North"), "region = North");
+    auto filtered = filter->Process(testData);
+    EXPECT_EQ(filtered.Data.size(), 30);
+
+    auto sorter = std::make_unique<TSortProcessor>("region");
+    auto sorted = sorter->Process(testData);
+    EXPECT_EQ(ValueToString(sorted.Data.front()["region"]), "East");
+    EXPECT_EQ(ValueToString(sorted.Data.back()["region"]), "South");
+
+    // Обычная и словарная строка с одним текстом - один ключ группировки и партиции
+    testData.push_back({{"id", 90}, {"region", std::string("North")}});
+    auto grouped = TGroupByProcessor({"region"}, {{"id", "count"}}).Process(testData);
+    ASSERT_TRUE(grouped.Success);
+    ASSERT_EQ(grouped.Data.size(), 3);
+    EXPECT_EQ(ValueToString(grouped.Data[1]["region"]), "North");
+    EXPECT_EQ(std::get<int>(grouped.Data[1]["id_count"]), 31);
+
+    TWindowProcessor window({"region"}, "id", {{EWindowFunction::CumulativeSum, "id", "running", 1}});
+    auto windowed = window.Process(testData);
+    ASSERT_TRUE(windowed.Success);
+    EXPECT_EQ(std::get<int>(windowed.Data[60]["id"]), 90);
+    EXPECT_EQ(ValueToString(windowed.Data[61]["region"]), "South");
+    EXPECT_EQ(HashKeyValue(testData[0]["region"]), HashKeyValue(DataValue(std::string("North"))));
+    EXPECT_TRUE(KeyValueEqual(testData[0]["region"], DataValue(std::string("North"))));
+}
+
+TEST(CompactTableTest, StoresCellsInSixteenBytes) {
+    static_assert(sizeof(TCompactValue) == 16);
+
+    TStringArena arena;
+    auto big = TCompactValue::FromInt(std::numeric_limits<int64_t>::min());
+    EXPECT_EQ(big.AsInt(), std::numeric_limits<int64_t>::min());
+    auto shortString = TCompactValue::FromString("fourteen chars", arena);
+    EXPECT_EQ(shortString.GetType(), ECompactType::ShortString);
+    EXPECT_EQ(shortString.AsString(), "fourteen chars");
+    auto longString = TCompactValue::FromString("a string that does not fit inline", arena);
+    EXPECT_EQ(longString.GetType(), ECompactType::LongString);
+    EXPECT_EQ(longString.AsString(), "a string that does not fit inline");
+    EXPECT_EQ(TCompactValue::FromString("a string that does not fit inline", arena).AsString().data(),
+              longString.AsString().data());
+
+    // Таблица с пропусками, словарной колонкой и длинными строками
+    DataTable rows;
+    for (int i = 0; i < 500; i++) {
+        DataRow row = {{"id", i},
+                       {"price", i * 0.25},
+                       {"active", i % 2 == 0},
+                       {"region", std::string(i % 3 ? "east" : "west")},
+                       {"comment", "order number " + std::to_string(i) + " shipped"}};
+        if (i % 10 == 0) {
+            row.erase("price");
+        }
+        rows.push_back(std::move(row));
+    }
+    TDictionaryEncodingOptions dictionary;
+    dictionary.Enabled = true;
+    DictionaryEncode(rows, dictionary);
+    ASSERT_TRUE(std::holds_alternative<TDictString>(rows[0]["region"]));
+
+    auto table = TCompactTable::FromRows(rows);
+    EXPECT_EQ(table.size(), rows.size());
+    EXPECT_EQ(table.GetColumns().size(), 5);
+    EXPECT_TRUE(table.At(0, *table.FindColumn("price")).IsNull());
+    EXPECT_EQ(table.GetString(1, *table.FindColumn("region")), "east");
+
+    auto restored = table.ToRows();
+    EXPECT_EQ(restored, rows);
+    EXPECT_TRUE(std::holds_alternative<TDictString>(restored[0]["region"]));
+    EXPECT_LT(table.GetMemoryBytes(), EstimateTableBytes(rows) / 3);
+
+    // Фильтр читает ячейки таблицы напрямую
+    const size_t id = *table.FindColumn("id");
+    TCompactDataProvider provider(std::make_shared<const TCompactTable>(std::move(table)), "compact",
+                                  [id](const TCompactTable& source, size_t row) { return source.At(row, id).AsInt() < 5; });
+    auto fetched = provider.FetchData();
+    ASSERT_TRUE(fetched.Success);
+    EXPECT_EQ(fetched.Data, DataTable(rows.begin(), rows.begin() + 5));
+}
+
+TEST(DataProcessorsTest, GroupByProcessorWorks) {
+    DataTable testData = {
+        {{"region", std::string("North")}, {"units", 15}},
+        {{"region", std::string("South")}, {"units", 32}},
+        {{"region", std::string("North")}, {"units", 21}},
+    };
+
+    auto groupBy = std::make_unique<TGroupByProcessor>(
+        std::vector<std::string>{"region"},
+        std::vector<std::pair<std::string, std::string>>{{"units", "sum"}, {"units", "count"}});
+    auto result = groupBy->Process(testData);
+
+    EXPECT_TRUE(result.Success);
+    ASSERT_EQ(result.Data.size(), 2);
+    EXPECT_EQ(std::get<std::string>(result.Data[0]["region"]), "North");
+    EXPECT_DOUBLE_EQ(std::get<double>(result.Data[0]["units_sum"]), 36.0);
+    EXPECT_EQ(std::get<int>(result.Data[0]["units_count"]), 2);
+}
+
+TEST(JoinProcessorTest, InnerAndLeftJoinWork) {
+    DataTable sales = {
+        {{"product", std::string("Laptop")}, {"region", std::string("North")}, {"units", 15}},
+        {{"product", std::string("Phone")}, {"region", std::string("South")}, {"units", 32}},
+        {{"product", std::string("Tablet")}, {"region", std::string("North")}, {"units", 21}},
+    };
+    DataTable managers = {
+        {{"region", std::string("North")}, {"manager", std::string("Ivanov")}},
+        {{"region", std::string("East")}, {"manager", std::string("Petrov")}},
+    };
+
+    auto inner = std::make_unique<THashJoinProcessor>(std::make_unique<TInMemoryDataProvider>(managers),
+                                                      std::vector<std::string>{"region"},
+                                                      std::vector<std::string>{"region"});
+    auto innerResult = inner->Process(sales);
+    EXPECT_TRUE(innerResult.Success);
+    ASSERT_EQ(innerResult.Data.size(), 2);
+    EXPECT_EQ(std::get<std::string>(innerResult.Data[0]["manager"]), "Ivanov");
+    EXPECT_EQ(std::get<std::string>(innerResult.Data[1]["product"]), "Tablet");
+
+    TJoinOptions leftOptions;
+    leftOptions.Type = EJoinType::Left;
+    auto left = std::make_unique<THashJoinProcessor>(std::make_unique<TInMemoryDataProvider>(managers),
+                                                     std::vector<std::string>{"region"},
+                                                     std::vector<std::string>{"region"}, leftOptions);
+    auto leftResult = left->Process(sales);
+    EXPECT_TRUE(leftResult.Success);
+    ASSERT_EQ(leftResult.Data.size(), 3);
+    EXPECT_EQ(leftResult.Data[1].count("manager"), 0); // Для South менеджера нет
+}
+
+TEST(JoinProcessorTest, MultiColumnJoinSpillsToDisk) {
+    DataTable left;
+    DataTable right;
+    for (int i = 0; i < 200; i++) {
+        left.push_back({{"year", 2024 + i % 2}, {"month", i % 12}, {"id", i}});
+    }
+    for (int year = 2024; year <= 2025; year++) {
+        for (int month = 0; month < 12; month++) {
+            right.push_back({{"year", year}, {"month", month}, {"plan", year * 100 + month}});
+        }
+    }
+
+    TJoinOptions options;
+    options.MaxBuildBytes = 0; // Принудительный сброс на диск
+    options.SpillPartitions = 4;
+    auto join = std::make_unique<THashJoinProcessor>(std::make_unique<TInMemoryDataProvider>(right),
+                                                     std::vector<std::string>{"year", "month"},
+                                                     std::vector<std::string>{"year", "month"}, options);
+    auto result = join->Process(left);
+
+    EXPECT_TRUE(result.Success);
+    ASSERT_EQ(result.Data.size(), 200);
+    for (auto& row : result.Data) {
+        EXPECT_EQ(std::get<int>(row["plan"]), std::get<int>(row["year"]) * 100 + std::get<int>(row["month"]));
+    }
+}
+
+TEST(JoinProcessorTest, ReadsRightSideRowByRow) {
+    // Поставщик отдает строки только по одной: соединению FetchData не нужен
+    class TRowsOnlyProvider: public IDataProvider {
+    public:
+        DataTable Rows;
+
+        explicit TRowsOnlyProvider(DataTable rows)
+            : Rows(std::move(rows)) {
+        }
+
+        TOperationResult FetchData() override {
+            return TOperationResult::Error("FetchData is not expected");
+        }
+
+        std::optional<TOperationResult> FetchRows(const TRowSink& sink) override {
+            for (const auto& row : Rows) {
+                sink(DataRow(row));
+            }
+            return TOperationResult::Ok({});
+        }
+
+        std::string GetSourceInfo() const override {
+            return "rows only";
+        }
+    };
+
+    DataTable left;
+    DataTable right;
+    for (int i = 0; i < 300; i++) {
+        left.push_back({{"id", i}, {"key", i % 30}});
+    }
+    for (int i = 0; i < 600; i++) {
+        right.push_back({{"key", i % 60}, {"value", i}});
+    }
+
+    // Обе стороны в памяти; хеш по левой стороне с зондированием по ходу чтения;
+    // партиции на диске с повторным разбиением
+    for (size_t budget : {size_t{1} << 30, EstimateTableBytes(left), size_t{0}}) {
+        TJoinOptions options;
+        options.Type = EJoinType::Left;
+        options.MaxBuildBytes = budget;
+        options.SpillPartitions = 2;
+        THashJoinProcessor join(std::make_unique<TRowsOnlyProvider>(right), {"key"}, {"key"}, options);
+        auto result = join.Process(left);
+        ASSERT_TRUE(result.Success) << *result.ErrorMessage;
+        ASSERT_EQ(result.Data.size(), 3000) << "budget " << budget;
+        for (auto& row : result.Data) {
+            EXPECT_EQ(std::get<int>(row["value"]) % 60, std::get<int>(row["key"]));
+        }
+    }
+}
+
+TEST(WindowProcessorTest, RunningTotalsAndMovingWindows) {
+    DataTable testData = {
+        {{"date", std::string("2024-01-03")}, {"region", std::string("North")}, {"revenue", 12000}},
+        {{"date", std::string("2024-01-01")}, {"region", std::string("North")}, {"revenue", 15000}},
+        {{"date", std::string("2024-01-02")}, {"region", std::string("North")}, {"revenue", 18000}},
+        {{"date", std::string("2024-01-01")}, {"region", std::string("South")}, {"revenue", 5000}},
+    };
+
+    auto window = std::make_unique<TWindowProcessor>(
+        std::vector<std::string>{"region"}, "date",
+        std::vector<TWindowSpec>{
+            {EWindowFunction::CumulativeSum, "revenue", "running", 1},
+            {EWindowFunction::MovingAverage, "revenue", "avg2", 2},
+            {EWindowFunction::Lag, "revenue", "prev", 1},
+            {EWindowFunction::Delta, "revenue", "", 1},
+        });
+    auto result = window->Process(testData);
+
+    EXPECT_TRUE(result.Success);
+    ASSERT_EQ(result.Data.size(), 4);
+
+    auto& north = result.Data;
+    EXPECT_EQ(std::get<std::string>(north[0]["date"]), "2024-01-01");
+    EXPECT_DOUBLE_EQ(std::get<double>(north[0]["running"]), 15000.0);
+    EXPECT_DOUBLE_EQ(std::get<double>(north[1]["running"]), 33000.0);
+    EXPECT_DOUBLE_EQ(std::get<double>(north[2]["running"]), 45000.0);
+    EXPECT_DOUBLE_EQ(std::get<double>(north[2]["avg2"]), 15000.0); // (18000 + 12000) / 2
+    EXPECT_EQ(north[0].count("prev"), 0);
+    EXPECT_EQ(std::get<int>(north[1]["prev"]), 15000);
+    EXPECT_DOUBLE_EQ(std::get<double>(north[2]["revenue_delta"]), -6000.0);
+
+    // Партиция South считается отдельно
+    EXPECT_DOUBLE_EQ(std::get<double>(result.Data[3]["running"]), 5000.0);
+}
+
+TEST(WindowProcessorTest, MovingSumDoesNotDriftAfterLargeValues) {
+    // Большое значение поглощает соседние единицы, но после выхода из окна не искажает сумму
+    DataTable testData;
+    for (int i = 0; i < 1000; i++) {
+        testData.push_back({{"id", i}, {"amount", i % 100 == 0 ? 1e16 : 0.1}});
+    }
+    TWindowProcessor window({}, "id", {{EWindowFunction::MovingSum, "amount", "sum3", 3}});
+    auto result = window.Process(testData);
+    ASSERT_TRUE(result.Success);
+    for (size_t i = 2; i < result.Data.size(); i++) {
+        double expected = 0.0;
+        for (size_t j = i - 2; j <= i; j++) {
+            expected += j % 100 == 0 ? 1e16 : 0.1;
+        }
+        EXPECT_DOUBLE_EQ(std::get<double>(result.Data[i]["sum3"]), expected) << "row " << i;
+    }
+}
+
+TEST(WindowProcessorTest, NonFiniteValuesAndMissingPartitionFields) {
+    // NaN портит сумму, только пока находится в окне
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    const double inf = std::numeric_limits<double>::infinity();
+    DataTable testData;
+    const std::vector<double> values = {1.0, nan, 2.0, 3.0, inf, 4.0, 5.0};
+    for (size_t i = 0; i < values.size(); i++) {
+        testData.push_back({{"id", static_cast<int>(i)}, {"amount", values[i]}});
+    }
+    auto result = TWindowProcessor({}, "id", {{EWindowFunction::MovingSum, "amount", "sum2", 2}}).Process(testData);
+    ASSERT_TRUE(result.Success);
+    EXPECT_DOUBLE_EQ(std::get<double>(result.Data[0]["sum2"]), 1.0);
+    EXPECT_TRUE(std::isnan(std::get<double>(result.Data[1]["sum2"])));
+    EXPECT_TRUE(std::isnan(std::get<double>(result.Data[2]["sum2"])));
+    EXPECT_DOUBLE_EQ(std::get<double>(result.Data[3]["sum2"]), 5.0);
+    EXPECT_EQ(std::get<double>(result.Data[4]["sum2"]), inf);
+    EXPECT_EQ(std::get<double>(result.Data[5]["sum2"]), inf);
+    EXPECT_DOUBLE_EQ(std::get<double>(result.Data[6]["sum2"]), 9.0);
+
+    // Строка без поля партиции не попадает в партицию с пустой строкой
+    DataTable partitioned = {
+        {{"id", 1}, {"region", std::string("")}, {"amount", 1}},
+        {{"id", 2}, {"amount", 10}},
+        {{"id", 3}, {"region", std::string("")}, {"amount", 2}},
+    };
+    auto running = TWindowProcessor({"region"}, "id", {{EWindowFunction::CumulativeSum, "amount", "running", 1}})
+                       .Process(partitioned);
+    ASSERT_TRUE(running.Success);
+    ASSERT_EQ(running.Data.size(), 3);
+    EXPECT_DOUBLE_EQ(std::get<double>(running.Data[1]["running"]), 3.0);
+    EXPECT_EQ(running.Data[2].count("region"), 0);
+    EXPECT_DOUBLE_EQ(std::get<double>(running.Data[2]["running"]), 10.0);
+}
+
+TEST(TimestampTest, ParsesOnceAndBucketsForGrouping) {
+    EXPECT_EQ(ValueToString(*ParseTimestamp("2024-02-29")), "2024-02-29T00:00:00");
+    EXPECT_EQ(ValueToString(*ParseTimestamp("2024-03-10 07:05:09Z")), "2024-03-10T07:05:09");
+    EXPECT_EQ(ValueToString(TTimestamp{-1}), "1969-12-31T23:59:59");
+    EXPECT_FALSE(ParseTimestamp("2023-02-29"));
+    EXPECT_FALSE(ParseTimestamp("2024-01-01T24:00"));
+    EXPECT_FALSE(ParseTimestamp("Laptop"));
+    EXPECT_LT(CompareValues(TTimestamp::FromDate(2024, 1, 9), TTimestamp::FromDate(2024, 1, 10)), 0);
+    // Разные виды значений не равны и упорядочены по виду: порядок транзитивен
+    EXPECT_LT(CompareValues(TTimestamp::FromDate(2024, 1, 9), std::string("2024-01-09")), 0);
+    EXPECT_LT(CompareValues(TTimestamp::FromDate(2024, 1, 9), std::string("Laptop")), 0);
+
+    // 2024-01-03 - среда, неделя начинается с понедельника 2024-01-01
+    const TTimestamp time = TTimestamp::FromDate(2024, 1, 3, 17, 45);
+    EXPECT_EQ(TruncateTimestamp(time, ETimeBucket::Hour), TTimestamp::FromDate(2024, 1, 3, 17));
+    EXPECT_EQ(TruncateTimestamp(time, ETimeBucket::Day), TTimestamp::FromDate(2024, 1, 3));
+    EXPECT_EQ(TruncateTimestamp(time, ETimeBucket::Week), TTimestamp::FromDate(2024, 1, 1));
+    EXPECT_EQ(TruncateTimestamp(TTimestamp::FromDate(1969, 12, 31), ETimeBucket::Week), TTimestamp::FromDate(1969, 12, 29));
+    EXPECT_EQ(TruncateTimestamp(time, ETimeBucket::Month), TTimestamp::FromDate(2024, 1, 1));
+    // Часовой интервал с началом в полночь выводится в той же форме, что и остальные
+    EXPECT_EQ(ValueToString(TruncateTimestamp(TTimestamp::FromDate(2024, 1, 3, 0, 30), ETimeBucket::Hour)),
+              "2024-01-03T00:00:00");
+    EXPECT_EQ(ValueToString(TruncateTimestamp(time, ETimeBucket::Hour)), "2024-01-03T17:00:00");
+
+    {
+        std::ofstream file("test_dates.csv");
+        file << "date,amount\n2024-02-03T10:00:00,5\n2024-01-15,2\n2024-01-31,3\n";
+    }
+    TCsvDataProvider provider("test_dates.csv");
+    auto data = provider.FetchData();
+    std::remove("test_dates.csv");
+    ASSERT_TRUE(data.Success);
+    EXPECT_EQ(provider.GetSchema()[0].second, EFieldType::Timestamp);
+    ASSERT_TRUE(std::holds_alternative<TTimestamp>(data.Data[0]["date"]));
+
+    // Даты переживают компактное хранение и сортируются по времени
+    auto restored = TCompactTable::FromRows(data.Data).ToRows();
+    EXPECT_EQ(restored, data.Data);
+    auto sorted = TSortProcessor("date", true).Process(restored);
+    EXPECT_EQ(ValueToString(sorted.Data[0]["date"]), "2024-01-15T00:00:00");
+
+    auto bucketed = TTimeBucketProcessor("date", ETimeBucket::Month).Process(std::move(sorted.Data));
+    auto grouped = TGroupByProcessor({"date_month"}, {{"amount", "sum"}}).Process(std::move(bucketed.Data));
+    ASSERT_TRUE(grouped.Success);
+    ASSERT_EQ(grouped.Data.size(), 2);
+    EXPECT_EQ(ValueToString(grouped.Data[0]["date_month"]), "2024-01-01T00:00:00");
+    EXPECT_DOUBLE_EQ(std::get<double>(grouped.Data[0]["amount_sum"]), 5.0);
+    EXPECT_DOUBLE_EQ(std::get<double>(grouped.Data[1]["amount_sum"]), 5.0);
+    EXPECT_NE(TMarkdownFormatter().Format(grouped.Data).find("| 2024-02-01T00:00:00 |"), std::string::npos);
+}
+
+TEST(ApproximateAggregatesTest, DistinctCountAndQuantilesWithinBounds) {
+    DataTable testData;
+    for (int i = 0; i < 20000; i++) {
+        testData.push_back({{"id", i % 5000}, {"price", static_cast<double>(i % 1000)}});
+    }
+
+    auto multi = std::make_unique<TMultiAggregationProcessor>(
+        std::vector<std::pair<std::string, std::string>>{{"id", "approx_distinct"}, {"price", "p50"}, {"price", "p99"}});
+    auto result = multi->Process(testData);
+
+    EXPECT_TRUE(result.Success);
+    ASSERT_EQ(result.Data.size(), 3);
+    EXPECT_NEAR(std::get<double>(result.Data[0]["value"]), 5000.0, 5000.0 * 0.03);
+    EXPECT_NEAR(std::get<double>(result.Data[1]["value"]), 500.0, 10.0);
+    EXPECT_NEAR(std::get<double>(result.Data[2]["value"]), 990.0, 5.0);
+}
+
+TEST(ApproximateAggregatesTest, PartialStatesMerge) {
+    THyperLogLog left = THyperLogLog::ForRelativeError(0.02);
+    THyperLogLog right = THyperLogLog::ForRelativeError(0.02);
+    TTDigest leftDigest;
+    TTDigest rightDigest;
+    for (int i = 0; i < 10000; i++) {
+        (i < 6000 ? left : right).Add(DataValue(i));
+        (i % 2 ? leftDigest : rightDigest).Add(i);
+    }
+
+    EXPECT_TRUE(left.Merge(right));
+    EXPECT_NEAR(left.Estimate(), 10000.0, 10000.0 * 0.06);
+
+    leftDigest.Merge(rightDigest);
+    EXPECT_DOUBLE_EQ(leftDigest.GetTotalWeight(), 10000.0);
+    EXPECT_NEAR(leftDigest.Quantile(0.95), 9500.0, 50.0);
+    EXPECT_LE(leftDigest.GetCentroidCount(), 200);
+
+    // Запросы к константному дайджесту с непустым буфером не меняют его и безопасны из нескольких потоков
+    TTDigest pending;
+    for (int i = 0; i < 500; i++) {
+        pending.Add(i);
+    }
+    const TTDigest& view = pending;
+    const double expected = view.Quantile(0.5);
+    std::vector<std::thread> readers;
+    std::vector<double> medians(4);
+    for (size_t t = 0; t < medians.size(); t++) {
+        readers.emplace_back([&view, &medians, t] { medians[t] = view.Quantile(0.5); });
+    }
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    for (double median : medians) {
+        EXPECT_DOUBLE_EQ(median, expected);
+    }
+    pending.Flush();
+    EXPECT_DOUBLE_EQ(pending.Quantile(0.5), expected);
+    EXPECT_NEAR(expected, 250.0, 5.0);
+}
+
+TEST(BatchExecutionTest, KernelsMatchRowProcessing) {
+    DataTable testData;
+    double expected = 0.0;
+    for (int i = 0; i < 2500; i++) {
+        DataRow row = {{"id", i}, {"units", i % 7}};
+        if (i % 10 != 0) {
+            row["price"] = (i % 100) * 1.5;
+            if ((i % 100) * 1.5 > 30.0) {
+                expected += (i % 7) * ((i % 100) * 1.5);
+            }
+        }
+        testData.push_back(row);
+    }
+    // Строковое значение делает колонку смешанной в одной из пачек
+    testData[5]["price"] = std::string("n/a");
+
+    auto makeStages = [](bool aggregate) {
+        std::vector<std::unique_ptr<IBatchProcessor>> stages;
+        stages.push_back(std::make_unique<TBatchCompareFilter>("price", ECompareOp::Greater, 30.0));
+        stages.push_back(std::make_unique<TBatchArithmetic>("revenue", TBatchOperand::Field("units"),
+                                                            EArithmeticOp::Multiply, TBatchOperand::Field("price")));
+        if (aggregate) {
+            stages.push_back(std::make_unique<TBatchAggregate>("revenue", "sum"));
+        } else {
+            stages.push_back(std::make_unique<TRowProcessorAdapter>(std::make_unique<TSortProcessor>("revenue", false)));
+        }
+        return stages;
+    };
+
+    TBatchPipelineProcessor aggregation(makeStages(true));
+    auto result = aggregation.Process(testData);
+    ASSERT_TRUE(result.Success);
+    ASSERT_EQ(result.Data.size(), 1);
+    EXPECT_EQ(std::get<std::string>(result.Data[0].at("operation")), "sum");
+    EXPECT_NEAR(std::get<double>(result.Data[0].at("value")), expected, 1e-6);
+    // Повторный прогон не накапливает состояние
+    EXPECT_NEAR(std::get<double>(aggregation.Process(testData).Data[0].at("value")), expected, 1e-6);
+
+    TBatchPipelineProcessor rows(makeStages(false), 256);
+    auto rowsResult = rows.Process(testData);
+    ASSERT_TRUE(rowsResult.Success);
+    ASSERT_FALSE(rowsResult.Data.empty());
+    double total = 0.0;
+    for (const auto& row : rowsResult.Data) {
+        EXPECT_GT(std::get<double>(row.at("price")), 30.0);
+        EXPECT_DOUBLE_EQ(std::get<double>(row.at("revenue")), std::get<int>(row.at("units")) * std::get<double>(row.at("price")));
+        total += std::get<double>(row.at("revenue"));
+    }
+    EXPECT_NEAR(total, expected, 1e-6);
+    EXPECT_NE(rows.GetDescription().find("Batch filter (price > 30) -> Batch compute revenue = units * price"),
+              std::string::npos);
+}
+
+TEST(StaticPipelineTest, MatchesDynamicProcessors) {
+    DataTable testData;
+    for (int i = 0; i < 100; i++) {
+        testData.push_back({{"units", i}, {"price", i * 10.0}});
+    }
+    auto expensive = [](const DataRow& row) { return std::get<double>(row.at("price")) > 500.0; };
+
+    auto staticSum = TStaticPipelineBuilder<>()
+                         .Filter(expensive, "price > 500")
+                         .Aggregate<EStaticAggregation::Sum>("units");
+    auto dynamicFiltered = TFilterProcessor(expensive, "price > 500").Process(testData);
+    auto dynamicSum = TAggregationProcessor("units", "sum").Process(dynamicFiltered.Data);
+    auto staticResult = staticSum->Process(testData);
+    ASSERT_TRUE(staticResult.Success);
+    EXPECT_EQ(staticResult.Data, dynamicSum.Data);
+    EXPECT_EQ(staticSum->GetDescription(), "Static pipeline: Filter (price > 500) -> sum of units");
+
+    // Статический процессор встраивается в обычный TReport
+    auto report = TReportBuilder()
+                      .SetDataSource(std::make_unique<TInMemoryDataProvider>(testData))
+                      .AddProcessor(TStaticPipelineBuilder<>()
+                                        .Map([](DataRow& row) { row["revenue"] = std::get<int>(row.at("units")) * 2.0; },
+                                             "revenue = units * 2")
+                                        .Filter([](const DataRow& row) { return std::get<double>(row.at("revenue")) < 10.0; })
+                                        .Collect())
+                      .SetFormatter(std::make_unique<TPlainTextFormatter>())
+                      .SetExportStrategy(std::make_unique<TConsoleExportStrategy>())
+                      .Build();
+    testing::internal::CaptureStdout();
+    auto result = report->Generate();
+    testing::internal::GetCapturedStdout();
+    ASSERT_TRUE(result.Success);
+    ASSERT_EQ(result.Data.size(), 5);
+    EXPECT_DOUBLE_EQ(std::get<double>(result.Data[4].at("revenue")), 8.0);
+
+    auto missing = TStaticPipelineBuilder<>().Aggregate<EStaticAggregation::Avg>("nonexistent")->Process(testData);
+    EXPECT_FALSE(missing.Success);
+}
+
+TEST(ExpressionsTest, ComputedColumnsProcessorEvaluatesExpressions) {
+    DataTable testData = {
+        {{"product", "Laptop"}, {"units", 15}, {"price", 999.99}, {"revenue", 15000}, {"expenses", 8000}},
+        {{"product", "Phone"}, {"units", 32}, {"price", 699.99}, {"revenue", 18000}, {"expenses", 8500}},
+        {{"product", "Tablet"}, {"units", 0}, {"price", 449.99}, {"revenue", 12000}},
+    };
+
+    TComputedColumnsProcessor processor({
+        {"total", "units * price"},
+        {"profit", "revenue - expenses"},
+        {"big", "total > 15000 and not (product == 'Tablet')"},
+        {"label", "concat(upper(product), ':', if(big, 'big', \"small\"))"},
+        {"per_unit", "revenue / units"},
+        {"name_len", "len(`product`) + 1"},
+        {"safe_profit", "coalesce(profit, -1)"},
+    });
+    ASSERT_TRUE(processor.GetCompileError().empty());
+
+    auto result = processor.Process(testData);
+    ASSERT_TRUE(result.Success);
+    const auto& rows = result.Data;
+    EXPECT_DOUBLE_EQ(std::get<double>(rows[0].at("total")), 15 * 999.99);
+    EXPECT_EQ(std::get<int>(rows[0].at("profit")), 7000);
+    EXPECT_EQ(std::get<bool>(rows[1].at("big")), true);
+    EXPECT_EQ(std::get<bool>(rows[0].at("big")), false);
+    EXPECT_EQ(std::get<std::string>(rows[1].at("label")), "PHONE:big");
+    EXPECT_EQ(std::get<std::string>(rows[2].at("label")), "TABLET:small");
+    EXPECT_EQ(std::get<int>(rows[2].at("name_len")), 7);
+
+    // Нет expenses - нет profit; деление на ноль дает пустое значение
+    EXPECT_EQ(rows[2].count("profit"), 0);
+    EXPECT_EQ(std::get<int>(rows[2].at("safe_profit")), -1);
+    EXPECT_EQ(rows[2].count("per_unit"), 0);
+    EXPECT_DOUBLE_EQ(std::get<double>(rows[0].at("per_unit")), 1000.0);
+
+    std::string error;
+    EXPECT_FALSE(TExpression::Compile("units * (price", &error));
+    EXPECT_NE(error.find("expected ')'"), std::string::npos);
+    TComputedColumnsProcessor broken({{"x", std::string("foo(1)")}});
+    auto failed = broken.Process(testData);
+    EXPECT_FALSE(failed.Success);
+    EXPECT_NE(failed.ErrorMessage->find("unknown function foo"), std::string::npos);
+}
+
+TEST(ExpressionsTest, ResultTypeFollowsEachValue) {
+    DataTable testData = {
+        {{"x", INT_MIN}, {"y", 2}, {"v", 5}},
+        {{"x", 3}, {"y", INT_MAX}, {"v", std::string("n/a")}},
+        {{"x", 4}, {"y", 1.5}, {"v", 7}},
+    };
+    TComputedColumnsProcessor processor({
+        {"neg", "-x"},
+        {"abs", "abs(x)"},
+        {"top", "max(-x, 0)"},
+        {"sum", "x + y"},
+        {"next", "v + 1"},
+        {"text", "concat(v, '!')"},
+    });
+    auto result = processor.Process(testData);
+    ASSERT_TRUE(result.Success);
+    const auto& rows = result.Data;
+
+    // Выход за пределы int дает int64_t только в этой строке
+    EXPECT_EQ(std::get<int64_t>(rows[0].at("neg")), 2147483648);
+    EXPECT_EQ(std::get<int>(rows[1].at("neg")), -3);
+    EXPECT_EQ(std::get<int64_t>(rows[0].at("abs")), 2147483648);
+    EXPECT_EQ(std::get<int>(rows[1].at("abs")), 3);
+    EXPECT_EQ(std::get<int64_t>(rows[0].at("top")), 2147483648);
+    EXPECT_EQ(std::get<int>(rows[2].at("top")), 0);
+    EXPECT_EQ(std::get<int>(rows[0].at("sum")), INT_MIN + 2);
+    EXPECT_EQ(std::get<int64_t>(rows[1].at("sum")), 3LL + INT_MAX);
+    EXPECT_DOUBLE_EQ(std::get<double>(rows[2].at("sum")), 5.5);
+
+    // Строка в колонке не делает строками числа соседних строк
+    EXPECT_EQ(std::get<int>(rows[0].at("next")), 6);
+    EXPECT_EQ(rows[1].count("next"), 0);
+    EXPECT_EQ(std::get<int>(rows[2].at("next")), 8);
+    EXPECT_EQ(std::get<std::string>(rows[1].at("text")), "n/a!");
+    EXPECT_EQ(std::get<std::string>(rows[2].at("text")), "7!");
+}
+
 TEST(FormattersTest, HtmlFormatterWorks) {
     DataTable testData = {
         {{"id", 1}, {"name", std::string("Item1")}, {"price", 100.50}},
@@ -273,6 +1273,98 @@ TEST(ExportStrategiesTest, FileExportStrategyWorks) {
     fs::remove_all("test_output");
 }
 
+TEST(ExportStrategiesTest, FileOutputsOfOneReportGetSeparateFiles) {
+    DataTable testData = {{{"id", 1}}, {{"id", 2}}};
+    testing::internal::CaptureStdout();
+    auto result = TReportBuilder()
+                      .SetDataSource(std::make_unique<TInMemoryDataProvider>(testData))
+                      .AddOutput(std::make_unique<TPlainTextFormatter>(), std::make_unique<TFileExportStrategy>("test_outputs/"))
+                      .AddOutput(std::make_unique<TMarkdownFormatter>(), std::make_unique<TFileExportStrategy>("test_outputs/"))
+                      .AddOutput(std::make_unique<THtmlFormatter>(), std::make_unique<TFileExportStrategy>("test_outputs/"))
+                      .Build()
+                      ->Generate();
+    testing::internal::GetCapturedStdout();
+    ASSERT_TRUE(result.Success);
+
+    size_t files = 0;
+    for ([[maybe_unused]] const auto& entry : fs::directory_iterator("test_outputs")) {
+        files++;
+    }
+    EXPECT_EQ(files, 3);
+    fs::remove_all("test_outputs");
+}
+
+TEST(ExportStrategiesTest, CompressedFileExportRoundTrips) {
+    // Повторяющийся отчет больше одного куска сжатия
+    DataTable data;
+    for (int i = 0; i < 3000; i++) {
+        data.push_back({{"id", i}, {"region", std::string(i % 3 ? "east" : "west")}, {"price", i * 1.5}});
+    }
+    const std::string formatted = THtmlFormatter().Format(data);
+
+    const ECompression codec = ECompression::Gzip;
+    if (!IsCompressionAvailable(codec)) {
+        GTEST_SKIP() << "gzip is not available in this build";
+    }
+    fs::remove_all("test_output_compressed");
+    TCompressionOptions options;
+    options.Codec = codec;
+    options.Level = 3;
+    options.ChunkBytes = 4096;
+    options.QueueDepth = 2;
+    TFileExportStrategy exporter("test_output_compressed/", options);
+    testing::internal::CaptureStdout();
+    ASSERT_TRUE(exporter.ExportData(formatted));
+    testing::internal::GetCapturedStdout();
+    EXPECT_EQ(exporter.GetLastPath().extension(), CompressionExtension(codec));
+
+    std::ifstream file(exporter.GetLastPath(), std::ios::binary);
+    std::string compressed((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    EXPECT_LT(compressed.size(), formatted.size() / 4);
+
+    // Распаковка кусками произвольного размера дает исходный текст
+    auto decompressor = MakeDecompressor(codec);
+    std::string restored;
+    for (size_t offset = 0; offset < compressed.size(); offset += 777) {
+        ASSERT_TRUE(decompressor->Decompress(std::string_view(compressed).substr(offset, 777), restored));
+    }
+    EXPECT_TRUE(decompressor->IsComplete());
+    EXPECT_EQ(restored, formatted);
+
+    // Потоковый отчет отдает текст на сжатие по мере форматирования строк
+    auto report = TReportBuilder()
+                      .SetDataSource(std::make_unique<TInMemoryDataProvider>(data))
+                      .AddProcessor(std::make_unique<TSortProcessor>("id", true, 4096))
+                      .SetFormatter(std::make_unique<THtmlFormatter>())
+                      .SetExportStrategy(std::make_unique<TFileExportStrategy>("test_output_compressed/", options))
+                      .EnableStreamingOutput()
+                      .EnableInstrumentation()
+                      .Build();
+    testing::internal::CaptureStdout();
+    auto result = report->Generate();
+    testing::internal::GetCapturedStdout();
+    ASSERT_TRUE(result.Success) << *result.ErrorMessage;
+    EXPECT_TRUE(result.Data.empty());
+    const auto& stages = report->GetLastStats()->Stages;
+    ASSERT_GE(stages.size(), 2);
+    EXPECT_EQ(stages[stages.size() - 2].Stage, "formatter");
+    EXPECT_EQ(stages[stages.size() - 2].BytesProduced, formatted.size());
+    EXPECT_EQ(stages.back().BytesProduced, formatted.size());
+
+    fs::path streamed;
+    for (const auto& entry : fs::directory_iterator("test_output_compressed")) {
+        if (entry.path() != exporter.GetLastPath()) {
+            streamed = entry.path();
+        }
+    }
+    ASSERT_FALSE(streamed.empty());
+    TDecompressingReader reader(streamed.string(), codec, options);
+    std::string streamedText((std::istreambuf_iterator<char>(reader)), std::istreambuf_iterator<char>());
+    EXPECT_FALSE(reader.Finish());
+    EXPECT_EQ(streamedText, formatted);
+    fs::remove_all("test_output_compressed");
+}
+
 TEST(ExportStrategiesTest, EmailExportStrategyWorks) {
     testing::internal::CaptureStdout();
 
@@ -313,6 +1405,786 @@ TEST(ReportBuilderTest, BuildReportWithMultiAggregation) {
     EXPECT_FALSE(output.empty());
 }
 
+TEST(ReportBuilderTest, InstrumentationCollectsStageStats) {
+    DataTable testData;
+    for (int i = 0; i < 100; i++) {
+        testData.push_back({{"id", i}, {"price", i * 10.0}});
+    }
+
+    auto report = TReportBuilder()
+                      .SetDataSource(std::make_unique<TInMemoryDataProvider>(testData))
+                      .AddProcessor(std::make_unique<TComputedColumnsProcessor>(
+                          std::vector<std::pair<std::string, std::string>>{{"total", "price * 2"}}))
+                      .AddProcessor(std::make_unique<TFilterProcessor>(
+                          [](const DataRow& row) { return std::get<double>(row.at("price")) >= 500.0; }, "price >= 500"))
+                      .SetFormatter(std::make_unique<TMarkdownFormatter>())
+                      .SetExportStrategy(std::make_unique<TConsoleExportStrategy>())
+                      .EnableInstrumentation()
+                      // Цепочка измеряется в заданном порядке, без перестановок планировщика
+                      .EnableQueryPlanner(false)
+                      .Build();
+
+    testing::internal::CaptureStdout();
+    auto result = report->Generate();
+    report->PrintStats();
+    std::string output = testing::internal::GetCapturedStdout();
+
+    ASSERT_TRUE(result.Success);
+    ASSERT_NE(result.Stats, nullptr);
+    const auto& stages = result.Stats->Stages;
+    ASSERT_EQ(stages.size(), 5); // provider, 2 processors, formatter, exporter
+    EXPECT_EQ(stages[0].Stage, "provider");
+    EXPECT_EQ(stages[0].RowsOut, 100);
+    EXPECT_EQ(stages[1].RowsIn, 100);
+    EXPECT_EQ(stages[1].RowsOut, 100);
+    EXPECT_GT(stages[1].PeakAllocatedBytes, 0);
+    EXPECT_EQ(stages[2].RowsIn, 100);
+    EXPECT_EQ(stages[2].RowsOut, 50);
+    EXPECT_EQ(stages[3].Stage, "formatter");
+    EXPECT_GT(stages[3].BytesProduced, 0);
+    EXPECT_GT(stages[3].PeakAllocatedBytes, 0);
+    EXPECT_EQ(stages[4].BytesProduced, stages[3].BytesProduced);
+    EXPECT_NE(output.find("Pipeline Stats"), std::string::npos);
+
+    // Без инструментирования статистика не собирается
+    report->EnableInstrumentation(false);
+    testing::internal::CaptureStdout();
+    auto plain = report->Generate();
+    testing::internal::GetCapturedStdout();
+    EXPECT_EQ(plain.Stats, nullptr);
+}
+
+TEST(ReportBuilderTest, StagePeaksIgnoreOtherThreads) {
+    // Выделение в другом потоке во время этапа не попадает в пик этапа
+    TPipelineStats stats;
+    TStageTimer timer(&stats);
+    std::thread other([] {
+        std::vector<char> big(64u << 20, 1);
+        EXPECT_EQ(big[12345], 1);
+    });
+    other.join();
+    std::vector<char> small(4096, 1);
+    timer.Finish("processor", [] { return std::string("small"); }, 0, 0, [] { return size_t{0}; });
+    ASSERT_EQ(stats.Stages.size(), 1);
+    EXPECT_GE(stats.Stages[0].PeakAllocatedBytes, small.size());
+    EXPECT_LT(stats.Stages[0].PeakAllocatedBytes, size_t{1} << 20);
+}
+
+TEST(QueryPlannerTest, ReordersAndFusesProcessors) {
+    DataTable testData;
+    for (int i = 0; i < 20; i++) {
+        testData.push_back({{"id", i}, {"price", i * 10.0}});
+    }
+    auto makeReport = [&](bool planning) {
+        return TReportBuilder()
+            .SetDataSource(std::make_unique<TInMemoryDataProvider>(testData))
+            .AddProcessor(std::make_unique<TSortProcessor>("id", false))
+            .AddProcessor(std::make_unique<TFilterProcessor>(
+                [](const DataRow& row) { return std::get<int>(row.at("id")) >= 5; }, "id >= 5"))
+            .AddProcessor(std::make_unique<TSortProcessor>("price"))
+            .AddProcessor(std::make_unique<TFilterProcessor>(
+                [](const DataRow& row) { return std::get<double>(row.at("price")) < 150.0; }, "price < 150"))
+            .AddProcessor(std::make_unique<TAggregationProcessor>("price", "sum"))
+            .SetFormatter(std::make_unique<TPlainTextFormatter>())
+            .SetExportStrategy(std::make_unique<TConsoleExportStrategy>())
+            .EnableQueryPlanner(planning)
+            .Build();
+    };
+
+    auto optimized = makeReport(true);
+    auto plain = makeReport(false);
+    testing::internal::CaptureStdout();
+    auto optimizedResult = optimized->Generate();
+    auto plainResult = plain->Generate();
+    testing::internal::GetCapturedStdout();
+
+    ASSERT_TRUE(optimizedResult.Success);
+    ASSERT_TRUE(plainResult.Success);
+    EXPECT_EQ(optimizedResult.Data, plainResult.Data);
+    EXPECT_DOUBLE_EQ(std::get<double>(optimizedResult.Data[0].at("value")), 50.0 + 60 + 70 + 80 + 90 + 100 + 110 + 120 + 130 + 140);
+
+    // Обе сортировки убраны, фильтры слиты в предусловие агрегации
+    std::string explain = optimized->Explain();
+    EXPECT_NE(explain.find("Optimized plan:\n  Source: In-memory data (20 rows)\n  1. sum of price where (id >= 5 AND price < 150)\n"),
+              std::string::npos);
+    EXPECT_NE(explain.find("  5. sum of price\n"), std::string::npos);
+    EXPECT_NE(explain.find("dropped Sort by id (desc)"), std::string::npos);
+    EXPECT_NE(plain->Explain().find("Rewrites:\n  (none)"), std::string::npos);
+}
+
+TEST(QueryPlannerTest, KeepsSortThatReachesOutput) {
+    std::vector<std::unique_ptr<IDataProcessor>> processors;
+    processors.push_back(std::make_unique<TSortProcessor>("id"));
+    processors.push_back(std::make_unique<TFilterProcessor>([](const DataRow&) { return true; }, "all"));
+    auto info = TQueryPlanner::Optimize(processors);
+
+    ASSERT_EQ(processors.size(), 2);
+    EXPECT_EQ(processors[0]->GetDescription(), "Filter (all)");
+    EXPECT_EQ(processors[1]->GetDescription(), "Sort by id (asc)");
+    EXPECT_EQ(info.Original.front(), "Sort by id (asc)");
+    EXPECT_EQ(info.Rewrites.size(), 1);
+}
+
+TEST(QueryPlannerTest, PushesLimitTowardsProvider) {
+    // Значение, не подходящее к типу, в конце файла: полное чтение с FailOnIssues падает
+    {
+        std::ofstream file("test_preview.csv");
+        file << "id,price\n";
+        for (int i = 0; i < 5000; i++) {
+            file << i << "," << (i * 37) % 1000 << "\n";
+        }
+        file << "broken,price\n";
+    }
+    TCsvSchemaOptions strict;
+    strict.FailOnIssues = true;
+    EXPECT_FALSE(TCsvDataProvider("test_preview.csv", ',', {}, strict).FetchData().Success);
+
+    std::string output;
+    auto preview = TReportBuilder()
+                       .SetDataSource(std::make_unique<TCsvDataProvider>("test_preview.csv", ',',
+                                                                         TDictionaryEncodingOptions{}, strict))
+                       .AddProcessor(std::make_unique<TFilterProcessor>(
+                           [](const DataRow& row) { return std::get<int>(row.at("price")) >= 900; }, "price >= 900"))
+                       .AddProcessor(std::make_unique<TLimitProcessor>(50))
+                       .SetFormatter(std::make_unique<TPlainTextFormatter>())
+                       .SetExportStrategy(std::make_unique<TStringExportStrategy>(&output))
+                       .EnableQueryPlanner()
+                       .Build();
+    auto result = preview->Generate();
+    ASSERT_TRUE(result.Success) << *result.ErrorMessage;
+    ASSERT_EQ(result.Data.size(), 50);
+    EXPECT_EQ(std::get<int>(result.Data[0].at("id")), 25); // 25 * 37 % 1000 = 925
+    const std::string explain = preview->Explain();
+    EXPECT_NE(explain.find("  1. Filter (price >= 900) limit 50\n"), std::string::npos);
+    EXPECT_NE(explain.find("pushed limit 50 into CSV file: test_preview.csv\n"), std::string::npos);
+    EXPECT_NE(explain.find("Source: CSV file: test_preview.csv (first 50 rows where price >= 900)"), std::string::npos);
+    std::remove("test_preview.csv");
+
+    // Сортировка перед лимитом становится top-K; лимит за ней поставщику не передается
+    DataTable testData;
+    for (int i = 0; i < 100; i++) {
+        testData.push_back({{"id", i}, {"price", (i * 37) % 100}});
+    }
+    std::vector<std::unique_ptr<IDataProcessor>> processors;
+    processors.push_back(std::make_unique<TSortProcessor>("price", false));
+    processors.push_back(std::make_unique<TLimitProcessor>(10));
+    processors.push_back(std::make_unique<TFilterProcessor>(
+        [](const DataRow& row) { return std::get<int>(row.at("id")) % 2 == 0; }, "even id"));
+    processors.push_back(std::make_unique<TLimitProcessor>(3));
+    processors.push_back(std::make_unique<TLimitProcessor>(5));
+    TInMemoryDataProvider provider(testData);
+    auto info = TQueryPlanner::Optimize(processors);
+    TQueryPlanner::PushDownLimit(provider, processors, info);
+
+    ASSERT_EQ(processors.size(), 2);
+    EXPECT_EQ(processors[0]->GetDescription(), "Sort by price (desc) limit 10");
+    EXPECT_EQ(processors[1]->GetDescription(), "Filter (even id) limit 3");
+    EXPECT_EQ(provider.GetSourceInfo(), "In-memory data (100 rows)");
+
+    auto topK = processors[0]->Process(testData);
+    auto full = TSortProcessor("price", false).Process(testData);
+    ASSERT_EQ(topK.Data.size(), 10);
+    for (size_t i = 0; i < topK.Data.size(); i++) {
+        EXPECT_EQ(topK.Data[i].at("price"), full.Data[i].at("price"));
+    }
+    auto filtered = processors[1]->Process(topK.Data);
+    EXPECT_EQ(filtered.Data.size(), 3);
+}
+
+// Фабрика с лимитом за фильтром: планировщик должен передать лимит поставщику
+class TPreviewReportFactory: public IReportFactory {
+public:
+    std::unique_ptr<IDataProvider> CreateDataProvider() override {
+        DataTable data;
+        for (int i = 0; i < 100; i++) {
+            data.push_back({{"id", i}});
+        }
+        return std::make_unique<TInMemoryDataProvider>(std::move(data));
+    }
+
+    std::vector<std::unique_ptr<IDataProcessor>> CreateProcessors() override {
+        std::vector<std::unique_ptr<IDataProcessor>> processors;
+        processors.push_back(std::make_unique<TFilterProcessor>(
+            [](const DataRow& row) { return std::get<int>(row.at("id")) % 2 == 0; }, "even id"));
+        processors.push_back(std::make_unique<TLimitProcessor>(5));
+        return processors;
+    }
+
+    std::unique_ptr<IFormatter> CreateFormatter() override {
+        return std::make_unique<TPlainTextFormatter>();
+    }
+
+    std::unique_ptr<IExportStrategy> CreateExportStrategy() override {
+        return std::make_unique<TStringExportStrategy>(&Output);
+    }
+
+    std::string Output;
+};
+
+TEST(QueryPlannerTest, FactoryReportsGetTheBuilderPlan) {
+    TPreviewReportFactory factory;
+    factory.EnableQueryPlanner();
+    auto report = factory.CreateReport();
+    EXPECT_NE(report->Explain().find("pushed limit 5 into In-memory data (100 rows)\n"), std::string::npos);
+    auto result = report->Generate();
+    ASSERT_TRUE(result.Success);
+    ASSERT_EQ(result.Data.size(), 5);
+    EXPECT_EQ(std::get<int>(result.Data[4].at("id")), 8);
+}
+
+TEST(SamplingTest, EstimatesTotalsWithConfidenceIntervals) {
+    DataTable data;
+    double trueSum = 0.0;
+    for (int i = 0; i < 20000; i++) {
+        const int amount = (i * 7919) % 1000;
+        data.push_back({{"id", i}, {"amount", amount}, {"region", std::string(i % 100 == 0 ? "rare" : "main")}});
+        trueSum += amount;
+    }
+
+    auto estimate = [&](const TSampleOptions& options, const std::string& operation) {
+        auto sample = TSampleProcessor(options).Process(data);
+        EXPECT_TRUE(sample.Success);
+        return TAggregationProcessor("amount", operation).Process(sample.Data).Data.at(0);
+    };
+
+    // Бернулли: интервал накрывает точную сумму, тот же seed - та же выборка
+    TSampleOptions bernoulli;
+    bernoulli.Fraction = 0.05;
+    auto sum = estimate(bernoulli, "sum");
+    EXPECT_LE(std::get<double>(sum.at("ci_low")), trueSum);
+    EXPECT_GE(std::get<double>(sum.at("ci_high")), trueSum);
+    EXPECT_LT(std::get<double>(sum.at("ci_high")) - std::get<double>(sum.at("ci_low")), trueSum * 0.2);
+    EXPECT_EQ(estimate(bernoulli, "sum"), sum);
+    bernoulli.Seed = 7;
+    EXPECT_NE(estimate(bernoulli, "sum").at("value"), sum.at("value"));
+
+    // Резервуар: ровно Rows строк, оценка числа строк точная
+    TSampleOptions reservoir;
+    reservoir.Mode = ESampleMode::Reservoir;
+    reservoir.Rows = 500;
+    EXPECT_EQ(TSampleProcessor(reservoir).Process(data).Data.size(), 500);
+    EXPECT_DOUBLE_EQ(std::get<double>(estimate(reservoir, "count").at("value")), 20000.0);
+    auto avg = estimate(reservoir, "avg");
+    EXPECT_LE(std::get<double>(avg.at("ci_low")), trueSum / 20000);
+    EXPECT_GE(std::get<double>(avg.at("ci_high")), trueSum / 20000);
+
+    // Страты: редкая страта попадает в выборку целиком с весом 1
+    TSampleOptions stratified;
+    stratified.Mode = ESampleMode::Stratified;
+    stratified.Rows = 300;
+    stratified.StratifyBy = "region";
+    auto strata = TSampleProcessor(stratified).Process(data);
+    ASSERT_TRUE(strata.Success);
+    EXPECT_EQ(strata.Data.size(), 500);
+    auto weights = TGroupByProcessor({"region"}, {{SampleWeightColumn, "sum"}}).Process(strata.Data);
+    for (const auto& row : weights.Data) {
+        const bool rare = ValueToString(row.at("region")) == "rare";
+        EXPECT_DOUBLE_EQ(std::get<double>(row.at(std::string(SampleWeightColumn) + "_sum")), rare ? 200.0 : 19800.0);
+    }
+
+    // Вес нужен агрегациям, но в отчет не попадает
+    EXPECT_EQ(TPlainTextFormatter().Format(strata.Data).find(SampleWeightColumn), std::string::npos);
+    EXPECT_EQ(TMarkdownFormatter().Format(strata.Data).find(SampleWeightColumn), std::string::npos);
+    EXPECT_EQ(THtmlFormatter().Format(strata.Data).find(SampleWeightColumn), std::string::npos);
+    EXPECT_NE(TMarkdownFormatter().Format(strata.Data).find("| amount | id | region |\n| --- | --- | --- |\n"),
+              std::string::npos);
+
+    // Взвешенной считается таблица, где вес есть хотя бы у одной строки
+    DataTable mixed = {{{"amount", 10}}, {{"amount", 20}, {SampleWeightColumn, 3.0}}};
+    EXPECT_FALSE(IsWeightedSample({{{"amount", 10}}}));
+    EXPECT_TRUE(IsWeightedSample(mixed));
+    EXPECT_DOUBLE_EQ(std::get<double>(TAggregationProcessor("amount", "sum").Process(mixed).Data.at(0).at("value")), 70.0);
+
+    stratified.StratifyBy.clear();
+    EXPECT_FALSE(TSampleProcessor(stratified).Process(data).Success);
+}
+
+TEST(SamplingTest, CsvProviderSamplesBeforeParsing) {
+    {
+        std::ofstream file("test_sample.csv");
+        file << "id,amount,region,tier\n";
+        for (int i = 0; i < 5000; i++) {
+            // Одно значение tier записано по-разному: страта определяется значением, а не текстом
+            file << i << "," << (i * 37) % 1000 << "," << (i % 3 ? "east" : "west") << "," << (i % 2 ? "1.50" : "1.5")
+                 << "\n";
+        }
+    }
+
+    std::string output;
+    auto makeReport = [&](bool planner, TSampleOptions options) {
+        return TReportBuilder()
+            .SetDataSource(std::make_unique<TCsvDataProvider>("test_sample.csv"))
+            .AddProcessor(std::make_unique<TSampleProcessor>(options))
+            .AddProcessor(std::make_unique<TAggregationProcessor>("amount", "sum"))
+            .SetFormatter(std::make_unique<TPlainTextFormatter>())
+            .SetExportStrategy(std::make_unique<TStringExportStrategy>(&output))
+            .EnableQueryPlanner(planner)
+            .Build();
+    };
+
+    // В поставщике выбираются те же строки, что и обработчиком
+    for (const std::string stratifyBy : {"region", "tier"}) {
+        for (ESampleMode mode : {ESampleMode::Bernoulli, ESampleMode::Reservoir, ESampleMode::Stratified}) {
+            TSampleOptions options;
+            options.Mode = mode;
+            options.Fraction = 0.1;
+            options.Rows = 100;
+            options.StratifyBy = stratifyBy;
+            auto pushed = makeReport(true, options);
+            auto plain = makeReport(false, options);
+            EXPECT_NE(pushed->Explain().find("pushed Sample (" + options.Describe() + ") into CSV file"), std::string::npos);
+            auto pushedResult = pushed->Generate();
+            auto plainResult = plain->Generate();
+            ASSERT_TRUE(pushedResult.Success);
+            ASSERT_TRUE(plainResult.Success);
+            EXPECT_EQ(pushedResult.Data, plainResult.Data);
+        }
+    }
+    std::remove("test_sample.csv");
+}
+
+TEST(TracingTest, WritesChromeTraceForPipeline) {
+    auto& tracer = TTracer::Global();
+    tracer.Clear();
+    tracer.Enable();
+
+    DataTable testData;
+    for (int i = 0; i < 10; i++) {
+        testData.push_back({{"id", i}});
+    }
+    auto report = TReportBuilder()
+                      .SetDataSource(std::make_unique<TInMemoryDataProvider>(testData))
+                      .AddProcessor(std::make_unique<TFilterProcessor>(
+                          [](const DataRow& row) { return std::get<int>(row.at("id")) < 4; }, "id < 4"))
+                      .SetFormatter(std::make_unique<TPlainTextFormatter>())
+                      .SetExportStrategy(std::make_unique<TConsoleExportStrategy>())
+                      .Build();
+    testing::internal::CaptureStdout();
+    ASSERT_TRUE(report->Generate().Success);
+    testing::internal::GetCapturedStdout();
+
+    // События из другого потока получают свой tid; буфер потока освобождается при его завершении
+    const size_t buffers = tracer.GetThreadBufferCount();
+    std::thread([] { TTraceSpan span("batch", "worker \"batch\""); }).join();
+    EXPECT_EQ(tracer.GetThreadBufferCount(), buffers);
+    tracer.Enable(false);
+
+    auto events = tracer.Collect();
+    ASSERT_EQ(events.size(), 6); // report, provider, processor, formatter, exporter, batch
+    std::set<uint32_t> threads;
+    for (const auto& event : events) {
+        threads.insert(event.ThreadId);
+    }
+    EXPECT_EQ(threads.size(), 2);
+
+    std::ostringstream out;
+    tracer.WriteChromeTrace(out);
+    std::string json = out.str();
+    EXPECT_NE(json.find("\"name\":\"Filter (id < 4)\",\"cat\":\"processor\",\"ph\":\"X\""), std::string::npos);
+    EXPECT_NE(json.find("\"rows_in\":10,\"rows_out\":4"), std::string::npos);
+    EXPECT_NE(json.find("worker \\\"batch\\\""), std::string::npos);
+    EXPECT_NE(json.find("\"dropped_events\":0"), std::string::npos);
+    tracer.Clear();
+
+    // Выключенный трассировщик ничего не пишет
+    { TTraceSpan span("batch", "ignored"); }
+    EXPECT_TRUE(tracer.Collect().empty());
+}
+
+TEST(ReportBuilderTest, FanOutRunsPipelineOnceForAllOutputs) {
+    // Поставщик, считающий обращения
+    class TCountingProvider: public IDataProvider {
+    public:
+        int Fetches = 0;
+
+        TOperationResult FetchData() override {
+            Fetches++;
+            DataTable data;
+            for (int i = 0; i < 50; i++) {
+                data.push_back({{"id", i}, {"price", i * 10.0}});
+            }
+            return TOperationResult::Ok(data);
+        }
+
+        std::string GetSourceInfo() const override {
+            return "Counting provider";
+        }
+    };
+
+    // Экспорт в строку
+    class TCapturingExporter: public IExportStrategy {
+    public:
+        std::string* Target;
+
+        explicit TCapturingExporter(std::string* target)
+            : Target(target) {
+        }
+
+        bool ExportData(const std::string& formattedData) override {
+            *Target = formattedData;
+            return true;
+        }
+
+        std::string GetMethodName() const override {
+            return "Capture";
+        }
+    };
+
+    auto provider = std::make_unique<TCountingProvider>();
+    auto* providerPtr = provider.get();
+    std::string html, text, markdown;
+    auto report = TReportBuilder()
+                      .SetDataSource(std::move(provider))
+                      .AddProcessor(std::make_unique<TFilterProcessor>(
+                          [](const DataRow& row) { return std::get<double>(row.at("price")) >= 250.0; }, "price >= 250"))
+                      .AddOutput(std::make_unique<THtmlFormatter>(), std::make_unique<TCapturingExporter>(&html))
+                      .AddOutput(std::make_unique<TPlainTextFormatter>(), std::make_unique<TCapturingExporter>(&text))
+                      .AddOutput(std::make_unique<TMarkdownFormatter>(), std::make_unique<TCapturingExporter>(&markdown))
+                      .EnableInstrumentation()
+                      .Build();
+
+    auto result = report->Generate();
+    ASSERT_TRUE(result.Success);
+    EXPECT_EQ(providerPtr->Fetches, 1);
+    ASSERT_EQ(result.Data.size(), 25);
+    EXPECT_EQ(html, THtmlFormatter().Format(result.Data));
+    EXPECT_EQ(text, TPlainTextFormatter().Format(result.Data));
+    EXPECT_EQ(markdown, TMarkdownFormatter().Format(result.Data));
+
+    // provider, processor, три форматировщика, три экспорта
+    ASSERT_NE(result.Stats, nullptr);
+    EXPECT_EQ(result.Stats->Stages.size(), 8);
+    for (const auto& stage : result.Stats->Stages) {
+        if (stage.Stage == "formatter") {
+            EXPECT_GT(stage.PeakAllocatedBytes, 0) << stage.Name;
+        }
+    }
+    EXPECT_NE(report->Explain().find("Output: Markdown -> Capture"), std::string::npos);
+}
+
+TEST(SharedPipelinesTest, ComputesCommonPrefixesOnce) {
+    // Поставщик и обработчик, считающие вызовы
+    class TCountingProvider: public IDataProvider {
+    public:
+        int* Fetches;
+
+        explicit TCountingProvider(int* fetches)
+            : Fetches(fetches) {
+        }
+
+        TOperationResult FetchData() override {
+            (*Fetches)++;
+            DataTable data;
+            for (int i = 0; i < 40; i++) {
+                data.push_back({{"id", i}, {"region", std::string(i % 2 ? "east" : "west")}, {"price", i * 10.0}});
+            }
+            return TOperationResult::Ok(data);
+        }
+
+        std::string GetSourceInfo() const override {
+            return "Counting provider";
+        }
+
+        std::optional<std::string> GetShareKey() const override {
+            return GetSourceInfo();
+        }
+    };
+
+    class TCountingProcessor: public IDataProcessor {
+    public:
+        int* Calls;
+
+        explicit TCountingProcessor(int* calls)
+            : Calls(calls) {
+        }
+
+        TOperationResult Process(DataTable data) override {
+            (*Calls)++;
+            RetainRows(data, [](const DataRow& row) { return std::get<int>(row.at("id")) >= 10; });
+            return TOperationResult::Ok(std::move(data));
+        }
+
+        std::string GetDescription() const override {
+            return "id >= 10";
+        }
+
+        std::optional<std::string> GetShareKey() const override {
+            return GetDescription();
+        }
+    };
+
+    class TDiscardExporter: public IExportStrategy {
+    public:
+        bool ExportData(const std::string&) override {
+            return true;
+        }
+
+        std::string GetMethodName() const override {
+            return "Discard";
+        }
+    };
+
+    int fetches = 0;
+    int calls = 0;
+    auto makeReport = [&](std::unique_ptr<IDataProcessor> tail) {
+        TReportBuilder builder;
+        builder.SetDataSource(std::make_unique<TCountingProvider>(&fetches))
+            .AddProcessor(std::make_unique<TCountingProcessor>(&calls))
+            .SetFormatter(std::make_unique<TPlainTextFormatter>())
+            .SetExportStrategy(std::make_unique<TDiscardExporter>());
+        if (tail) {
+            builder.AddProcessor(std::move(tail));
+        }
+        return builder.Build();
+    };
+
+    std::vector<std::unique_ptr<IDataProcessor>> tails;
+    tails.push_back(std::make_unique<TAggregationProcessor>("price", "sum"));
+    tails.push_back(std::make_unique<TGroupByProcessor>(std::vector<std::string>{"region"},
+                                                        std::vector<std::pair<std::string, std::string>>{{"price", "avg"}}));
+    tails.push_back(std::make_unique<TSortProcessor>("price", false));
+    tails.push_back(nullptr);
+
+    // Ожидаемые результаты - отдельные запуски тех же отчетов
+    std::vector<DataTable> expected;
+    for (auto& tail : tails) {
+        std::unique_ptr<IDataProcessor> copy;
+        if (dynamic_cast<TAggregationProcessor*>(tail.get())) {
+            copy = std::make_unique<TAggregationProcessor>("price", "sum");
+        } else if (dynamic_cast<TGroupByProcessor*>(tail.get())) {
+            copy = std::make_unique<TGroupByProcessor>(std::vector<std::string>{"region"},
+                                                       std::vector<std::pair<std::string, std::string>>{{"price", "avg"}});
+        } else if (tail) {
+            copy = std::make_unique<TSortProcessor>("price", false);
+        }
+        auto result = makeReport(std::move(copy))->Generate();
+        ASSERT_TRUE(result.Success);
+        expected.push_back(result.Data);
+    }
+    EXPECT_EQ(fetches, 4);
+    EXPECT_EQ(calls, 4);
+
+    fetches = 0;
+    calls = 0;
+    TBatchReportExecutor executor;
+    for (auto& tail : tails) {
+        executor.Add(makeReport(std::move(tail)));
+    }
+    auto results = executor.Run();
+
+    // Источник прочитан и общий фильтр выполнен один раз на пачку
+    EXPECT_EQ(fetches, 1);
+    EXPECT_EQ(calls, 1);
+    EXPECT_EQ(executor.GetSharedStageCount(), 2);
+    ASSERT_EQ(results.size(), 4);
+    for (size_t i = 0; i < results.size(); i++) {
+        ASSERT_TRUE(results[i].Success) << i;
+        EXPECT_EQ(results[i].Data, expected[i]) << i;
+    }
+    EXPECT_NE(executor.Explain().find("Counting provider [shared by 4 reports]"), std::string::npos);
+    EXPECT_NE(executor.Explain().find("  id >= 10 [shared by 4 reports]"), std::string::npos);
+
+    // Этапы без ключа не сливаются, даже если описания совпадают
+    auto makeFiltered = [](DataTable data, int minId, std::optional<std::string> dataKey) {
+        auto provider = std::make_unique<TInMemoryDataProvider>(std::move(data));
+        provider->SetDataKey(std::move(dataKey));
+        return TReportBuilder()
+            .SetDataSource(std::move(provider))
+            .AddProcessor(std::make_unique<TFilterProcessor>(
+                [minId](const DataRow& row) { return std::get<int>(row.at("id")) >= minId; }))
+            .SetFormatter(std::make_unique<TPlainTextFormatter>())
+            .SetExportStrategy(std::make_unique<TDiscardExporter>())
+            .EnableInstrumentation()
+            .Build();
+    };
+    const DataTable ids = {{{"id", 1}}, {{"id", 2}}, {{"id", 3}}};
+    TBatchReportExecutor unkeyed;
+    unkeyed.Add(makeFiltered(ids, 2, "ids"));
+    unkeyed.Add(makeFiltered(ids, 3, "ids"));
+    unkeyed.Add(makeFiltered({{{"id", 5}}, {{"id", 6}}, {{"id", 7}}}, 0, std::nullopt));
+    auto separate = unkeyed.Run();
+    EXPECT_EQ(unkeyed.GetSharedStageCount(), 1);
+    EXPECT_EQ(separate[0].Data.size(), 2);
+    EXPECT_EQ(separate[1].Data.size(), 1);
+    EXPECT_EQ(separate[2].Data.size(), 3);
+    // Общее чтение попадает в статистику каждого отчета
+    const auto& stages = unkeyed.GetReport(1).GetLastStats()->Stages;
+    ASSERT_EQ(stages.size(), 4);
+    EXPECT_EQ(stages[0].Stage, "provider");
+    EXPECT_EQ(stages[0].RowsOut, 3);
+}
+
+TEST(MemoryBudgetTest, AdmitsReportsWithinBudget) {
+    DataTable data;
+    for (int i = 0; i < 8000; i++) {
+        data.push_back({{"id", i}, {"key", "key-" + std::to_string((i * 7919) % 8000)}});
+    }
+    const size_t tableBytes = EstimateTableBytes(data);
+
+    std::string output;
+    auto makeReport = [&](TMemoryBudget& budget, EAdmissionMode mode) {
+        TAdmissionOptions options;
+        options.Mode = mode;
+        options.QueueTimeout = std::chrono::milliseconds(2000);
+        return TReportBuilder()
+            .SetDataSource(std::make_unique<TInMemoryDataProvider>(data))
+            .AddProcessor(std::make_unique<TSortProcessor>("key"))
+            .SetFormatter(std::make_unique<TPlainTextFormatter>())
+            .SetExportStrategy(std::make_unique<TStringExportStrategy>(&output))
+            .SetMemoryBudget(budget, options)
+            .EnableInstrumentation()
+            .EnableStreamingOutput()
+            .Build();
+    };
+
+    // Без лимита - только учет: резерв виден во время работы и возвращается после
+    TMemoryBudget unlimited;
+    auto report = makeReport(unlimited, EAdmissionMode::FailFast);
+    ASSERT_TRUE(report->Generate().Success);
+    EXPECT_GE(report->GetLastPeakReservedBytes(), tableBytes);
+    EXPECT_EQ(report->GetLastStats()->PeakReservedBytes, report->GetLastPeakReservedBytes());
+    EXPECT_EQ(unlimited.GetUsedBytes(), 0);
+    EXPECT_EQ(unlimited.GetPeakBytes(), report->GetLastPeakReservedBytes());
+
+    // FailFast: память занята другим отчетом - понятная ошибка сразу
+    TMemoryBudget budget(tableBytes * 3);
+    auto other = std::make_unique<TMemoryReservation>(budget);
+    ASSERT_TRUE(other->Resize(tableBytes * 2, {}));
+    auto failed = makeReport(budget, EAdmissionMode::FailFast)->Generate();
+    EXPECT_FALSE(failed.Success);
+    EXPECT_NE(failed.ErrorMessage->find("Memory budget exceeded"), std::string::npos);
+    EXPECT_EQ(budget.GetUsedBytes(), tableBytes * 2);
+
+    // Degrade: сортировка получает остаток бюджета (ноль) и сбрасывает данные на диск
+    auto degraded = makeReport(budget, EAdmissionMode::Degrade);
+    ASSERT_TRUE(degraded->Generate().Success);
+    const auto& stages = degraded->GetLastStats()->Stages;
+    EXPECT_TRUE(std::any_of(stages.begin(), stages.end(), [](const TStageStats& stage) {
+        return stage.Name.find("[streaming]") != std::string::npos;
+    }));
+    auto plain = makeReport(unlimited, EAdmissionMode::Degrade);
+    std::string sorted = output;
+    ASSERT_TRUE(plain->Generate().Success);
+    EXPECT_EQ(output, sorted);
+
+    // Queue: отчет ждет, пока другой не освободит память
+    std::thread releaser([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        other.reset();
+    });
+    auto queued = makeReport(budget, EAdmissionMode::Queue)->Generate();
+    releaser.join();
+    EXPECT_TRUE(queued.Success);
+    EXPECT_EQ(budget.GetUsedBytes(), 0);
+}
+
+TEST(MemoryBudgetTest, ReservesBeforeFetchAndForProcessOutput) {
+    DataTable data;
+    for (int i = 0; i < 2000; i++) {
+        data.push_back({{"id", i}, {"key", "key-" + std::to_string(i % 97)}});
+    }
+    const size_t tableBytes = EstimateTableBytes(data);
+
+    class TCountingProvider: public TInMemoryDataProvider {
+    public:
+        int Fetches = 0;
+
+        using TInMemoryDataProvider::TInMemoryDataProvider;
+
+        TOperationResult FetchData() override {
+            Fetches++;
+            return TInMemoryDataProvider::FetchData();
+        }
+    };
+
+    std::string output;
+    auto makeReport = [&](TMemoryBudget& budget, TCountingProvider*& provider) {
+        auto source = std::make_unique<TCountingProvider>(data);
+        provider = source.get();
+        return TReportBuilder()
+            .SetDataSource(std::move(source))
+            .AddProcessor(std::make_unique<TFilterProcessor>([](const DataRow&) { return true; }, "all"))
+            .AddProcessor(std::make_unique<TSortProcessor>("key"))
+            .SetFormatter(std::make_unique<TPlainTextFormatter>())
+            .SetExportStrategy(std::make_unique<TStringExportStrategy>(&output))
+            .SetMemoryBudget(budget, {EAdmissionMode::FailFast, std::chrono::milliseconds(0)})
+            .Build();
+    };
+
+    // Таблица больше бюджета: отказ до чтения
+    TCountingProvider* provider = nullptr;
+    TMemoryBudget small(tableBytes / 2);
+    auto rejected = makeReport(small, provider);
+    EXPECT_FALSE(rejected->Generate().Success);
+    EXPECT_EQ(provider->Fetches, 0);
+
+    // Во время фильтра в памяти вход и результат
+    TMemoryBudget unlimited;
+    auto report = makeReport(unlimited, provider);
+    ASSERT_TRUE(report->Generate().Success);
+    EXPECT_EQ(provider->Fetches, 1);
+    EXPECT_GE(report->GetLastPeakReservedBytes(), tableBytes * 2);
+}
+
+TEST(MemoryBudgetTest, QueuedReservationReleasesHeldMemoryWhileWaiting) {
+    // Два резерва держат часть бюджета и оба хотят больше, чем осталось: пока
+    // один ждет, его память доступна другому, и никто не стоит до таймаута
+    TMemoryBudget budget(1000);
+    TAdmissionOptions options{EAdmissionMode::Queue, std::chrono::milliseconds(5000)};
+    TMemoryReservation first(budget);
+    TMemoryReservation second(budget);
+    ASSERT_TRUE(first.Resize(400, options));
+    ASSERT_TRUE(second.Resize(400, options));
+
+    const auto started = std::chrono::steady_clock::now();
+    std::thread waiter([&] { EXPECT_TRUE(first.Resize(700, options)); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_TRUE(second.Resize(700, options));
+    EXPECT_LT(std::chrono::steady_clock::now() - started, std::chrono::seconds(2));
+    second.Resize(200, options); // второй отчет закончил основную работу
+    waiter.join();
+    EXPECT_LT(std::chrono::steady_clock::now() - started, std::chrono::seconds(2));
+    EXPECT_EQ(budget.GetUsedBytes(), 900);
+
+    // Отказ по таймауту возвращает удерживаемую память
+    EXPECT_FALSE(second.Resize(400, {EAdmissionMode::Queue, std::chrono::milliseconds(10)}));
+    EXPECT_EQ(second.GetBytes(), 200);
+    EXPECT_EQ(budget.GetUsedBytes(), 900);
+}
+
+TEST(MetricsTest, RegistryExposesOpenMetrics) {
+    TMetricsRegistry registry;
+    auto& counter = registry.GetCounter("test_events", "Test events.", {{"kind", "a\"b"}});
+    auto& histogram = registry.GetHistogram("test_latency_seconds", "Test latency.", {}, {0.1, 1.0});
+    auto& gauge = registry.GetGauge("test_in_flight", "Test gauge.");
+    counter.Inc(3);
+    gauge.Add(5);
+    gauge.Add(-2);
+    histogram.Observe(0.05);
+    histogram.Observe(0.5);
+    histogram.Observe(5.0);
+
+    EXPECT_EQ(&counter, &registry.GetCounter("test_events", "Test events.", {{"kind", "a\"b"}}));
+    EXPECT_THROW(registry.GetHistogram("test_events", "Wrong type."), std::logic_error);
+
+    std::string text = registry.Expose();
+    EXPECT_NE(text.find("# TYPE test_events counter"), std::string::npos);
+    EXPECT_NE(text.find("test_events_total{kind=\"a\\\"b\"} 3"), std::string::npos);
+    EXPECT_NE(text.find("test_latency_seconds_bucket{le=\"0.1\"} 1"), std::string::npos);
+    EXPECT_NE(text.find("test_latency_seconds_bucket{le=\"1\"} 2"), std::string::npos);
+    EXPECT_NE(text.find("test_latency_seconds_bucket{le=\"+Inf\"} 3"), std::string::npos);
+    EXPECT_NE(text.find("test_latency_seconds_count 3"), std::string::npos);
+    EXPECT_NE(text.find("# TYPE test_in_flight gauge\n# HELP test_in_flight Test gauge.\ntest_in_flight 3\n"),
+              std::string::npos);
+    EXPECT_EQ(text.substr(text.size() - 6), "# EOF\n");
+
+    ASSERT_TRUE(registry.DumpToFile("test_metrics.txt"));
+    std::ifstream dump("test_metrics.txt");
+    std::string dumped((std::istreambuf_iterator<char>(dump)), std::istreambuf_iterator<char>());
+    EXPECT_EQ(dumped, text);
+    std::remove("test_metrics.txt");
+}
+
 int main(int argc, char** argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();